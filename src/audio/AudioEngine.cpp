@@ -1,7 +1,15 @@
 #include "AudioEngine.h"
+#include "core/FrameTime.h"
+#include "core/MemoryBudget.h"
+#include "core/Trace.h"
 #include "core/Utils.h"
+#include "platform/RealtimeChecker.h"
+#include "platform/RealtimeSupport.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 #include <thread>
 
@@ -11,6 +19,176 @@
 #define DR_MP3_IMPLEMENTATION
 #include "dr_mp3.h"
 
+#include "DecoderInput.h"
+
+namespace
+{
+    constexpr uint64_t kDecodeChunkFrames = 65536;
+    constexpr std::chrono::seconds kXrunReportInterval{1};
+    // Share of a background load's progress taken by decoding; the rest is the caller's preparation
+    constexpr float kDecodeProgressShare = 0.8f;
+
+    // Counts a background job's buffers as scratch until the job returns them to the UI thread
+    class ScratchUsage
+    {
+    public:
+        explicit ScratchUsage(MemoryBudget* budget) : m_budget(budget) {}
+        ~ScratchUsage()
+        {
+            if (m_budget)
+                m_budget->release(MemoryCategory::Scratch, m_bytes);
+        }
+        ScratchUsage(const ScratchUsage&) = delete;
+        ScratchUsage& operator=(const ScratchUsage&) = delete;
+
+        void add(size_t bytes)
+        {
+            m_bytes += bytes;
+            if (m_budget)
+                m_budget->add(MemoryCategory::Scratch, bytes);
+        }
+
+    private:
+        MemoryBudget* m_budget;
+        size_t m_bytes = 0;
+    };
+
+    // Calls wake when a background job returns, whichever way it returns
+    class WakeOnReturn
+    {
+    public:
+        explicit WakeOnReturn(const std::function<void()>& wake) : m_wake(wake) {}
+        ~WakeOnReturn()
+        {
+            if (m_wake)
+                m_wake();
+        }
+        WakeOnReturn(const WakeOnReturn&) = delete;
+        WakeOnReturn& operator=(const WakeOnReturn&) = delete;
+
+    private:
+        const std::function<void()>& m_wake;
+    };
+
+    // Linear interpolation fed chunk by chunk; gives the same frames as resampling the
+    // whole track at once, without holding it in memory
+    class StreamResampler
+    {
+    public:
+        StreamResampler(uint32_t channels, uint32_t sourceRate, uint32_t targetRate)
+            : m_channels(channels),
+              m_ratio(static_cast<double>(targetRate) / static_cast<double>(sourceRate)),
+              m_lastFrame(channels, 0.0f)
+        {
+        }
+
+        // Replaces out with every output frame whose two source frames are known
+        void process(const float* input, uint64_t frames, std::vector<float>& out)
+        {
+            out.clear();
+            const uint64_t firstSource = m_consumed;
+            m_consumed += frames;
+            const auto sourceFrame = [&](uint64_t index) {
+                return (index < firstSource) ? m_lastFrame.data() : input + (index - firstSource) * m_channels;
+            };
+
+            for (;; ++m_nextOutput)
+            {
+                const double sourcePos = static_cast<double>(m_nextOutput) / m_ratio;
+                const uint64_t index0 = static_cast<uint64_t>(sourcePos);
+                if (index0 + 1 >= m_consumed)
+                    break;
+                const float frac = static_cast<float>(sourcePos - static_cast<double>(index0));
+                const float* frame0 = sourceFrame(index0);
+                const float* frame1 = sourceFrame(index0 + 1);
+                for (uint32_t ch = 0; ch < m_channels; ++ch)
+                    out.push_back(frame0[ch] + frac * (frame1[ch] - frame0[ch]));
+            }
+
+            if (frames > 0)
+                std::copy(input + (frames - 1) * m_channels, input + frames * m_channels, m_lastFrame.begin());
+        }
+
+        // The remaining frames all fall on the last source frame
+        void finish(std::vector<float>& out)
+        {
+            out.clear();
+            const uint64_t outputFrames = static_cast<uint64_t>(m_consumed * m_ratio);
+            for (; m_nextOutput < outputFrames; ++m_nextOutput)
+                out.insert(out.end(), m_lastFrame.begin(), m_lastFrame.end());
+        }
+
+    private:
+        uint32_t m_channels;
+        double m_ratio;
+        std::vector<float> m_lastFrame;
+        uint64_t m_consumed = 0;
+        uint64_t m_nextOutput = 0;
+    };
+
+    // Streams frames from readFrames(buffer, maxFrames) into store, resampling to the store's
+    // rate on the way. onProgress receives 0..1 and may return false to abort.
+    template <typename ReadFrames>
+    bool decodeIntoStore(ReadFrames&& readFrames, uint64_t totalFrames, uint32_t sourceRate, PcmStore& store,
+                         const std::function<bool(float)>& onProgress)
+    {
+        const uint32_t channels = store.channelCount();
+        std::unique_ptr<StreamResampler> resampler;
+        if (sourceRate != store.sampleRate())
+        {
+            std::cout << "AudioEngine: Resampling from " << sourceRate << " Hz to " << store.sampleRate() << " Hz" << std::endl;
+            resampler = std::make_unique<StreamResampler>(channels, sourceRate, store.sampleRate());
+            store.reserveFrames(static_cast<uint64_t>(totalFrames * (static_cast<double>(store.sampleRate()) / sourceRate)));
+        }
+        else
+        {
+            store.reserveFrames(totalFrames);
+        }
+
+        // Read in chunks so progress can be reported and the load aborted
+        std::vector<float> chunk(static_cast<size_t>(kDecodeChunkFrames) * channels);
+        std::vector<float> resampled;
+        uint64_t framesRead = 0;
+        while (framesRead < totalFrames)
+        {
+            const uint64_t framesToRead = std::min<uint64_t>(kDecodeChunkFrames, totalFrames - framesRead);
+            uint64_t chunkFrames = 0;
+            {
+                Trace::Span span("Decode chunk");
+                chunkFrames = readFrames(chunk.data(), framesToRead);
+            }
+            if (chunkFrames == 0)
+                break;
+            framesRead += chunkFrames;
+
+            if (resampler)
+            {
+                {
+                    Trace::Span span("Resample chunk");
+                    resampler->process(chunk.data(), chunkFrames, resampled);
+                }
+                Trace::Span span("Store chunk");
+                store.append(resampled.data(), resampled.size() / channels);
+            }
+            else
+            {
+                Trace::Span span("Store chunk");
+                store.append(chunk.data(), chunkFrames);
+            }
+
+            if (onProgress && !onProgress(static_cast<float>(framesRead) / static_cast<float>(totalFrames)))
+                return false;
+        }
+
+        if (resampler)
+        {
+            resampler->finish(resampled);
+            store.append(resampled.data(), resampled.size() / channels);
+        }
+        return framesRead > 0;
+    }
+}
+
 AudioEngine::AudioEngine()
 {
 }
@@ -18,6 +196,8 @@ AudioEngine::AudioEngine()
 AudioEngine::~AudioEngine()
 {
     shutdown();
+    delete m_takePlayback.exchange(nullptr);
+    delete m_playback.exchange(nullptr);
 }
 
 bool AudioEngine::initialize()
@@ -25,6 +205,13 @@ bool AudioEngine::initialize()
     if (m_initialized)
         return true;
 
+    if (m_offlineSampleRate != 0)
+    {
+        m_deviceSampleRate = m_offlineSampleRate;
+        m_initialized = true;
+        return true;
+    }
+
     try
     {
         m_rtaudio = std::make_unique<RtAudio>(RtAudio::Api::UNSPECIFIED);
@@ -51,6 +238,16 @@ bool AudioEngine::initialize()
         if (m_deviceSampleRate == 0)
             m_deviceSampleRate = 44100;
 
+        // The microphone is optional: mono from the first channel of the default input
+        const unsigned int inputDevice = m_rtaudio->getDefaultInputDevice();
+        if (m_rtaudio->getDeviceInfo(inputDevice).inputChannels > 0)
+        {
+            m_defaultInputDeviceId = static_cast<int>(inputDevice);
+            m_inputParams.deviceId = inputDevice;
+            m_inputParams.nChannels = 1;
+            m_inputParams.firstChannel = 0;
+        }
+
         m_streamOptions.flags = 0;  // use interleaved buffers (default)
         m_streamOptions.streamName = "SongPractice";
 
@@ -64,8 +261,54 @@ bool AudioEngine::initialize()
     }
 }
 
+void AudioEngine::initializeAsync()
+{
+    if (m_initialized || m_initResult.valid())
+        return;
+
+    m_initResult = std::async(std::launch::async, [this]() {
+        const auto start = std::chrono::steady_clock::now();
+        const bool initialized = initialize();
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "AudioEngine: Device initialization took " << elapsed.count() << " ms" << std::endl;
+        return initialized;
+    }).share();
+}
+
+bool AudioEngine::waitUntilInitialized()
+{
+    if (m_initResult.valid())
+        return m_initResult.get();
+    return m_initialized;
+}
+
+bool AudioEngine::isInitializing() const
+{
+    return m_initResult.valid() && m_initResult.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+std::shared_future<bool> AudioEngine::initializationResult() const
+{
+    return m_initResult;
+}
+
+uint32_t AudioEngine::deviceSampleRate() const
+{
+    return m_deviceSampleRate;
+}
+
+void AudioEngine::setMemoryBudget(MemoryBudget* budget)
+{
+    m_memoryBudget = budget;
+    reportMemoryUsage();
+}
+
 void AudioEngine::shutdown()
 {
+    clearNextTrack();
+    cancelPendingLoads();
+    waitUntilInitialized();
+    m_initResult = {};
     if (!m_initialized)
         return;
 
@@ -90,221 +333,1075 @@ bool AudioEngine::loadAudioFile(const char* filePath)
     if (path.empty())
         return false;
 
-    unloadAudio();
+    waitUntilInitialized();
 
-    std::string extension = Utils::getFileExtension(path);
+    DecodedAudio audio;
+    if (!decodeAudioFile(path, m_deviceSampleRate, audio, {}, pcmResidentLimit()))
+    {
+        unloadAudio();
+        return false;
+    }
+
+    return installDecodedAudio(std::move(audio));
+}
+
+bool AudioEngine::decodeAudioFile(const std::string& filePath, uint32_t targetSampleRate, DecodedAudio& out,
+                                  const std::function<bool(float)>& onProgress, size_t residentLimitBytes)
+{
+    Trace::Span span("Decode file", filePath.c_str());
+    std::string extension = Utils::getFileExtension(filePath);
     bool loaded = false;
 
+    // Decoding and resampling are reported as 0..0.9 of the work
+    bool aborted = false;
+    const std::function<bool(float)> onDecodeProgress = [&onProgress, &aborted](float fraction) {
+        aborted = onProgress && !onProgress(fraction * 0.9f);
+        return !aborted;
+    };
+
     if (extension == "wav")
     {
-        loaded = loadWavFile(path.c_str());
+        loaded = decodeWavFile(filePath.c_str(), targetSampleRate, residentLimitBytes, out, onDecodeProgress);
     }
     else if (extension == "mp3")
     {
-        loaded = loadMp3File(path.c_str());
+        loaded = decodeMp3File(filePath.c_str(), targetSampleRate, residentLimitBytes, out, onDecodeProgress);
     }
     else
     {
         // Attempt to load using both handlers in case extension is missing or unusual
-        loaded = loadWavFile(path.c_str());
-        if (!loaded)
-            loaded = loadMp3File(path.c_str());
+        loaded = decodeWavFile(filePath.c_str(), targetSampleRate, residentLimitBytes, out, onDecodeProgress);
+        if (!loaded && !aborted)
+            loaded = decodeMp3File(filePath.c_str(), targetSampleRate, residentLimitBytes, out, onDecodeProgress);
     }
 
     if (!loaded)
     {
-        resetState();
-        std::cerr << "AudioEngine: Failed to load audio file " << path << std::endl;
+        if (!aborted)
+            std::cerr << "AudioEngine: Failed to load audio file " << filePath << std::endl;
+        return false;
+    }
+
+    out.filePath = filePath;
+
+    if (onProgress)
+        onProgress(1.0f);
+    return true;
+}
+
+bool AudioEngine::installDecodedAudio(DecodedAudio&& audio)
+{
+    Trace::Span span("Install track", audio.filePath.c_str());
+    waitUntilInitialized();
+    clearNextTrack();
+    unloadAudio();
+    ++m_trackGeneration;
+
+    if (!audio.pcm || audio.pcm->empty() || audio.channelCount == 0 || audio.sampleRate == 0)
+        return false;
+
+    // Playback reads the original store until a tempo pass produces a stretched one
+    m_originalAudio = std::move(audio.pcm);
+    m_originalAudio->startReadAhead();
+    m_channelCount = audio.channelCount;
+    m_sampleRate = audio.sampleRate;
+    m_frameCount = audio.frameCount;
+
+    m_loadedFilePath = audio.filePath;
+    m_hasAudio = true;
+    m_playbackFrameIndex.store(0);
+    ++m_playheadEpoch;
+    m_currentFrame.store(0);
+    m_endOfStream.store(false);
+    m_duration = static_cast<float>(m_frameCount) / static_cast<float>(m_sampleRate);
+
+    auto playback = std::make_unique<PlaybackTrack>();
+    playback->pcm = m_originalAudio;
+    playback->frameCount = m_frameCount;
+    m_tempoMultiplier.store(1.0f);
+
+    // Re-open stream for this audio format
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        closeStreamLocked();
+        publishPlaybackLocked(std::move(playback));
+        m_streamSampleRate = m_sampleRate;
+        m_streamChannels = m_channelCount;
+        if (!openStreamLocked())
+        {
+            std::cerr << "AudioEngine: Failed to open RtAudio stream" << std::endl;
+            m_hasAudio = false;
+            resetState();
+            return false;
+        }
+        // The mic is tracked while paused too
+        if (m_streamHasInput)
+            startStreamLocked();
+    }
+
+    std::cout << "AudioEngine: Loaded file " << m_loadedFilePath
+              << " (" << m_channelCount << " channels, "
+              << m_sampleRate << " Hz, "
+              << m_frameCount << " frames)" << std::endl;
+
+    reportMemoryUsage();
+    return true;
+}
+
+std::shared_ptr<AudioLoadHandle> AudioEngine::loadAudioFileAsync(const std::string& filePath,
+                                                                 LoadCompletion onComplete,
+                                                                 LoadPreparation prepare)
+{
+    // Only the newest request matters; older ones stop at their next chunk
+    for (PendingLoad& pending : m_pendingLoads)
+        pending.handle->cancel();
+
+    auto handle = std::make_shared<AudioLoadHandle>(filePath);
+
+    PendingLoad load;
+    load.handle = handle;
+    load.onComplete = std::move(onComplete);
+    load.result = std::async(std::launch::async,
+                             [this, handle, prepare = std::move(prepare), deviceReady = m_initResult,
+                              residentLimit = pcmResidentLimit()]() {
+        RealtimeSupport::configureWorkerThread();
+        Trace::setThreadName("Loader");
+        Trace::Span span("Load track", handle->filePath().c_str());
+        WakeOnReturn wake(m_wakeCallback);
+        DecodedAudio audio;
+        ScratchUsage scratch(m_memoryBudget);
+
+        // Resampling targets the device rate, so wait for enumeration to finish
+        if (deviceReady.valid())
+            deviceReady.wait();
+
+        const float decodeShare = prepare ? kDecodeProgressShare : 1.0f;
+        const auto onProgress = [&handle, decodeShare](float fraction) {
+            handle->m_progress.store(fraction * decodeShare);
+            return !handle->isCancelled();
+        };
+        if (!decodeAudioFile(handle->filePath(), m_deviceSampleRate, audio, onProgress, residentLimit)
+            || handle->isCancelled())
+            return DecodedAudio{};
+        scratch.add(audio.pcm->residentBytes());
+
+        if (prepare)
+        {
+            Trace::Span prepareSpan("Prepare track");
+            prepare(audio);
+        }
+        handle->m_progress.store(1.0f);
+        return audio;
+    });
+
+    m_pendingLoads.push_back(std::move(load));
+    return handle;
+}
+
+void AudioEngine::update()
+{
+    // Collect first: completion callbacks may start new loads
+    std::vector<PendingLoad> finished;
+    for (auto it = m_pendingLoads.begin(); it != m_pendingLoads.end();)
+    {
+        if (it->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            finished.push_back(std::move(*it));
+            it = m_pendingLoads.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    updateNextTrack();
+
+    for (PendingLoad& load : finished)
+    {
+        DecodedAudio audio = load.result.get();
+
+        AudioLoadStatus status = AudioLoadStatus::Failed;
+        if (load.handle->isCancelled())
+            status = AudioLoadStatus::Cancelled;
+        else if (audio.pcm && installDecodedAudio(std::move(audio)))
+            status = AudioLoadStatus::Loaded;
+
+        load.handle->m_finished.store(true);
+        if (load.onComplete)
+            load.onComplete(status);
+    }
+
+    releaseRetired();
+    reportMemoryUsage();
+    updateMemoryLocks();
+    reportXruns();
+}
+
+bool AudioEngine::isLoading() const
+{
+    return !m_pendingLoads.empty();
+}
+
+void AudioEngine::cancelPendingLoads()
+{
+    for (PendingLoad& pending : m_pendingLoads)
+        pending.handle->cancel();
+    // Destroying the futures waits for the loader threads
+    m_pendingLoads.clear();
+}
+
+std::shared_ptr<AudioLoadHandle> AudioEngine::preloadNextTrack(const std::string& filePath,
+                                                               float tempoMultiplier,
+                                                               LoadPreparation prepare)
+{
+    clearNextTrack();
+
+    auto handle = std::make_shared<AudioLoadHandle>(filePath);
+    const float tempo = std::clamp(tempoMultiplier, 0.25f, 4.0f);
+
+    m_pendingPreload.handle = handle;
+    m_pendingPreload.result = std::async(std::launch::async,
+                                         [this, handle, tempo, prepare = std::move(prepare), deviceReady = m_initResult,
+                                          residentLimit = pcmResidentLimit()]() {
+        RealtimeSupport::configureWorkerThread();
+        Trace::setThreadName("Preload");
+        Trace::Span span("Preload track", handle->filePath().c_str());
+        WakeOnReturn wake(m_wakeCallback);
+        std::unique_ptr<QueuedTrack> track;
+        ScratchUsage scratch(m_memoryBudget);
+        if (deviceReady.valid())
+            deviceReady.wait();
+
+        auto next = std::make_unique<QueuedTrack>();
+        const auto onDecodeProgress = [&handle](float fraction) {
+            handle->m_progress.store(fraction * 0.5f);
+            return !handle->isCancelled();
+        };
+        if (!decodeAudioFile(handle->filePath(), m_deviceSampleRate, next->audio, onDecodeProgress, residentLimit))
+            return track;
+        const PcmStore& original = *next->audio.pcm;
+        scratch.add(original.residentBytes());
+
+        // The decoded original is already counted; the stretched copy has to fit as well
+        const bool stretch = std::abs(tempo - 1.0f) >= 0.001f;
+        size_t processedBytes = 0;
+        if (stretch)
+        {
+            processedBytes = static_cast<size_t>(original.frameCount() * original.channelCount() * sizeof(float) / tempo);
+            if (residentLimit > 0)
+                processedBytes = std::min(processedBytes, residentLimit);
+        }
+        if (m_memoryBudget && processedBytes > m_memoryBudget->available())
+        {
+            std::cout << "AudioEngine: Not preloading " << handle->filePath() << " ("
+                      << (processedBytes >> 20) << " MiB more needed, " << (m_memoryBudget->available() >> 20)
+                      << " MiB left in the memory budget)" << std::endl;
+            return track;
+        }
+        scratch.add(processedBytes);
+
+        next->playback = std::make_unique<PlaybackTrack>();
+        PlaybackTrack& playback = *next->playback;
+        playback.tempo = tempo;
+        if (!stretch)
+        {
+            playback.pcm = next->audio.pcm;
+        }
+        else
+        {
+            playback.pcm = std::make_shared<PcmStore>(original.channelCount(), original.sampleRate(), residentLimit);
+            stretchBuffer(original, tempo, *playback.pcm, playback.timeMap,
+                          [&handle](float fraction) {
+                              handle->m_progress.store(0.5f + fraction * 0.4f);
+                              return !handle->isCancelled();
+                          });
+        }
+        if (handle->isCancelled() || playback.pcm->empty())
+            return track;
+        playback.frameCount = playback.pcm->frameCount();
+
+        if (prepare)
+        {
+            Trace::Span prepareSpan("Prepare track");
+            prepare(next->audio);
+        }
+        // Pages the start back in if the stretch pushed it out, ready for the rollover
+        playback.pcm->startReadAhead();
+        handle->m_progress.store(1.0f);
+        track = std::move(next);
+        return track;
+    });
+
+    return handle;
+}
+
+void AudioEngine::clearNextTrack()
+{
+    if (m_pendingPreload.handle)
+    {
+        m_pendingPreload.handle->cancel();
+        m_pendingPreload = PendingPreload{};  // Waits for the worker, which stops at its next chunk
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        m_queuedTrackArmed.store(false);
+    }
+
+    if (m_queuedTrackTaken.load())
+        finishTrackSwitch();
+    else
+        m_queuedTrack.reset();
+}
+
+bool AudioEngine::hasNextTrack() const
+{
+    return m_queuedTrack != nullptr && !m_queuedTrackTaken.load();
+}
+
+const std::string& AudioEngine::nextTrackPath() const
+{
+    static const std::string noTrack;
+    return hasNextTrack() ? m_queuedTrack->audio.filePath : noTrack;
+}
+
+bool AudioEngine::switchToNextTrack()
+{
+    if (!hasNextTrack())
+        return false;
+
+    if (m_queuedTrackArmed.load())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_streamMutex);
+            if (!takeQueuedTrackLocked())
+                return false;
+        }
+        finishTrackSwitch();
+        return true;
+    }
+
+    // Channel layout differs: the stream has to be reopened for the new track
+    std::unique_ptr<QueuedTrack> next = std::move(m_queuedTrack);
+    const bool wasPlaying = isPlaying();
+    if (!installDecodedAudio(std::move(next->audio)))
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        m_tempoMultiplier.store(next->playback->tempo);
+        publishPlaybackLocked(std::move(next->playback));
+    }
+
+    m_trackSwitched = true;
+    if (wasPlaying)
+        play();
+    return true;
+}
+
+bool AudioEngine::takeTrackSwitch()
+{
+    const bool switched = m_trackSwitched;
+    m_trackSwitched = false;
+    return switched;
+}
+
+void AudioEngine::updateNextTrack()
+{
+    if (m_pendingPreload.result.valid()
+        && m_pendingPreload.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        std::unique_ptr<QueuedTrack> track = m_pendingPreload.result.get();
+        const bool cancelled = m_pendingPreload.handle->isCancelled();
+        m_pendingPreload.handle->m_finished.store(true);
+        m_pendingPreload = PendingPreload{};
+
+        if (track && !cancelled)
+        {
+            m_queuedTrack = std::move(track);
+            // Gapless rollover only when the open stream can carry on with the same format
+            const bool formatMatches = m_streamOpen
+                                       && m_queuedTrack->audio.channelCount == m_streamChannels
+                                       && m_queuedTrack->audio.sampleRate == m_streamSampleRate;
+            m_queuedTrackArmed.store(formatMatches);
+            std::cout << "AudioEngine: Preloaded " << m_queuedTrack->audio.filePath
+                      << (formatMatches ? " (gapless)" : " (format differs, stream will be reopened)") << std::endl;
+        }
+    }
+
+    // The callback rolled over; finish the switch once no tempo pass is reading the old original
+    if (m_queuedTrackTaken.load() && !m_tempoProcessingInProgress.load())
+        finishTrackSwitch();
+
+    // Without gapless rollover, move on when the current track has played out
+    if (m_queuedTrack && !m_queuedTrackArmed.load() && !m_queuedTrackTaken.load() && isPlaybackFinished())
+    {
+        if (switchToNextTrack())
+            play();
+    }
+}
+
+bool AudioEngine::takeQueuedTrackLocked()
+{
+    if (!m_queuedTrackArmed.load() || !m_queuedTrack)
         return false;
+
+    // Pointer swap without allocating; finishTrackSwitch() retires the previous track
+    PlaybackTrack* next = m_queuedTrack->playback.release();
+    m_queuedTrack->playback.reset(m_playback.exchange(next));
+    m_tempoMultiplier.store(next->tempo);
+    m_playbackFrameIndex.store(0);
+    ++m_playheadEpoch;
+    m_currentFrame.store(0);
+    m_endOfStream.store(false);
+    ++m_trackGeneration;
+
+    m_queuedTrackArmed.store(false);
+    m_queuedTrackTaken.store(true);
+    return true;
+}
+
+void AudioEngine::finishTrackSwitch()
+{
+    std::unique_ptr<QueuedTrack> previous;
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        retireLocked(std::move(m_queuedTrack->playback));
+        m_originalAudio.swap(m_queuedTrack->audio.pcm);
+        m_frameCount = m_queuedTrack->audio.frameCount;
+        m_duration = static_cast<float>(m_frameCount) / static_cast<float>(m_sampleRate);
+        m_loadedFilePath = m_queuedTrack->audio.filePath;
+        previous = std::move(m_queuedTrack);
+        m_queuedTrackTaken.store(false);
+    }
+
+    // previous now holds the old original; the retired track keeps what the callback may read
+    previous.reset();
+    m_trackSwitched = true;
+    std::cout << "AudioEngine: Switched to " << m_loadedFilePath << " without reopening the stream" << std::endl;
+}
+
+const AudioEngine::PlaybackTrack* AudioEngine::playbackTrack() const
+{
+    return m_playback.load();
+}
+
+float AudioEngine::activeTempo() const
+{
+    const PlaybackTrack* track = playbackTrack();
+    return track ? track->tempo : 1.0f;
+}
+
+void AudioEngine::publishPlaybackLocked(std::unique_ptr<PlaybackTrack> track)
+{
+    retireLocked(std::unique_ptr<PlaybackTrack>(m_playback.exchange(track.release())));
+}
+
+void AudioEngine::retireLocked(std::unique_ptr<PlaybackTrack> track)
+{
+    if (track)
+        m_retiredPlayback.push_back({std::move(track), nullptr, m_callbackBlocks.load()});
+}
+
+void AudioEngine::retireLocked(std::unique_ptr<TakePlayback> take)
+{
+    if (take)
+        m_retiredPlayback.push_back({nullptr, std::move(take), m_callbackBlocks.load()});
+}
+
+void AudioEngine::releaseRetired()
+{
+    std::vector<RetiredPlayback> released;
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        // Offline the callback runs on this thread; a stopped stream has no callback in flight
+        const bool idle = !m_rtaudio || !m_streamRunning;
+        // The block in flight when it was replaced, then one that started after it
+        const uint64_t finished = m_callbackBlocks.load();
+        const auto readable = std::stable_partition(m_retiredPlayback.begin(), m_retiredPlayback.end(),
+                                                    [idle, finished](const RetiredPlayback& retired) {
+                                                        return !idle && finished < retired.callbackBlocks + 2;
+                                                    });
+        std::move(readable, m_retiredPlayback.end(), std::back_inserter(released));
+        m_retiredPlayback.erase(readable, m_retiredPlayback.end());
+    }
+    // Dropping the last reference to a paged store deletes its cache file; kept off the lock
+    released.clear();
+}
+
+void AudioEngine::unloadAudio()
+{
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        closeStreamLocked();
+        resetState();
+    }
+    // A take belongs to the track it was sung over; the callback is stopped
+    delete m_takePlayback.exchange(nullptr);
+    reportMemoryUsage();
+}
+
+void AudioEngine::play()
+{
+    if (!m_initialized || !m_hasAudio)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    if (!ensureStreamReadyLocked() || !startStreamLocked())
+        return;
+
+    m_playing.store(true);
+    m_endOfStream.store(false);
+}
+
+void AudioEngine::pause()
+{
+    m_playing.store(false);
+    m_metronome.cancelCountIn();
+}
+
+void AudioEngine::stop()
+{
+    m_playing.store(false);
+    m_metronome.cancelCountIn();
+    m_playbackFrameIndex.store(0);
+    ++m_playheadEpoch;
+    m_currentFrame.store(0);
+    m_endOfStream.store(false);
+}
+
+void AudioEngine::seekToFrame(uint64_t frame)
+{
+    if (!m_hasAudio || m_sampleRate == 0)
+        return;
+
+    // The tempo thread publishes a new track together with the position mapped into it
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    const PlaybackTrack* track = playbackTrack();
+    if (track == nullptr)
+        return;
+
+    // Clamp to the original length, then map into the processed buffer
+    const uint64_t originalFrame = std::min(frame, m_frameCount);
+    const uint64_t processedFrame = std::min(track->timeMap.toProcessed(originalFrame), track->frameCount);
+
+    m_playbackFrameIndex.store(processedFrame);
+    ++m_playheadEpoch;
+    track->pcm->setPlayhead(processedFrame);
+    m_currentFrame.store(originalFrame);
+    m_endOfStream.store(false);
+}
+
+void AudioEngine::seek(float timeSeconds)
+{
+    seekToFrame(FrameTime::fromSeconds(timeSeconds, m_sampleRate));
+}
+
+void AudioEngine::seekBy(float delay)
+{
+    const int64_t delta = static_cast<int64_t>(std::llround(static_cast<double>(delay) * m_sampleRate));
+    const int64_t target = static_cast<int64_t>(m_currentFrame.load()) + delta;
+    seekToFrame(target > 0 ? static_cast<uint64_t>(target) : 0);
+}
+
+void AudioEngine::setBeatGrid(double bpm, uint64_t firstBeatFrame, uint32_t beatsPerBar)
+{
+    m_metronome.setGrid(bpm, firstBeatFrame, beatsPerBar);
+}
+
+void AudioEngine::setMetronomeEnabled(bool enabled)
+{
+    m_metronome.setEnabled(enabled);
+}
+
+bool AudioEngine::metronomeEnabled() const
+{
+    return m_metronome.isEnabled();
+}
+
+void AudioEngine::setMetronomeVolume(float volume)
+{
+    m_metronome.setVolume(volume);
+}
+
+float AudioEngine::metronomeVolume() const
+{
+    return m_metronome.volume();
+}
+
+void AudioEngine::playWithCountIn(uint32_t bars)
+{
+    const double bpm = m_metronome.bpm();
+    if (bars > 0 && bpm > 0.0 && m_sampleRate > 0 && m_hasAudio && !m_playing.load())
+    {
+        // Beats as heard: the tempo multiplier shortens them in output frames
+        const double beatFrames = 60.0 * m_sampleRate / (bpm * activeTempo());
+        m_metronome.armCountIn(bars * m_metronome.beatsPerBar(), beatFrames);
+    }
+    play();
+    if (!m_playing.load())
+        m_metronome.cancelCountIn();
+}
+
+bool AudioEngine::isCountingIn() const
+{
+    return m_metronome.isCountingIn();
+}
+
+void AudioEngine::beginScrub(uint64_t frame)
+{
+    if (!m_initialized || !m_hasAudio)
+        return;
+
+    // Pausing keeps the stream running; a track that was never played starts it here. Under
+    // the lock a tempo change remaps the scrub into the track it publishes.
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    if (!ensureStreamReadyLocked() || !startStreamLocked())
+        return;
+
+    const PlaybackTrack* track = playbackTrack();
+    if (track == nullptr)
+        return;
+
+    frame = std::min(frame, m_frameCount);
+    m_scrubFrame.store(frame);
+    m_scrubber.begin(track->timeMap.toProcessed(frame));
+}
+
+void AudioEngine::scrubTo(uint64_t frame)
+{
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    const PlaybackTrack* track = playbackTrack();
+    if (!m_scrubber.isActive() || track == nullptr)
+        return;
+
+    frame = std::min(frame, m_frameCount);
+    m_scrubFrame.store(frame);
+    m_scrubber.setTarget(track->timeMap.toProcessed(frame));
+}
+
+void AudioEngine::endScrub()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        if (!m_scrubber.isActive())
+            return;
+        m_scrubber.end();
+    }
+    seekToFrame(m_scrubFrame.load());
+}
+
+bool AudioEngine::isScrubbing() const
+{
+    return m_scrubber.isActive();
+}
+
+bool AudioEngine::isPlaying() const
+{
+    return m_playing.load();
+}
+
+bool AudioEngine::hasAudio() const
+{
+    return m_hasAudio;
+}
+
+const std::string& AudioEngine::loadedFilePath() const
+{
+    return m_loadedFilePath;
+}
+
+bool AudioEngine::isStreamRunning() const
+{
+    return m_streamRunning;
+}
+
+bool AudioEngine::isPlaybackFinished() const
+{
+    return m_endOfStream.load();
+}
+
+bool AudioEngine::streamReady() const
+{
+    return m_streamOpen;
+}
+
+float AudioEngine::getDuration() const
+{
+    return m_duration;
+}
+
+uint64_t AudioEngine::getCurrentFrame() const
+{
+    return m_currentFrame.load();
+}
+
+float AudioEngine::getCurrentTime() const
+{
+    return static_cast<float>(FrameTime::toSeconds(m_currentFrame.load(), m_sampleRate));
+}
+
+float AudioEngine::getPlayheadTime() const
+{
+    if (m_scrubber.isActive())
+        return static_cast<float>(FrameTime::toSeconds(m_scrubFrame.load(), m_sampleRate));
+    if (!m_playing.load() || m_sampleRate == 0)
+        return getCurrentTime();
+
+    uint64_t epoch = 0;
+    int64_t hostTimeNs = 0;
+    uint64_t frameEnd = 0;
+    uint64_t originalFrameEnd = 0;
+    uint32_t blockFrames = 0;
+    float tempo = 1.0f;
+    const PlayheadStamp& stamp = m_playheadStamp;
+    for (;;)
+    {
+        const uint32_t sequence = stamp.sequence.load(std::memory_order_acquire);
+        epoch = stamp.epoch.load(std::memory_order_relaxed);
+        hostTimeNs = stamp.hostTimeNs.load(std::memory_order_relaxed);
+        frameEnd = stamp.frameEnd.load(std::memory_order_relaxed);
+        originalFrameEnd = stamp.originalFrameEnd.load(std::memory_order_relaxed);
+        blockFrames = stamp.blockFrames.load(std::memory_order_relaxed);
+        tempo = stamp.tempo.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((sequence & 1) == 0 && stamp.sequence.load(std::memory_order_relaxed) == sequence)
+            break;
     }
+    // No block rendered since the last seek or track change
+    if (hostTimeNs == 0 || epoch != m_playheadEpoch.load())
+        return getCurrentTime();
+
+    // The block's first frame reaches the speaker one output latency after the callback
+    // started, and later frames follow in real time. Never run ahead of what was rendered.
+    const int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    const double elapsedFrames = static_cast<double>(nowNs - hostTimeNs) * 1e-9 * m_sampleRate;
+    const double heardFrame = static_cast<double>(frameEnd) - blockFrames + elapsedFrames
+                              - m_streamLatencyFrames.load();
+    const double processedFrame = std::clamp(heardFrame, 0.0, static_cast<double>(frameEnd));
+    // Back from the block's end in original frames, at the tempo's rate
+    const double originalFrame = std::max(0.0, originalFrameEnd - (frameEnd - processedFrame) * tempo);
+    return std::min(static_cast<float>(originalFrame / m_sampleRate), m_duration);
+}
+
+uint32_t AudioEngine::getSampleRate() const
+{
+    return m_sampleRate;
+}
+
+uint32_t AudioEngine::getChannelCount() const
+{
+    return m_channelCount;
+}
 
-    m_loadedFilePath = path;
-    m_hasAudio = true;
-    m_playbackFrameIndex.store(0);
-    m_currentTime.store(0.0f);
-    m_endOfStream.store(false);
-    m_duration = (m_sampleRate > 0) ? static_cast<float>(m_frameCount) / static_cast<float>(m_sampleRate) : 0.0f;
+uint64_t AudioEngine::getFrameCount() const
+{
+    return m_frameCount;
+}
 
-    // Resample to device sample rate if needed
-    if (m_deviceSampleRate > 0 && m_sampleRate != m_deviceSampleRate)
+std::shared_ptr<const PcmStore> AudioEngine::getAudioData() const
+{
+    return m_originalAudio;
+}
+
+size_t AudioEngine::spillOriginalAudio()
+{
+    // At 1x the original is the playback store. Tempo passes read it; a pending switch replaces it.
+    const PlaybackTrack* track = playbackTrack();
+    if (!m_originalAudio || !track || m_originalAudio == track->pcm || m_tempoProcessingInProgress.load()
+        || m_queuedTrackTaken.load())
     {
-        std::cout << "AudioEngine: Resampling from " << m_sampleRate << " Hz to " << m_deviceSampleRate << " Hz" << std::endl;
-        resampleBuffer(m_originalAudioBuffer, m_channelCount, m_sampleRate, m_deviceSampleRate, m_frameCount);
-        m_processedAudioBuffer = m_originalAudioBuffer;
-        m_sampleRate = m_deviceSampleRate;
+        return 0;
     }
 
-    m_processedFrameCount = m_frameCount;  // Initially same as original
-    m_activeTempoMultiplier = 1.0f;
-    m_tempoMultiplier.store(1.0f);
-
-    // Re-open stream for this audio format
+    const auto start = std::chrono::steady_clock::now();
+    const size_t released = m_originalAudio->evictAll();
+    if (released > 0)
     {
-        std::lock_guard<std::mutex> lock(m_streamMutex);
-        closeStreamLocked();
-        m_streamSampleRate = m_sampleRate;
-        m_streamChannels = m_channelCount;
-        if (!openStreamLocked())
-        {
-            std::cerr << "AudioEngine: Failed to open RtAudio stream" << std::endl;
-            m_hasAudio = false;
-            resetState();
-            return false;
-        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "AudioEngine: Paged out " << (released >> 20) << " MiB of original audio in "
+                  << elapsed.count() << " ms" << std::endl;
     }
-
-    std::cout << "AudioEngine: Loaded file " << path
-              << " (" << m_channelCount << " channels, "
-              << m_sampleRate << " Hz, "
-              << m_frameCount << " frames)" << std::endl;
-
-    return true;
+    reportMemoryUsage();
+    return released;
 }
 
-void AudioEngine::unloadAudio()
+uint64_t AudioEngine::pageMisses() const
 {
-    stop();
-    std::lock_guard<std::mutex> lock(m_streamMutex);
-    closeStreamLocked();
-    resetState();
+    const PlaybackTrack* track = playbackTrack();
+    return track ? track->pcm->pageMisses() : 0;
 }
 
-void AudioEngine::play()
+void AudioEngine::setRealtimeSafety(bool enabled)
 {
-    if (!m_initialized || !m_hasAudio)
-        return;
-
-    std::lock_guard<std::mutex> lock(m_streamMutex);
-    if (!ensureStreamReadyLocked())
+    if (RealtimeSupport::isEnabled() == enabled)
         return;
+    RealtimeSupport::setEnabled(enabled);
 
-    if (!m_streamRunning)
+    // An idle stream is reopened with the new scheduling by the next play()
     {
-        try
-        {
-            RtAudioErrorType result = m_rtaudio->startStream();
-            if (result != RTAUDIO_NO_ERROR)
-            {
-                std::cerr << "AudioEngine: Failed to start stream - " << m_rtaudio->getErrorText() << std::endl;
-                return;
-            }
-            m_streamRunning = true;
-        }
-        catch (...)
-        {
-            std::cerr << "AudioEngine: Failed to start stream" << std::endl;
-            return;
-        }
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        if (m_streamOpen && !m_streamRunning)
+            closeStreamLocked();
     }
+    updateMemoryLocks();
+}
 
-    m_playing.store(true);
-    m_endOfStream.store(false);
+bool AudioEngine::realtimeSafety() const
+{
+    return RealtimeSupport::isEnabled();
 }
 
-void AudioEngine::pause()
+uint64_t AudioEngine::xrunCount() const
 {
-    m_playing.store(false);
+    return m_xrunCount.load();
 }
 
-void AudioEngine::stop()
+bool AudioEngine::callbackIsRealtime() const
 {
-    m_playing.store(false);
-    m_playbackFrameIndex.store(0);
-    m_currentTime.store(0.0f);
-    m_endOfStream.store(false);
+    return m_callbackRealtime.load();
 }
 
-void AudioEngine::seek(float timeSeconds)
+void AudioEngine::setWakeCallback(std::function<void()> wake)
 {
-    if (!m_hasAudio || m_sampleRate == 0)
+    m_wakeCallback = std::move(wake);
+}
+
+void AudioEngine::setInputEnabled(bool enabled)
+{
+    if (m_inputEnabled.exchange(enabled) == enabled)
         return;
 
-    // Clamp to original duration
-    const float clampedTime = std::max(0.0f, std::min(timeSeconds, m_duration));
+    // Reopened with or without input; a running stream keeps running
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    const bool wasRunning = m_streamRunning;
+    closeStreamLocked();
+    if (!m_initialized || !m_hasAudio || !ensureStreamReadyLocked())
+        return;
+    if (wasRunning || m_streamHasInput)
+        startStreamLocked();
+}
 
-    // Calculate position in original audio
-    const uint64_t originalFramePos = static_cast<uint64_t>(clampedTime * static_cast<float>(m_sampleRate));
+bool AudioEngine::inputEnabled() const
+{
+    return m_inputEnabled.load();
+}
 
-    // Map to processed buffer position
-    // At 50% tempo: processed buffer is 2x longer, so multiply by (1/tempo)
-    const float tempoRatio = m_activeTempoMultiplier;
-    const uint64_t processedFramePos = static_cast<uint64_t>(originalFramePos / tempoRatio);
+bool AudioEngine::inputActive() const
+{
+    return m_streamHasInput && m_streamRunning;
+}
 
-    m_playbackFrameIndex.store(std::min<uint64_t>(processedFramePos, m_processedFrameCount));
-    m_currentTime.store(clampedTime);
-    m_endOfStream.store(false);
+const LivePitchTracker& AudioEngine::livePitch() const
+{
+    return m_livePitch;
 }
 
-void AudioEngine::seekBy(float delay)
+bool AudioEngine::startRecording(const std::string& filePath, bool withBacking)
 {
-    const float currentTime = m_currentTime.load();
-    seek(currentTime + delay);
+    if (!inputActive())
+    {
+        std::cerr << "AudioEngine: Recording needs a running stream with input" << std::endl;
+        return false;
+    }
+    return m_recorder.start(filePath, m_streamSampleRate, m_streamChannels, withBacking);
 }
 
-bool AudioEngine::isPlaying() const
+void AudioEngine::stopRecording()
 {
-    return m_playing.load();
+    m_recorder.stop();
 }
 
-bool AudioEngine::hasAudio() const
+bool AudioEngine::takeFinishedRecording(RecordedTake& out)
 {
-    return m_hasAudio;
+    return m_recorder.takeFinished(out);
 }
 
-std::string AudioEngine::loadedFilePath() const
+const TakeRecorder& AudioEngine::recorder() const
 {
-    return m_loadedFilePath;
+    return m_recorder;
 }
 
-bool AudioEngine::isStreamRunning() const
+void AudioEngine::setTakePlayback(std::shared_ptr<const PcmStore> take, uint64_t startFrame, float tempo, bool muteTrack)
 {
-    return m_streamRunning;
+    TakePlayback* playback = nullptr;
+    if (take && !take->empty())
+    {
+        playback = new TakePlayback();
+        playback->pcm = std::move(take);
+        playback->startFrame = startFrame;
+        playback->tempo = tempo;
+        playback->muteTrack = muteTrack;
+        playback->trackGeneration = m_trackGeneration.load();
+        playback->scratch.resize(static_cast<size_t>(std::max(m_bufferFrames, 256u)) * playback->pcm->channelCount());
+    }
+    // The callback may be inside a block that reads the previous take; update() frees it later
+    std::lock_guard<std::mutex> lock(m_streamMutex);
+    retireLocked(std::unique_ptr<TakePlayback>(m_takePlayback.exchange(playback, std::memory_order_acq_rel)));
 }
 
-bool AudioEngine::isPlaybackFinished() const
+bool AudioEngine::hasTakePlayback() const
 {
-    return m_endOfStream.load();
+    return m_takePlayback.load() != nullptr;
 }
 
-bool AudioEngine::streamReady() const
+void AudioEngine::setOfflineRendering(uint32_t sampleRate)
 {
-    return m_streamOpen;
+    if (m_initialized || m_initResult.valid())
+    {
+        std::cerr << "AudioEngine: Offline rendering must be selected before initialization" << std::endl;
+        return;
+    }
+    m_offlineSampleRate = sampleRate;
 }
 
-float AudioEngine::getDuration() const
+bool AudioEngine::setOfflineInput(const std::string& filePath)
 {
-    return m_duration;
+    if (m_offlineSampleRate == 0)
+    {
+        std::cerr << "AudioEngine: Simulated input needs the offline backend" << std::endl;
+        return false;
+    }
+
+    DecodedAudio decoded;
+    if (!decodeAudioFile(filePath, m_offlineSampleRate, decoded))
+    {
+        std::cerr << "AudioEngine: Failed to load simulated input " << filePath << std::endl;
+        return false;
+    }
+
+    const uint32_t channels = decoded.channelCount;
+    std::vector<float> interleaved(static_cast<size_t>(decoded.frameCount) * channels);
+    const uint64_t frames = decoded.pcm->read(0, interleaved.data(), decoded.frameCount);
+    m_offlineInput.assign(static_cast<size_t>(frames), 0.0f);
+    for (size_t frame = 0; frame < m_offlineInput.size(); ++frame)
+    {
+        for (uint32_t channel = 0; channel < channels; ++channel)
+            m_offlineInput[frame] += interleaved[frame * channels + channel];
+        m_offlineInput[frame] /= static_cast<float>(channels);
+    }
+    m_offlineInputPosition = 0;
+    return true;
 }
 
-float AudioEngine::getCurrentTime() const
+bool AudioEngine::renderOffline(float* output, unsigned int frames)
 {
-    return m_currentTime.load();
+    if (m_offlineSampleRate == 0 || !m_streamRunning || m_streamChannels == 0)
+        return false;
+
+    // The simulated microphone delivers the file's next frames with each block
+    const float* input = nullptr;
+    if (m_streamHasInput)
+    {
+        if (m_offlineInputBlock.size() < frames)
+            m_offlineInputBlock.resize(frames);
+        const size_t available = std::min<size_t>(frames, m_offlineInput.size() - m_offlineInputPosition);
+        std::copy_n(m_offlineInput.begin() + static_cast<ptrdiff_t>(m_offlineInputPosition), available,
+                    m_offlineInputBlock.begin());
+        std::fill(m_offlineInputBlock.begin() + static_cast<ptrdiff_t>(available),
+                  m_offlineInputBlock.begin() + frames, 0.0f);
+        m_offlineInputPosition += available;
+        input = m_offlineInputBlock.data();
+    }
+    processAudio(output, input, frames, 0);
+    return true;
 }
 
-uint32_t AudioEngine::getSampleRate() const
+void AudioEngine::updateMemoryLocks()
 {
-    return m_sampleRate;
+    std::shared_ptr<PcmStore> playback;
+    std::shared_ptr<PcmStore> original;
+    std::shared_ptr<PcmStore> next;
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        if (const PlaybackTrack* track = playbackTrack())
+            playback = track->pcm;
+        original = m_originalAudio;
+        if (m_queuedTrack && m_queuedTrack->playback)
+            next = m_queuedTrack->playback->pcm;
+    }
+
+    // Only what the callback may read is locked: the playback store and the armed next track
+    const bool enabled = RealtimeSupport::isEnabled();
+    if (original && original != playback)
+        original->setLocked(false);
+    if (playback)
+        playback->setLocked(enabled);
+    if (next)
+        next->setLocked(enabled);
 }
 
-uint32_t AudioEngine::getChannelCount() const
+void AudioEngine::reportXruns()
 {
-    return m_channelCount;
+    // The callback cannot log that it failed to get real-time scheduling
+    if (!m_priorityFailureReported && RealtimeSupport::isEnabled() && m_callbackThreadChecked.load()
+        && !m_callbackRealtime.load())
+    {
+        std::cerr << "AudioEngine: Audio callback runs without real-time scheduling; grant RLIMIT_RTPRIO "
+                     "(e.g. the audio group) for glitch-free playback" << std::endl;
+        m_priorityFailureReported = true;
+    }
+
+    const uint64_t xruns = m_xrunCount.load();
+    const auto now = std::chrono::steady_clock::now();
+    if (xruns == m_reportedXrunCount || now - m_lastXrunReport < kXrunReportInterval)
+        return;
+
+    std::cerr << "AudioEngine: " << (xruns - m_reportedXrunCount) << " output underflow(s) or input overflow(s), "
+              << xruns << " since start" << std::endl;
+    m_reportedXrunCount = xruns;
+    m_lastXrunReport = now;
 }
 
-uint64_t AudioEngine::getFrameCount() const
+size_t AudioEngine::pcmResidentLimit() const
 {
-    return m_frameCount;
+    // Original, playback and the next song's two stores share the budget with the waveform
+    return m_memoryBudget ? m_memoryBudget->limit() / 5 : 0;
 }
 
-const std::vector<float>& AudioEngine::getAudioData() const
+void AudioEngine::reportMemoryUsage()
 {
-    return m_originalAudioBuffer;
+    if (m_memoryBudget == nullptr)
+        return;
+
+    // The tempo thread and the audio callback swap the tracks under the lock
+    std::shared_ptr<PcmStore> processed;
+    std::shared_ptr<PcmStore> nextOriginal;
+    std::shared_ptr<PcmStore> nextProcessed;
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        if (const PlaybackTrack* track = playbackTrack())
+            processed = track->pcm;
+        if (m_queuedTrack)
+        {
+            nextOriginal = m_queuedTrack->audio.pcm;
+            if (m_queuedTrack->playback)
+                nextProcessed = m_queuedTrack->playback->pcm;
+        }
+    }
+
+    // A store shared between original and processed is counted once
+    const auto resident = [](const std::shared_ptr<PcmStore>& store) { return store ? store->residentBytes() : 0; };
+    const auto spilled = [](const std::shared_ptr<PcmStore>& store) { return store ? store->spilledBytes() : 0; };
+    const bool originalShared = (m_originalAudio == processed);
+    const bool nextShared = (nextOriginal == nextProcessed);
+
+    m_memoryBudget->setUsage(MemoryCategory::OriginalAudio, originalShared ? 0 : resident(m_originalAudio));
+    m_memoryBudget->setUsage(MemoryCategory::PlaybackAudio, resident(processed));
+    m_memoryBudget->setUsage(MemoryCategory::NextTrack, resident(nextOriginal) + (nextShared ? 0 : resident(nextProcessed)));
+    m_memoryBudget->setSpilledBytes((originalShared ? 0 : spilled(m_originalAudio)) + spilled(processed)
+                                    + spilled(nextOriginal) + (nextShared ? 0 : spilled(nextProcessed)));
 }
 
-bool AudioEngine::loadWavFile(const char* filePath)
+bool AudioEngine::decodeWavFile(const char* filePath, uint32_t targetSampleRate, size_t residentLimitBytes,
+                                DecodedAudio& out, const std::function<bool(float)>& onProgress)
 {
     drwav wav;
-    if (!drwav_init_file(&wav, filePath, nullptr))
+    AsyncFileReader reader;
+    if (!DecoderInput::openWav(wav, filePath, reader))
         return false;
 
     const drwav_uint64 totalFrames = wav.totalPCMFrameCount;
@@ -317,29 +1414,31 @@ bool AudioEngine::loadWavFile(const char* filePath)
         return false;
     }
 
-    std::vector<float> buffer;
-    buffer.resize(static_cast<size_t>(totalFrames) * channels);
-    drwav_uint64 framesRead = drwav_read_pcm_frames_f32(&wav, totalFrames, buffer.data());
+    const uint32_t outputRate = (targetSampleRate > 0) ? targetSampleRate : sampleRate;
+    auto store = std::make_shared<PcmStore>(channels, outputRate, residentLimitBytes);
+    const bool decoded = decodeIntoStore([&wav](float* buffer, uint64_t frames) {
+        return static_cast<uint64_t>(drwav_read_pcm_frames_f32(&wav, frames, buffer));
+    }, totalFrames, sampleRate, *store, onProgress);
     drwav_uninit(&wav);
+    DecoderInput::logStats("AudioEngine", reader);
 
-    if (framesRead == 0)
+    if (!decoded || store->empty())
         return false;
 
-    buffer.resize(static_cast<size_t>(framesRead) * channels);
-
-    m_originalAudioBuffer = buffer;
-    m_processedAudioBuffer = std::move(buffer);
-    m_channelCount = channels;
-    m_sampleRate = sampleRate;
-    m_frameCount = framesRead;
+    out.pcm = std::move(store);
+    out.channelCount = channels;
+    out.sampleRate = outputRate;
+    out.frameCount = out.pcm->frameCount();
 
     return true;
 }
 
-bool AudioEngine::loadMp3File(const char* filePath)
+bool AudioEngine::decodeMp3File(const char* filePath, uint32_t targetSampleRate, size_t residentLimitBytes,
+                                DecodedAudio& out, const std::function<bool(float)>& onProgress)
 {
     drmp3 mp3;
-    if (!drmp3_init_file(&mp3, filePath, nullptr))
+    AsyncFileReader reader;
+    if (!DecoderInput::openMp3(mp3, filePath, reader))
         return false;
 
     const drmp3_uint64 frameCount = drmp3_get_pcm_frame_count(&mp3);
@@ -352,41 +1451,41 @@ bool AudioEngine::loadMp3File(const char* filePath)
         return false;
     }
 
-    std::vector<float> buffer;
-    buffer.resize(static_cast<size_t>(frameCount) * channels);
-    drmp3_uint64 framesRead = drmp3_read_pcm_frames_f32(&mp3, frameCount, buffer.data());
+    const uint32_t outputRate = (targetSampleRate > 0) ? targetSampleRate : sampleRate;
+    auto store = std::make_shared<PcmStore>(channels, outputRate, residentLimitBytes);
+    const bool decoded = decodeIntoStore([&mp3](float* buffer, uint64_t frames) {
+        return static_cast<uint64_t>(drmp3_read_pcm_frames_f32(&mp3, frames, buffer));
+    }, frameCount, sampleRate, *store, onProgress);
     drmp3_uninit(&mp3);
+    DecoderInput::logStats("AudioEngine", reader);
 
-    if (framesRead == 0)
+    if (!decoded || store->empty())
         return false;
 
-    buffer.resize(static_cast<size_t>(framesRead) * channels);
-
-    m_originalAudioBuffer = buffer;
-    m_processedAudioBuffer = std::move(buffer);
-    m_channelCount = channels;
-    m_sampleRate = sampleRate;
-    m_frameCount = framesRead;
+    out.pcm = std::move(store);
+    out.channelCount = channels;
+    out.sampleRate = outputRate;
+    out.frameCount = out.pcm->frameCount();
 
     return true;
 }
 
 void AudioEngine::resetState()
 {
-    m_originalAudioBuffer.clear();
-    m_originalAudioBuffer.shrink_to_fit();
-    m_processedAudioBuffer.clear();
-    m_processedAudioBuffer.shrink_to_fit();
+    // Called with the stream closed: nothing reads the playback track any more
+    m_originalAudio.reset();
+    delete m_playback.exchange(nullptr);
+    m_retiredPlayback.clear();
+    m_scrubber.end();
     m_channelCount = 0;
     m_sampleRate = 0;
     m_frameCount = 0;
-    m_processedFrameCount = 0;
     m_duration = 0.0f;
-    m_currentTime.store(0.0f);
+    m_currentFrame.store(0);
     m_hasAudio = false;
     m_loadedFilePath.clear();
     m_playbackFrameIndex.store(0);
-    m_activeTempoMultiplier = 1.0f;
+    ++m_playheadEpoch;
     m_tempoMultiplier.store(1.0f);
     m_tempoProcessingInProgress.store(false);
     m_tempoProcessingProgress.store(0.0f);
@@ -404,9 +1503,45 @@ bool AudioEngine::ensureStreamReadyLocked()
     return true;
 }
 
-bool AudioEngine::openStreamLocked()
+bool AudioEngine::startStreamLocked()
 {
+    if (m_streamRunning)
+        return true;
+
     if (!m_rtaudio)
+    {
+        m_streamRunning = true;  // Offline: renderOffline() drives the callback
+        return true;
+    }
+
+    try
+    {
+        RtAudioErrorType result = m_rtaudio->startStream();
+        if (result != RTAUDIO_NO_ERROR)
+        {
+            std::cerr << "AudioEngine: Failed to start stream - " << m_rtaudio->getErrorText() << std::endl;
+            return false;
+        }
+        m_streamRunning = true;
+        // Known once the stream runs on some backends. Duplex streams report input and
+        // output latency together; they are taken as equal.
+        const uint32_t latency = static_cast<uint32_t>(std::max(0L, m_rtaudio->getStreamLatency()));
+        const uint32_t outputLatency = m_streamHasInput ? latency / 2 : latency;
+        m_streamLatencyFrames.store(outputLatency);
+        m_livePitch.setLatency(latency - outputLatency, outputLatency);
+        m_recorder.setLatency(latency - outputLatency, outputLatency);
+        return true;
+    }
+    catch (...)
+    {
+        std::cerr << "AudioEngine: Failed to start stream" << std::endl;
+        return false;
+    }
+}
+
+bool AudioEngine::openStreamLocked()
+{
+    if (!m_rtaudio && m_offlineSampleRate == 0)
         return false;
 
     if (m_streamOpen)
@@ -416,17 +1551,52 @@ bool AudioEngine::openStreamLocked()
         return false;
 
     m_streamParams.nChannels = m_streamChannels;
+    // RtAudio creates its callback thread with SCHED_RR where the backend and limits allow
+    m_streamOptions.flags = RealtimeSupport::isEnabled() ? RTAUDIO_SCHEDULE_REALTIME : 0;
+    m_streamOptions.priority = RealtimeSupport::kAudioThreadPriority;
+    m_callbackThreadChecked.store(false);
+    m_callbackRealtime.store(false);
+    // The callback is not running yet, so the grain buffers can be sized here
+    m_scrubber.prepare(m_streamChannels, m_streamSampleRate);
+    m_metronome.prepare(m_streamChannels, m_streamSampleRate);
+
+    // Input needs a device; the offline backend reads the simulated input file instead
+    const bool wantInput = m_inputEnabled.load()
+                           && (m_rtaudio ? m_defaultInputDeviceId >= 0 : !m_offlineInput.empty());
+
+    if (!m_rtaudio)
+    {
+        m_streamOpen = true;
+        m_streamRunning = false;
+        m_streamHasInput = wantInput;
+        m_offlineInputPosition = 0;
+        if (wantInput)
+            m_livePitch.start(m_streamSampleRate);
+        return true;
+    }
 
     try
     {
-        RtAudioErrorType result = m_rtaudio->openStream(&m_streamParams,
-                               nullptr,
-                               RTAUDIO_FLOAT32,
-                               m_streamSampleRate,
-                               &m_bufferFrames,
-                               &AudioEngine::audioCallback,
-                               this,
-                               &m_streamOptions);
+        const auto open = [this](RtAudio::StreamParameters* inputParams) {
+            return m_rtaudio->openStream(&m_streamParams,
+                                         inputParams,
+                                         RTAUDIO_FLOAT32,
+                                         m_streamSampleRate,
+                                         &m_bufferFrames,
+                                         &AudioEngine::audioCallback,
+                                         this,
+                                         &m_streamOptions);
+        };
+        bool withInput = wantInput;
+        RtAudioErrorType result = open(withInput ? &m_inputParams : nullptr);
+        if (result != RTAUDIO_NO_ERROR && withInput)
+        {
+            // A microphone that cannot run at the track's rate should not stop playback
+            std::cerr << "AudioEngine: Failed to open the input device - " << m_rtaudio->getErrorText()
+                      << "; continuing without input" << std::endl;
+            withInput = false;
+            result = open(nullptr);
+        }
         if (result != RTAUDIO_NO_ERROR)
         {
             std::cerr << "AudioEngine: Failed to open RtAudio stream - " << m_rtaudio->getErrorText() << std::endl;
@@ -434,6 +1604,9 @@ bool AudioEngine::openStreamLocked()
         }
         m_streamOpen = true;
         m_streamRunning = false;
+        m_streamHasInput = withInput;
+        if (withInput)
+            m_livePitch.start(m_streamSampleRate);
         return true;
     }
     catch (...)
@@ -446,12 +1619,13 @@ bool AudioEngine::openStreamLocked()
 
 void AudioEngine::closeStreamLocked()
 {
-    if (!m_rtaudio || !m_streamOpen)
+    if (!m_streamOpen)
         return;
 
+    // The offline backend has no device stream to stop
     try
     {
-        if (m_rtaudio->isStreamRunning())
+        if (m_rtaudio && m_rtaudio->isStreamRunning())
         {
             RtAudioErrorType result = m_rtaudio->stopStream();
             if (result != RTAUDIO_NO_ERROR)
@@ -460,7 +1634,7 @@ void AudioEngine::closeStreamLocked()
             }
             m_streamRunning = false;
         }
-        if (m_rtaudio->isStreamOpen())
+        if (m_rtaudio && m_rtaudio->isStreamOpen())
             m_rtaudio->closeStream();
     }
     catch (...)
@@ -468,8 +1642,14 @@ void AudioEngine::closeStreamLocked()
         std::cerr << "AudioEngine: Failed to close RtAudio stream" << std::endl;
     }
 
+    // The callback no longer runs, so the detector can stop reading its rings and a take
+    // ends with what was captured
+    m_livePitch.stop();
+    m_recorder.finishCapture();
+    m_retiredPlayback.clear();
     m_streamOpen = false;
     m_streamRunning = false;
+    m_streamHasInput = false;
 }
 
 void AudioEngine::setTempoMultiplier(float multiplier)
@@ -477,13 +1657,13 @@ void AudioEngine::setTempoMultiplier(float multiplier)
     multiplier = std::clamp(multiplier, 0.25f, 4.0f);
 
     // Check if tempo actually changed
-    if (std::abs(multiplier - m_activeTempoMultiplier) < 0.001f)
+    if (std::abs(multiplier - activeTempo()) < 0.001f)
         return;
 
     m_tempoMultiplier.store(multiplier);
 
     // Trigger background reprocessing
-    if (m_hasAudio && !m_originalAudioBuffer.empty())
+    if (m_hasAudio && m_originalAudio)
     {
         reprocessAudioWithTempo(multiplier);
     }
@@ -506,179 +1686,362 @@ float AudioEngine::getTempoProcessingProgress() const
 
 void AudioEngine::reprocessAudioWithTempo(float multiplier)
 {
+    const uint64_t generation = m_trackGeneration.load();
+    const std::shared_ptr<PcmStore> original = m_originalAudio;
+    const size_t residentLimit = pcmResidentLimit();
+
+    // Marked before the thread starts so the original is not paged out while it is being read
+    m_tempoProcessingInProgress.store(true);
+    const bool stretch = std::abs(multiplier - 1.0f) >= 0.001f;
+    size_t scratchBytes = 0;
+    if (stretch)
+    {
+        scratchBytes = static_cast<size_t>(original->frameCount() * original->channelCount() * sizeof(float) / multiplier);
+        if (residentLimit > 0)
+            scratchBytes = std::min(scratchBytes, residentLimit);
+    }
+    if (m_memoryBudget)
+        m_memoryBudget->enforce(scratchBytes);
+
     // Launch background thread to reprocess audio
-    std::thread([this, multiplier]() {
+    std::thread([this, original, multiplier, stretch, generation, scratchBytes, residentLimit]() {
+        RealtimeSupport::configureWorkerThread();
+        Trace::setThreadName("Tempo");
+        Trace::Span span("Tempo change");
+        WakeOnReturn wake(m_wakeCallback);
         m_tempoProcessingInProgress.store(true);
         m_tempoProcessingProgress.store(0.0f);
 
         std::cout << "AudioEngine: Starting tempo processing (" << multiplier << "x)..." << std::endl;
 
-        // Create temporary SoundTouch instance for this processing
-        soundtouch::SoundTouch st;
-        st.setSampleRate(m_sampleRate);
-        st.setChannels(m_channelCount);
-        st.setTempo(multiplier);
-
-        // High quality settings for offline processing
-        st.setSetting(SETTING_USE_QUICKSEEK, 0);
-        st.setSetting(SETTING_USE_AA_FILTER, 1);
-        st.setSetting(SETTING_SEQUENCE_MS, 100);
-        st.setSetting(SETTING_SEEKWINDOW_MS, 35);
-        st.setSetting(SETTING_OVERLAP_MS, 24);
-
-        // Calculate expected output size
-        const uint64_t originalFrameCount = m_originalAudioBuffer.size() / m_channelCount;
-        const size_t expectedFrames = static_cast<size_t>(originalFrameCount / multiplier);
-
-        // Feed entire original audio in chunks for progress tracking
-        const size_t chunkSize = 44100; // 1 second chunks
-        std::vector<float> tempBuffer;
-        tempBuffer.reserve(expectedFrames * m_channelCount);
-
-        // Feed audio in chunks
-        size_t framesProcessed = 0;
-        while (framesProcessed < originalFrameCount)
-        {
-            const size_t framesToProcess = std::min(chunkSize, static_cast<size_t>(originalFrameCount - framesProcessed));
-            const float* sourceData = m_originalAudioBuffer.data() + (framesProcessed * m_channelCount);
-            st.putSamples(sourceData, framesToProcess);
-            framesProcessed += framesToProcess;
-
-            // Update progress
-            m_tempoProcessingProgress.store(static_cast<float>(framesProcessed) / static_cast<float>(originalFrameCount) * 0.9f);
+        ScratchUsage scratch(m_memoryBudget);
+        scratch.add(scratchBytes);
 
-            // Receive any available processed samples
-            std::vector<float> outputChunk(chunkSize * m_channelCount * 2); // Extra space for stretching
-            unsigned int receivedSamples;
-            while ((receivedSamples = st.receiveSamples(outputChunk.data(), chunkSize * 2)) > 0)
-            {
-                tempBuffer.insert(tempBuffer.end(),
-                                outputChunk.begin(),
-                                outputChunk.begin() + receivedSamples * m_channelCount);
-            }
+        // At 1x playback goes back to the original store
+        std::shared_ptr<PcmStore> processed = original;
+        TimeMap timeMap;
+        if (stretch)
+        {
+            processed = std::make_shared<PcmStore>(original->channelCount(), original->sampleRate(), residentLimit);
+            stretchBuffer(*original, multiplier, *processed, timeMap,
+                          [this](float fraction) {
+                              m_tempoProcessingProgress.store(fraction * 0.95f);
+                              return true;
+                          });
         }
-
-        // Flush remaining samples
-        st.flush();
         m_tempoProcessingProgress.store(0.95f);
 
-        std::vector<float> outputChunk(chunkSize * m_channelCount * 2);
-        unsigned int receivedSamples;
-        while ((receivedSamples = st.receiveSamples(outputChunk.data(), chunkSize * 2)) > 0)
-        {
-            tempBuffer.insert(tempBuffer.end(),
-                            outputChunk.begin(),
-                            outputChunk.begin() + receivedSamples * m_channelCount);
-        }
+        auto track = std::make_unique<PlaybackTrack>();
+        track->pcm = processed;
+        track->timeMap.swap(timeMap);
+        track->frameCount = processed->frameCount();
+        track->tempo = multiplier;
 
-        // Atomically swap buffers and update metadata
+        // Publish the new track; the callback keeps reading the old one until its next block
         {
             std::lock_guard<std::mutex> lock(m_streamMutex);
 
-            // Get current position in ORIGINAL time
-            const float currentOriginalTime = m_currentTime.load();
+            // A setlist transition replaced the track while we were stretching
+            if (generation != m_trackGeneration.load())
+            {
+                m_tempoProcessingInProgress.store(false);
+                return;
+            }
 
-            // Update to new processed buffer
-            m_processedAudioBuffer = std::move(tempBuffer);
-            m_processedFrameCount = m_processedAudioBuffer.size() / m_channelCount;
-            m_activeTempoMultiplier = multiplier;
+            // Current position in original frames; it stays the same. Seeks and scrubs map
+            // positions under the lock too, so none is mapped through the old track meanwhile.
+            const uint64_t currentOriginalFrame = m_currentFrame.load();
 
             // Note: m_frameCount and m_duration remain unchanged (always refer to original audio)
 
-            // Map current position from original time to processed buffer position
-            // At 50% tempo: processed buffer is 2x longer, so divide by tempo
-            const uint64_t originalFramePos = static_cast<uint64_t>(currentOriginalTime * static_cast<float>(m_sampleRate));
-            const uint64_t processedFramePos = static_cast<uint64_t>(originalFramePos / multiplier);
-            m_playbackFrameIndex.store(std::min(processedFramePos, m_processedFrameCount));
-
-            // Current time stays the same (in original time)
-            m_currentTime.store(currentOriginalTime);
+            // Map the current position into the new processed buffer
+            const uint64_t processedFrame = std::min(track->timeMap.toProcessed(currentOriginalFrame), track->frameCount);
+            m_playbackFrameIndex.store(processedFrame);
+            ++m_playheadEpoch;
+            processed->setPlayhead(processedFrame);
+            if (m_scrubber.isActive())
+                m_scrubber.begin(track->timeMap.toProcessed(m_scrubFrame.load()));
+            publishPlaybackLocked(std::move(track));
         }
+        processed->startReadAhead();
 
         m_tempoProcessingProgress.store(1.0f);
         m_tempoProcessingInProgress.store(false);
 
-        std::cout << "AudioEngine: Tempo processing complete (processed: " << m_processedFrameCount
+        std::cout << "AudioEngine: Tempo processing complete (processed: " << processed->frameCount()
                   << " frames, original: " << m_frameCount << " frames)" << std::endl;
     }).detach();
 }
 
-void AudioEngine::resampleBuffer(std::vector<float>& buffer, uint32_t channels,
-                                  uint32_t srcRate, uint32_t dstRate, uint64_t& frameCount)
+bool AudioEngine::stretchBuffer(const PcmStore& input, float tempo, PcmStore& output, TimeMap& timeMap,
+                                const std::function<bool(float)>& onProgress)
 {
-    if (srcRate == dstRate || srcRate == 0 || dstRate == 0 || frameCount == 0)
-        return;
+    Trace::Span span("Stretch");
+    const uint32_t channels = input.channelCount();
+    const uint32_t sampleRate = input.sampleRate();
+    if (channels == 0 || sampleRate == 0)
+        return false;
 
-    const double ratio = static_cast<double>(dstRate) / static_cast<double>(srcRate);
-    const uint64_t newFrameCount = static_cast<uint64_t>(frameCount * ratio);
-    std::vector<float> resampled(newFrameCount * channels);
+    // Create temporary SoundTouch instance for this processing
+    soundtouch::SoundTouch st;
+    st.setSampleRate(sampleRate);
+    st.setChannels(channels);
+    st.setTempo(tempo);
 
-    for (uint64_t i = 0; i < newFrameCount; ++i)
-    {
-        const double srcPos = static_cast<double>(i) / ratio;
-        const uint64_t idx0 = static_cast<uint64_t>(srcPos);
-        const uint64_t idx1 = std::min(idx0 + 1, frameCount - 1);
-        const float frac = static_cast<float>(srcPos - static_cast<double>(idx0));
+    // High quality settings for offline processing
+    st.setSetting(SETTING_USE_QUICKSEEK, 0);
+    st.setSetting(SETTING_USE_AA_FILTER, 1);
+    st.setSetting(SETTING_SEQUENCE_MS, 100);
+    st.setSetting(SETTING_SEEKWINDOW_MS, 35);
+    st.setSetting(SETTING_OVERLAP_MS, 24);
+
+    // Calculate expected output size
+    const uint64_t originalFrameCount = input.frameCount();
+    output.reserveFrames(static_cast<uint64_t>(originalFrameCount / tempo));
+
+    // Feed the original block by block; output goes straight into the (possibly paged) store
+    const size_t chunkSize = 44100; // 1 second chunks
+    std::vector<float> outputChunk(chunkSize * channels * 2); // Extra space for stretching
+
+    const auto receiveAvailable = [&]() {
+        unsigned int receivedSamples;
+        while ((receivedSamples = st.receiveSamples(outputChunk.data(), chunkSize * 2)) > 0)
+            output.append(outputChunk.data(), receivedSamples);
+    };
+
+    uint64_t framesProcessed = 0;
+    const bool completed = input.forEachBlock([&](const float* frames, uint64_t frameCount) {
+        for (uint64_t offset = 0; offset < frameCount; offset += chunkSize)
+        {
+            const uint64_t framesToProcess = std::min<uint64_t>(chunkSize, frameCount - offset);
+            st.putSamples(frames + offset * channels, static_cast<unsigned int>(framesToProcess));
+            framesProcessed += framesToProcess;
+
+            if (onProgress && !onProgress(static_cast<float>(framesProcessed) / static_cast<float>(originalFrameCount)))
+                return false;
+
+            // Receive any available processed samples
+            receiveAvailable();
+
+            // Input still buffered inside SoundTouch has not reached the output yet
+            timeMap.addAnchor(framesProcessed - st.numUnprocessedSamples(), output.frameCount());
+        }
+        return true;
+    });
+    if (!completed)
+        return false;
+
+    // Flush remaining samples
+    st.flush();
+    receiveAvailable();
+    timeMap.addAnchor(originalFrameCount, output.frameCount());
+    return true;
+}
+
+int AudioEngine::processAudio(float* output, const float* input, unsigned int frames, RtAudioStreamStatus status)
+{
+    // Counts allocations, locks and blocking calls made from here on in SONGPRACTICE_RT_CHECK builds
+    RealtimeChecker::CallbackScope realtimeScope;
+    int64_t blockStartNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 
-        for (uint32_t ch = 0; ch < channels; ++ch)
+    // Counted here, reported from update(): logging would block the callback
+    if (status & (RTAUDIO_OUTPUT_UNDERFLOW | RTAUDIO_INPUT_OVERFLOW))
+        m_xrunCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (RealtimeSupport::isEnabled())
+    {
+        // Cheap enough per callback, and it covers backends that change the callback thread
+        RealtimeSupport::enableDenormalFlush();
+        // Once per stream: a couple of system calls when RtAudio could not raise the thread itself
+        if (!m_callbackThreadChecked.load())
         {
-            const float s0 = buffer[idx0 * channels + ch];
-            const float s1 = buffer[idx1 * channels + ch];
-            resampled[i * channels + ch] = s0 + frac * (s1 - s0);
+            m_callbackRealtime.store(RealtimeSupport::isRealtimeThread()
+                                     || RealtimeSupport::raiseToRealtime(RealtimeSupport::kAudioThreadPriority));
+            m_callbackThreadChecked.store(true);
         }
     }
 
-    buffer = std::move(resampled);
-    frameCount = newFrameCount;
+    // The output block about to be rendered starts at the current frame
+    const bool hasInput = input != nullptr && m_streamHasInput;
+    InputBlockInfo info;
+    if (hasInput)
+    {
+        info.hostTimeNs = blockStartNs;
+        info.trackFrame = m_currentFrame.load();
+        info.epoch = m_playheadEpoch.load();
+        const PlaybackTrack* track = m_playback.load();
+        info.tempo = track ? track->tempo : 1.0f;
+        info.playing = m_playing.load() && m_hasAudio && !m_scrubber.isActive() && !m_metronome.isCountingIn();
+        m_livePitch.push(input, frames, info);
+    }
+
+    renderOutput(output, frames, blockStartNs);
+
+    if (hasInput)
+    {
+        // A seek or track rollover during the block ends a take before it
+        info.playing = info.playing && info.epoch == m_playheadEpoch.load();
+        m_recorder.capture(input, output, frames, info);
+    }
+    m_callbackBlocks.fetch_add(1, std::memory_order_release);
+    return 0;
 }
 
-int AudioEngine::processAudio(float* output, unsigned int frames, RtAudioStreamStatus status)
+void AudioEngine::renderOutput(float* output, unsigned int frames, int64_t blockStartNs)
 {
-    if (status != 0)
+    // Loaded once: the track stays valid for the whole block even if another is published meanwhile
+    const PlaybackTrack* track = m_playback.load();
+    if (track && m_scrubber.isActive())
     {
-        std::cerr << "AudioEngine: Stream underflow/overflow detected" << std::endl;
+        // The track itself holds still; endScrub() moves it to where the scrub stopped
+        std::fill(output, output + frames * m_streamChannels, 0.0f);
+        m_scrubber.mix(*track->pcm, output, frames);
+        track->pcm->setPlayhead(m_scrubber.position());
+        return;
     }
 
-    if (!m_playing.load() || !m_hasAudio)
+    if (!m_playing.load() || !track)
     {
         std::fill(output, output + frames * m_streamChannels, 0.0f);
-        return 0;
+        // Grains still fading out after a scrub while paused
+        if (track && m_scrubber.isSounding())
+            m_scrubber.mix(*track->pcm, output, frames);
+        return;
+    }
+
+    if (m_metronome.isCountingIn())
+    {
+        // Clicks over silence; the track starts on the frame the count-in ends
+        std::fill(output, output + frames * m_streamChannels, 0.0f);
+        const unsigned int countInFrames = m_metronome.mixCountIn(output, frames);
+        if (countInFrames == frames)
+            return;
+        output += countInFrames * m_streamChannels;
+        frames -= countInFrames;
+        blockStartNs += static_cast<int64_t>(countInFrames * 1e9 / m_sampleRate);
     }
 
+    uint64_t playheadEpoch = m_playheadEpoch.load();
     const uint64_t currentIndex = m_playbackFrameIndex.load();
-    const uint64_t framesRemaining = (currentIndex < m_processedFrameCount) ? (m_processedFrameCount - currentIndex) : 0;
+    const uint64_t framesRemaining = (currentIndex < track->frameCount) ? (track->frameCount - currentIndex) : 0;
     const unsigned int framesToCopy = static_cast<unsigned int>(std::min<uint64_t>(frames, framesRemaining));
 
     if (framesToCopy > 0)
     {
-        const float* source = m_processedAudioBuffer.data() + (currentIndex * m_streamChannels);
-        std::copy(source, source + framesToCopy * m_streamChannels, output);
+        // Blocks that are not paged in yet play as silence; the read-ahead thread follows the playhead
+        const uint64_t copied = track->pcm->readResident(currentIndex, output, framesToCopy);
+        std::fill(output + copied * m_streamChannels, output + framesToCopy * m_streamChannels, 0.0f);
+        mixTakePlayback(*track, output, framesToCopy, currentIndex);
     }
+    m_metronome.mixBeats(output, framesToCopy, currentIndex, track->timeMap);
 
     if (framesToCopy < frames)
     {
-        std::fill(output + framesToCopy * m_streamChannels, output + frames * m_streamChannels, 0.0f);
-        m_playing.store(false);
-        m_endOfStream.store(true);
+        // Setlist: continue straight into the preloaded track. If the UI thread holds the
+        // lock this block is silent and the rollover is retried on the next callback.
+        bool rolledOver = false;
+        const bool queued = m_queuedTrackArmed.load();
+        if (queued)
+        {
+            std::unique_lock<std::mutex> lock(m_streamMutex, std::try_to_lock);
+            rolledOver = lock.owns_lock() && takeQueuedTrackLocked();
+        }
+
+        float* rest = output + framesToCopy * m_streamChannels;
+        const unsigned int framesLeft = frames - framesToCopy;
+        if (rolledOver)
+        {
+            // The previous track stays with the queued one until the UI thread retires it
+            track = m_playback.load();
+            const unsigned int framesFromNext = static_cast<unsigned int>(std::min<uint64_t>(framesLeft, track->frameCount));
+            const uint64_t copied = track->pcm->readResident(0, rest, framesFromNext);
+            std::fill(rest + copied * m_streamChannels, rest + framesLeft * m_streamChannels, 0.0f);
+            m_playbackFrameIndex.store(framesFromNext);
+            playheadEpoch = m_playheadEpoch.load();  // The rollover started a new epoch
+        }
+        else
+        {
+            std::fill(rest, rest + framesLeft * m_streamChannels, 0.0f);
+            m_playbackFrameIndex.store(currentIndex + framesToCopy);
+            if (!queued)
+            {
+                m_playing.store(false);
+                m_endOfStream.store(true);
+            }
+        }
     }
     else
     {
         m_playbackFrameIndex.store(currentIndex + framesToCopy);
     }
 
-    // Convert processed buffer position back to original time
-    // At 50% tempo: processed buffer is 2x longer, so multiply by tempo to get original position
-    const float tempoRatio = m_activeTempoMultiplier;
+    if (m_scrubber.isSounding())
+        m_scrubber.mix(*track->pcm, output, frames);
+
+    // Back to the original position through the map recorded while stretching
     const uint64_t processedPos = m_playbackFrameIndex.load();
-    const uint64_t originalPos = static_cast<uint64_t>(processedPos * tempoRatio);
-    const float time = static_cast<float>(originalPos) / static_cast<float>(m_sampleRate);
-    m_currentTime.store(time);
+    track->pcm->setPlayhead(processedPos);
+    const uint64_t originalPos = track->timeMap.toOriginal(processedPos);
+    m_currentFrame.store(originalPos);
+    publishPlayhead(playheadEpoch, blockStartNs, processedPos, originalPos, frames, track->tempo);
+}
 
-    return 0;
+void AudioEngine::mixTakePlayback(const PlaybackTrack& track, float* output, unsigned int frames,
+                                  uint64_t processedStart)
+{
+    TakePlayback* take = m_takePlayback.load(std::memory_order_acquire);
+    if (take == nullptr || take->trackGeneration != m_trackGeneration.load()
+        || std::abs(take->tempo - track.tempo) > 0.001f)
+        return;
+
+    // The take's frames follow the processed track from where its start frame was stretched to
+    const uint64_t takeStart = track.timeMap.toProcessed(take->startFrame);
+    const uint64_t takeFrames = take->pcm->frameCount();
+    const uint32_t takeChannels = take->pcm->channelCount();
+    const size_t chunkFrames = take->scratch.size() / takeChannels;
+    unsigned int done = takeStart > processedStart
+                            ? static_cast<unsigned int>(std::min<uint64_t>(frames, takeStart - processedStart))
+                            : 0;
+    while (done < frames)
+    {
+        const uint64_t takeFrame = processedStart + done - takeStart;
+        if (takeFrame >= takeFrames)
+            break;
+        const unsigned int count = static_cast<unsigned int>(
+            std::min<uint64_t>({frames - done, chunkFrames, takeFrames - takeFrame}));
+        float* target = output + static_cast<size_t>(done) * m_streamChannels;
+        if (take->muteTrack)
+            std::fill(target, target + static_cast<size_t>(count) * m_streamChannels, 0.0f);
+        // Resident after decoding; a paged-out block is skipped rather than waited for
+        const uint64_t copied = take->pcm->readResident(takeFrame, take->scratch.data(), count);
+        for (uint64_t frame = 0; frame < copied; ++frame)
+        {
+            for (uint32_t channel = 0; channel < m_streamChannels; ++channel)
+                target[frame * m_streamChannels + channel] += take->scratch[frame * takeChannels + channel % takeChannels];
+        }
+        done += count;
+    }
+}
+
+void AudioEngine::publishPlayhead(uint64_t epoch, int64_t hostTimeNs, uint64_t frameEnd, uint64_t originalFrameEnd,
+                                  uint32_t blockFrames, float tempo)
+{
+    PlayheadStamp& stamp = m_playheadStamp;
+    const uint32_t sequence = stamp.sequence.load(std::memory_order_relaxed);
+    stamp.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    stamp.epoch.store(epoch, std::memory_order_relaxed);
+    stamp.hostTimeNs.store(hostTimeNs, std::memory_order_relaxed);
+    stamp.frameEnd.store(frameEnd, std::memory_order_relaxed);
+    stamp.originalFrameEnd.store(originalFrameEnd, std::memory_order_relaxed);
+    stamp.blockFrames.store(blockFrames, std::memory_order_relaxed);
+    stamp.tempo.store(tempo, std::memory_order_relaxed);
+    stamp.sequence.store(sequence + 2, std::memory_order_release);
 }
 
 int AudioEngine::audioCallback(void* outputBuffer,
-                               void* /*inputBuffer*/,
+                               void* inputBuffer,
                                unsigned int nBufferFrames,
                                double /*streamTime*/,
                                RtAudioStreamStatus status,
@@ -688,5 +2051,6 @@ int AudioEngine::audioCallback(void* outputBuffer,
     if (engine == nullptr || outputBuffer == nullptr)
         return 0;
 
-    return engine->processAudio(static_cast<float*>(outputBuffer), nBufferFrames, status);
+    return engine->processAudio(static_cast<float*>(outputBuffer), static_cast<const float*>(inputBuffer),
+                                nBufferFrames, status);
 }
\ No newline at end of file
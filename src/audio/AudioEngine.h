@@ -1,7 +1,10 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -10,29 +13,142 @@
 #include <RtAudio.h>
 #include <SoundTouch.h>
 
+#include "LivePitchTracker.h"
+#include "Metronome.h"
+#include "PcmStore.h"
+#include "Scrubber.h"
+#include "TakeRecorder.h"
+#include "TimeMap.h"
+
+class MemoryBudget;
+
+// PCM decoded off the audio engine, ready to be installed with installDecodedAudio()
+struct DecodedAudio
+{
+    std::string filePath;
+    std::shared_ptr<PcmStore> pcm;
+    uint32_t channelCount = 0;
+    uint32_t sampleRate = 0;
+    uint64_t frameCount = 0;
+};
+
+enum class AudioLoadStatus
+{
+    Loaded,
+    Failed,
+    Cancelled
+};
+
+// Progress and cancellation of a loadAudioFileAsync() request
+class AudioLoadHandle
+{
+public:
+    explicit AudioLoadHandle(std::string filePath) : m_filePath(std::move(filePath)) {}
+
+    const std::string& filePath() const { return m_filePath; }
+    float progress() const { return m_progress.load(); }
+    void cancel() { m_cancelled.store(true); }
+    bool isCancelled() const { return m_cancelled.load(); }
+    bool isFinished() const { return m_finished.load(); }
+
+private:
+    friend class AudioEngine;
+
+    std::string m_filePath;
+    std::atomic<float> m_progress{0.0f};
+    std::atomic<bool> m_cancelled{false};
+    std::atomic<bool> m_finished{false};
+};
+
 class AudioEngine
 {
 public:
+    // Runs on the UI thread from update()
+    using LoadCompletion = std::function<void(AudioLoadStatus status)>;
+    // Runs on the loader thread once the audio is decoded, e.g. to build display data
+    using LoadPreparation = std::function<void(const DecodedAudio& audio)>;
+
     AudioEngine();
     ~AudioEngine();
     
     // Basic playback control
     bool initialize();
     void shutdown();
+
+    // Device enumeration can take seconds on ALSA/PulseAudio; initializeAsync() runs it on a
+    // background thread. Calls that need the device wait for it via waitUntilInitialized().
+    void initializeAsync();
+    bool waitUntilInitialized();
+    bool isInitializing() const;
+    std::shared_future<bool> initializationResult() const;
+    uint32_t deviceSampleRate() const;  // Valid once initialization finished
+
+    // Reports buffer sizes to budget (may be null); the budget must outlive the engine
+    void setMemoryBudget(MemoryBudget* budget);
     
     // Audio file handling
     bool loadAudioFile(const char* filePath);
+    // Thread-safe: decodes and resamples to targetSampleRate (0 keeps the file rate).
+    // onProgress receives 0..1 and may return false to abort. With residentLimitBytes the
+    // PCM is paged to a cache file beyond that size (see PcmStore).
+    static bool decodeAudioFile(const std::string& filePath, uint32_t targetSampleRate, DecodedAudio& out,
+                                const std::function<bool(float)>& onProgress = {},
+                                size_t residentLimitBytes = 0);
+    bool installDecodedAudio(DecodedAudio&& audio);
+
+    // Decodes, resamples and runs prepare on a background thread; the current track keeps
+    // playing until update() swaps the new one in. A new request cancels older ones.
+    std::shared_ptr<AudioLoadHandle> loadAudioFileAsync(const std::string& filePath,
+                                                        LoadCompletion onComplete,
+                                                        LoadPreparation prepare = {});
+    // Installs finished loads and runs their completion callbacks; call once per frame
+    void update();
+    bool isLoading() const;
+
+    // Gapless queue (setlist mode): the next track is decoded and stretched to its tempo in the
+    // background. When the current track ends the audio callback continues straight into it
+    // without closing the stream. Skipped if its stretched copy does not fit the memory budget.
+    std::shared_ptr<AudioLoadHandle> preloadNextTrack(const std::string& filePath,
+                                                      float tempoMultiplier,
+                                                      LoadPreparation prepare = {});
+    void clearNextTrack();
+    bool hasNextTrack() const;
+    const std::string& nextTrackPath() const;
+    // Switches to the preloaded track right away (stream kept open when the format matches)
+    bool switchToNextTrack();
+    // True once after the engine moved on to the preloaded track
+    bool takeTrackSwitch();
     void unloadAudio();
     bool hasAudio() const;
-    std::string loadedFilePath() const;
+    const std::string& loadedFilePath() const;
     bool streamReady() const;
 
     // Playback control
     void play();
     void pause();
     void stop();
+    // Sample-accurate; frame counts original frames at getSampleRate()
+    void seekToFrame(uint64_t frame);
+    // Seconds from the UI (waveform clicks, seek steps), rounded to the nearest frame
     void seek(float timeSeconds);
     void seekBy(float delay);
+    // Metronome: clicks on a beat grid given in original frames at getSampleRate(), which
+    // follow the tempo multiplier. bpm <= 0 clears the grid.
+    void setBeatGrid(double bpm, uint64_t firstBeatFrame, uint32_t beatsPerBar);
+    void setMetronomeEnabled(bool enabled);
+    bool metronomeEnabled() const;
+    void setMetronomeVolume(float volume);
+    float metronomeVolume() const;
+    // Clicks bars of the grid's bar at the active tempo, then starts playback on the frame
+    // the count-in ends. Without a grid this is play().
+    void playWithCountIn(uint32_t bars);
+    bool isCountingIn() const;
+    // Scrubbing (dragging the waveform cursor): grains around the drag position replace the
+    // track, also while paused. endScrub() moves the playback position to where it stopped.
+    void beginScrub(uint64_t frame);
+    void scrubTo(uint64_t frame);
+    void endScrub();
+    bool isScrubbing() const;
     bool isPlaying() const;
     bool isStreamRunning() const;
     bool isPlaybackFinished() const;
@@ -45,20 +161,174 @@ public:
 
     // Getters
     float getDuration() const;
+    // Position after the last rendered block, in original frames
+    uint64_t getCurrentFrame() const;
+    // getCurrentFrame() in seconds, for display
     float getCurrentTime() const;
+    // Position being heard now, for drawing: interpolated from the last callback on the
+    // host clock and delayed by the output latency; getCurrentTime() while paused
+    float getPlayheadTime() const;
     uint32_t getSampleRate() const;
     uint32_t getChannelCount() const;
     uint64_t getFrameCount() const;
-    const std::vector<float>& getAudioData() const;
+    // Original PCM (null when nothing is loaded); blocks page in as they are read
+    std::shared_ptr<const PcmStore> getAudioData() const;
+
+    // Memory pressure: pages the original PCM out to its cache file. Playback reads the
+    // processed store, so it is unaffected. Returns the bytes released.
+    size_t spillOriginalAudio();
+    // Blocks the audio callback found paged out and played as silence
+    uint64_t pageMisses() const;
+
+    // Real-time safety (see RealtimeSupport): locks the playback PCM in RAM, flushes
+    // denormals on the audio and worker threads and asks for real-time scheduling of the
+    // callback. A change of scheduling applies when the stream is next opened.
+    void setRealtimeSafety(bool enabled);
+    bool realtimeSafety() const;
+    // Output underflows and input overflows reported by the device since the engine was created
+    uint64_t xrunCount() const;
+    // Whether the callback thread runs under SCHED_FIFO/RR (known after the first callback)
+    bool callbackIsRealtime() const;
+
+    // Called on worker threads when a load, preload or tempo change finishes, so an idle UI
+    // can wake up to collect it in update(). Set before starting any work.
+    void setWakeCallback(std::function<void()> wake);
+
+    // Microphone: the stream is reopened as a duplex stream on the default input device and
+    // runs while paused, so the mic is tracked before playback starts. The callback passes
+    // the first input channel to livePitch(). Without an input device it stays output-only.
+    void setInputEnabled(bool enabled);
+    bool inputEnabled() const;
+    // Whether the open stream captures input
+    bool inputActive() const;
+    const LivePitchTracker& livePitch() const;
+
+    // Practice takes: while inputActive(), records the microphone (with withBacking mixed
+    // with everything the stream plays) to filePath, from the next block that plays the track
+    // until playback pauses or jumps or stopRecording(). Aligned to the track by the stream's
+    // latency. takeFinishedRecording() returns the take once its file is complete.
+    bool startRecording(const std::string& filePath, bool withBacking);
+    void stopRecording();
+    bool takeFinishedRecording(RecordedTake& out);
+    const TakeRecorder& recorder() const;
+    // Listening back: take (at getSampleRate()) is mixed over the current track from the
+    // original frame startFrame while the tempo is the take's; muteTrack silences the track
+    // where the take plays. Null stops it. The take is dropped when the track changes.
+    void setTakePlayback(std::shared_ptr<const PcmStore> take, uint64_t startFrame, float tempo, bool muteTrack);
+    bool hasTakePlayback() const;
+
+    // Offline backend, selected before initialize(): no device is opened and renderOffline()
+    // runs the audio callback on the calling thread (used by the --rt-check harness)
+    void setOfflineRendering(uint32_t sampleRate);
+    // Offline backend: the file's mono mix stands in for the microphone, from its start
+    // whenever the stream opens with input enabled, then silence
+    bool setOfflineInput(const std::string& filePath);
+    // Renders frames * getChannelCount() samples; false unless play() started the offline stream
+    bool renderOffline(float* output, unsigned int frames);
 
 private:
-    bool loadWavFile(const char* filePath);
-    bool loadMp3File(const char* filePath);
+    struct PendingLoad
+    {
+        std::shared_ptr<AudioLoadHandle> handle;
+        LoadCompletion onComplete;
+        std::future<DecodedAudio> result;
+    };
+
+    // What the callback plays. Never changed once published through m_playback: a new
+    // track or tempo publishes a new one, and the old one is retired (see retireLocked()).
+    struct PlaybackTrack
+    {
+        std::shared_ptr<PcmStore> pcm;  // Stretched to tempo (the original store at 1x)
+        TimeMap timeMap;                // Original <-> processed positions
+        uint64_t frameCount = 0;        // Of pcm
+        float tempo = 1.0f;             // Multiplier pcm was stretched with
+    };
+
+    // Preloaded next track. Owned by the UI thread; while armed, the audio callback may
+    // swap its playback in (under m_streamMutex), leaving the previous one in its place.
+    struct QueuedTrack
+    {
+        DecodedAudio audio;                      // Original PCM
+        std::unique_ptr<PlaybackTrack> playback;  // Stretched to its tempo (the original at 1x)
+    };
+
+    // Where and when the callback's last block ended, published without locks (sequence
+    // counter, single writer). Stale once the epoch moves on after a seek or track change.
+    struct PlayheadStamp
+    {
+        std::atomic<uint32_t> sequence{0};
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<int64_t> hostTimeNs{0};  // steady_clock at the callback's start
+        std::atomic<uint64_t> frameEnd{0};   // Processed frame index after the block
+        std::atomic<uint64_t> originalFrameEnd{0};
+        std::atomic<uint32_t> blockFrames{0};
+        std::atomic<float> tempo{1.0f};
+    };
+
+    // A recorded take mixed over the track. Replaced by the UI thread through an atomic
+    // pointer and retired like a playback track.
+    struct TakePlayback
+    {
+        std::shared_ptr<const PcmStore> pcm;
+        uint64_t startFrame = 0;  // Original frame under the take's first frame
+        float tempo = 1.0f;
+        bool muteTrack = false;
+        uint64_t trackGeneration = 0;
+        std::vector<float> scratch;  // Take frames read per chunk
+    };
+
+    // Freed by releaseRetired() once the callback finished the blocks that may read it
+    struct RetiredPlayback
+    {
+        std::unique_ptr<PlaybackTrack> playback;
+        std::unique_ptr<TakePlayback> take;
+        uint64_t callbackBlocks = 0;  // m_callbackBlocks when it was replaced
+    };
+
+    struct PendingPreload
+    {
+        std::shared_ptr<AudioLoadHandle> handle;
+        std::future<std::unique_ptr<QueuedTrack>> result;
+    };
+
+    static bool decodeWavFile(const char* filePath, uint32_t targetSampleRate, size_t residentLimitBytes,
+                              DecodedAudio& out, const std::function<bool(float)>& onProgress);
+    static bool decodeMp3File(const char* filePath, uint32_t targetSampleRate, size_t residentLimitBytes,
+                              DecodedAudio& out, const std::function<bool(float)>& onProgress);
+    // Working set allowed per PCM store, derived from the memory budget (0 = unpaged)
+    size_t pcmResidentLimit() const;
+    void cancelPendingLoads();
+    void updateNextTrack();
+    bool takeQueuedTrackLocked();
+    void finishTrackSwitch();
+    // Returns false if onProgress aborted
+    // Records the original <-> stretched positions in timeMap
+    static bool stretchBuffer(const PcmStore& input, float tempo, PcmStore& output, TimeMap& timeMap,
+                              const std::function<bool(float)>& onProgress = {});
+    // The UI thread's view of m_playback; only the UI thread frees tracks
+    const PlaybackTrack* playbackTrack() const;
+    // Tempo of the playback track (1 without one)
+    float activeTempo() const;
+    // Swaps track in for the callback and retires the previous one (m_streamMutex held)
+    void publishPlaybackLocked(std::unique_ptr<PlaybackTrack> track);
+    void retireLocked(std::unique_ptr<PlaybackTrack> track);
+    void retireLocked(std::unique_ptr<TakePlayback> take);
+    // UI thread: frees retired tracks and takes the callback can no longer be reading
+    void releaseRetired();
+    void reportMemoryUsage();
+    void updateMemoryLocks();
+    void reportXruns();
+    void publishPlayhead(uint64_t epoch, int64_t hostTimeNs, uint64_t frameEnd, uint64_t originalFrameEnd,
+                         uint32_t blockFrames, float tempo);
     void resetState();
     bool ensureStreamReadyLocked();
+    bool startStreamLocked();
     bool openStreamLocked();
     void closeStreamLocked();
-    int processAudio(float* output, unsigned int frames, RtAudioStreamStatus status);
+    int processAudio(float* output, const float* input, unsigned int frames, RtAudioStreamStatus status);
+    void renderOutput(float* output, unsigned int frames, int64_t blockStartNs);
+    // Adds the take to frames of track starting at the processed frame processedStart
+    void mixTakePlayback(const PlaybackTrack& track, float* output, unsigned int frames, uint64_t processedStart);
     static int audioCallback(void* outputBuffer,
                              void* inputBuffer,
                              unsigned int nBufferFrames,
@@ -67,38 +337,68 @@ private:
                              void* userData);
 
     void reprocessAudioWithTempo(float multiplier);
-    void resampleBuffer(std::vector<float>& buffer, uint32_t channels,
-                        uint32_t srcRate, uint32_t dstRate, uint64_t& frameCount);
 
     bool m_initialized = false;
+    std::shared_future<bool> m_initResult;
+    std::vector<PendingLoad> m_pendingLoads;
+    PendingPreload m_pendingPreload;
+    std::unique_ptr<QueuedTrack> m_queuedTrack;
+    std::atomic<bool> m_queuedTrackArmed{false};  // Callback may roll over into m_queuedTrack
+    std::atomic<bool> m_queuedTrackTaken{false};  // Processed buffer swapped in, UI side pending
+    bool m_trackSwitched = false;
+    std::atomic<uint64_t> m_trackGeneration{0};   // Bumped whenever the playing track changes
     std::atomic<bool> m_playing{false};
     bool m_hasAudio = false;
     std::atomic<bool> m_endOfStream{false};
-    std::atomic<float> m_currentTime{0.0f};
+    std::atomic<uint64_t> m_currentFrame{0};  // Original frame after the last rendered block
     std::atomic<float> m_tempoMultiplier{1.0f};
-    float m_activeTempoMultiplier = 1.0f;  // Currently applied tempo
     std::atomic<bool> m_tempoProcessingInProgress{false};
     std::atomic<float> m_tempoProcessingProgress{0.0f};
     float m_duration = 0.0f;  // Always original duration
     uint32_t m_sampleRate = 0;
     uint32_t m_channelCount = 0;
     uint64_t m_frameCount = 0;  // Always original frame count
-    uint64_t m_processedFrameCount = 0;  // Frame count of processed buffer
     std::atomic<uint64_t> m_playbackFrameIndex{0};  // Index in processed buffer
-    std::vector<float> m_originalAudioBuffer;  // Original audio data
-    std::vector<float> m_processedAudioBuffer; // Tempo-adjusted audio
+    std::atomic<uint64_t> m_playheadEpoch{0};       // Bumped when the playback position jumps
+    PlayheadStamp m_playheadStamp;
+    std::atomic<uint32_t> m_streamLatencyFrames{0};
+    std::function<void()> m_wakeCallback;
+    std::shared_ptr<PcmStore> m_originalAudio;   // Original audio data
+    std::atomic<PlaybackTrack*> m_playback{nullptr};  // Owned; read once per block by the callback
+    std::vector<RetiredPlayback> m_retiredPlayback;   // Guarded by m_streamMutex
+    Metronome m_metronome;                       // Prepared when a stream opens
+    Scrubber m_scrubber;                         // Reads the playback track; prepared when a stream opens
+    LivePitchTracker m_livePitch;                // Runs while a stream with input is open
+    std::atomic<bool> m_inputEnabled{false};
+    TakeRecorder m_recorder;                     // Fed by the callback while a stream with input runs
+    std::atomic<TakePlayback*> m_takePlayback{nullptr};  // Owned; see setTakePlayback()
+    std::atomic<uint64_t> m_callbackBlocks{0};   // Blocks the callback has finished
+    std::atomic<uint64_t> m_scrubFrame{0};       // Original frame under the dragged cursor
     std::string m_loadedFilePath;
-
+    MemoryBudget* m_memoryBudget = nullptr;
+    std::atomic<uint64_t> m_xrunCount{0};
+    uint64_t m_reportedXrunCount = 0;
+    std::chrono::steady_clock::time_point m_lastXrunReport;
+    std::atomic<bool> m_callbackThreadChecked{false};  // Reset when a stream opens
+    std::atomic<bool> m_callbackRealtime{false};
+    bool m_priorityFailureReported = false;
 
     std::unique_ptr<RtAudio> m_rtaudio;
+    uint32_t m_offlineSampleRate = 0;  // Non-zero: offline backend instead of RtAudio
     RtAudio::StreamParameters m_streamParams{};
+    RtAudio::StreamParameters m_inputParams{};
     RtAudio::StreamOptions m_streamOptions{};
     unsigned int m_bufferFrames = 512;
     uint32_t m_streamSampleRate = 0;
     uint32_t m_streamChannels = 0;
     bool m_streamOpen = false;
     bool m_streamRunning = false;
+    bool m_streamHasInput = false;
     int m_defaultDeviceId = -1;
+    int m_defaultInputDeviceId = -1;  // -1 without an input device
+    std::vector<float> m_offlineInput;       // Mono, at m_offlineSampleRate
+    size_t m_offlineInputPosition = 0;
+    std::vector<float> m_offlineInputBlock;
     uint32_t m_deviceSampleRate = 0;
     std::mutex m_streamMutex;
 };
\ No newline at end of file
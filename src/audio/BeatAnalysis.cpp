@@ -0,0 +1,520 @@
+#include "BeatAnalysis.h"
+#include "Fft.h"
+#include "PcmStore.h"
+#include "core/AnalysisCache.h"
+#include "core/BinaryIO.h"
+#include "core/Trace.h"
+#include "platform/RealtimeSupport.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr const char* kCacheKind = "beats";
+
+    constexpr size_t kChunkHops = 256;            // Flux frames per work item
+    constexpr uint32_t kEnergyBlockFrames = 64;   // Resolution of onset positions
+    constexpr int64_t kOnsetContextBlocks = 8;    // Blocks an onset is compared with (~10 ms)
+    constexpr float kCompression = 100.0f;        // Spectra are log(1 + kCompression * magnitude)
+    constexpr float kProgressShare = 0.9f;        // Of the whole analysis, for the spectra
+
+    // An onset is the largest flux within kPeakSeconds and exceeds the mean around it
+    // ([-kMeanBeforeSeconds, kMeanAfterSeconds]) by kThreshold standard deviations
+    constexpr double kPeakSeconds = 0.03;
+    constexpr double kMeanBeforeSeconds = 0.1;
+    constexpr double kMeanAfterSeconds = 0.07;
+    constexpr float kThreshold = 0.5f;
+
+    constexpr double kMinBpm = 40.0;
+    constexpr double kMaxBpm = 240.0;
+    constexpr double kPreferredBpm = 120.0;  // Centre of the tempo prior (one octave wide)
+    constexpr double kTightness = 100.0;     // How strongly beat spacing sticks to the tempo
+
+    // Read-only state shared by the flux threads
+    struct FluxSetup
+    {
+        FluxSetup(const PcmStore& store, size_t size) : pcm(store), fft(size) {}
+
+        const PcmStore& pcm;
+        Fft fft;
+        std::vector<float> window;
+        size_t fftSize = 0;
+        size_t hop = 0;
+        size_t hopCount = 0;  // Flux frame i is centred on source frame i * hop
+        size_t energyBlocks = 0;
+    };
+
+    struct FluxBuffers
+    {
+        std::vector<float> interleaved;
+        std::vector<float> mono;
+        std::vector<float> re;
+        std::vector<float> im;
+        std::vector<float> previous;
+        std::vector<float> current;
+    };
+
+    // Flux frames [firstHop, endHop) and the energy blocks of source frames
+    // [firstHop * hop, endHop * hop). Frame i is compared with frame i - 1, so the chunk
+    // computes one spectrum more than it writes; two real frames share each complex FFT.
+    void computeChunk(const FluxSetup& setup, FluxBuffers& buffers, size_t firstHop, size_t endHop,
+                      float* flux, float* energy)
+    {
+        const size_t n = setup.fftSize;
+        const size_t bins = n / 2 + 1;
+        const int64_t sampleStart = (static_cast<int64_t>(firstHop) - 1) * static_cast<int64_t>(setup.hop)
+                                    - static_cast<int64_t>(n / 2);
+        const int64_t sampleEnd = (static_cast<int64_t>(endHop) - 1) * static_cast<int64_t>(setup.hop)
+                                  + static_cast<int64_t>(n / 2);
+
+        // Mono mix of the span; silence before the start and after the end of the track
+        buffers.mono.assign(static_cast<size_t>(sampleEnd - sampleStart), 0.0f);
+        const uint32_t channels = setup.pcm.channelCount();
+        const uint64_t readFrom = static_cast<uint64_t>(std::max<int64_t>(0, sampleStart));
+        const uint64_t readTo = std::min<uint64_t>(setup.pcm.frameCount(), static_cast<uint64_t>(std::max<int64_t>(0, sampleEnd)));
+        if (readTo > readFrom)
+        {
+            buffers.interleaved.resize(static_cast<size_t>(readTo - readFrom) * channels);
+            const uint64_t got = setup.pcm.read(readFrom, buffers.interleaved.data(), readTo - readFrom);
+            float* mono = buffers.mono.data() + (static_cast<int64_t>(readFrom) - sampleStart);
+            const float scale = 1.0f / static_cast<float>(channels);
+            for (uint64_t frame = 0; frame < got; ++frame)
+            {
+                float sum = 0.0f;
+                for (uint32_t channel = 0; channel < channels; ++channel)
+                    sum += buffers.interleaved[frame * channels + channel];
+                mono[frame] = sum * scale;
+            }
+        }
+
+        buffers.re.resize(n);
+        buffers.im.resize(n);
+        buffers.previous.resize(bins);
+        buffers.current.resize(bins);
+        const float magnitudeScale = kCompression * 2.0f / static_cast<float>(n);  // Hann gain: n / 2
+        const size_t spectra = endHop - firstHop + 1;
+        for (size_t pair = 0; pair < spectra; pair += 2)
+        {
+            const float* first = buffers.mono.data() + pair * setup.hop;
+            const bool hasSecond = pair + 1 < spectra;
+            for (size_t i = 0; i < n; ++i)
+            {
+                buffers.re[i] = first[i] * setup.window[i];
+                buffers.im[i] = hasSecond ? first[i + setup.hop] * setup.window[i] : 0.0f;
+            }
+            setup.fft.forward(buffers.re.data(), buffers.im.data());
+
+            // Z = A + iB for real frames a and b: A[k] = (Z[k] + conj Z[n-k]) / 2, B[k] = (Z[k] - conj Z[n-k]) / 2i
+            for (size_t half = 0; half < 2 && pair + half < spectra; ++half)
+            {
+                const float* re = buffers.re.data();
+                const float* im = buffers.im.data();
+                for (size_t k = 0; k < bins; ++k)
+                {
+                    const size_t mirror = (n - k) & (n - 1);
+                    const float x = half == 0 ? re[k] + re[mirror] : im[k] + im[mirror];
+                    const float y = half == 0 ? im[k] - im[mirror] : re[k] - re[mirror];
+                    buffers.current[k] = std::log1p(magnitudeScale * 0.5f * std::sqrt(x * x + y * y));
+                }
+
+                const size_t spectrum = pair + half;
+                if (spectrum > 0)
+                {
+                    float sum = 0.0f;
+                    for (size_t k = 1; k < bins; ++k)
+                        sum += std::max(0.0f, buffers.current[k] - buffers.previous[k]);
+                    flux[firstHop + spectrum - 1] = sum;
+                }
+                buffers.previous.swap(buffers.current);
+            }
+        }
+
+        const size_t firstBlock = firstHop * setup.hop / kEnergyBlockFrames;
+        const size_t endBlock = std::min(setup.energyBlocks, endHop * setup.hop / kEnergyBlockFrames);
+        for (size_t block = firstBlock; block < endBlock; ++block)
+        {
+            const float* samples = buffers.mono.data() + (static_cast<int64_t>(block * kEnergyBlockFrames) - sampleStart);
+            float sum = 0.0f;
+            for (uint32_t i = 0; i < kEnergyBlockFrames; ++i)
+                sum += samples[i] * samples[i];
+            energy[block] = sum;
+        }
+    }
+
+    // Peaks of the standardised flux, as flux frame indices
+    std::vector<size_t> pickPeaks(const std::vector<float>& strength, size_t peakRadius, size_t meanBefore, size_t meanAfter)
+    {
+        std::vector<double> prefix(strength.size() + 1, 0.0);
+        for (size_t i = 0; i < strength.size(); ++i)
+            prefix[i + 1] = prefix[i] + strength[i];
+
+        std::vector<size_t> peaks;
+        for (size_t i = 0; i < strength.size(); ++i)
+        {
+            const size_t from = i >= peakRadius ? i - peakRadius : 0;
+            const size_t to = std::min(strength.size(), i + peakRadius + 1);
+            if (std::max_element(strength.begin() + from, strength.begin() + to) != strength.begin() + i)
+                continue;
+
+            const size_t meanFrom = i >= meanBefore ? i - meanBefore : 0;
+            const size_t meanTo = std::min(strength.size(), i + meanAfter + 1);
+            const double mean = (prefix[meanTo] - prefix[meanFrom]) / static_cast<double>(meanTo - meanFrom);
+            if (strength[i] < mean + kThreshold)
+                continue;
+            if (!peaks.empty() && i - peaks.back() <= peakRadius)
+                continue;
+            peaks.push_back(i);
+        }
+        return peaks;
+    }
+
+    // The flux of frame i peaks for onsets from n / 2 before its centre to a hop after it:
+    // the onset is the energy block in that range that rises most above the blocks
+    // just before it. Comparing with their maximum ignores the dips of low notes between cycles.
+    uint64_t refineOnset(const std::vector<float>& energy, size_t hopIndex, size_t hop, size_t fftSize)
+    {
+        const int64_t centre = static_cast<int64_t>(hopIndex * hop);
+        const int64_t from = std::max<int64_t>(1, (centre - static_cast<int64_t>(fftSize / 2)) / kEnergyBlockFrames);
+        const int64_t to = std::min<int64_t>(static_cast<int64_t>(energy.size()) - 1,
+                                             (centre + static_cast<int64_t>(hop)) / kEnergyBlockFrames);
+        const float floor = 1e-9f;
+        int64_t best = -1;
+        float bestRise = 0.0f;
+        for (int64_t block = from; block <= to; ++block)
+        {
+            const int64_t first = std::max<int64_t>(0, block - kOnsetContextBlocks);
+            const float before = *std::max_element(energy.begin() + first, energy.begin() + block);
+            const float rise = std::log(energy[block] + floor) - std::log(before + floor);
+            if (rise > bestRise)
+            {
+                bestRise = rise;
+                best = block;
+            }
+        }
+        return best >= 0 ? static_cast<uint64_t>(best) * kEnergyBlockFrames : static_cast<uint64_t>(centre);
+    }
+
+    // Beat period in flux frames: the autocorrelation peak between kMinBpm and kMaxBpm,
+    // weighted towards kPreferredBpm so that the tempo octave is the one a listener counts
+    double estimatePeriod(const std::vector<float>& strength, double hopsPerMinute)
+    {
+        const size_t minLag = std::max<size_t>(2, static_cast<size_t>(hopsPerMinute / kMaxBpm));
+        const size_t maxLag = static_cast<size_t>(std::ceil(hopsPerMinute / kMinBpm)) + 1;
+        if (strength.size() < 2 * maxLag)
+            return 0.0;
+
+        std::vector<double> correlation(maxLag + 1, 0.0);
+        for (size_t lag = minLag - 1; lag <= maxLag; ++lag)
+        {
+            double sum = 0.0;
+            for (size_t i = lag; i < strength.size(); ++i)
+                sum += static_cast<double>(strength[i]) * strength[i - lag];
+            correlation[lag] = sum / static_cast<double>(strength.size() - lag);
+        }
+
+        size_t best = 0;
+        double bestScore = 0.0;
+        for (size_t lag = minLag; lag < maxLag; ++lag)
+        {
+            const double octaves = std::log2(hopsPerMinute / lag / kPreferredBpm);
+            const double score = correlation[lag] * std::exp(-0.5 * octaves * octaves);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best = lag;
+            }
+        }
+        if (best == 0)
+            return 0.0;
+
+        const double before = correlation[best - 1];
+        const double at = correlation[best];
+        const double after = correlation[best + 1];
+        const double curvature = before - 2.0 * at + after;
+        const double shift = curvature < 0.0 ? std::clamp(0.5 * (before - after) / curvature, -0.5, 0.5) : 0.0;
+        return static_cast<double>(best) + shift;
+    }
+
+    // Dynamic programming beat tracker (Ellis 2007): each beat maximises the onset strength
+    // plus the best score of a predecessor, penalised by how far their spacing is from period
+    std::vector<size_t> trackBeats(const std::vector<float>& strength, double period)
+    {
+        const size_t count = strength.size();
+        std::vector<double> score(count, 0.0);
+        std::vector<int64_t> previous(count, -1);
+        const int64_t shortest = std::max<int64_t>(1, std::llround(period / 2.0));
+        const int64_t longest = std::llround(period * 2.0);
+        for (size_t t = 0; t < count; ++t)
+        {
+            double best = -std::numeric_limits<double>::infinity();
+            int64_t bestFrame = -1;
+            for (int64_t frame = std::max<int64_t>(0, static_cast<int64_t>(t) - longest);
+                 frame <= static_cast<int64_t>(t) - shortest; ++frame)
+            {
+                const double spacing = std::log(static_cast<double>(static_cast<int64_t>(t) - frame) / period);
+                const double candidate = score[frame] - kTightness * spacing * spacing;
+                if (candidate > best)
+                {
+                    best = candidate;
+                    bestFrame = frame;
+                }
+            }
+            score[t] = strength[t] + (bestFrame >= 0 ? std::max(0.0, best) : 0.0);
+            previous[t] = (bestFrame >= 0 && best > 0.0) ? bestFrame : -1;
+        }
+
+        // The last beat is the best score within the final period
+        const size_t tail = std::min(count, static_cast<size_t>(std::ceil(period)));
+        int64_t beat = static_cast<int64_t>(std::max_element(score.end() - tail, score.end()) - score.begin());
+        std::vector<size_t> beats;
+        for (; beat >= 0; beat = previous[beat])
+            beats.push_back(static_cast<size_t>(beat));
+        std::reverse(beats.begin(), beats.end());
+        return beats;
+    }
+
+    void putFrames(std::string& out, const std::vector<uint64_t>& frames)
+    {
+        BinaryIO::put(out, static_cast<uint32_t>(frames.size()));
+        for (const uint64_t frame : frames)
+            BinaryIO::put(out, frame);
+    }
+
+    bool getFrames(BinaryIO::Reader& reader, size_t limit, std::vector<uint64_t>& frames)
+    {
+        const uint32_t count = reader.get<uint32_t>();
+        if (!reader.ok() || count > limit)
+            return false;
+        frames.resize(count);
+        for (uint64_t& frame : frames)
+            frame = reader.get<uint64_t>();
+        return reader.ok() && std::is_sorted(frames.begin(), frames.end());
+    }
+}
+
+bool BeatAnalysis::nearest(const std::vector<uint64_t>& sorted, uint64_t frame, uint64_t maxDistance, uint64_t& out)
+{
+    const auto after = std::lower_bound(sorted.begin(), sorted.end(), frame);
+    bool found = false;
+    uint64_t bestDistance = maxDistance;
+    if (after != sorted.end() && *after - frame <= bestDistance)
+    {
+        bestDistance = *after - frame;
+        out = *after;
+        found = true;
+    }
+    if (after != sorted.begin() && frame - *(after - 1) <= bestDistance)
+    {
+        out = *(after - 1);
+        found = true;
+    }
+    return found;
+}
+
+bool BeatAnalysis::fitGrid(uint32_t beatsPerBar, BeatGrid& out) const
+{
+    if (beats.size() < 4 || bpm <= 0.0 || sampleRate == 0)
+        return false;
+
+    // Number each beat by its distance from the previous one, so tempo drift in the
+    // estimate does not accumulate, then fit beats[k] = offset + index[k] * period
+    const double estimate = 60.0 * sampleRate / bpm;
+    double index = 0.0;
+    double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+    for (size_t k = 0; k < beats.size(); ++k)
+    {
+        if (k > 0)
+            index += std::max(1.0, std::round(static_cast<double>(beats[k] - beats[k - 1]) / estimate));
+        const double y = static_cast<double>(beats[k]);
+        sumX += index;
+        sumY += y;
+        sumXX += index * index;
+        sumXY += index * y;
+    }
+    const double n = static_cast<double>(beats.size());
+    const double denominator = n * sumXX - sumX * sumX;
+    if (denominator <= 0.0)
+        return false;
+    const double period = (n * sumXY - sumX * sumY) / denominator;
+    if (period <= 0.0)
+        return false;
+
+    // The downbeat must not lie before the track; move it on by whole bars
+    double offset = (sumY - period * sumX) / n;
+    const uint32_t barBeats = std::max<uint32_t>(1, beatsPerBar);
+    if (offset < 0.0)
+        offset += std::ceil(-offset / (period * barBeats)) * period * barBeats;
+
+    out.bpm = 60.0 * sampleRate / period;
+    out.firstBeatFrame = static_cast<uint64_t>(std::llround(offset));
+    out.beatsPerBar = barBeats;
+    return true;
+}
+
+namespace BeatDetection
+{
+    bool analyze(const PcmStore& pcm, BeatAnalysis& out, const std::function<bool(float)>& onProgress,
+                 unsigned int threadCount)
+    {
+        out = BeatAnalysis{};
+        out.sampleRate = pcm.sampleRate();
+        if (pcm.empty() || pcm.sampleRate() == 0)
+            return false;
+
+        FluxSetup setup(pcm, pcm.sampleRate() >= 32000 ? 2048 : 1024);
+        setup.fftSize = setup.fft.size();
+        setup.hop = setup.fftSize / 4;
+        setup.hopCount = static_cast<size_t>(pcm.frameCount() / setup.hop) + 1;
+        setup.energyBlocks = static_cast<size_t>((pcm.frameCount() + kEnergyBlockFrames - 1) / kEnergyBlockFrames);
+        setup.window.resize(setup.fftSize);
+        for (size_t i = 0; i < setup.fftSize; ++i)
+            setup.window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / setup.fftSize));
+
+        // Spectral flux and block energies, chunk by chunk on every core
+        std::vector<float> flux(setup.hopCount, 0.0f);
+        std::vector<float> energy(setup.energyBlocks, 0.0f);
+        const size_t chunks = (setup.hopCount + kChunkHops - 1) / kChunkHops;
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<size_t> finishedChunks{0};
+        std::atomic<bool> cancelled{false};
+        const auto work = [&](bool reportProgress) {
+            FluxBuffers buffers;
+            while (!cancelled.load())
+            {
+                const size_t chunk = nextChunk.fetch_add(1);
+                if (chunk >= chunks)
+                    break;
+                const size_t firstHop = chunk * kChunkHops;
+                computeChunk(setup, buffers, firstHop, std::min(setup.hopCount, firstHop + kChunkHops),
+                             flux.data(), energy.data());
+                const size_t finished = finishedChunks.fetch_add(1) + 1;
+                if (reportProgress && onProgress
+                    && !onProgress(kProgressShare * static_cast<float>(finished) / static_cast<float>(chunks)))
+                    cancelled.store(true);
+            }
+        };
+
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < std::min<size_t>(threadCount, chunks); ++i)
+        {
+            workers.emplace_back([&work]() {
+                RealtimeSupport::configureWorkerThread();
+                Trace::setThreadName("Beat analysis");
+                work(false);
+            });
+        }
+        work(true);
+        for (std::thread& worker : workers)
+            worker.join();
+        if (cancelled.load())
+            return false;
+
+        // Standardise the flux so thresholds and the tracker do not depend on loudness
+        double mean = 0.0;
+        for (const float value : flux)
+            mean += value;
+        mean /= static_cast<double>(flux.size());
+        double variance = 0.0;
+        for (const float value : flux)
+            variance += (value - mean) * (value - mean);
+        const double deviation = std::sqrt(variance / static_cast<double>(flux.size()));
+        if (deviation <= 0.0)
+            return true;  // Silence or a steady tone: nothing to find
+        std::vector<float> strength(flux.size());
+        for (size_t i = 0; i < flux.size(); ++i)
+            strength[i] = static_cast<float>((flux[i] - mean) / deviation);
+
+        const double hopsPerSecond = static_cast<double>(pcm.sampleRate()) / setup.hop;
+        const auto hops = [hopsPerSecond](double seconds) {
+            return std::max<size_t>(1, static_cast<size_t>(std::lround(seconds * hopsPerSecond)));
+        };
+        const std::vector<size_t> peaks = pickPeaks(strength, hops(kPeakSeconds), hops(kMeanBeforeSeconds),
+                                                    hops(kMeanAfterSeconds));
+        std::vector<int64_t> peakOffsets;
+        for (const size_t peak : peaks)
+        {
+            const uint64_t onset = refineOnset(energy, peak, setup.hop, setup.fftSize);
+            out.onsets.push_back(onset);
+            peakOffsets.push_back(static_cast<int64_t>(onset) - static_cast<int64_t>(peak * setup.hop));
+        }
+        out.onsets.erase(std::unique(out.onsets.begin(), out.onsets.end()), out.onsets.end());
+        if (onProgress && !onProgress(0.95f))
+            return false;
+
+        // Beats on the onset strength (negative values would reward skipping beats)
+        for (float& value : strength)
+            value = std::max(0.0f, value);
+        const double period = estimatePeriod(strength, 60.0 * hopsPerSecond);
+        if (period > 0.0)
+        {
+            out.bpm = 60.0 * hopsPerSecond / period;
+
+            // A beat on a detected onset takes its position; others are shifted like a typical onset
+            std::vector<int64_t> sortedOffsets = peakOffsets;
+            std::nth_element(sortedOffsets.begin(), sortedOffsets.begin() + sortedOffsets.size() / 2, sortedOffsets.end());
+            const int64_t typicalOffset = sortedOffsets.empty() ? 0 : sortedOffsets[sortedOffsets.size() / 2];
+            for (const size_t beat : trackBeats(strength, period))
+            {
+                const auto peak = std::lower_bound(peaks.begin(), peaks.end(), beat > 0 ? beat - 1 : 0);
+                int64_t frame = static_cast<int64_t>(beat * setup.hop) + typicalOffset;
+                if (peak != peaks.end() && *peak <= beat + 1)
+                    frame = static_cast<int64_t>(*peak * setup.hop) + peakOffsets[peak - peaks.begin()];
+                if (frame >= 0 && (out.beats.empty() || static_cast<uint64_t>(frame) > out.beats.back()))
+                    out.beats.push_back(static_cast<uint64_t>(frame));
+            }
+
+            BeatGrid grid;
+            if (out.fitGrid(1, grid))
+                out.bpm = grid.bpm;
+        }
+        if (onProgress)
+            onProgress(1.0f);
+        return true;
+    }
+
+    bool loadCached(const std::string& audioPath, uint32_t sampleRate, BeatAnalysis& out)
+    {
+        std::string payload;
+        if (!AnalysisCache::load(audioPath, kCacheKind, sampleRate, payload))
+            return false;
+
+        BinaryIO::Reader reader(payload);
+        BeatAnalysis analysis;
+        analysis.sampleRate = sampleRate;
+        analysis.bpm = reader.get<double>();
+        const size_t limit = payload.size() / sizeof(uint64_t);
+        if (!getFrames(reader, limit, analysis.onsets) || !getFrames(reader, limit, analysis.beats))
+        {
+            std::cerr << "BeatDetection: Ignoring damaged cache for " << audioPath << std::endl;
+            return false;
+        }
+        out = std::move(analysis);
+        return true;
+    }
+
+    bool saveCached(const std::string& audioPath, const BeatAnalysis& analysis)
+    {
+        std::string payload;
+        BinaryIO::put(payload, analysis.bpm);
+        putFrames(payload, analysis.onsets);
+        putFrames(payload, analysis.beats);
+        return AnalysisCache::store(audioPath, kCacheKind, analysis.sampleRate, payload);
+    }
+
+    BeatAnalysis analyzeTrack(const std::string& audioPath, const PcmStore& pcm, const std::function<bool(float)>& onProgress)
+    {
+        BeatAnalysis analysis;
+        if (loadCached(audioPath, pcm.sampleRate(), analysis))
+            return analysis;
+        if (!analyze(pcm, analysis, onProgress))
+            return BeatAnalysis{};
+        saveCached(audioPath, analysis);
+        return analysis;
+    }
+}
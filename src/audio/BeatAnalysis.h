@@ -0,0 +1,42 @@
+#pragma once
+
+#include "core/ApplicationState.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class PcmStore;
+
+// Onsets and beats of a track, as sorted frame positions at sampleRate
+struct BeatAnalysis
+{
+    uint32_t sampleRate = 0;
+    double bpm = 0.0;
+    std::vector<uint64_t> onsets;
+    std::vector<uint64_t> beats;
+
+    bool empty() const { return onsets.empty() && beats.empty(); }
+
+    // Entry of sorted closest to frame, if one lies within maxDistance frames (binary search)
+    static bool nearest(const std::vector<uint64_t>& sorted, uint64_t frame, uint64_t maxDistance, uint64_t& out);
+    // Constant-tempo grid through the beats (least squares), its downbeat on the first beat
+    bool fitGrid(uint32_t beatsPerBar, BeatGrid& out) const;
+};
+
+namespace BeatDetection
+{
+    // Spectral-flux onsets, tempo from the flux autocorrelation and beats from dynamic
+    // programming over the flux. The spectra are computed by threadCount threads (0 = one
+    // per core), the calling thread included. onProgress runs on the calling thread and
+    // cancels by returning false.
+    bool analyze(const PcmStore& pcm, BeatAnalysis& out, const std::function<bool(float)>& onProgress,
+                 unsigned int threadCount = 0);
+
+    // Per-track results in the AnalysisCache
+    bool loadCached(const std::string& audioPath, uint32_t sampleRate, BeatAnalysis& out);
+    bool saveCached(const std::string& audioPath, const BeatAnalysis& analysis);
+    // The cached analysis of the track, or a new one that is then cached; empty if cancelled
+    BeatAnalysis analyzeTrack(const std::string& audioPath, const PcmStore& pcm,
+                              const std::function<bool(float)>& onProgress);
+}
@@ -0,0 +1,121 @@
+#include "DecoderInput.h"
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+    enum class SeekOrigin
+    {
+        Start,
+        Current,
+        End
+    };
+
+    size_t readCallback(void* userData, void* buffer, size_t bytes)
+    {
+        return static_cast<AsyncFileReader*>(userData)->read(buffer, bytes);
+    }
+
+    bool seekReader(void* userData, int offset, SeekOrigin origin)
+    {
+        AsyncFileReader& reader = *static_cast<AsyncFileReader*>(userData);
+        int64_t base = 0;
+        if (origin == SeekOrigin::Current)
+            base = static_cast<int64_t>(reader.tell());
+        else if (origin == SeekOrigin::End)
+            base = static_cast<int64_t>(reader.size());
+
+        const int64_t target = base + offset;
+        return target >= 0 && reader.seek(static_cast<uint64_t>(target));
+    }
+
+    // dr_wav 0.14 and dr_mp3 0.7 renamed the seek origins and added a tell callback
+#if DRWAV_VERSION_MAJOR > 0 || DRWAV_VERSION_MINOR >= 14
+    drwav_bool32 wavSeekCallback(void* userData, int offset, drwav_seek_origin origin)
+    {
+        const SeekOrigin from = (origin == DRWAV_SEEK_SET) ? SeekOrigin::Start
+                              : (origin == DRWAV_SEEK_CUR) ? SeekOrigin::Current : SeekOrigin::End;
+        return seekReader(userData, offset, from) ? DRWAV_TRUE : DRWAV_FALSE;
+    }
+
+    drwav_bool32 wavTellCallback(void* userData, drwav_int64* cursor)
+    {
+        *cursor = static_cast<drwav_int64>(static_cast<AsyncFileReader*>(userData)->tell());
+        return DRWAV_TRUE;
+    }
+#else
+    drwav_bool32 wavSeekCallback(void* userData, int offset, drwav_seek_origin origin)
+    {
+        const SeekOrigin from = (origin == drwav_seek_origin_start) ? SeekOrigin::Start : SeekOrigin::Current;
+        return seekReader(userData, offset, from) ? DRWAV_TRUE : DRWAV_FALSE;
+    }
+#endif
+
+#if DRMP3_VERSION_MAJOR > 0 || DRMP3_VERSION_MINOR >= 7
+    drmp3_bool32 mp3SeekCallback(void* userData, int offset, drmp3_seek_origin origin)
+    {
+        const SeekOrigin from = (origin == DRMP3_SEEK_SET) ? SeekOrigin::Start
+                              : (origin == DRMP3_SEEK_CUR) ? SeekOrigin::Current : SeekOrigin::End;
+        return seekReader(userData, offset, from) ? DRMP3_TRUE : DRMP3_FALSE;
+    }
+
+    drmp3_bool32 mp3TellCallback(void* userData, drmp3_int64* cursor)
+    {
+        *cursor = static_cast<drmp3_int64>(static_cast<AsyncFileReader*>(userData)->tell());
+        return DRMP3_TRUE;
+    }
+#else
+    drmp3_bool32 mp3SeekCallback(void* userData, int offset, drmp3_seek_origin origin)
+    {
+        const SeekOrigin from = (origin == drmp3_seek_origin_start) ? SeekOrigin::Start : SeekOrigin::Current;
+        return seekReader(userData, offset, from) ? DRMP3_TRUE : DRMP3_FALSE;
+    }
+#endif
+}
+
+namespace DecoderInput
+{
+    bool openWav(drwav& wav, const std::string& filePath, AsyncFileReader& reader)
+    {
+        if (!reader.open(filePath))
+            return drwav_init_file(&wav, filePath.c_str(), nullptr);
+
+#if DRWAV_VERSION_MAJOR > 0 || DRWAV_VERSION_MINOR >= 14
+        const bool opened = drwav_init(&wav, readCallback, wavSeekCallback, wavTellCallback, &reader, nullptr);
+#else
+        const bool opened = drwav_init(&wav, readCallback, wavSeekCallback, &reader, nullptr);
+#endif
+        if (!opened)
+            reader.close();
+        return opened;
+    }
+
+    bool openMp3(drmp3& mp3, const std::string& filePath, AsyncFileReader& reader)
+    {
+        if (!reader.open(filePath))
+            return drmp3_init_file(&mp3, filePath.c_str(), nullptr);
+
+#if DRMP3_VERSION_MAJOR > 0 || DRMP3_VERSION_MINOR >= 7
+        const bool opened = drmp3_init(&mp3, readCallback, mp3SeekCallback, mp3TellCallback, nullptr, &reader, nullptr);
+#else
+        const bool opened = drmp3_init(&mp3, readCallback, mp3SeekCallback, &reader, nullptr);
+#endif
+        if (!opened)
+            reader.close();
+        return opened;
+    }
+
+    void logStats(const char* owner, const AsyncFileReader& reader)
+    {
+        const AsyncFileReader::Stats stats = reader.stats();
+        if (stats.requests == 0)
+            return;
+
+        std::cout << owner << ": Read " << std::fixed << std::setprecision(1)
+                  << static_cast<double>(stats.bytesRead) / (1024.0 * 1024.0) << " MiB via "
+                  << AsyncFileReader::backendName(reader.backend()) << " at " << stats.throughputMiBs()
+                  << " MiB/s (" << stats.requests << " reads, avg " << std::setprecision(2) << stats.averageLatencyMs()
+                  << " ms, max " << static_cast<double>(stats.latencyMaxNs) * 1e-6 << " ms, waited "
+                  << static_cast<double>(stats.waitNs) * 1e-6 << " ms)" << std::defaultfloat << std::endl;
+    }
+}
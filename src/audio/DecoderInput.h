@@ -0,0 +1,19 @@
+#pragma once
+
+#include "dr_mp3.h"
+#include "dr_wav.h"
+#include "platform/AsyncFileReader.h"
+#include <string>
+
+// Opens the dr_libs decoders on an AsyncFileReader through their read/seek callbacks,
+// so decoding is fed by read-ahead I/O instead of blocking FILE* reads. When the reader
+// cannot open the file the decoders fall back to dr_libs' own file functions.
+// The reader must outlive the decoder.
+namespace DecoderInput
+{
+    bool openWav(drwav& wav, const std::string& filePath, AsyncFileReader& reader);
+    bool openMp3(drmp3& mp3, const std::string& filePath, AsyncFileReader& reader);
+
+    // One log line with the reader's throughput and latency counters (nothing if unused)
+    void logStats(const char* owner, const AsyncFileReader& reader);
+}
@@ -0,0 +1,95 @@
+#include "Fft.h"
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define SONGPRACTICE_FFT_SSE 1
+#endif
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+}
+
+Fft::Fft(size_t size)
+    : m_size(size)
+{
+    size_t bits = 0;
+    while ((size_t(1) << bits) < size)
+        ++bits;
+    for (size_t i = 0; i < size; ++i)
+    {
+        size_t reversed = 0;
+        for (size_t bit = 0; bit < bits; ++bit)
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        if (i < reversed)
+        {
+            m_bitReverse.push_back(i);
+            m_bitReverse.push_back(reversed);
+        }
+    }
+
+    // Stage h (1, 2, 4, ...) needs w^k = e^{-i*pi*k/h} for k < h; 1 + 2 + ... + N/2 = N - 1
+    m_cos.reserve(size);
+    m_sin.reserve(size);
+    for (size_t half = 1; half < size; half *= 2)
+    {
+        for (size_t k = 0; k < half; ++k)
+        {
+            const double angle = -kPi * static_cast<double>(k) / static_cast<double>(half);
+            m_cos.push_back(static_cast<float>(std::cos(angle)));
+            m_sin.push_back(static_cast<float>(std::sin(angle)));
+        }
+    }
+}
+
+void Fft::forward(float* re, float* im) const
+{
+    for (size_t i = 0; i < m_bitReverse.size(); i += 2)
+    {
+        std::swap(re[m_bitReverse[i]], re[m_bitReverse[i + 1]]);
+        std::swap(im[m_bitReverse[i]], im[m_bitReverse[i + 1]]);
+    }
+
+    for (size_t half = 1; half < m_size; half *= 2)
+    {
+        const float* wr = m_cos.data() + half - 1;
+        const float* wi = m_sin.data() + half - 1;
+        for (size_t group = 0; group < m_size; group += 2 * half)
+        {
+            float* ar = re + group;
+            float* ai = im + group;
+            float* br = ar + half;
+            float* bi = ai + half;
+            size_t k = 0;
+#ifdef SONGPRACTICE_FFT_SSE
+            for (; k + 4 <= half; k += 4)
+            {
+                const __m128 cosines = _mm_loadu_ps(wr + k);
+                const __m128 sines = _mm_loadu_ps(wi + k);
+                const __m128 xr = _mm_loadu_ps(br + k);
+                const __m128 xi = _mm_loadu_ps(bi + k);
+                // t = b * w
+                const __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cosines), _mm_mul_ps(xi, sines));
+                const __m128 ti = _mm_add_ps(_mm_mul_ps(xr, sines), _mm_mul_ps(xi, cosines));
+                const __m128 yr = _mm_loadu_ps(ar + k);
+                const __m128 yi = _mm_loadu_ps(ai + k);
+                _mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+                _mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+                _mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+                _mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+            }
+#endif
+            for (; k < half; ++k)
+            {
+                const float tr = br[k] * wr[k] - bi[k] * wi[k];
+                const float ti = br[k] * wi[k] + bi[k] * wr[k];
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+    }
+}
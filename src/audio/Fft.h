@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// In-place radix-2 complex FFT on split real/imaginary arrays, for analysis (spectral
+// flux, pitch). Twiddles are laid out per stage so that, from the third stage on, the
+// butterflies run four at a time with SSE; the first two stages and other targets use
+// scalar code.
+// One instance may be shared by threads: forward() only reads the tables.
+class Fft
+{
+public:
+    // size must be a power of two (at least 4)
+    explicit Fft(size_t size);
+
+    size_t size() const { return m_size; }
+
+    // Transforms re/im (size() values each) in place; unnormalised, e^{-2*pi*i*k*n/N}
+    void forward(float* re, float* im) const;
+
+private:
+    size_t m_size = 0;
+    std::vector<size_t> m_bitReverse;  // Pairs (i, j) with i < j to swap
+    std::vector<float> m_cos;          // Stage with half-width h starts at index h - 1
+    std::vector<float> m_sin;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+// Where playback stood when the audio callback received an input block, for placing the
+// microphone on the track timeline
+struct InputBlockInfo
+{
+    int64_t hostTimeNs = 0;   // steady_clock at the callback's start
+    uint64_t trackFrame = 0;  // Original frame rendered at the start of the output block
+    uint64_t epoch = 0;       // Changes when the playback position jumps
+    float tempo = 1.0f;       // Original frames per output frame
+    bool playing = false;
+};
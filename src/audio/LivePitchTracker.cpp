@@ -0,0 +1,203 @@
+#include "LivePitchTracker.h"
+#include "PitchDetection.h"
+#include "core/Trace.h"
+#include "platform/RealtimeSupport.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+    constexpr double kHopSeconds = 0.01;       // Same rate as the reference contour
+    constexpr double kRingSeconds = 1.0;       // Input the detector may fall behind by
+    constexpr uint32_t kMinBlockFrames = 64;   // Smallest callback the block queue is sized for
+    constexpr size_t kHistoryPoints = 1000;    // 10 s of results
+    constexpr double kLatencySmoothing = 0.1;
+    constexpr std::chrono::milliseconds kIdleWait{2};
+
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+LivePitchTracker::~LivePitchTracker()
+{
+    stop();
+}
+
+void LivePitchTracker::start(uint32_t sampleRate)
+{
+    stop();
+    m_sampleRate = sampleRate;
+    m_samples.reset(static_cast<size_t>(sampleRate * kRingSeconds));
+    // Enough descriptors for a full ring of the smallest blocks, so the sample ring is the only limit
+    m_blocks.reset((m_samples.capacity() + kMinBlockFrames - 1) / kMinBlockFrames);
+    m_droppedFrames.store(0);
+    {
+        std::lock_guard<std::mutex> lock(m_historyMutex);
+        m_history.assign(kHistoryPoints, LivePitchPoint{});
+        m_historyNext = 0;
+        m_historyCount = 0;
+    }
+    m_latencyMs.store(0.0);
+    m_stopRequested.store(false);
+    m_thread = std::thread(&LivePitchTracker::run, this);
+}
+
+void LivePitchTracker::stop()
+{
+    if (!m_thread.joinable())
+        return;
+    m_stopRequested.store(true);
+    m_thread.join();
+}
+
+bool LivePitchTracker::isRunning() const
+{
+    return m_thread.joinable();
+}
+
+uint32_t LivePitchTracker::sampleRate() const
+{
+    return m_sampleRate;
+}
+
+void LivePitchTracker::setLatency(uint32_t inputFrames, uint32_t outputFrames)
+{
+    m_inputLatencyFrames.store(inputFrames);
+    m_outputLatencyFrames.store(outputFrames);
+}
+
+void LivePitchTracker::push(const float* samples, unsigned int frames, const InputBlockInfo& info)
+{
+    if (frames == 0 || m_blocks.writable() == 0 || m_samples.writable() < frames)
+    {
+        m_droppedFrames.fetch_add(frames, std::memory_order_relaxed);
+        return;
+    }
+    m_samples.write(samples, frames);
+    const QueuedBlock block{info, frames};
+    m_blocks.write(&block, 1);
+}
+
+void LivePitchTracker::pointsSince(int64_t sinceNs, std::vector<LivePitchPoint>& out) const
+{
+    std::lock_guard<std::mutex> lock(m_historyMutex);
+    const size_t capacity = m_history.size();
+    for (size_t i = 0; i < m_historyCount; ++i)
+    {
+        const LivePitchPoint& point = m_history[(m_historyNext + capacity - m_historyCount + i) % capacity];
+        if (point.captureTimeNs > sinceNs)
+            out.push_back(point);
+    }
+}
+
+double LivePitchTracker::detectionLatencyMs() const
+{
+    return m_latencyMs.load();
+}
+
+size_t LivePitchTracker::backlogFrames() const
+{
+    return m_samples.readable();
+}
+
+uint64_t LivePitchTracker::droppedFrames() const
+{
+    return m_droppedFrames.load();
+}
+
+void LivePitchTracker::run()
+{
+    RealtimeSupport::configureWorkerThread();
+    Trace::setThreadName("Live pitch");
+
+    YinDetector detector(m_sampleRate);
+    const uint64_t window = detector.windowFrames();
+    const uint64_t hop = std::max<uint64_t>(1, static_cast<uint64_t>(std::lround(m_sampleRate * kHopSeconds)));
+
+    // Input frames from historyStart on, and the blocks they arrived in
+    std::vector<float> samples;
+    std::vector<ReceivedBlock> blocks;
+    uint64_t historyStart = 0;
+    uint64_t received = 0;
+    uint64_t nextWindow = 0;
+    QueuedBlock block;
+    while (!m_stopRequested.load())
+    {
+        bool receivedAny = false;
+        while (m_blocks.read(&block, 1) == 1)
+        {
+            const size_t offset = samples.size();
+            samples.resize(offset + block.frames);
+            m_samples.read(samples.data() + offset, block.frames);
+            blocks.push_back(ReceivedBlock{block, received});
+            received += block.frames;
+            receivedAny = true;
+        }
+
+        // Each window is reported at its centre, like the reference contour's values
+        for (; nextWindow + window <= received; nextWindow += hop)
+        {
+            Trace::Span span("Live pitch");
+            LivePitchPoint point = locate(blocks, nextWindow + window / 2);
+            point.note = detector.detect(samples.data() + (nextWindow - historyStart));
+            publish(point, nowNs());
+        }
+
+        const uint64_t consumed = std::min(nextWindow, received) - historyStart;
+        samples.erase(samples.begin(), samples.begin() + static_cast<ptrdiff_t>(consumed));
+        historyStart += consumed;
+        blocks.erase(blocks.begin(), std::find_if(blocks.begin(), blocks.end(), [historyStart](const ReceivedBlock& entry) {
+            return entry.firstFrame + entry.block.frames > historyStart;
+        }));
+
+        if (!receivedAny)
+            std::this_thread::sleep_for(kIdleWait);
+    }
+}
+
+LivePitchPoint LivePitchTracker::locate(const std::vector<ReceivedBlock>& blocks, uint64_t frame) const
+{
+    LivePitchPoint point;
+    const auto entry = std::find_if(blocks.begin(), blocks.end(), [frame](const ReceivedBlock& candidate) {
+        return frame < candidate.firstFrame + candidate.block.frames;
+    });
+    if (entry == blocks.end())
+        return point;
+
+    // The block's last frame was captured one input latency before its callback started
+    const InputBlockInfo& info = entry->block.info;
+    const double inputLatency = m_inputLatencyFrames.load();
+    const double outputLatency = m_outputLatencyFrames.load();
+    const double offset = static_cast<double>(frame - entry->firstFrame);
+    const double framesBeforeCallback = entry->block.frames - offset + inputLatency;
+    point.captureTimeNs = info.hostTimeNs - static_cast<int64_t>(framesBeforeCallback * 1e9 / m_sampleRate);
+
+    // What reached the speaker at that moment was rendered one output latency earlier still,
+    // counted back in output frames from the start of the callback's output block
+    if (info.playing)
+    {
+        const double trackFrame = static_cast<double>(info.trackFrame)
+                                  - (framesBeforeCallback + outputLatency) * info.tempo;
+        point.onTrack = trackFrame >= 0.0;
+        point.trackFrame = point.onTrack ? static_cast<uint64_t>(trackFrame) : 0;
+    }
+    return point;
+}
+
+void LivePitchTracker::publish(const LivePitchPoint& point, int64_t nowNs)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_historyMutex);
+        m_history[m_historyNext] = point;
+        m_historyNext = (m_historyNext + 1) % m_history.size();
+        m_historyCount = std::min(m_historyCount + 1, m_history.size());
+    }
+
+    const double latency = static_cast<double>(nowNs - point.captureTimeNs) * 1e-6;
+    const double smoothed = m_latencyMs.load();
+    m_latencyMs.store(smoothed == 0.0 ? latency : smoothed + kLatencySmoothing * (latency - smoothed));
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "InputBlockInfo.h"
+#include "core/SpscRing.h"
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One pitch measurement of the microphone
+struct LivePitchPoint
+{
+    int64_t captureTimeNs = 0;  // steady_clock when the analysed window's centre reached the microphone
+    float note = std::numeric_limits<float>::quiet_NaN();  // MIDI note, NaN when unvoiced
+    bool onTrack = false;       // The track was playing, so trackFrame is valid
+    uint64_t trackFrame = 0;    // Original frame of the track the singer heard at that moment
+};
+
+// Pitch of the microphone, measured while the track plays. The audio callback hands every
+// input block to push(), which only copies it into lock-free rings; a detector thread runs
+// YIN over the last window every 10 ms and keeps the results for the UI. Each result
+// carries the track position the singer was hearing (one device round trip before the
+// capture) and when the sound reached the microphone, from which the latency follows.
+class LivePitchTracker
+{
+public:
+    LivePitchTracker() = default;
+    ~LivePitchTracker();
+    LivePitchTracker(const LivePitchTracker&) = delete;
+    LivePitchTracker& operator=(const LivePitchTracker&) = delete;
+
+    // Sizes the rings and starts the detector thread; call while the callback is stopped
+    void start(uint32_t sampleRate);
+    void stop();
+    bool isRunning() const;
+    uint32_t sampleRate() const;
+    // Device latencies of the stream, known once it runs
+    void setLatency(uint32_t inputFrames, uint32_t outputFrames);
+
+    // Audio callback: copies one block of mono input. Never blocks; a block that does not
+    // fit because the detector fell behind is dropped.
+    void push(const float* samples, unsigned int frames, const InputBlockInfo& info);
+
+    // Appends the results captured after sinceNs to out, oldest first
+    void pointsSince(int64_t sinceNs, std::vector<LivePitchPoint>& out) const;
+    // Capture to result, smoothed over the last results; 0 before the first one
+    double detectionLatencyMs() const;
+    // Input frames waiting for the detector
+    size_t backlogFrames() const;
+    uint64_t droppedFrames() const;
+
+private:
+    struct QueuedBlock
+    {
+        InputBlockInfo info;
+        uint32_t frames = 0;
+    };
+
+    // A received block and the input frame it starts at
+    struct ReceivedBlock
+    {
+        QueuedBlock block;
+        uint64_t firstFrame = 0;
+    };
+
+    void run();
+    LivePitchPoint locate(const std::vector<ReceivedBlock>& blocks, uint64_t frame) const;
+    void publish(const LivePitchPoint& point, int64_t nowNs);
+
+    uint32_t m_sampleRate = 0;
+    std::thread m_thread;
+    std::atomic<bool> m_stopRequested{false};
+    std::atomic<uint32_t> m_inputLatencyFrames{0};
+    std::atomic<uint32_t> m_outputLatencyFrames{0};
+
+    // Audio callback -> detector thread; a block's samples are written before the block
+    SpscRing<float> m_samples;
+    SpscRing<QueuedBlock> m_blocks;
+    std::atomic<uint64_t> m_droppedFrames{0};
+
+    // Detector thread -> UI: the most recent results, oldest overwritten first
+    mutable std::mutex m_historyMutex;
+    std::vector<LivePitchPoint> m_history;
+    size_t m_historyNext = 0;
+    size_t m_historyCount = 0;
+    std::atomic<double> m_latencyMs{0.0};
+};
@@ -0,0 +1,218 @@
+#include "Metronome.h"
+#include "TimeMap.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define SONGPRACTICE_METRONOME_SSE 1
+#endif
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr double kClickSeconds = 0.04;
+    constexpr double kClickDecaySeconds = 0.008;
+    constexpr double kAccentHz = 1760.0;
+    constexpr double kBeatHz = 1320.0;
+    // Guards the beat loop against a degenerate grid; a block never holds this many beats
+    constexpr int kMaxBeatsPerBlock = 64;
+
+    std::vector<float> renderClickSound(uint32_t sampleRate, double frequency, float level)
+    {
+        std::vector<float> click(static_cast<size_t>(kClickSeconds * sampleRate));
+        for (size_t i = 0; i < click.size(); ++i)
+        {
+            const double t = static_cast<double>(i) / sampleRate;
+            click[i] = static_cast<float>(level * std::exp(-t / kClickDecaySeconds) * std::sin(2.0 * kPi * frequency * t));
+        }
+        return click;
+    }
+
+    // Adds gain * mono to every channel of the interleaved output
+    void addToAllChannels(float* output, uint32_t channels, const float* mono, size_t frames, float gain)
+    {
+        size_t frame = 0;
+#ifdef SONGPRACTICE_METRONOME_SSE
+        if (channels == 2)
+        {
+            const __m128 scale = _mm_set1_ps(gain);
+            for (; frame + 4 <= frames; frame += 4)
+            {
+                const __m128 samples = _mm_mul_ps(_mm_loadu_ps(mono + frame), scale);
+                float* out = output + frame * 2;
+                _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), _mm_unpacklo_ps(samples, samples)));
+                _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_unpackhi_ps(samples, samples)));
+            }
+        }
+#endif
+        for (; frame < frames; ++frame)
+        {
+            const float sample = gain * mono[frame];
+            for (uint32_t channel = 0; channel < channels; ++channel)
+                output[frame * channels + channel] += sample;
+        }
+    }
+}
+
+void Metronome::prepare(uint32_t channelCount, uint32_t sampleRate)
+{
+    m_channelCount = channelCount;
+    m_sampleRate = sampleRate;
+    m_accentClick = renderClickSound(sampleRate, kAccentHz, 0.8f);
+    m_beatClick = renderClickSound(sampleRate, kBeatHz, 0.5f);
+    m_click = nullptr;
+    m_clickPosition = 0;
+}
+
+void Metronome::setGrid(double bpm, uint64_t firstBeatFrame, uint32_t beatsPerBar)
+{
+    m_firstBeatFrame.store(firstBeatFrame);
+    m_beatsPerBar.store(std::max<uint32_t>(1, beatsPerBar));
+    m_bpm.store(bpm > 0.0 ? bpm : 0.0);
+}
+
+double Metronome::bpm() const
+{
+    return m_bpm.load();
+}
+
+uint32_t Metronome::beatsPerBar() const
+{
+    return m_beatsPerBar.load();
+}
+
+void Metronome::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled);
+}
+
+bool Metronome::isEnabled() const
+{
+    return m_enabled.load();
+}
+
+void Metronome::setVolume(float volume)
+{
+    m_volume.store(std::clamp(volume, 0.0f, 1.0f));
+}
+
+float Metronome::volume() const
+{
+    return m_volume.load();
+}
+
+void Metronome::armCountIn(uint32_t beats, double beatFrames)
+{
+    if (beats == 0 || beatFrames <= 0.0)
+        return;
+    m_countInBeats.store(beats);
+    m_countInBeatFrames.store(beatFrames);
+    m_countInGeneration.fetch_add(1);
+    m_countingIn.store(true);
+}
+
+void Metronome::cancelCountIn()
+{
+    m_countingIn.store(false);
+}
+
+bool Metronome::isCountingIn() const
+{
+    return m_countingIn.load();
+}
+
+void Metronome::startClick(bool accent)
+{
+    m_click = accent ? &m_accentClick : &m_beatClick;
+    m_clickPosition = 0;
+}
+
+void Metronome::renderClick(float* output, unsigned int from, unsigned int to)
+{
+    if (!m_click || from >= to)
+        return;
+
+    const size_t frames = std::min<size_t>(m_click->size() - m_clickPosition, to - from);
+    addToAllChannels(output + static_cast<size_t>(from) * m_channelCount, m_channelCount,
+                     m_click->data() + m_clickPosition, frames, m_volume.load());
+    m_clickPosition += frames;
+    if (m_clickPosition >= m_click->size())
+        m_click = nullptr;
+}
+
+unsigned int Metronome::mixCountIn(float* output, unsigned int frames)
+{
+    if (!m_countingIn.load() || m_channelCount == 0)
+        return 0;
+
+    const uint32_t generation = m_countInGeneration.load();
+    if (generation != m_seenCountIn)
+    {
+        m_seenCountIn = generation;
+        m_countInElapsed = 0;
+    }
+
+    // Beat n at round(n * beatFrames) from the start, like the grid
+    const uint32_t beats = m_countInBeats.load();
+    const double beatFrames = m_countInBeatFrames.load();
+    const uint32_t beatsPerBar = std::max<uint32_t>(1, m_beatsPerBar.load());
+    const uint64_t total = static_cast<uint64_t>(std::llround(beats * beatFrames));
+    const unsigned int countInFrames = static_cast<unsigned int>(
+        std::min<uint64_t>(frames, total > m_countInElapsed ? total - m_countInElapsed : 0));
+
+    unsigned int rendered = 0;
+    for (uint32_t beat = 0; beat < beats; ++beat)
+    {
+        const uint64_t at = static_cast<uint64_t>(std::llround(beat * beatFrames));
+        if (at < m_countInElapsed)
+            continue;
+        if (at >= m_countInElapsed + countInFrames)
+            break;
+        const unsigned int offset = static_cast<unsigned int>(at - m_countInElapsed);
+        renderClick(output, rendered, offset);
+        rendered = offset;
+        startClick(beat % beatsPerBar == 0);
+    }
+    renderClick(output, rendered, countInFrames);
+
+    m_countInElapsed += countInFrames;
+    if (m_countInElapsed >= total)
+        m_countingIn.store(false);
+    return countInFrames;
+}
+
+void Metronome::mixBeats(float* output, unsigned int frames, uint64_t processedStart, const TimeMap& timeMap)
+{
+    unsigned int rendered = 0;
+    const double bpm = m_bpm.load();
+    if (m_enabled.load() && bpm > 0.0 && m_sampleRate > 0 && m_channelCount > 0)
+    {
+        const double beatFrames = 60.0 * m_sampleRate / bpm;
+        const int64_t firstBeatFrame = static_cast<int64_t>(m_firstBeatFrame.load());
+        const int64_t beatsPerBar = std::max<uint32_t>(1, m_beatsPerBar.load());
+        const uint64_t processedEnd = processedStart + frames;
+
+        // From the beat before the block's start in original frames until one lands past the
+        // block. Each beat maps to a single processed frame, so it clicks in exactly one block.
+        const double originalStart = static_cast<double>(timeMap.toOriginal(processedStart));
+        int64_t beat = static_cast<int64_t>(std::floor((originalStart - firstBeatFrame) / beatFrames)) - 1;
+        for (int visited = 0; visited < kMaxBeatsPerBlock; ++visited, ++beat)
+        {
+            const int64_t beatFrame = firstBeatFrame + std::llround(beat * beatFrames);
+            if (beatFrame < 0)
+                continue;
+            const uint64_t processed = timeMap.toProcessed(static_cast<uint64_t>(beatFrame));
+            if (processed >= processedEnd)
+                break;
+            if (processed < processedStart)
+                continue;
+
+            const unsigned int offset = static_cast<unsigned int>(processed - processedStart);
+            renderClick(output, rendered, offset);
+            rendered = offset;
+            startClick(((beat % beatsPerBar) + beatsPerBar) % beatsPerBar == 0);
+        }
+    }
+    renderClick(output, rendered, frames);
+}
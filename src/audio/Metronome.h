@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TimeMap;
+
+// Click track mixed into the output by the audio callback. Beats come from a grid in
+// original frames (tempo and the frame of a downbeat): beat n is computed from n alone, so
+// clicks never drift, and it is mapped through the stretch TimeMap, so it lands on the same
+// note at any tempo multiplier. A count-in plays clicks on their own before the track.
+//
+// Settings are atomics written by the UI thread; a grid change may take one block to apply
+// consistently. mix*() run in the audio callback and neither allocate nor lock. prepare()
+// renders the click sounds and must only be called while the callback is not running.
+class Metronome
+{
+public:
+    void prepare(uint32_t channelCount, uint32_t sampleRate);
+
+    // bpm <= 0 clears the grid
+    void setGrid(double bpm, uint64_t firstBeatFrame, uint32_t beatsPerBar);
+    double bpm() const;
+    uint32_t beatsPerBar() const;
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    void setVolume(float volume);
+    float volume() const;
+
+    // Clicks beats times, beatFrames output frames apart, before the track resumes
+    void armCountIn(uint32_t beats, double beatFrames);
+    void cancelCountIn();
+    bool isCountingIn() const;
+
+    // Audio callback: adds count-in clicks to the start of the block and returns how many
+    // of its frames still belong to the count-in (frames while it lasts, 0 once it is over)
+    unsigned int mixCountIn(float* output, unsigned int frames);
+    // Audio callback: adds the beats whose processed frames fall in
+    // [processedStart, processedStart + frames) and finishes a click still sounding
+    void mixBeats(float* output, unsigned int frames, uint64_t processedStart, const TimeMap& timeMap);
+
+private:
+    void startClick(bool accent);
+    // Continues the sounding click over output frames [from, to)
+    void renderClick(float* output, unsigned int from, unsigned int to);
+
+    uint32_t m_channelCount = 0;
+    uint32_t m_sampleRate = 0;
+    std::vector<float> m_accentClick;  // Mono, first beat of a bar
+    std::vector<float> m_beatClick;    // Mono, other beats
+
+    // UI thread -> audio callback
+    std::atomic<double> m_bpm{0.0};
+    std::atomic<uint64_t> m_firstBeatFrame{0};
+    std::atomic<uint32_t> m_beatsPerBar{4};
+    std::atomic<bool> m_enabled{false};
+    std::atomic<float> m_volume{0.7f};
+    std::atomic<uint32_t> m_countInBeats{0};
+    std::atomic<double> m_countInBeatFrames{0.0};
+    std::atomic<uint32_t> m_countInGeneration{0};
+    std::atomic<bool> m_countingIn{false};  // Cleared by the callback when the count-in ends
+
+    // Audio callback only
+    const std::vector<float>* m_click = nullptr;  // Sounding click, if any
+    size_t m_clickPosition = 0;
+    uint32_t m_seenCountIn = 0;
+    uint64_t m_countInElapsed = 0;
+};
@@ -0,0 +1,384 @@
+#include "PcmStore.h"
+#include "platform/RealtimeSupport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+    // Blocks kept ahead of the playhead, capped by the resident limit
+    constexpr size_t kReadAheadBlocks = 8;
+    constexpr std::chrono::milliseconds kReadAheadInterval{10};
+
+    std::atomic<uint64_t> s_cacheFileCounter{0};
+}
+
+PcmStore::PcmStore(uint32_t channelCount, uint32_t sampleRate, size_t residentLimitBytes)
+    : m_channelCount(channelCount),
+      m_sampleRate(sampleRate),
+      m_residentLimitBytes(residentLimitBytes)
+{
+}
+
+PcmStore::~PcmStore()
+{
+    if (m_readAheadThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_readAheadMutex);
+            m_stopReadAhead = true;
+        }
+        m_readAheadWake.notify_all();
+        m_readAheadThread.join();
+    }
+    setLocked(false);
+
+    if (m_cacheFile.is_open())
+        m_cacheFile.close();
+    if (!m_cachePath.empty())
+    {
+        std::error_code error;
+        std::filesystem::remove(m_cachePath, error);
+    }
+}
+
+void PcmStore::reserveFrames(uint64_t frameCount)
+{
+    m_blocks.reserve(static_cast<size_t>((frameCount + BLOCK_FRAMES - 1) / BLOCK_FRAMES));
+}
+
+bool PcmStore::append(const float* frames, uint64_t frameCount)
+{
+    if (m_channelCount == 0)
+        return false;
+
+    while (frameCount > 0)
+    {
+        if (m_blocks.empty() || m_blocks.back()->frames == BLOCK_FRAMES)
+        {
+            auto block = std::make_unique<Block>();
+            block->data = std::make_unique<float[]>(BLOCK_FRAMES * m_channelCount);
+            m_blocks.push_back(std::move(block));
+            m_residentBytes.fetch_add(blockBytes());
+
+            // Sequential writer: the oldest blocks go to the cache file first
+            if (m_residentLimitBytes > 0 && m_residentBytes.load() > m_residentLimitBytes)
+            {
+                std::lock_guard<std::mutex> lock(m_pageMutex);
+                trimLocked(m_blocks.size() - 1, m_blocks.size() - 1);
+            }
+        }
+
+        Block& block = *m_blocks.back();
+        const uint64_t count = std::min(frameCount, BLOCK_FRAMES - block.frames);
+        std::memcpy(block.data.get() + block.frames * m_channelCount, frames, count * m_channelCount * sizeof(float));
+        block.frames += count;
+        m_frameCount += count;
+        frames += count * m_channelCount;
+        frameCount -= count;
+    }
+    return true;
+}
+
+uint64_t PcmStore::read(uint64_t firstFrame, float* out, uint64_t frameCount) const
+{
+    uint64_t copied = 0;
+    forEachBlock([&](const float* frames, uint64_t count) {
+        const uint64_t take = std::min(count, frameCount - copied);
+        std::memcpy(out + copied * m_channelCount, frames, take * m_channelCount * sizeof(float));
+        copied += take;
+        return copied < frameCount;
+    }, firstFrame);
+    return copied;
+}
+
+bool PcmStore::forEachBlock(const std::function<bool(const float*, uint64_t)>& visit, uint64_t firstFrame) const
+{
+    uint64_t frame = firstFrame;
+    while (frame < m_frameCount)
+    {
+        const size_t index = static_cast<size_t>(frame / BLOCK_FRAMES);
+        const uint64_t offset = frame % BLOCK_FRAMES;
+        if (!pinResident(index))
+            return false;
+
+        const Block& block = *m_blocks[index];
+        const uint64_t count = block.frames - offset;
+        const bool keepGoing = visit(block.data.get() + offset * m_channelCount, count);
+        unpin(index);
+
+        frame += count;
+        if (!keepGoing)
+            return false;
+    }
+    return true;
+}
+
+uint64_t PcmStore::readResident(uint64_t firstFrame, float* out, uint64_t frameCount) const
+{
+    uint64_t copied = 0;
+    while (copied < frameCount && firstFrame + copied < m_frameCount)
+    {
+        const uint64_t frame = firstFrame + copied;
+        const size_t index = static_cast<size_t>(frame / BLOCK_FRAMES);
+        const uint64_t offset = frame % BLOCK_FRAMES;
+        Block& block = *m_blocks[index];
+
+        // Pin before checking the state; evictLocked() checks the pin after claiming the block
+        block.users.fetch_add(1);
+        if (block.state.load() != Resident)
+        {
+            block.users.fetch_sub(1);
+            m_pageMisses.fetch_add(1);
+            break;
+        }
+
+        const uint64_t count = std::min(frameCount - copied, block.frames - offset);
+        std::memcpy(out + copied * m_channelCount,
+                    block.data.get() + offset * m_channelCount,
+                    count * m_channelCount * sizeof(float));
+        block.lastUse.store(m_useClock.fetch_add(1), std::memory_order_relaxed);
+        block.users.fetch_sub(1);
+        copied += count;
+    }
+    return copied;
+}
+
+void PcmStore::startReadAhead()
+{
+    if (m_residentLimitBytes == 0 || m_readAheadThread.joinable())
+        return;
+
+    // The writer evicted the oldest blocks first, so fill the window now for the first callback
+    pageInAhead();
+    m_readAheadThread = std::thread(&PcmStore::readAheadLoop, this);
+}
+
+void PcmStore::setPlayhead(uint64_t frame) const
+{
+    m_playhead.store(frame, std::memory_order_relaxed);
+}
+
+size_t PcmStore::evictAll()
+{
+    std::lock_guard<std::mutex> lock(m_pageMutex);
+    size_t released = 0;
+    for (size_t index = 0; index < m_blocks.size(); ++index)
+        released += evictLocked(index);
+    return released;
+}
+
+void PcmStore::setLocked(bool locked)
+{
+    if (m_locked.load() == locked)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_pageMutex);
+    m_locked.store(locked);
+    for (const std::unique_ptr<Block>& block : m_blocks)
+    {
+        // Resident blocks only change state under the page mutex
+        if (block->state.load() != Resident)
+            continue;
+        if (locked)
+            lockBlockLocked(*block);
+        else
+            unlockBlockLocked(*block);
+    }
+}
+
+size_t PcmStore::spilledBytes() const
+{
+    const size_t total = m_blocks.size() * blockBytes();
+    return total - std::min(total, m_residentBytes.load());
+}
+
+size_t PcmStore::blockBytes() const
+{
+    return static_cast<size_t>(BLOCK_FRAMES * m_channelCount * sizeof(float));
+}
+
+bool PcmStore::pinResident(size_t index) const
+{
+    Block& block = *m_blocks[index];
+    block.users.fetch_add(1);
+    block.lastUse.store(m_useClock.fetch_add(1), std::memory_order_relaxed);
+    if (block.state.load() == Resident)
+        return true;
+
+    // Evicting only happens under the page mutex, so here the block is Resident or Absent
+    std::lock_guard<std::mutex> lock(m_pageMutex);
+    if (!pageInLocked(index))
+    {
+        block.users.fetch_sub(1);
+        return false;
+    }
+    if (m_residentLimitBytes > 0 && m_residentBytes.load() > m_residentLimitBytes)
+    {
+        const uint64_t playheadBlock = m_playhead.load(std::memory_order_relaxed) / BLOCK_FRAMES;
+        trimLocked(static_cast<size_t>(playheadBlock), static_cast<size_t>(playheadBlock) + 1);
+    }
+    return true;
+}
+
+void PcmStore::unpin(size_t index) const
+{
+    m_blocks[index]->users.fetch_sub(1);
+}
+
+bool PcmStore::pageInLocked(size_t index) const
+{
+    Block& block = *m_blocks[index];
+    if (block.state.load() == Resident)
+        return true;
+    if (!block.cached || !m_cacheFile.is_open())
+        return false;
+
+    const uint64_t blockSamples = BLOCK_FRAMES * m_channelCount;
+    auto data = std::make_unique<float[]>(blockSamples);
+    m_cacheFile.seekg(static_cast<std::streamoff>(index * blockSamples * sizeof(float)));
+    m_cacheFile.read(reinterpret_cast<char*>(data.get()), static_cast<std::streamsize>(block.frames * m_channelCount * sizeof(float)));
+    if (!m_cacheFile)
+    {
+        m_cacheFile.clear();
+        std::cerr << "PcmStore: Failed to read block " << index << " from " << m_cachePath << std::endl;
+        return false;
+    }
+
+    block.data = std::move(data);
+    if (m_locked.load())
+        lockBlockLocked(block);
+    m_residentBytes.fetch_add(blockBytes());
+    block.state.store(Resident);
+    return true;
+}
+
+size_t PcmStore::evictLocked(size_t index) const
+{
+    Block& block = *m_blocks[index];
+    int expected = Resident;
+    if (!block.state.compare_exchange_strong(expected, Evicting))
+        return 0;
+    if (block.users.load() > 0)
+    {
+        block.state.store(Resident);
+        return 0;
+    }
+
+    // Blocks never change after append(), so a cached copy stays valid
+    if (!block.cached)
+    {
+        if (!openCacheLocked())
+        {
+            block.state.store(Resident);
+            return 0;
+        }
+        const uint64_t blockSamples = BLOCK_FRAMES * m_channelCount;
+        m_cacheFile.seekp(static_cast<std::streamoff>(index * blockSamples * sizeof(float)));
+        m_cacheFile.write(reinterpret_cast<const char*>(block.data.get()),
+                          static_cast<std::streamsize>(block.frames * m_channelCount * sizeof(float)));
+        if (!m_cacheFile)
+        {
+            m_cacheFile.clear();
+            std::cerr << "PcmStore: Failed to write block " << index << " to " << m_cachePath << std::endl;
+            block.state.store(Resident);
+            return 0;
+        }
+        block.cached = true;
+    }
+
+    unlockBlockLocked(block);
+    block.data.reset();
+    m_residentBytes.fetch_sub(blockBytes());
+    block.state.store(Absent);
+    return blockBytes();
+}
+
+void PcmStore::trimLocked(size_t keepFirst, size_t keepLast) const
+{
+    // Least recently used first, never the blocks in [keepFirst, keepLast]
+    std::vector<std::pair<uint64_t, size_t>> candidates;
+    for (size_t index = 0; index < m_blocks.size(); ++index)
+    {
+        if (index >= keepFirst && index <= keepLast)
+            continue;
+        const Block& block = *m_blocks[index];
+        if (block.state.load() == Resident)
+            candidates.emplace_back(block.lastUse.load(std::memory_order_relaxed), index);
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto& candidate : candidates)
+    {
+        if (m_residentBytes.load() <= m_residentLimitBytes)
+            break;
+        evictLocked(candidate.second);
+    }
+}
+
+bool PcmStore::openCacheLocked() const
+{
+    if (m_cacheFile.is_open())
+        return true;
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path()
+        / ("songpractice-pcm-" + std::to_string(s_cacheFileCounter.fetch_add(1)) + "-"
+           + std::to_string(reinterpret_cast<uintptr_t>(this)) + ".cache");
+    m_cacheFile.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!m_cacheFile.is_open())
+    {
+        std::cerr << "PcmStore: Failed to create cache file " << path.string() << std::endl;
+        return false;
+    }
+    m_cachePath = path.string();
+    return true;
+}
+
+void PcmStore::lockBlockLocked(Block& block) const
+{
+    if (block.locked)
+        return;
+    block.locked = RealtimeSupport::lockMemory(block.data.get(), blockBytes());
+    if (!block.locked)
+        RealtimeSupport::prefault(block.data.get(), blockBytes());
+}
+
+void PcmStore::unlockBlockLocked(Block& block) const
+{
+    if (!block.locked)
+        return;
+    RealtimeSupport::unlockMemory(block.data.get(), blockBytes());
+    block.locked = false;
+}
+
+void PcmStore::pageInAhead() const
+{
+    const size_t limitBlocks = std::max<size_t>(2, m_residentLimitBytes / blockBytes());
+    const size_t aheadBlocks = std::min(kReadAheadBlocks, limitBlocks / 2);
+    const size_t first = static_cast<size_t>(m_playhead.load(std::memory_order_relaxed) / BLOCK_FRAMES);
+    const size_t last = std::min(first + aheadBlocks, m_blocks.size());
+
+    std::lock_guard<std::mutex> lock(m_pageMutex);
+    for (size_t index = first; index < last; ++index)
+    {
+        // Refresh the window's use stamps so trimming prefers blocks behind the playhead
+        m_blocks[index]->lastUse.store(m_useClock.fetch_add(1), std::memory_order_relaxed);
+        pageInLocked(index);
+    }
+    if (m_residentBytes.load() > m_residentLimitBytes && last > first)
+        trimLocked(first, last - 1);
+}
+
+void PcmStore::readAheadLoop()
+{
+    std::unique_lock<std::mutex> wakeLock(m_readAheadMutex);
+    while (!m_stopReadAhead)
+    {
+        wakeLock.unlock();
+        pageInAhead();
+        wakeLock.lock();
+        m_readAheadWake.wait_for(wakeLock, kReadAheadInterval, [this]() { return m_stopReadAhead; });
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Interleaved float PCM split into fixed-size blocks. With a resident limit, blocks
+// beyond it are written to a temporary cache file and paged back in on demand, so
+// memory is bounded by the working set instead of the track length. Without a limit
+// every block stays in memory and no file is created.
+//
+// The store is filled by a single writer with append() before it is shared. After
+// that any number of threads may read: read() and forEachBlock() page in as needed,
+// readResident() never blocks and is safe in the audio callback.
+class PcmStore
+{
+public:
+    static constexpr uint64_t BLOCK_FRAMES = 65536;
+
+    PcmStore(uint32_t channelCount, uint32_t sampleRate, size_t residentLimitBytes = 0);
+    ~PcmStore();
+    PcmStore(const PcmStore&) = delete;
+    PcmStore& operator=(const PcmStore&) = delete;
+
+    uint32_t channelCount() const { return m_channelCount; }
+    uint32_t sampleRate() const { return m_sampleRate; }
+    uint64_t frameCount() const { return m_frameCount; }
+    bool empty() const { return m_frameCount == 0; }
+
+    // Writer side
+    bool append(const float* frames, uint64_t frameCount);
+    void reserveFrames(uint64_t frameCount);
+
+    // Blocking reads; return the number of frames delivered
+    uint64_t read(uint64_t firstFrame, float* out, uint64_t frameCount) const;
+    // Calls visit(frames, frameCount) for each block from firstFrame on; stops when visit returns false
+    bool forEachBlock(const std::function<bool(const float*, uint64_t)>& visit, uint64_t firstFrame = 0) const;
+
+    // Realtime read: copies up to the first block that is not resident, without locking,
+    // allocating or touching the disk. The caller plays silence for the rest.
+    uint64_t readResident(uint64_t firstFrame, float* out, uint64_t frameCount) const;
+
+    // Read-ahead for playback: a pager thread keeps the blocks after the playhead resident.
+    // setPlayhead() is a plain atomic store, callable from the audio callback.
+    void startReadAhead();
+    void setPlayhead(uint64_t frame) const;
+
+    // Writes every block that is not in use to the cache file and frees it
+    size_t evictAll();
+
+    // Pins resident blocks in RAM (prefaulting them where mlock is refused), including
+    // blocks paged in later; for the store the audio callback reads from
+    void setLocked(bool locked);
+
+    size_t residentBytes() const { return m_residentBytes.load(); }
+    size_t spilledBytes() const;
+    uint64_t pageMisses() const { return m_pageMisses.load(); }
+
+private:
+    enum BlockState : int
+    {
+        Absent,
+        Resident,
+        Evicting
+    };
+
+    struct Block
+    {
+        std::atomic<int> state{Resident};
+        std::atomic<int> users{0};         // Readers currently copying from data
+        std::atomic<uint64_t> lastUse{0};
+        std::unique_ptr<float[]> data;     // Valid while Resident
+        uint64_t frames = 0;
+        bool cached = false;               // A copy is in the cache file
+        bool locked = false;               // data is mlocked
+    };
+
+    size_t blockBytes() const;
+    bool pinResident(size_t index) const;   // Pins and pages in; false on I/O failure
+    void unpin(size_t index) const;
+    bool pageInLocked(size_t index) const;
+    size_t evictLocked(size_t index) const;
+    void trimLocked(size_t keepFirst, size_t keepLast) const;
+    bool openCacheLocked() const;
+    void lockBlockLocked(Block& block) const;
+    void unlockBlockLocked(Block& block) const;
+    void pageInAhead() const;  // Pages in the blocks after the playhead
+    void readAheadLoop();
+
+    uint32_t m_channelCount = 0;
+    uint32_t m_sampleRate = 0;
+    uint64_t m_frameCount = 0;
+    size_t m_residentLimitBytes = 0;  // 0 = keep everything in memory
+    std::vector<std::unique_ptr<Block>> m_blocks;
+
+    // Paging state; reads page in behind logically const accessors
+    mutable std::mutex m_pageMutex;
+    mutable std::fstream m_cacheFile;
+    mutable std::string m_cachePath;
+    mutable std::atomic<size_t> m_residentBytes{0};
+    mutable std::atomic<uint64_t> m_useClock{0};
+    mutable std::atomic<uint64_t> m_pageMisses{0};
+    mutable std::atomic<uint64_t> m_playhead{0};
+    std::atomic<bool> m_locked{false};
+
+    std::thread m_readAheadThread;
+    std::mutex m_readAheadMutex;
+    std::condition_variable m_readAheadWake;
+    bool m_stopReadAhead = false;
+};
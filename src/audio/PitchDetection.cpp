@@ -0,0 +1,241 @@
+#include "PitchDetection.h"
+#include "PcmStore.h"
+#include "core/AnalysisCache.h"
+#include "core/BinaryIO.h"
+#include "core/Trace.h"
+#include "platform/RealtimeSupport.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace
+{
+    constexpr const char* kCacheKind = "pitch";
+    constexpr double kHopSeconds = 0.01;
+    constexpr double kMaxHz = 1000.0;             // Shortest lag; the longest follows from the FFT size
+    constexpr float kAperiodicityThreshold = 0.2f;  // YIN's absolute threshold on the normalised difference
+    constexpr double kSilence = 1e-6;             // Mean square below which a window is not analysed (-60 dBFS)
+    constexpr size_t kChunkValues = 256;          // Contour values per work item
+    constexpr size_t kMinVoicedRun = 3;           // Shorter voiced runs are dropped as spurious
+
+    size_t fftSizeFor(uint32_t sampleRate)
+    {
+        // Integration window of half the FFT: ~21 ms at 48 kHz, down to ~60 Hz
+        return sampleRate > 50000 ? 4096 : 2048;
+    }
+
+    float toNote(double frequency)
+    {
+        return static_cast<float>(69.0 + 12.0 * std::log2(frequency / 440.0));
+    }
+}
+
+YinDetector::YinDetector(uint32_t sampleRate)
+    : m_sampleRate(sampleRate),
+      m_fft(fftSizeFor(sampleRate))
+{
+    const size_t n = m_fft.size();
+    m_integrationFrames = n / 2;
+    m_maxLag = n / 2 - n / 8;  // Integration window plus lags must fit in n without wrapping
+    m_minLag = std::max<size_t>(2, static_cast<size_t>(sampleRate / kMaxHz));
+    m_re.resize(n);
+    m_im.resize(n);
+    m_productRe.resize(n);
+    m_productIm.resize(n);
+    m_energy.resize(windowFrames() + 1);
+    m_difference.resize(m_maxLag + 1);
+}
+
+float YinDetector::detect(const float* samples)
+{
+    const size_t n = m_fft.size();
+    const size_t window = m_integrationFrames;
+    const size_t total = windowFrames();
+    const float unvoiced = std::numeric_limits<float>::quiet_NaN();
+
+    m_energy[0] = 0.0;
+    for (size_t i = 0; i < total; ++i)
+        m_energy[i + 1] = m_energy[i] + static_cast<double>(samples[i]) * samples[i];
+    if (m_energy[window] / static_cast<double>(window) < kSilence)
+        return unvoiced;
+
+    // r(lag) = sum over the window of x[j] * x[j + lag]: the window a (zero padded) and the
+    // whole span b share one complex FFT, then r = IFFT(conj(A) * B)
+    for (size_t i = 0; i < n; ++i)
+    {
+        m_re[i] = i < window ? samples[i] : 0.0f;
+        m_im[i] = i < total ? samples[i] : 0.0f;
+    }
+    m_fft.forward(m_re.data(), m_im.data());
+    for (size_t k = 0; k <= n / 2; ++k)
+    {
+        const size_t mirror = (n - k) & (n - 1);
+        const float ar = 0.5f * (m_re[k] + m_re[mirror]);
+        const float ai = 0.5f * (m_im[k] - m_im[mirror]);
+        const float br = 0.5f * (m_im[k] + m_im[mirror]);
+        const float bi = -0.5f * (m_re[k] - m_re[mirror]);
+        m_productRe[k] = ar * br + ai * bi;
+        m_productIm[k] = ar * bi - ai * br;
+        m_productRe[mirror] = m_productRe[k];
+        m_productIm[mirror] = -m_productIm[k];
+    }
+    // The inverse transform is the forward one with real and imaginary parts swapped
+    m_fft.forward(m_productIm.data(), m_productRe.data());
+    const double scale = 1.0 / static_cast<double>(n);
+
+    // d(lag) = sum (x[j] - x[j + lag])^2, normalised by its running mean
+    m_difference[0] = 1.0f;
+    double runningSum = 0.0;
+    for (size_t lag = 1; lag <= m_maxLag; ++lag)
+    {
+        const double shifted = m_energy[lag + window] - m_energy[lag];
+        const double difference = std::max(0.0, m_energy[window] + shifted - 2.0 * scale * m_productRe[lag]);
+        runningSum += difference;
+        m_difference[lag] = runningSum > 0.0 ? static_cast<float>(difference * lag / runningSum) : 1.0f;
+    }
+
+    // The first dip under the threshold, followed down to its minimum
+    size_t lag = m_minLag;
+    while (lag < m_maxLag && m_difference[lag] >= kAperiodicityThreshold)
+        ++lag;
+    if (lag >= m_maxLag)
+        return unvoiced;
+    while (lag + 1 < m_maxLag && m_difference[lag + 1] < m_difference[lag])
+        ++lag;
+
+    const float before = m_difference[lag - 1];
+    const float at = m_difference[lag];
+    const float after = m_difference[lag + 1];
+    const float curvature = before - 2.0f * at + after;
+    const double shift = curvature > 0.0f ? std::clamp(0.5f * (before - after) / curvature, -0.5f, 0.5f) : 0.0;
+    return toNote(m_sampleRate / (static_cast<double>(lag) + shift));
+}
+
+namespace PitchDetection
+{
+    bool analyze(const PcmStore& pcm, PitchContour& out, const std::function<bool(float)>& onProgress,
+                 unsigned int threadCount)
+    {
+        out = PitchContour{};
+        out.sampleRate = pcm.sampleRate();
+        if (pcm.empty() || pcm.sampleRate() == 0)
+            return false;
+
+        out.hopFrames = std::max<uint32_t>(1, static_cast<uint32_t>(std::lround(pcm.sampleRate() * kHopSeconds)));
+        out.notes.assign(static_cast<size_t>(pcm.frameCount() / out.hopFrames) + 1, std::numeric_limits<float>::quiet_NaN());
+        const size_t chunks = (out.notes.size() + kChunkValues - 1) / kChunkValues;
+        const uint32_t channels = pcm.channelCount();
+
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<size_t> finishedChunks{0};
+        std::atomic<bool> cancelled{false};
+        const auto work = [&](bool reportProgress) {
+            YinDetector detector(pcm.sampleRate());
+            const int64_t span = static_cast<int64_t>(detector.windowFrames());
+            std::vector<float> interleaved;
+            std::vector<float> mono;
+            while (!cancelled.load())
+            {
+                const size_t chunk = nextChunk.fetch_add(1);
+                if (chunk >= chunks)
+                    break;
+                const size_t first = chunk * kChunkValues;
+                const size_t end = std::min(out.notes.size(), first + kChunkValues);
+
+                // Mono mix of the windows of values [first, end), each centred on its frame
+                const int64_t sampleStart = static_cast<int64_t>(first) * out.hopFrames - span / 2;
+                const int64_t sampleEnd = static_cast<int64_t>(end - 1) * out.hopFrames - span / 2 + span;
+                mono.assign(static_cast<size_t>(sampleEnd - sampleStart), 0.0f);
+                const uint64_t readFrom = static_cast<uint64_t>(std::max<int64_t>(0, sampleStart));
+                const uint64_t readTo = std::min<uint64_t>(pcm.frameCount(), static_cast<uint64_t>(std::max<int64_t>(0, sampleEnd)));
+                if (readTo > readFrom)
+                {
+                    interleaved.resize(static_cast<size_t>(readTo - readFrom) * channels);
+                    const uint64_t got = pcm.read(readFrom, interleaved.data(), readTo - readFrom);
+                    float* target = mono.data() + (static_cast<int64_t>(readFrom) - sampleStart);
+                    const float scale = 1.0f / static_cast<float>(channels);
+                    for (uint64_t frame = 0; frame < got; ++frame)
+                    {
+                        float sum = 0.0f;
+                        for (uint32_t channel = 0; channel < channels; ++channel)
+                            sum += interleaved[frame * channels + channel];
+                        target[frame] = sum * scale;
+                    }
+                }
+
+                for (size_t value = first; value < end; ++value)
+                    out.notes[value] = detector.detect(mono.data() + (value - first) * out.hopFrames);
+
+                const size_t finished = finishedChunks.fetch_add(1) + 1;
+                if (reportProgress && onProgress
+                    && !onProgress(static_cast<float>(finished) / static_cast<float>(chunks)))
+                    cancelled.store(true);
+            }
+        };
+
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < std::min<size_t>(threadCount, chunks); ++i)
+        {
+            workers.emplace_back([&work]() {
+                RealtimeSupport::configureWorkerThread();
+                Trace::setThreadName("Pitch analysis");
+                work(false);
+            });
+        }
+        work(true);
+        for (std::thread& worker : workers)
+            worker.join();
+        if (cancelled.load())
+            return false;
+
+        // Isolated voiced values are mostly noise or percussion that happened to repeat
+        size_t runStart = 0;
+        for (size_t i = 0; i <= out.notes.size(); ++i)
+        {
+            if (i < out.notes.size() && !std::isnan(out.notes[i]))
+                continue;
+            if (i - runStart < kMinVoicedRun)
+                std::fill(out.notes.begin() + runStart, out.notes.begin() + i, std::numeric_limits<float>::quiet_NaN());
+            runStart = i + 1;
+        }
+        return true;
+    }
+
+    PitchContour analyzeTrack(const std::string& audioPath, const PcmStore& pcm,
+                              const std::function<bool(float)>& onProgress)
+    {
+        PitchContour contour;
+        std::string payload;
+        if (AnalysisCache::load(audioPath, kCacheKind, pcm.sampleRate(), payload))
+        {
+            BinaryIO::Reader reader(payload);
+            contour.sampleRate = pcm.sampleRate();
+            contour.hopFrames = reader.get<uint32_t>();
+            const uint32_t count = reader.get<uint32_t>();
+            if (reader.ok() && contour.hopFrames > 0 && count <= payload.size() / sizeof(float))
+            {
+                contour.notes.resize(count);
+                for (float& note : contour.notes)
+                    note = reader.get<float>();
+                if (reader.ok())
+                    return contour;
+            }
+            std::cerr << "PitchDetection: Ignoring damaged cache for " << audioPath << std::endl;
+        }
+
+        if (!analyze(pcm, contour, onProgress))
+            return PitchContour{};
+        payload.clear();
+        BinaryIO::put(payload, contour.hopFrames);
+        BinaryIO::put(payload, static_cast<uint32_t>(contour.notes.size()));
+        for (const float note : contour.notes)
+            BinaryIO::put(payload, note);
+        AnalysisCache::store(audioPath, kCacheKind, contour.sampleRate, payload);
+        return contour;
+    }
+}
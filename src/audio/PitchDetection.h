@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Fft.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class PcmStore;
+
+// Fundamental frequency of a window of mono audio with YIN (de Cheveigné and Kawahara,
+// 2002). The difference function comes from a cross-correlation through the FFT instead
+// of a sum per lag. Keeps scratch buffers: one detector per thread.
+class YinDetector
+{
+public:
+    explicit YinDetector(uint32_t sampleRate);
+
+    // Samples detect() reads: the integration window plus the longest lag
+    size_t windowFrames() const { return m_integrationFrames + m_maxLag; }
+    // MIDI note number (fractional) of samples[0, windowFrames()); NaN when unvoiced or silent
+    float detect(const float* samples);
+
+private:
+    uint32_t m_sampleRate = 0;
+    Fft m_fft;
+    size_t m_integrationFrames = 0;
+    size_t m_minLag = 0;
+    size_t m_maxLag = 0;
+    std::vector<float> m_re;
+    std::vector<float> m_im;
+    std::vector<float> m_productRe;
+    std::vector<float> m_productIm;
+    std::vector<double> m_energy;      // Prefix sums of squared samples
+    std::vector<float> m_difference;  // Cumulative mean normalised difference per lag
+};
+
+// f0 contour of a track at a fixed hop
+struct PitchContour
+{
+    uint32_t sampleRate = 0;
+    uint32_t hopFrames = 0;    // Value i is centred on source frame i * hopFrames
+    std::vector<float> notes;  // MIDI note numbers, NaN where unvoiced
+
+    bool empty() const { return notes.empty(); }
+};
+
+namespace PitchDetection
+{
+    // Contour of the track's mono mix every 10 ms. Time ranges are spread over threadCount
+    // threads (0 = one per core), the calling thread included; onProgress runs on the
+    // calling thread and cancels by returning false.
+    bool analyze(const PcmStore& pcm, PitchContour& out, const std::function<bool(float)>& onProgress,
+                 unsigned int threadCount = 0);
+
+    // The cached contour of the track (see AnalysisCache), or a new one that is then cached;
+    // empty if cancelled
+    PitchContour analyzeTrack(const std::string& audioPath, const PcmStore& pcm,
+                              const std::function<bool(float)>& onProgress);
+}
@@ -0,0 +1,233 @@
+#include "RealtimeCheckSession.h"
+#include "AudioEngine.h"
+#include "platform/RealtimeChecker.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kSampleRate = 48000;
+    constexpr unsigned int kBlockFrames = 256;
+    constexpr float kDefaultSeconds = 20.0f;
+    constexpr std::chrono::seconds kWaitTimeout{30};
+
+    class Session
+    {
+    public:
+        explicit Session(AudioEngine& engine)
+            : m_engine(engine),
+              m_buffer(static_cast<size_t>(kBlockFrames) * engine.getChannelCount())
+        {
+        }
+
+        // Renders as fast as the engine allows; UI-side work runs between blocks like a frame would
+        void render(float seconds)
+        {
+            const uint64_t blocks = static_cast<uint64_t>(seconds * m_engine.getSampleRate() / kBlockFrames) + 1;
+            for (uint64_t block = 0; block < blocks; ++block)
+                renderBlock();
+        }
+
+        // Keeps rendering until done() holds; false on timeout
+        template <typename Condition>
+        bool renderUntil(Condition done)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + kWaitTimeout;
+            while (!done())
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                    return false;
+                renderBlock();
+                // Give the loader and tempo threads the time a real callback period would
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        }
+
+        uint64_t blocksRendered() const { return m_blocks; }
+
+    private:
+        void renderBlock()
+        {
+            // The pitch detector and take writer keep up with a device, not with rendering as
+            // fast as possible
+            while (m_engine.inputActive() && (m_engine.livePitch().backlogFrames() > kBlockFrames * 4
+                                              || m_engine.recorder().backlogFrames() > m_engine.getSampleRate()))
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            m_engine.renderOffline(m_buffer.data(), kBlockFrames);
+            m_engine.update();
+            ++m_blocks;
+        }
+
+        AudioEngine& m_engine;
+        std::vector<float> m_buffer;
+        uint64_t m_blocks = 0;
+    };
+
+    // Records a take with the track mixed in while playing on, then plays it back over the track
+    void recordTake(AudioEngine& engine, Session& session, float seconds)
+    {
+        std::cout << "RealtimeCheck: recording a take and listening back" << std::endl;
+        const std::string takePath = (std::filesystem::temp_directory_path() / "songpractice-rt-check-take.wav").string();
+        if (!engine.startRecording(takePath, true))
+        {
+            std::cerr << "RealtimeCheck: Failed to start recording" << std::endl;
+            return;
+        }
+        session.render(seconds * 0.5f);
+        engine.stopRecording();
+        RecordedTake take;
+        if (!session.renderUntil([&engine, &take]() { return engine.takeFinishedRecording(take); }))
+        {
+            std::cerr << "RealtimeCheck: Take was not finished" << std::endl;
+            return;
+        }
+        std::cout << "RealtimeCheck: take of " << take.frameCount << " frames from frame " << take.startFrame
+                  << (take.truncated ? ", cut short" : "") << std::endl;
+
+        DecodedAudio decoded;
+        if (take.frameCount == 0 || !AudioEngine::decodeAudioFile(take.filePath, engine.getSampleRate(), decoded))
+        {
+            std::cerr << "RealtimeCheck: Recorded take could not be read back" << std::endl;
+            return;
+        }
+        engine.setTakePlayback(decoded.pcm, take.startFrame, take.tempo, take.withBacking);
+        engine.seekToFrame(take.startFrame);
+        session.render(seconds * 0.5f);
+        engine.setTakePlayback(nullptr, 0, 1.0f, false);
+        std::error_code error;
+        std::filesystem::remove(takePath, error);
+    }
+
+    void exercise(AudioEngine& engine, const std::string& filePath, float seconds)
+    {
+        Session session(engine);
+        const float step = seconds / 5.0f;
+
+        std::cout << "RealtimeCheck: playing with the metronome" << std::endl;
+        engine.setBeatGrid(120.0, 0, 4);
+        engine.setMetronomeEnabled(true);
+        engine.play();
+        session.render(step);
+
+        if (engine.inputActive())
+            recordTake(engine, session, step);
+
+        std::cout << "RealtimeCheck: seeking and pausing" << std::endl;
+        engine.seekToFrame(engine.getFrameCount() / 2);
+        session.render(step * 0.5f);
+        engine.pause();
+        session.render(0.5f);
+        engine.playWithCountIn(1);
+        if (!session.renderUntil([&engine]() { return !engine.isCountingIn(); }))
+            std::cerr << "RealtimeCheck: Count-in did not finish" << std::endl;
+        engine.seekBy(-2.0f);
+        session.render(step * 0.5f);
+
+        std::cout << "RealtimeCheck: scrubbing" << std::endl;
+        const uint64_t scrubStart = engine.getCurrentFrame();
+        const uint64_t scrubStep = engine.getSampleRate() / 100;
+        engine.beginScrub(scrubStart);
+        for (uint64_t move = 1; move <= 50; ++move)
+        {
+            // Forwards, then back towards the start, one cursor move per block
+            engine.scrubTo(move <= 25 ? scrubStart + move * scrubStep
+                                      : scrubStart + (50 - move) * scrubStep / 2);
+            session.render(static_cast<float>(kBlockFrames) / engine.getSampleRate());
+        }
+        engine.endScrub();
+        session.render(0.1f);
+
+        std::cout << "RealtimeCheck: changing tempo" << std::endl;
+        engine.setTempoMultiplier(0.75f);
+        if (!session.renderUntil([&engine]() { return !engine.isTempoProcessing(); }))
+            std::cerr << "RealtimeCheck: Tempo change did not finish" << std::endl;
+        session.render(step);
+
+        std::cout << "RealtimeCheck: rolling over into a preloaded track" << std::endl;
+        engine.preloadNextTrack(filePath, 0.75f);
+        if (!session.renderUntil([&engine]() { return engine.hasNextTrack(); }))
+            std::cerr << "RealtimeCheck: Next track was not preloaded" << std::endl;
+        engine.seekToFrame(engine.getFrameCount() - std::min<uint64_t>(engine.getFrameCount(), engine.getSampleRate()));
+        bool switched = false;
+        if (!session.renderUntil([&engine, &switched]() { return switched = switched || engine.takeTrackSwitch(); }))
+            std::cerr << "RealtimeCheck: Playback did not roll over" << std::endl;
+        session.render(step);
+
+        engine.stop();
+        std::cout << "RealtimeCheck: rendered " << session.blocksRendered() << " blocks of " << kBlockFrames
+                  << " frames, " << engine.pageMisses() << " page miss(es)" << std::endl;
+
+        if (engine.inputActive())
+        {
+            // Let the detector finish the last blocks
+            session.render(0.1f);
+            std::vector<LivePitchPoint> points;
+            engine.livePitch().pointsSince(0, points);
+            const size_t voiced = static_cast<size_t>(std::count_if(points.begin(), points.end(), [](const LivePitchPoint& point) {
+                return !std::isnan(point.note);
+            }));
+            std::cout << "RealtimeCheck: live pitch voiced in " << voiced << " of the last " << points.size()
+                      << " results, " << engine.livePitch().droppedFrames() << " input frame(s) dropped" << std::endl;
+        }
+    }
+}
+
+namespace RealtimeCheckSession
+{
+    int run(const std::vector<std::string>& args)
+    {
+        bool trap = false;
+        std::string inputPath;
+        std::string filePath;
+        float seconds = kDefaultSeconds;
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            const std::string& arg = args[i];
+            if (arg == "--trap")
+                trap = true;
+            else if (arg == "--input" && i + 1 < args.size())
+                inputPath = args[++i];
+            else if (filePath.empty())
+                filePath = arg;
+            else
+                seconds = std::max(1.0f, static_cast<float>(std::atof(arg.c_str())));
+        }
+        if (filePath.empty())
+        {
+            std::cerr << "usage: SongPractice --rt-check [--trap] [--input <audio file>] <audio file> [seconds]"
+                      << std::endl;
+            return 2;
+        }
+
+        if (!RealtimeChecker::isEnabled())
+            std::cerr << "RealtimeCheck: Built without SONGPRACTICE_RT_CHECK; the session runs unchecked" << std::endl;
+        RealtimeChecker::setTrap(trap);
+
+        {
+            AudioEngine engine;
+            engine.setOfflineRendering(kSampleRate);
+            if (!engine.initialize() || !engine.loadAudioFile(filePath.c_str()))
+            {
+                std::cerr << "RealtimeCheck: Failed to load " << filePath << std::endl;
+                return 2;
+            }
+            if (!inputPath.empty())
+            {
+                if (!engine.setOfflineInput(inputPath))
+                    return 2;
+                std::cout << "RealtimeCheck: tracking the pitch of " << inputPath << " as the microphone" << std::endl;
+                engine.setInputEnabled(true);
+            }
+            exercise(engine, filePath, seconds);
+        }
+
+        return RealtimeChecker::printSummary() > 0 ? 1 : 0;
+    }
+}
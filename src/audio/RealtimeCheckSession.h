@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// `SongPractice --rt-check [--trap] [--input <wav>] <file> [seconds]`: plays the file through
+// the audio engine's offline backend while seeking, pausing, changing tempo and rolling over
+// into a preloaded track, then prints the RealtimeChecker summary of what the callback did
+// that real-time code must not. With --input the wav stands in for the microphone: its
+// pitch is tracked throughout, and a take is recorded and played back. Needs a build with -DSONGPRACTICE_RT_CHECK=ON to check anything.
+namespace RealtimeCheckSession
+{
+    // Returns the process exit code: 1 when the callback broke a rule, 2 on usage errors
+    int run(const std::vector<std::string>& args);
+}
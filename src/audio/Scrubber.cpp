@@ -0,0 +1,173 @@
+#include "Scrubber.h"
+#include "PcmStore.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr float kGrainSeconds = 0.02f;  // Hop of 10 ms: under one typical callback period
+    constexpr double kMaxSpeed = 4.0;
+    // Below kSilentSpeed a grain is silent, from kFullSpeed on it plays at full level
+    constexpr double kSilentSpeed = 0.05;
+    constexpr double kFullSpeed = 0.25;
+
+    float gainForSpeed(double velocity)
+    {
+        const double speed = std::abs(velocity);
+        return static_cast<float>(std::clamp((speed - kSilentSpeed) / (kFullSpeed - kSilentSpeed), 0.0, 1.0));
+    }
+}
+
+void Scrubber::prepare(uint32_t channelCount, uint32_t sampleRate)
+{
+    m_channelCount = channelCount;
+    m_grainFrames = std::max<uint32_t>(64, static_cast<uint32_t>(sampleRate * kGrainSeconds) & ~1u);
+    m_hopFrames = m_grainFrames / 2;
+
+    // A periodic Hann window overlapped by half sums to one
+    m_window.resize(m_grainFrames);
+    for (uint32_t i = 0; i < m_grainFrames; ++i)
+        m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / m_grainFrames));
+
+    // Enough source frames for a grain at full speed, plus one for interpolation
+    const size_t spanFrames = static_cast<size_t>(m_grainFrames * kMaxSpeed) + 2;
+    for (Grain& grain : m_grains)
+    {
+        grain.samples.assign(spanFrames * channelCount, 0.0f);
+        grain.playing = false;
+    }
+    m_untilNextGrain = 0;
+}
+
+void Scrubber::begin(uint64_t frame)
+{
+    m_target.store(frame);
+    m_generation.fetch_add(1);
+    m_active.store(true);
+}
+
+void Scrubber::setTarget(uint64_t frame)
+{
+    m_target.store(frame);
+}
+
+void Scrubber::end()
+{
+    m_active.store(false);
+}
+
+bool Scrubber::isActive() const
+{
+    return m_active.load();
+}
+
+bool Scrubber::isSounding() const
+{
+    return m_active.load() || m_grains[0].playing || m_grains[1].playing;
+}
+
+uint64_t Scrubber::position() const
+{
+    return m_publishedPosition.load();
+}
+
+void Scrubber::updateVelocity(uint64_t sourceFrames, unsigned int blockFrames)
+{
+    const double target = static_cast<double>(std::min(m_target.load(), sourceFrames));
+    const uint32_t generation = m_generation.load();
+    if (generation != m_seenGeneration)
+    {
+        m_seenGeneration = generation;
+        m_position = target;
+        m_velocity = 0.0;
+    }
+
+    // Reach the target within two callback periods (at least one grain). A drag faster
+    // than kMaxSpeed jumps ahead instead of lagging behind the cursor.
+    const double chaseFrames = std::max(2.0 * blockFrames, static_cast<double>(m_grainFrames));
+    const double reach = kMaxSpeed * chaseFrames;
+    double distance = target - m_position;
+    if (std::abs(distance) > reach)
+    {
+        distance = std::copysign(reach, distance);
+        m_position = target - distance;
+    }
+    m_velocity = distance / chaseFrames;
+}
+
+void Scrubber::startGrain(Grain& grain, const PcmStore& source)
+{
+    grain.start = m_position;
+    grain.rate = m_velocity;
+    grain.gain = gainForSpeed(m_velocity);
+    grain.age = 0;
+    grain.playing = false;
+    if (grain.gain <= 0.0f)
+        return;
+
+    // Copy the source span the grain will cover; blocks that are not resident stay silent
+    const double end = m_position + m_velocity * (m_grainFrames - 1);
+    const uint64_t first = static_cast<uint64_t>(std::max(0.0, std::floor(std::min(m_position, end))));
+    const uint64_t last = std::min(static_cast<uint64_t>(std::ceil(std::max(m_position, end))) + 2,
+                                   source.frameCount());
+    const uint64_t capacity = grain.samples.size() / m_channelCount;
+    const uint64_t wanted = last > first ? std::min(last - first, capacity) : 0;
+    grain.firstFrame = first;
+    grain.frameCount = source.readResident(first, grain.samples.data(), wanted);
+    grain.playing = grain.frameCount > 0;
+}
+
+void Scrubber::mix(const PcmStore& source, float* output, unsigned int frames)
+{
+    if (m_channelCount == 0 || m_grainFrames == 0 || source.channelCount() != m_channelCount)
+        return;
+
+    const uint64_t sourceFrames = source.frameCount();
+    const bool active = m_active.load();
+    if (active)
+        updateVelocity(sourceFrames, frames);
+
+    for (unsigned int frame = 0; frame < frames; ++frame)
+    {
+        if (m_untilNextGrain == 0)
+        {
+            // With half overlap the older grain has just finished when the next one starts
+            Grain* grain = !m_grains[0].playing ? &m_grains[0] : (!m_grains[1].playing ? &m_grains[1] : nullptr);
+            if (active && grain)
+                startGrain(*grain, source);
+            m_untilNextGrain = m_hopFrames;
+        }
+        --m_untilNextGrain;
+
+        float* out = output + static_cast<size_t>(frame) * m_channelCount;
+        for (Grain& grain : m_grains)
+        {
+            if (!grain.playing)
+                continue;
+
+            const double offset = grain.start + grain.rate * grain.age - static_cast<double>(grain.firstFrame);
+            if (offset >= 0.0)
+            {
+                const uint64_t index = static_cast<uint64_t>(offset);
+                if (index < grain.frameCount)
+                {
+                    const float fraction = static_cast<float>(offset - static_cast<double>(index));
+                    const float weight = m_window[grain.age] * grain.gain;
+                    const float* a = grain.samples.data() + index * m_channelCount;
+                    const float* b = (index + 1 < grain.frameCount) ? a + m_channelCount : a;
+                    for (uint32_t channel = 0; channel < m_channelCount; ++channel)
+                        out[channel] += weight * (a[channel] + (b[channel] - a[channel]) * fraction);
+                }
+            }
+
+            if (++grain.age >= m_grainFrames)
+                grain.playing = false;
+        }
+
+        if (active)
+            m_position = std::clamp(m_position + m_velocity, 0.0, static_cast<double>(sourceFrames));
+    }
+
+    m_publishedPosition.store(static_cast<uint64_t>(m_position));
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class PcmStore;
+
+// Grain player for scrubbing the waveform cursor. While active it plays short
+// Hann-windowed grains, half-overlapped, that chase the drag position. Each grain reads at
+// the drag velocity, so a slow drag sounds slow and a backwards drag plays backwards; a
+// cursor held still fades to silence. Positions are frames of the store passed to mix().
+//
+// begin(), setTarget() and end() are atomic stores for the UI thread. mix() runs in the
+// audio callback and neither allocates nor locks. prepare() sizes the grain buffers and
+// must only be called while the callback is not running.
+class Scrubber
+{
+public:
+    void prepare(uint32_t channelCount, uint32_t sampleRate);
+
+    void begin(uint64_t frame);
+    void setTarget(uint64_t frame);
+    // Grains already playing fade out; no new ones start
+    void end();
+    bool isActive() const;
+
+    // Audio callback: adds frames * channelCount samples of grains to output
+    void mix(const PcmStore& source, float* output, unsigned int frames);
+    // Active, or grains are still fading out after end()
+    bool isSounding() const;
+    // Read position reached by the last mix(), for the playhead
+    uint64_t position() const;
+
+private:
+    struct Grain
+    {
+        std::vector<float> samples;  // Source frames under the grain, interleaved
+        uint64_t firstFrame = 0;     // Source frame of samples[0]
+        uint64_t frameCount = 0;     // Frames loaded into samples
+        double start = 0.0;          // Source position at the grain's first output frame
+        double rate = 0.0;           // Source frames per output frame (negative: backwards)
+        float gain = 0.0f;
+        uint32_t age = 0;            // Output frames played so far
+        bool playing = false;
+    };
+
+    void startGrain(Grain& grain, const PcmStore& source);
+    void updateVelocity(uint64_t sourceFrames, unsigned int blockFrames);
+
+    uint32_t m_channelCount = 0;
+    uint32_t m_grainFrames = 0;
+    uint32_t m_hopFrames = 0;
+    std::vector<float> m_window;  // Periodic Hann, m_grainFrames long
+    Grain m_grains[2];
+
+    // UI thread -> audio callback
+    std::atomic<bool> m_active{false};
+    std::atomic<uint64_t> m_target{0};
+    std::atomic<uint32_t> m_generation{0};  // Bumped by begin() to snap to the target
+
+    // Audio callback only, apart from the published position
+    uint32_t m_seenGeneration = 0;
+    double m_position = 0.0;
+    double m_velocity = 0.0;
+    uint32_t m_untilNextGrain = 0;
+    std::atomic<uint64_t> m_publishedPosition{0};
+};
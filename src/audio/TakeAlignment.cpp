@@ -0,0 +1,630 @@
+#include "TakeAlignment.h"
+#include "Fft.h"
+#include "PcmStore.h"
+#include "core/Trace.h"
+#include "platform/RealtimeSupport.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #include <xmmintrin.h>
+    #define SONGPRACTICE_DTW_SSE 1
+#endif
+
+namespace
+{
+    constexpr double kPi = 3.14159265358979323846;
+    constexpr size_t kChromaBins = 12;
+
+    constexpr double kWindowSeconds = 0.04;     // Chroma window, rounded up to a power of two
+    constexpr double kMinChromaHz = 65.0;       // C2; lower bins are too coarse to name a note
+    constexpr double kMaxChromaHz = 2100.0;     // Above the sung range, where overtones dominate
+    constexpr float kSilence = 1e-7f;           // Mean square of a window without chroma (-70 dBFS)
+    constexpr size_t kChunkHops = 256;          // Hops per work item
+
+    constexpr float kSameNoteCents = 100.0f;    // Further off is another note, not intonation
+    constexpr double kBandSeconds = 2.0;        // How far the singer may drift from the track
+    constexpr size_t kMinCellsPerThread = 128;  // Shorter runs are not worth a barrier per diagonal
+    constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+    constexpr double kPitchProgress = 0.5;      // Of the whole scoring, for the take's pitch
+    constexpr double kFeatureProgress = 0.9;    // ... and the features after it
+
+    // How a path reaches a cell (take hop i, reference hop j)
+    enum Step : uint8_t
+    {
+        Diagonal,  // From (i - 1, j - 1)
+        Up,        // From (i - 1, j): the take lingers
+        Left       // From (i, j - 1): the take skips ahead
+    };
+
+    // Read-only state shared by the chroma threads
+    struct ChromaSetup
+    {
+        ChromaSetup(const PcmStore& store, size_t size) : pcm(store), fft(size) {}
+
+        const PcmStore& pcm;
+        Fft fft;
+        std::vector<float> window;
+        std::vector<int8_t> pitchClass;  // Per FFT bin, -1 outside the chroma range
+        size_t fftSize = 0;
+        double firstFrame = 0.0;
+        double hopFrames = 0.0;
+    };
+
+    struct ChromaBuffers
+    {
+        std::vector<float> interleaved;
+        std::vector<float> mono;
+        std::vector<float> re;
+        std::vector<float> im;
+    };
+
+    int64_t windowStart(const ChromaSetup& setup, size_t hop)
+    {
+        return std::llround(setup.firstFrame + static_cast<double>(hop) * setup.hopFrames)
+               - static_cast<int64_t>(setup.fftSize / 2);
+    }
+
+    // Chroma rows of hops [firstHop, endHop); two windows share each complex FFT
+    void computeChunk(const ChromaSetup& setup, ChromaBuffers& buffers, size_t firstHop, size_t endHop,
+                      AlignmentFeatures& out)
+    {
+        const size_t n = setup.fftSize;
+        const size_t bins = n / 2 + 1;
+        const int64_t sampleStart = windowStart(setup, firstHop);
+        const int64_t sampleEnd = windowStart(setup, endHop - 1) + static_cast<int64_t>(n);
+
+        // Mono mix of the span; silence before the start and after the end of the audio
+        buffers.mono.assign(static_cast<size_t>(sampleEnd - sampleStart), 0.0f);
+        const uint32_t channels = setup.pcm.channelCount();
+        const uint64_t readFrom = static_cast<uint64_t>(std::max<int64_t>(0, sampleStart));
+        const uint64_t readTo = std::min<uint64_t>(setup.pcm.frameCount(), static_cast<uint64_t>(std::max<int64_t>(0, sampleEnd)));
+        if (readTo > readFrom)
+        {
+            buffers.interleaved.resize(static_cast<size_t>(readTo - readFrom) * channels);
+            const uint64_t got = setup.pcm.read(readFrom, buffers.interleaved.data(), readTo - readFrom);
+            float* mono = buffers.mono.data() + (static_cast<int64_t>(readFrom) - sampleStart);
+            const float scale = 1.0f / static_cast<float>(channels);
+            for (uint64_t frame = 0; frame < got; ++frame)
+            {
+                float sum = 0.0f;
+                for (uint32_t channel = 0; channel < channels; ++channel)
+                    sum += buffers.interleaved[frame * channels + channel];
+                mono[frame] = sum * scale;
+            }
+        }
+
+        buffers.re.resize(n);
+        buffers.im.resize(n);
+        for (size_t pair = firstHop; pair < endHop; pair += 2)
+        {
+            const bool hasSecond = pair + 1 < endHop;
+            const float* first = buffers.mono.data() + (windowStart(setup, pair) - sampleStart);
+            const float* second = hasSecond ? buffers.mono.data() + (windowStart(setup, pair + 1) - sampleStart) : first;
+            float energy[2] = {0.0f, 0.0f};
+            for (size_t i = 0; i < n; ++i)
+            {
+                energy[0] += first[i] * first[i];
+                energy[1] += second[i] * second[i];
+                buffers.re[i] = first[i] * setup.window[i];
+                buffers.im[i] = hasSecond ? second[i] * setup.window[i] : 0.0f;
+            }
+            setup.fft.forward(buffers.re.data(), buffers.im.data());
+
+            // Z = A + iB for real frames a and b: A[k] = (Z[k] + conj Z[n-k]) / 2, B[k] = (Z[k] - conj Z[n-k]) / 2i
+            for (size_t half = 0; half < 2 && pair + half < endHop; ++half)
+            {
+                float chroma[kChromaBins] = {};
+                const float* re = buffers.re.data();
+                const float* im = buffers.im.data();
+                for (size_t k = 1; k < bins; ++k)
+                {
+                    const int pitchClass = setup.pitchClass[k];
+                    if (pitchClass < 0)
+                        continue;
+                    const size_t mirror = (n - k) & (n - 1);
+                    const float x = half == 0 ? re[k] + re[mirror] : im[k] + im[mirror];
+                    const float y = half == 0 ? im[k] - im[mirror] : re[k] - re[mirror];
+                    chroma[pitchClass] += std::sqrt(x * x + y * y);
+                }
+
+                float norm = 0.0f;
+                for (const float value : chroma)
+                    norm += value * value;
+                norm = std::sqrt(norm);
+                const bool silent = energy[half] < kSilence * static_cast<float>(n) || norm <= 0.0f;
+                const size_t hop = pair + half;
+                for (size_t bin = 0; bin < kChromaBins; ++bin)
+                    out.row(bin)[hop] = silent ? 0.0f : chroma[bin] / norm;
+            }
+        }
+    }
+
+    // Threads meeting after every anti-diagonal; spins, as diagonals take microseconds
+    class SpinBarrier
+    {
+    public:
+        explicit SpinBarrier(unsigned int count) : m_count(count) {}
+
+        void arrive()
+        {
+            const unsigned int generation = m_generation.load();
+            if (m_waiting.fetch_add(1) + 1 == m_count)
+            {
+                m_waiting.store(0);
+                m_generation.fetch_add(1);
+                return;
+            }
+            for (unsigned int spins = 0; m_generation.load() == generation; ++spins)
+            {
+                if (spins > 1000)
+                    std::this_thread::yield();
+            }
+        }
+
+    private:
+        const unsigned int m_count;
+        std::atomic<unsigned int> m_waiting{0};
+        std::atomic<unsigned int> m_generation{0};
+    };
+
+    // Band cells along anti-diagonals s = i + j. Cell k of diagonal s is take hop
+    // i = first(s) + k at reference hop j = s - i, and j - i runs from 2 * radius down to 0 in
+    // steps of 2, so a diagonal has radius + 1 cells when s is even and radius when it is odd.
+    // A cell's predecessors are cell k of diagonal s - 2 and cells k - 1 + odd, k + odd of
+    // diagonal s - 1. Rows of costs are padded by one infinite cell on each side.
+    struct Band
+    {
+        const AlignmentFeatures* take = nullptr;
+        std::vector<float> reversed;  // Reference rows back to front: along a diagonal both hop indices rise
+        size_t takeHops = 0;
+        size_t referenceHops = 0;
+        size_t radius = 0;
+        size_t width = 0;             // Cells of an even diagonal
+        std::vector<float> costs;     // Three padded rows, for diagonals s - 2, s - 1 and s
+        std::vector<uint8_t> steps;   // width per diagonal
+
+        int64_t first(int64_t s) const { return (s - 2 * static_cast<int64_t>(radius) + (s & 1)) / 2; }
+        int64_t lastCell(int64_t s) const { return static_cast<int64_t>(radius) - (s & 1); }
+        float* row(int64_t s) { return costs.data() + static_cast<size_t>((s + 3) % 3) * (width + 2); }
+
+        // Band cells of diagonal s that lie on take hops
+        void cells(int64_t s, int64_t& from, int64_t& to) const
+        {
+            const int64_t firstHop = first(s);
+            from = std::max<int64_t>(0, -firstHop);
+            to = std::min<int64_t>(lastCell(s), static_cast<int64_t>(takeHops) - 1 - firstHop);
+        }
+
+        // Everything around the cells of diagonal s: infinite, except a virtual take hop -1
+        // that costs nothing, so a path may start at any reference hop of the band
+        void prepareRow(int64_t s)
+        {
+            float* costsOut = row(s);
+            int64_t from = 0;
+            int64_t to = 0;
+            cells(s, from, to);
+            if (from > to)
+            {
+                from = static_cast<int64_t>(width) + 1;
+                to = from - 1;
+            }
+            std::fill(costsOut, costsOut + from + 1, kInfinity);
+            std::fill(costsOut + to + 2, costsOut + width + 2, kInfinity);
+            const int64_t start = -1 - first(s);
+            if (start >= 0 && start <= lastCell(s))
+                costsOut[start + 1] = 0.0f;
+        }
+
+        // Cells [from, to] of diagonal s
+        void computeCells(int64_t s, int64_t from, int64_t to)
+        {
+            const int64_t firstHop = first(s);
+            const int64_t odd = s & 1;
+            const float* beforePrevious = row(s - 2) + 1;
+            const float* previous = row(s - 1) + odd;
+            float* current = row(s) + 1;
+            uint8_t* stepsOut = steps.data() + static_cast<size_t>(s) * width;
+            // Reference hop j = s - i sits at m - 1 - j of the reversed rows
+            const int64_t reversedOffset = static_cast<int64_t>(referenceHops) - 1 - s;
+            const size_t takeStride = takeHops;
+            const size_t referenceStride = referenceHops;
+            const float* takeRows = take->values.data();
+            const float* referenceRows = reversed.data();
+
+            int64_t k = from;
+#ifdef SONGPRACTICE_DTW_SSE
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 half = _mm_set1_ps(0.5f);
+            for (; k + 3 <= to; k += 4)
+            {
+                const size_t i = static_cast<size_t>(firstHop + k);
+                const size_t r = static_cast<size_t>(reversedOffset + firstHop + k);
+                __m128 chroma = _mm_setzero_ps();
+                for (size_t bin = 0; bin < kChromaBins; ++bin)
+                {
+                    chroma = _mm_add_ps(chroma, _mm_mul_ps(_mm_loadu_ps(takeRows + bin * takeStride + i),
+                                                           _mm_loadu_ps(referenceRows + bin * referenceStride + r)));
+                }
+                const __m128 takeVoiced = _mm_loadu_ps(takeRows + AlignmentFeatures::kVoiced * takeStride + i);
+                const __m128 referenceVoiced = _mm_loadu_ps(referenceRows + AlignmentFeatures::kVoiced * referenceStride + r);
+                const __m128 pitchDot = _mm_add_ps(
+                    _mm_mul_ps(_mm_loadu_ps(takeRows + AlignmentFeatures::kPitchCos * takeStride + i),
+                               _mm_loadu_ps(referenceRows + AlignmentFeatures::kPitchCos * referenceStride + r)),
+                    _mm_mul_ps(_mm_loadu_ps(takeRows + AlignmentFeatures::kPitchSin * takeStride + i),
+                               _mm_loadu_ps(referenceRows + AlignmentFeatures::kPitchSin * referenceStride + r)));
+                const __m128 pitch = _mm_mul_ps(half, _mm_sub_ps(_mm_add_ps(takeVoiced, referenceVoiced),
+                                                                 _mm_add_ps(_mm_mul_ps(takeVoiced, referenceVoiced), pitchDot)));
+                const __m128 cost = _mm_add_ps(_mm_sub_ps(one, chroma), pitch);
+
+                const __m128 diagonal = _mm_loadu_ps(beforePrevious + k);
+                const __m128 up = _mm_loadu_ps(previous + k);
+                const __m128 left = _mm_loadu_ps(previous + k + 1);
+                const __m128 best = _mm_min_ps(diagonal, _mm_min_ps(up, left));
+                _mm_storeu_ps(current + k, _mm_add_ps(cost, best));
+                const int isDiagonal = _mm_movemask_ps(_mm_cmpeq_ps(diagonal, best));
+                const int isUp = _mm_movemask_ps(_mm_cmpeq_ps(up, best));
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    stepsOut[k + lane] = ((isDiagonal >> lane) & 1) ? Diagonal : ((isUp >> lane) & 1) ? Up : Left;
+                }
+            }
+#endif
+            for (; k <= to; ++k)
+            {
+                const size_t i = static_cast<size_t>(firstHop + k);
+                const size_t r = static_cast<size_t>(reversedOffset + firstHop + k);
+                float chroma = 0.0f;
+                for (size_t bin = 0; bin < kChromaBins; ++bin)
+                    chroma += takeRows[bin * takeStride + i] * referenceRows[bin * referenceStride + r];
+                const float takeVoiced = takeRows[AlignmentFeatures::kVoiced * takeStride + i];
+                const float referenceVoiced = referenceRows[AlignmentFeatures::kVoiced * referenceStride + r];
+                const float pitchDot = takeRows[AlignmentFeatures::kPitchCos * takeStride + i]
+                                           * referenceRows[AlignmentFeatures::kPitchCos * referenceStride + r]
+                                       + takeRows[AlignmentFeatures::kPitchSin * takeStride + i]
+                                             * referenceRows[AlignmentFeatures::kPitchSin * referenceStride + r];
+                const float cost = 1.0f - chroma
+                                   + 0.5f * (takeVoiced + referenceVoiced - takeVoiced * referenceVoiced - pitchDot);
+
+                const float diagonal = beforePrevious[k];
+                const float up = previous[k];
+                const float left = previous[k + 1];
+                const float best = std::min(diagonal, std::min(up, left));
+                current[k] = cost + best;
+                stepsOut[k] = diagonal == best ? Diagonal : up == best ? Up : Left;
+            }
+        }
+    };
+
+    // Hop of pitch class note as a point on the unit circle, so that the dot product of two
+    // is the cosine of their interval and octaves do not count
+    void putPitch(AlignmentFeatures& features, size_t hop, float note)
+    {
+        const bool voiced = !std::isnan(note);
+        const double angle = voiced ? 2.0 * kPi * note / 12.0 : 0.0;
+        features.row(AlignmentFeatures::kPitchCos)[hop] = voiced ? static_cast<float>(std::cos(angle)) : 0.0f;
+        features.row(AlignmentFeatures::kPitchSin)[hop] = voiced ? static_cast<float>(std::sin(angle)) : 0.0f;
+        features.row(AlignmentFeatures::kVoiced)[hop] = voiced ? 1.0f : 0.0f;
+    }
+
+    struct Accumulator
+    {
+        double timingSum = 0.0;
+        size_t timingHops = 0;
+        double pitchSum = 0.0;
+        double pitchErrorSum = 0.0;
+        size_t pitchHops = 0;
+        double startFrame = std::numeric_limits<double>::infinity();
+        double endFrame = 0.0;
+
+        void add(double position, double hopFrames, bool sounding, double timingMs, float centsOrNaN)
+        {
+            startFrame = std::min(startFrame, position);
+            endFrame = std::max(endFrame, position + hopFrames);
+            if (sounding)
+            {
+                timingSum += timingMs;
+                ++timingHops;
+            }
+            if (!std::isnan(centsOrNaN))
+            {
+                pitchSum += centsOrNaN;
+                pitchErrorSum += std::abs(centsOrNaN);
+                ++pitchHops;
+            }
+        }
+
+        SectionScore finish(const std::string& name) const
+        {
+            SectionScore section;
+            section.name = name;
+            section.startFrame = static_cast<uint64_t>(std::max(0.0, startFrame));
+            section.endFrame = static_cast<uint64_t>(std::max(0.0, endFrame));
+            section.timingHops = timingHops;
+            section.timingMs = timingHops > 0 ? timingSum / static_cast<double>(timingHops) : 0.0;
+            section.pitchHops = pitchHops;
+            section.pitchCents = pitchHops > 0 ? pitchSum / static_cast<double>(pitchHops) : 0.0;
+            section.pitchErrorCents = pitchHops > 0 ? pitchErrorSum / static_cast<double>(pitchHops) : 0.0;
+            return section;
+        }
+    };
+}
+
+namespace TakeAlignment
+{
+    bool computeFeatures(const PcmStore& pcm, double firstFrame, double hopFrames, std::vector<float> notes,
+                         AlignmentFeatures& out, const std::function<bool()>& isCancelled, unsigned int threadCount)
+    {
+        out.hops = notes.size();
+        out.values.assign(AlignmentFeatures::kCount * out.hops, 0.0f);
+        out.notes = std::move(notes);
+        if (out.hops == 0 || pcm.sampleRate() == 0 || pcm.channelCount() == 0 || hopFrames <= 0.0)
+            return true;
+
+        for (size_t hop = 0; hop < out.hops; ++hop)
+            putPitch(out, hop, out.notes[hop]);
+
+        size_t fftSize = 4;
+        while (fftSize < pcm.sampleRate() * kWindowSeconds)
+            fftSize *= 2;
+        ChromaSetup setup(pcm, fftSize);
+        setup.fftSize = fftSize;
+        setup.firstFrame = firstFrame;
+        setup.hopFrames = hopFrames;
+        setup.window.resize(fftSize);
+        for (size_t i = 0; i < fftSize; ++i)
+            setup.window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * i / fftSize));
+        setup.pitchClass.assign(fftSize / 2 + 1, -1);
+        for (size_t k = 1; k < setup.pitchClass.size(); ++k)
+        {
+            const double frequency = static_cast<double>(k) * pcm.sampleRate() / fftSize;
+            if (frequency < kMinChromaHz || frequency > kMaxChromaHz)
+                continue;
+            const long note = std::lround(69.0 + 12.0 * std::log2(frequency / 440.0));
+            setup.pitchClass[k] = static_cast<int8_t>(((note % 12) + 12) % 12);
+        }
+
+        const size_t chunks = (out.hops + kChunkHops - 1) / kChunkHops;
+        std::atomic<size_t> nextChunk{0};
+        std::atomic<bool> cancelled{false};
+        const auto work = [&](bool checkCancelled) {
+            ChromaBuffers buffers;
+            while (!cancelled.load())
+            {
+                const size_t chunk = nextChunk.fetch_add(1);
+                if (chunk >= chunks)
+                    break;
+                const size_t firstHop = chunk * kChunkHops;
+                computeChunk(setup, buffers, firstHop, std::min(out.hops, firstHop + kChunkHops), out);
+                if (checkCancelled && isCancelled && isCancelled())
+                    cancelled.store(true);
+            }
+        };
+
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> workers;
+        for (unsigned int i = 1; i < std::min<size_t>(threadCount, chunks); ++i)
+        {
+            workers.emplace_back([&work]() {
+                RealtimeSupport::configureWorkerThread();
+                Trace::setThreadName("Take features");
+                work(false);
+            });
+        }
+        work(true);
+        for (std::thread& worker : workers)
+            worker.join();
+        return !cancelled.load();
+    }
+
+    bool align(const AlignmentFeatures& take, const AlignmentFeatures& reference, size_t radius,
+               std::vector<float>& path, unsigned int threadCount)
+    {
+        path.clear();
+        if (take.hops == 0 || reference.hops < take.hops + 2 * radius)
+            return false;
+
+        Band band;
+        band.take = &take;
+        band.takeHops = take.hops;
+        band.referenceHops = take.hops + 2 * radius;
+        band.radius = radius;
+        band.width = radius + 1;
+        band.reversed.resize(AlignmentFeatures::kCount * band.referenceHops);
+        for (size_t feature = 0; feature < AlignmentFeatures::kCount; ++feature)
+        {
+            const float* source = reference.row(feature);
+            float* target = band.reversed.data() + feature * band.referenceHops;
+            std::reverse_copy(source, source + band.referenceHops, target);
+        }
+        const int64_t diagonals = static_cast<int64_t>(2 * band.takeHops + 2 * radius - 1);
+        band.costs.assign(3 * (band.width + 2), kInfinity);
+        band.steps.resize(static_cast<size_t>(diagonals) * band.width);
+        band.prepareRow(-2);
+        band.prepareRow(-1);
+
+        // The path ends at the best cell of the last take hop
+        float bestEnd = kInfinity;
+        int64_t bestDiagonal = -1;
+
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        const unsigned int threads = static_cast<unsigned int>(
+            std::max<size_t>(1, std::min<size_t>(threadCount, band.width / kMinCellsPerThread)));
+        SpinBarrier barrier(threads);
+        const auto work = [&](unsigned int thread) {
+            for (int64_t s = 0; s < diagonals; ++s)
+            {
+                int64_t from = 0;
+                int64_t to = 0;
+                band.cells(s, from, to);
+                const int64_t count = to - from + 1;
+                const int64_t sliceFrom = from + count * thread / threads;
+                const int64_t sliceTo = from + count * (thread + 1) / threads - 1;
+                if (thread == 0)
+                    band.prepareRow(s);
+                if (sliceFrom <= sliceTo)
+                    band.computeCells(s, sliceFrom, sliceTo);
+                if (thread + 1 == threads && count > 0 && band.first(s) + to == static_cast<int64_t>(band.takeHops) - 1)
+                {
+                    const float cost = band.row(s)[to + 1];
+                    if (cost < bestEnd)
+                    {
+                        bestEnd = cost;
+                        bestDiagonal = s;
+                    }
+                }
+                if (threads > 1)
+                    barrier.arrive();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned int thread = 1; thread < threads; ++thread)
+        {
+            workers.emplace_back([&work, thread]() {
+                RealtimeSupport::configureWorkerThread();
+                Trace::setThreadName("Take alignment");
+                work(thread);
+            });
+        }
+        work(0);
+        for (std::thread& worker : workers)
+            worker.join();
+        if (bestDiagonal < 0)
+            return false;
+
+        // Back from the end to the virtual take hop -1
+        std::vector<double> sums(band.takeHops, 0.0);
+        std::vector<uint32_t> counts(band.takeHops, 0);
+        int64_t s = bestDiagonal;
+        int64_t i = static_cast<int64_t>(band.takeHops) - 1;
+        while (i >= 0)
+        {
+            sums[static_cast<size_t>(i)] += static_cast<double>(s - i);
+            ++counts[static_cast<size_t>(i)];
+            const uint8_t step = band.steps[static_cast<size_t>(s) * band.width + static_cast<size_t>(i - band.first(s))];
+            if (step != Left)
+                --i;
+            s -= step == Diagonal ? 2 : 1;
+        }
+
+        path.resize(band.takeHops);
+        for (size_t hop = 0; hop < band.takeHops; ++hop)
+            path[hop] = static_cast<float>(sums[hop] / counts[hop]);
+        return true;
+    }
+
+    TakeScore scoreTake(const PcmStore& take, float tempo, uint64_t startFrame, const PcmStore& reference,
+                        const PitchContour& referencePitch, const std::vector<Marker>& markers,
+                        const std::function<bool(float)>& onProgress)
+    {
+        TakeScore score;
+        if (take.empty() || reference.empty() || referencePitch.empty() || tempo <= 0.0f)
+            return score;
+        if (take.sampleRate() != reference.sampleRate())
+        {
+            std::cerr << "TakeAlignment: Take at " << take.sampleRate() << " Hz, track at "
+                      << reference.sampleRate() << " Hz" << std::endl;
+            return score;
+        }
+
+        PitchContour takePitch;
+        if (!PitchDetection::analyze(take, takePitch, [&onProgress](float fraction) {
+                return !onProgress || onProgress(static_cast<float>(kPitchProgress * fraction));
+            }))
+        {
+            return score;
+        }
+
+        // Take hop i was sung to track frame startFrame + i * referenceHop; the reference
+        // features run from radius hops before the take to radius hops after it
+        const size_t hops = takePitch.notes.size();
+        const double hopFrames = takePitch.hopFrames;
+        const double referenceHop = hopFrames * tempo;
+        const size_t radius = std::max<size_t>(1, static_cast<size_t>(std::lround(kBandSeconds * take.sampleRate() / hopFrames)));
+        const double referenceFirst = static_cast<double>(startFrame) - static_cast<double>(radius) * referenceHop;
+        std::vector<float> referenceNotes(hops + 2 * radius, std::numeric_limits<float>::quiet_NaN());
+        for (size_t j = 0; j < referenceNotes.size(); ++j)
+        {
+            const int64_t index = std::llround((referenceFirst + static_cast<double>(j) * referenceHop) / referencePitch.hopFrames);
+            if (index >= 0 && index < static_cast<int64_t>(referencePitch.notes.size()))
+                referenceNotes[j] = referencePitch.notes[static_cast<size_t>(index)];
+        }
+
+        AlignmentFeatures takeFeatures;
+        AlignmentFeatures referenceFeatures;
+        const auto cancelledAt = [&onProgress](double fraction) {
+            return [&onProgress, fraction]() { return onProgress && !onProgress(static_cast<float>(fraction)); };
+        };
+        if (!computeFeatures(take, 0.0, hopFrames, takePitch.notes, takeFeatures,
+                             cancelledAt((kPitchProgress + kFeatureProgress) / 2.0))
+            || !computeFeatures(reference, referenceFirst, referenceHop, referenceNotes, referenceFeatures,
+                                cancelledAt(kFeatureProgress)))
+        {
+            return score;
+        }
+
+        const auto alignStart = std::chrono::steady_clock::now();
+        std::vector<float> path;
+        {
+            Trace::Span span("Align take");
+            if (!align(takeFeatures, referenceFeatures, radius, path))
+                return score;
+        }
+        score.alignMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - alignStart).count();
+
+        // Sections run from one marker to the next; "Start" is everything before the first
+        std::vector<Marker> sorted = markers;
+        std::sort(sorted.begin(), sorted.end(), [](const Marker& a, const Marker& b) { return a.frame < b.frame; });
+        std::vector<Accumulator> sections(sorted.size() + 1);
+        Accumulator overall;
+        const double msPerHop = 1000.0 * hopFrames / take.sampleRate();
+        for (size_t i = 0; i < hops; ++i)
+        {
+            const double position = static_cast<double>(startFrame) + static_cast<double>(i) * referenceHop;
+            const auto next = std::upper_bound(sorted.begin(), sorted.end(), position, [](double frame, const Marker& marker) {
+                return frame < static_cast<double>(marker.frame);
+            });
+
+            // Matched later in the reference than expected: the singer is early
+            const double timingMs = (static_cast<double>(i + radius) - path[i]) * msPerHop;
+            float chroma = 0.0f;
+            for (size_t bin = 0; bin < kChromaBins; ++bin)
+                chroma += takeFeatures.row(bin)[i];
+            const bool sounding = chroma > 0.0f;
+
+            // Octave errors of either detector are not the singer's; a wrong note (or a
+            // reference that followed another voice) says nothing about intonation
+            float cents = std::numeric_limits<float>::quiet_NaN();
+            const float referenceNote = referenceNotes[static_cast<size_t>(std::lround(path[i]))];
+            if (!std::isnan(takePitch.notes[i]) && !std::isnan(referenceNote))
+            {
+                const float semitones = takePitch.notes[i] - referenceNote;
+                const float folded = 100.0f * (semitones - 12.0f * std::round(semitones / 12.0f));
+                if (std::abs(folded) <= kSameNoteCents)
+                    cents = folded;
+            }
+
+            sections[static_cast<size_t>(next - sorted.begin())].add(position, referenceHop, sounding, timingMs, cents);
+            overall.add(position, referenceHop, sounding, timingMs, cents);
+        }
+
+        for (size_t section = 0; section < sections.size(); ++section)
+        {
+            if (std::isfinite(sections[section].startFrame))
+                score.sections.push_back(sections[section].finish(section == 0 ? "Start" : sorted[section - 1].name));
+        }
+        score.overall = overall.finish("Whole take");
+        if (onProgress)
+            onProgress(1.0f);
+        return score;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "PitchDetection.h"
+#include "core/ApplicationState.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class PcmStore;
+
+// Per-hop features that a take and its reference are aligned on, one row per feature
+// (structure of arrays, so the alignment loads four hops at once): the 12 chroma bins as a
+// unit vector, then the pitch class as a point on the unit circle and whether it is voiced.
+struct AlignmentFeatures
+{
+    static constexpr size_t kCount = 15;
+    static constexpr size_t kPitchCos = 12;
+    static constexpr size_t kPitchSin = 13;
+    static constexpr size_t kVoiced = 14;
+
+    size_t hops = 0;
+    std::vector<float> values;  // kCount rows of hops values
+    std::vector<float> notes;   // MIDI note per hop, NaN where unvoiced
+
+    float* row(size_t feature) { return values.data() + feature * hops; }
+    const float* row(size_t feature) const { return values.data() + feature * hops; }
+};
+
+// How a take went in one marker section of the track
+struct SectionScore
+{
+    std::string name;
+    uint64_t startFrame = 0;  // Original frames of the track covered by the take
+    uint64_t endFrame = 0;
+    double timingMs = 0.0;         // Mean offset from the track; positive = late (dragging)
+    size_t timingHops = 0;         // Hops where the take was not silent (0: no timing score)
+    double pitchCents = 0.0;       // Mean deviation from the reference pitch; positive = sharp
+    double pitchErrorCents = 0.0;  // Mean absolute deviation
+    size_t pitchHops = 0;          // Hops where both sang the same note (0: no pitch scores)
+};
+
+struct TakeScore
+{
+    std::vector<SectionScore> sections;
+    SectionScore overall;
+    double alignMs = 0.0;  // Time spent in the alignment itself
+
+    bool empty() const { return sections.empty(); }
+};
+
+namespace TakeAlignment
+{
+    // Features of notes.size() hops of pcm, hop n centred on source frame firstFrame +
+    // n * hopFrames (silent outside the audio); notes are the pitches at those hops. Hops are
+    // spread over threadCount threads (0 = one per core); false if cancelled.
+    bool computeFeatures(const PcmStore& pcm, double firstFrame, double hopFrames, std::vector<float> notes,
+                         AlignmentFeatures& out, const std::function<bool()>& isCancelled = {},
+                         unsigned int threadCount = 0);
+
+    // Dynamic time warping of take against reference within a band: take hop i is expected at
+    // reference hop i + radius and the path may stray radius hops either way, starting and
+    // ending anywhere in the band. Anti-diagonals of the band are computed in turn, four
+    // cells at a time with SSE and split over threads when they are long enough; memory is
+    // three anti-diagonals of costs plus one step byte per band cell. path[i] is the
+    // reference hop matched to take hop i (the mean where the path stays on the take hop).
+    // reference needs take.hops + 2 * radius hops; false if it has fewer.
+    bool align(const AlignmentFeatures& take, const AlignmentFeatures& reference, size_t radius,
+               std::vector<float>& path, unsigned int threadCount = 0);
+
+    // Aligns a take recorded at tempo from original frame startFrame of the reference
+    // (both at the same sample rate) and scores it per marker section. referencePitch is
+    // the reference's contour. Empty if cancelled.
+    TakeScore scoreTake(const PcmStore& take, float tempo, uint64_t startFrame, const PcmStore& reference,
+                        const PitchContour& referencePitch, const std::vector<Marker>& markers,
+                        const std::function<bool(float)>& onProgress);
+}
@@ -0,0 +1,261 @@
+#include "TakeRecorder.h"
+#include "core/Trace.h"
+#include "platform/RealtimeSupport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    constexpr double kRingSeconds = 2.0;     // Disk stall the writer can catch up from
+    constexpr size_t kChunkFrames = 4096;    // Frames per write
+    constexpr std::chrono::milliseconds kIdleWait{10};
+}
+
+TakeRecorder::~TakeRecorder()
+{
+    finishCapture();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool TakeRecorder::start(const std::string& filePath, uint32_t sampleRate, uint32_t outputChannels, bool withBacking)
+{
+    if (m_state.load() != State::Idle || sampleRate == 0 || outputChannels == 0)
+        return false;
+
+    drwav_data_format format{};
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+    format.channels = withBacking ? outputChannels : 1;
+    format.sampleRate = sampleRate;
+    format.bitsPerSample = 32;
+    if (!drwav_init_file_write(&m_wav, filePath.c_str(), &format, nullptr))
+    {
+        std::cerr << "TakeRecorder: Failed to create " << filePath << std::endl;
+        return false;
+    }
+
+    m_take = RecordedTake{};
+    m_take.filePath = filePath;
+    m_take.withBacking = withBacking;
+    m_sampleRate = sampleRate;
+    m_outputChannels = outputChannels;
+    // The input ring also holds the round trip the writer skips
+    m_input.reset(static_cast<size_t>(sampleRate * kRingSeconds * 1.5));
+    m_output.reset(withBacking ? static_cast<size_t>(sampleRate * kRingSeconds) * outputChannels : 0);
+    m_capturedFrames.store(0);
+    m_roundTripFrames.store(0);
+    m_truncated.store(false);
+    m_writerDone.store(false);
+    m_stopRequested.store(false);
+    m_state.store(State::Armed, std::memory_order_release);
+    m_thread = std::thread(&TakeRecorder::run, this);
+    return true;
+}
+
+void TakeRecorder::stop()
+{
+    m_stopRequested.store(true);
+}
+
+void TakeRecorder::finishCapture()
+{
+    const State state = m_state.load();
+    if (state == State::Armed || state == State::Capturing || state == State::Draining)
+        m_state.store(State::Finished, std::memory_order_release);
+}
+
+bool TakeRecorder::isActive() const
+{
+    return m_state.load() != State::Idle;
+}
+
+bool TakeRecorder::isCapturing() const
+{
+    return m_state.load() == State::Capturing;
+}
+
+double TakeRecorder::capturedSeconds() const
+{
+    return m_sampleRate > 0 ? static_cast<double>(m_capturedFrames.load()) / m_sampleRate : 0.0;
+}
+
+size_t TakeRecorder::backlogFrames() const
+{
+    return m_input.readable();
+}
+
+bool TakeRecorder::takeFinished(RecordedTake& out)
+{
+    if (!m_writerDone.load(std::memory_order_acquire))
+        return false;
+    m_thread.join();
+    out = m_take;
+    m_writerDone.store(false);
+    m_state.store(State::Idle);
+    return true;
+}
+
+void TakeRecorder::setLatency(uint32_t inputFrames, uint32_t outputFrames)
+{
+    m_inputLatencyFrames.store(inputFrames);
+    m_outputLatencyFrames.store(outputFrames);
+}
+
+void TakeRecorder::capture(const float* input, const float* output, unsigned int frames, const InputBlockInfo& info)
+{
+    State state = m_state.load(std::memory_order_acquire);
+    if (state == State::Idle || state == State::Finished)
+        return;
+
+    if (state == State::Armed)
+    {
+        if (m_stopRequested.load())
+        {
+            m_state.store(State::Finished, std::memory_order_release);
+            return;
+        }
+        if (!info.playing || input == nullptr)
+            return;
+
+        // This block's output starts the take. What the singer sings over its first frame
+        // reaches us one block plus both device latencies later (see LivePitchTracker).
+        m_epoch = info.epoch;
+        m_inputFrames = 0;
+        m_startFrame.store(info.trackFrame);
+        m_tempo.store(info.tempo);
+        m_roundTripFrames.store(frames + static_cast<uint64_t>(m_inputLatencyFrames.load())
+                                + m_outputLatencyFrames.load());
+        state = State::Capturing;
+        m_state.store(state, std::memory_order_release);
+    }
+
+    if (state == State::Capturing && (!info.playing || info.epoch != m_epoch || m_stopRequested.load() || input == nullptr))
+    {
+        state = State::Draining;
+        m_state.store(state, std::memory_order_release);
+    }
+
+    if (state == State::Capturing)
+    {
+        // Both streams or neither, so the writer can pair them frame by frame
+        const size_t outputSamples = m_take.withBacking ? static_cast<size_t>(frames) * m_outputChannels : 0;
+        if (m_input.writable() < frames || m_output.writable() < outputSamples)
+        {
+            m_truncated.store(true);
+            m_state.store(State::Finished, std::memory_order_release);
+            return;
+        }
+        m_input.write(input, frames);
+        if (outputSamples > 0)
+            m_output.write(output, outputSamples);
+        m_inputFrames += frames;
+        m_capturedFrames.fetch_add(frames, std::memory_order_release);
+        return;
+    }
+
+    // Draining: the input that answers the last captured output is still arriving
+    const uint64_t needed = m_capturedFrames.load(std::memory_order_relaxed) + m_roundTripFrames.load();
+    if (input != nullptr && m_inputFrames < needed)
+    {
+        const size_t count = std::min<uint64_t>(frames, needed - m_inputFrames);
+        m_inputFrames += m_input.write(input, count);
+    }
+    if (input == nullptr || m_inputFrames >= needed || m_input.writable() == 0)
+        m_state.store(State::Finished, std::memory_order_release);
+}
+
+void TakeRecorder::run()
+{
+    RealtimeSupport::configureWorkerThread();
+    Trace::setThreadName("Take writer");
+
+    const bool withBacking = m_take.withBacking;
+    const uint32_t fileChannels = withBacking ? m_outputChannels : 1;
+    std::vector<float> input(kChunkFrames);
+    std::vector<float> output(withBacking ? kChunkFrames * m_outputChannels : 0);
+    std::vector<float> frames(kChunkFrames * fileChannels);
+    uint64_t consumed = 0;    // Output frames taken from the rings
+    uint64_t fileFrames = 0;  // Frames in the file
+    uint64_t skipped = 0;
+    bool failed = false;
+    for (;;)
+    {
+        // Loaded before the rings, so a finished state means they hold everything
+        const State state = m_state.load(std::memory_order_acquire);
+        if (state == State::Armed)
+        {
+            std::this_thread::sleep_for(kIdleWait);
+            continue;
+        }
+
+        // Input captured before the take's first output frame could be heard
+        const uint64_t roundTrip = m_roundTripFrames.load();
+        while (skipped < roundTrip)
+        {
+            const size_t count = m_input.read(input.data(), std::min<uint64_t>(kChunkFrames, roundTrip - skipped));
+            if (count == 0)
+                break;
+            skipped += count;
+        }
+
+        size_t ready = 0;
+        if (skipped == roundTrip)
+        {
+            ready = static_cast<size_t>(std::min<uint64_t>(kChunkFrames, m_capturedFrames.load(std::memory_order_acquire) - consumed));
+            ready = std::min(ready, m_input.readable());
+            if (withBacking)
+                ready = std::min(ready, m_output.readable() / m_outputChannels);
+        }
+        if (ready == 0)
+        {
+            if (state == State::Finished)
+                break;
+            std::this_thread::sleep_for(kIdleWait);
+            continue;
+        }
+
+        Trace::Span span("Write take");
+        m_input.read(input.data(), ready);
+        if (withBacking)
+        {
+            m_output.read(output.data(), ready * m_outputChannels);
+            for (size_t frame = 0; frame < ready; ++frame)
+            {
+                for (uint32_t channel = 0; channel < m_outputChannels; ++channel)
+                {
+                    const size_t index = frame * m_outputChannels + channel;
+                    frames[index] = output[index] + input[frame];
+                }
+            }
+        }
+        else
+        {
+            std::copy_n(input.begin(), ready, frames.begin());
+        }
+        consumed += ready;
+
+        // After a failed write the rings are still emptied so the callback never stalls
+        if (!failed && drwav_write_pcm_frames(&m_wav, ready, frames.data()) != ready)
+        {
+            std::cerr << "TakeRecorder: Failed to write " << m_take.filePath << std::endl;
+            failed = true;
+            m_truncated.store(true);
+        }
+        if (!failed)
+            fileFrames += ready;
+    }
+
+    drwav_uninit(&m_wav);
+    if (fileFrames == 0)
+        std::remove(m_take.filePath.c_str());
+
+    m_take.startFrame = m_startFrame.load();
+    m_take.tempo = m_tempo.load();
+    m_take.frameCount = fileFrames;
+    m_take.truncated = m_truncated.load();
+    m_writerDone.store(true, std::memory_order_release);
+}
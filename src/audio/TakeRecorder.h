@@ -0,0 +1,94 @@
+#pragma once
+
+#include "InputBlockInfo.h"
+#include "core/SpscRing.h"
+#include "dr_wav.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// A practice take written by TakeRecorder and where it belongs on the track
+struct RecordedTake
+{
+    std::string filePath;
+    uint64_t startFrame = 0;   // Original track frame heard with the take's first frame
+    float tempo = 1.0f;        // Tempo multiplier it was sung to; it only lines up at that tempo
+    uint64_t frameCount = 0;   // 0 when nothing was captured (the file is removed)
+    bool withBacking = false;  // The output was mixed in, so the take holds the track too
+    bool truncated = false;    // The writer fell behind by more than its rings hold
+};
+
+// Records the microphone while the track plays, optionally mixed with the output, into a
+// 32-bit float WAV file. The audio callback only copies blocks into rings allocated by
+// start(); a writer thread streams them to disk through dr_wav, so a take of any length
+// needs a few seconds of memory. The take starts with the first block that plays the track
+// and ends when playback pauses or jumps. The input is shifted by the stream's round trip,
+// so each frame holds what the singer sang while hearing the output frame beside it.
+class TakeRecorder
+{
+public:
+    TakeRecorder() = default;
+    ~TakeRecorder();
+    TakeRecorder(const TakeRecorder&) = delete;
+    TakeRecorder& operator=(const TakeRecorder&) = delete;
+
+    // Creates the file and arms the recorder for the next playing block; false while a
+    // previous take is still being written or collected
+    bool start(const std::string& filePath, uint32_t sampleRate, uint32_t outputChannels, bool withBacking);
+    // Ends the take after the input answering its last output frames has arrived
+    void stop();
+    // Ends the take right away; call once the callback no longer runs
+    void finishCapture();
+    // Armed, capturing or writing out the rest
+    bool isActive() const;
+    bool isCapturing() const;
+    double capturedSeconds() const;
+    // Input frames waiting for the writer
+    size_t backlogFrames() const;
+    // Once the file is complete: fills out, returns true and makes the recorder idle again
+    bool takeFinished(RecordedTake& out);
+    // Device latencies of the stream, known once it runs
+    void setLatency(uint32_t inputFrames, uint32_t outputFrames);
+
+    // Audio callback, after the output block is rendered: info describes the block as it
+    // was before rendering, with playing cleared if the position jumped meanwhile. Never
+    // blocks; if the writer is a full ring behind, the take ends there.
+    void capture(const float* input, const float* output, unsigned int frames, const InputBlockInfo& info);
+
+private:
+    enum class State
+    {
+        Idle,
+        Armed,      // Waiting for a playing block
+        Capturing,
+        Draining,   // Collecting the input that answers the last captured output
+        Finished    // Nothing more comes from the callback; the writer empties the rings
+    };
+
+    void run();
+
+    std::atomic<State> m_state{State::Idle};
+    std::atomic<bool> m_stopRequested{false};
+    std::atomic<uint32_t> m_inputLatencyFrames{0};
+    std::atomic<uint32_t> m_outputLatencyFrames{0};
+    std::thread m_thread;
+    drwav m_wav{};
+    RecordedTake m_take;  // Written by start() and the writer thread
+    uint32_t m_sampleRate = 0;
+    uint32_t m_outputChannels = 0;
+
+    // Audio callback -> writer thread: input frames and, with the backing, output frames
+    SpscRing<float> m_input;
+    SpscRing<float> m_output;
+    std::atomic<uint64_t> m_capturedFrames{0};   // Output frames in the take so far
+    std::atomic<uint64_t> m_roundTripFrames{0};  // Input frames ahead of the first output frame
+    std::atomic<uint64_t> m_startFrame{0};
+    std::atomic<float> m_tempo{1.0f};
+    std::atomic<bool> m_truncated{false};
+    std::atomic<bool> m_writerDone{false};
+
+    // Audio callback only
+    uint64_t m_epoch = 0;
+    uint64_t m_inputFrames = 0;
+};
@@ -0,0 +1,53 @@
+#include "TimeMap.h"
+#include <algorithm>
+
+namespace
+{
+    // Maps position on one axis to the other by the segment around it; past the last anchor
+    // the position clamps to the end
+    template <uint64_t TimeMap::Anchor::*From, uint64_t TimeMap::Anchor::*To>
+    uint64_t mapPosition(const std::vector<TimeMap::Anchor>& anchors, uint64_t position)
+    {
+        const auto after = std::upper_bound(anchors.begin(), anchors.end(), position,
+                                            [](uint64_t value, const TimeMap::Anchor& anchor) {
+                                                return value < anchor.*From;
+                                            });
+        if (after == anchors.end())
+            return anchors.back().*To;
+
+        const TimeMap::Anchor& before = *(after - 1);
+        const uint64_t span = (*after).*From - before.*From;
+        const uint64_t mappedSpan = (*after).*To - before.*To;
+        // Segments are one chunk long, so the product stays far below 2^64
+        return before.*To + ((position - before.*From) * mappedSpan + span / 2) / span;
+    }
+}
+
+void TimeMap::clear()
+{
+    m_anchors.clear();
+}
+
+void TimeMap::addAnchor(uint64_t originalFrame, uint64_t processedFrame)
+{
+    if (m_anchors.empty())
+        m_anchors.push_back({0, 0});
+
+    const Anchor& last = m_anchors.back();
+    if (originalFrame > last.originalFrame && processedFrame > last.processedFrame)
+        m_anchors.push_back({originalFrame, processedFrame});
+}
+
+uint64_t TimeMap::toProcessed(uint64_t originalFrame) const
+{
+    if (m_anchors.empty())
+        return originalFrame;
+    return mapPosition<&Anchor::originalFrame, &Anchor::processedFrame>(m_anchors, originalFrame);
+}
+
+uint64_t TimeMap::toOriginal(uint64_t processedFrame) const
+{
+    if (m_anchors.empty())
+        return processedFrame;
+    return mapPosition<&Anchor::processedFrame, &Anchor::originalFrame>(m_anchors, processedFrame);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Correspondence between original and time-stretched frame positions, recorded while
+// stretching: one anchor per chunk fed to SoundTouch, pairing the input frames it had
+// consumed with the output frames it had produced. Positions between anchors are
+// interpolated in integer arithmetic, so they follow the stretched audio actually
+// produced rather than drifting from it as a nominal "frames / tempo" does over a long
+// track. An empty map is the identity (1x). Lookups do not allocate.
+class TimeMap
+{
+public:
+    struct Anchor
+    {
+        uint64_t originalFrame;
+        uint64_t processedFrame;
+    };
+
+    void clear();
+    // Anchors must grow on both axes; others are ignored (SoundTouch emits output in bursts)
+    void addAnchor(uint64_t originalFrame, uint64_t processedFrame);
+
+    bool isIdentity() const { return m_anchors.empty(); }
+    uint64_t toProcessed(uint64_t originalFrame) const;
+    uint64_t toOriginal(uint64_t processedFrame) const;
+
+    void swap(TimeMap& other) noexcept { m_anchors.swap(other.m_anchors); }
+    size_t memoryUsageBytes() const { return m_anchors.capacity() * sizeof(Anchor); }
+
+private:
+    std::vector<Anchor> m_anchors;  // Starts at (0, 0) once non-empty
+};
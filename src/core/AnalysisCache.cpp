@@ -0,0 +1,97 @@
+#include "AnalysisCache.h"
+#include "BinaryIO.h"
+#include "Utils.h"
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    constexpr char kCacheMagic[8] = {'S', 'P', 'C', 'A', 'C', 'H', 'E', '1'};
+    constexpr const char* kCacheDirectory = "songpractice-analysis";
+
+    bool statFile(const std::string& path, uint64_t& size, int64_t& modifiedTime)
+    {
+        std::error_code error;
+        const auto fileSize = std::filesystem::file_size(path, error);
+        if (error)
+            return false;
+        const auto writeTime = std::filesystem::last_write_time(path, error);
+        if (error)
+            return false;
+        size = static_cast<uint64_t>(fileSize);
+        modifiedTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+        return true;
+    }
+
+    std::string cacheFilePath(const std::string& audioPath, const char* kind, uint32_t sampleRate)
+    {
+        uint64_t hash = 14695981039346656037ull;  // FNV-1a
+        for (const char c : audioPath)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        char name[64];
+        std::snprintf(name, sizeof(name), "%016llx-%u.%s", static_cast<unsigned long long>(hash), sampleRate, kind);
+        return Utils::getExecutableDirectory() + "/" + kCacheDirectory + "/" + name;
+    }
+}
+
+namespace AnalysisCache
+{
+    bool load(const std::string& audioPath, const char* kind, uint32_t sampleRate, std::string& payload)
+    {
+        std::ifstream file(cacheFilePath(audioPath, kind, sampleRate), std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < sizeof(kCacheMagic) || std::memcmp(data.data(), kCacheMagic, sizeof(kCacheMagic)) != 0)
+            return false;
+
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+        if (!statFile(audioPath, size, modifiedTime))
+            return false;
+
+        // A hash collision or a changed file both make the entry stale
+        BinaryIO::Reader reader(data);
+        reader.get<std::array<char, sizeof(kCacheMagic)>>();
+        if (reader.getString() != kind || reader.getString() != audioPath || reader.get<uint64_t>() != size
+            || reader.get<int64_t>() != modifiedTime || reader.get<uint32_t>() != sampleRate || !reader.ok())
+            return false;
+
+        payload = data.substr(reader.position());
+        return true;
+    }
+
+    bool store(const std::string& audioPath, const char* kind, uint32_t sampleRate, const std::string& payload)
+    {
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+        if (!statFile(audioPath, size, modifiedTime))
+            return false;
+
+        std::string data(kCacheMagic, sizeof(kCacheMagic));
+        BinaryIO::putString(data, kind);
+        BinaryIO::putString(data, audioPath);
+        BinaryIO::put(data, size);
+        BinaryIO::put(data, modifiedTime);
+        BinaryIO::put(data, sampleRate);
+        data += payload;
+
+        const std::string path = cacheFilePath(audioPath, kind, sampleRate);
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+        if (error || !Utils::writeFileAtomically(path, data))
+        {
+            std::cerr << "AnalysisCache: Could not write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
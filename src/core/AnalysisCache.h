@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Results of track analyses (beats, pitch) in a directory next to the executable, one file
+// per track, kind and sample rate. An entry is only returned while the audio file keeps
+// the size and modification time it had when the entry was stored.
+namespace AnalysisCache
+{
+    // Payload stored for the track; false when there is none or it is stale
+    bool load(const std::string& audioPath, const char* kind, uint32_t sampleRate, std::string& payload);
+    bool store(const std::string& audioPath, const char* kind, uint32_t sampleRate, const std::string& payload);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "core/Trace.h"
+#include "platform/RealtimeSupport.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+// One background analysis of the loaded track (beats, pitch contour), owned and polled by
+// the UI thread. Starting another track's analysis cancels the running one.
+template <typename Result>
+class AnalysisJob
+{
+public:
+    // Reports progress (0..1) from the worker; returns false once the job is cancelled
+    using Progress = std::function<bool(float)>;
+    using Work = std::function<Result(const Progress&)>;
+
+    explicit AnalysisJob(const char* name) : m_name(name) {}
+    ~AnalysisJob() { cancel(); }
+    AnalysisJob(const AnalysisJob&) = delete;
+    AnalysisJob& operator=(const AnalysisJob&) = delete;
+
+    // Called from the worker when a result is ready, so the UI can wake up to collect it
+    void setWakeCallback(std::function<void()> wake) { m_wake = std::move(wake); }
+
+    // Replaces the result with what work returns for audioPath; work runs on a worker thread
+    void start(const std::string& audioPath, Work work)
+    {
+        cancel();
+        m_audioPath = audioPath;
+        m_result = Result{};
+
+        m_cancelled = std::make_shared<std::atomic<bool>>(false);
+        m_progress = std::make_shared<std::atomic<float>>(0.0f);
+        m_pending = std::async(std::launch::async, [name = m_name, audioPath, work = std::move(work),
+                                                    cancelled = m_cancelled, progress = m_progress, wake = m_wake]() {
+            RealtimeSupport::configureWorkerThread();
+            Trace::setThreadName(name);
+            Trace::Span span(name, audioPath.c_str());
+
+            Result result = work([&](float fraction) {
+                progress->store(fraction);
+                return !cancelled->load();
+            });
+            progress->store(1.0f);
+            if (wake)
+                wake();
+            return result;
+        });
+    }
+
+    void clear()
+    {
+        cancel();
+        m_audioPath.clear();
+        m_result = Result{};
+    }
+
+    // Collects a finished job; returns true when result() changed
+    bool update()
+    {
+        if (!m_pending.valid() || m_pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+        m_result = m_pending.get();
+        return true;
+    }
+
+    bool isRunning() const { return m_pending.valid(); }
+    float progress() const { return m_progress ? m_progress->load() : 0.0f; }
+    // Track of result(), or of the job in progress
+    const std::string& audioPath() const { return m_audioPath; }
+    const Result& result() const { return m_result; }
+
+private:
+    void cancel()
+    {
+        // Work checks its progress callback often, so this waits milliseconds at most
+        if (m_cancelled)
+            m_cancelled->store(true);
+        if (m_pending.valid())
+            m_pending.wait();
+        m_pending = {};
+    }
+
+    const char* m_name;
+    std::function<void()> m_wake;
+    std::string m_audioPath;
+    Result m_result;
+    std::future<Result> m_pending;
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+    std::shared_ptr<std::atomic<float>> m_progress;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include "FrameTime.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Marker
+{
+    std::string name;
+    uint64_t frame = 0;  // At ApplicationState::sampleRate
+};
+
+// Metronome grid of a track: beats at a constant tempo through a known downbeat
+struct BeatGrid
+{
+    double bpm = 0.0;             // 0 = no grid
+    uint64_t firstBeatFrame = 0;  // A downbeat, at ApplicationState::sampleRate
+    uint32_t beatsPerBar = 4;
+
+    bool isValid() const { return bpm > 0.0; }
+};
+
+// A practice take recorded over the track
+struct Take
+{
+    std::string filePath;      // WAV file at the track's playback rate
+    uint64_t startFrame = 0;   // Track frame heard with the take's first frame, at ApplicationState::sampleRate
+    float tempo = 1.0f;        // Tempo multiplier it was recorded at
+    double durationSeconds = 0.0;
+    bool withBacking = false;  // Holds the track mixed in
+};
+
+struct ApplicationState
+{
+    std::vector<Marker> markers;  // Kept sorted by frame
+    std::string soundFilePath;
+    uint64_t playPositionFrame = 0;
+    // Rate the frame positions count at: the playback rate of the track when they were taken
+    uint32_t sampleRate = FrameTime::kDefaultSampleRate;
+    float tempoMultiplier = 1.0f;  // 1.0 = normal speed, 0.5 = half speed, 2.0 = double speed
+    BeatGrid beatGrid;
+    std::vector<Take> takes;  // Oldest first
+
+    double toSeconds(uint64_t frame) const { return FrameTime::toSeconds(frame, sampleRate); }
+    uint64_t toFrame(double seconds) const { return FrameTime::fromSeconds(seconds, sampleRate); }
+
+    // Moves all positions to frames at newRate (a track played back at another device rate)
+    void convertToSampleRate(uint32_t newRate)
+    {
+        if (newRate == 0 || newRate == sampleRate)
+            return;
+        for (Marker& marker : markers)
+            marker.frame = FrameTime::rescale(marker.frame, sampleRate, newRate);
+        playPositionFrame = FrameTime::rescale(playPositionFrame, sampleRate, newRate);
+        beatGrid.firstBeatFrame = FrameTime::rescale(beatGrid.firstBeatFrame, sampleRate, newRate);
+        for (Take& take : takes)
+            take.startFrame = FrameTime::rescale(take.startFrame, sampleRate, newRate);
+        sampleRate = newRate;
+    }
+};
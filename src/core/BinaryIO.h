@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Little-endian helpers for the app's binary files (library index, analysis cache).
+// Values are copied as they are laid out in memory, which is little-endian on every
+// supported platform.
+namespace BinaryIO
+{
+    template <typename T>
+    void put(std::string& out, T value)
+    {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    // Length-prefixed (uint16); longer strings are truncated
+    inline void putString(std::string& out, const std::string& value)
+    {
+        const uint16_t length = static_cast<uint16_t>(std::min<size_t>(value.size(), UINT16_MAX));
+        put(out, length);
+        out.append(value.data(), length);
+    }
+
+    // Reads what put()/putString() wrote. Reading past the end yields zero values and
+    // clears ok(), so a file can be parsed first and validated once.
+    class Reader
+    {
+    public:
+        explicit Reader(const std::string& data) : m_data(data) {}
+
+        template <typename T>
+        T get()
+        {
+            T value{};
+            if (m_offset + sizeof(T) > m_data.size())
+            {
+                m_ok = false;
+                return value;
+            }
+            std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+            m_offset += sizeof(T);
+            return value;
+        }
+
+        std::string getString()
+        {
+            const uint16_t length = get<uint16_t>();
+            if (!m_ok || m_offset + length > m_data.size())
+            {
+                m_ok = false;
+                return {};
+            }
+            std::string value = m_data.substr(m_offset, length);
+            m_offset += length;
+            return value;
+        }
+
+        bool ok() const { return m_ok; }
+        // Bytes consumed so far
+        size_t position() const { return m_offset; }
+        // Bytes left; bounds record counts read from the data before anything is allocated
+        size_t remaining() const { return m_data.size() - m_offset; }
+
+    private:
+        const std::string& m_data;
+        size_t m_offset = 0;
+        bool m_ok = true;
+    };
+}
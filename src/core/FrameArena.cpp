@@ -0,0 +1,37 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+FrameArena::FrameArena(size_t capacity)
+    : m_buffer(new char[capacity]),
+      m_capacity(capacity)
+{
+}
+
+void FrameArena::reset()
+{
+    m_used = 0;
+}
+
+const char* FrameArena::format(const char* fmt, ...)
+{
+    const size_t available = m_capacity - m_used;
+    if (available == 0)
+        return "";
+
+    char* text = m_buffer.get() + m_used;
+    va_list args;
+    va_start(args, fmt);
+    const int length = std::vsnprintf(text, available, fmt, args);
+    va_end(args);
+    if (length < 0)
+    {
+        text[0] = '\0';
+        return text;
+    }
+
+    // Truncated text still takes up the rest of the buffer, terminator included
+    m_used += std::min(static_cast<size_t>(length) + 1, available);
+    return text;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+// Scratch space for text that only has to live until the end of the frame, e.g. status
+// bar strings. The buffer is allocated once; reset() at the start of each frame makes it
+// reusable. Text that no longer fits is truncated rather than allocated.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity = 16 * 1024);
+
+    void reset();
+
+    // printf-style; the result stays valid until the next reset()
+    const char* format(const char* fmt, ...)
+#if defined(__GNUC__) || defined(__clang__)
+        __attribute__((format(printf, 2, 3)))
+#endif
+        ;
+
+    size_t used() const { return m_used; }
+    size_t capacity() const { return m_capacity; }
+
+private:
+    std::unique_ptr<char[]> m_buffer;
+    size_t m_capacity;
+    size_t m_used = 0;
+};
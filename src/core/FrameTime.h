@@ -0,0 +1,30 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// Positions are counted in frames at a sample rate; seconds are derived for display and
+// for text formats that store them
+namespace FrameTime
+{
+    // Rate for positions saved in seconds by older versions, and before any track is loaded
+    constexpr uint32_t kDefaultSampleRate = 48000;
+
+    inline double toSeconds(uint64_t frame, uint32_t sampleRate)
+    {
+        return sampleRate > 0 ? static_cast<double>(frame) / sampleRate : 0.0;
+    }
+
+    // Nearest frame; negative times give frame 0
+    inline uint64_t fromSeconds(double seconds, uint32_t sampleRate)
+    {
+        return seconds > 0.0 ? static_cast<uint64_t>(std::llround(seconds * sampleRate)) : 0;
+    }
+
+    // Nearest frame at another rate; exact when the rates are equal
+    inline uint64_t rescale(uint64_t frame, uint32_t fromRate, uint32_t toRate)
+    {
+        if (fromRate == toRate || fromRate == 0)
+            return frame;
+        return (frame * toRate + fromRate / 2) / fromRate;
+    }
+}
@@ -0,0 +1,26 @@
+#include "MarkerIndex.h"
+#include "ApplicationState.h"
+#include <algorithm>
+
+void MarkerIndex::rebuild(const std::vector<Marker>& markers)
+{
+    m_frames.resize(markers.size());
+    for (size_t i = 0; i < markers.size(); ++i)
+        m_frames[i] = markers[i].frame;
+}
+
+int MarkerIndex::indexAtOrBefore(uint64_t frame) const
+{
+    const auto it = std::upper_bound(m_frames.begin(), m_frames.end(), frame);
+    return static_cast<int>(it - m_frames.begin()) - 1;
+}
+
+size_t MarkerIndex::size() const
+{
+    return m_frames.size();
+}
+
+bool MarkerIndex::empty() const
+{
+    return m_frames.empty();
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Marker;
+
+// Contiguous copy of the (sorted) marker frames, giving O(log n) lookups
+// without touching the marker names.
+class MarkerIndex
+{
+public:
+    // Markers must already be sorted by frame
+    void rebuild(const std::vector<Marker>& markers);
+
+    // Index of the last marker at or before frame, -1 if there is none
+    int indexAtOrBefore(uint64_t frame) const;
+
+    size_t size() const;
+    bool empty() const;
+
+private:
+    std::vector<uint64_t> m_frames;
+};
@@ -0,0 +1,139 @@
+#include "MemoryBudget.h"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    size_t index(MemoryCategory category)
+    {
+        return static_cast<size_t>(category);
+    }
+}
+
+const char* MemoryBudget::categoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::OriginalAudio:
+        return "Original";
+    case MemoryCategory::PlaybackAudio:
+        return "Playback";
+    case MemoryCategory::Scratch:
+        return "Scratch";
+    case MemoryCategory::NextTrack:
+        return "Next";
+    case MemoryCategory::Waveform:
+        return "Waveform";
+    case MemoryCategory::Count:
+        break;
+    }
+    return "";
+}
+
+void MemoryBudget::setLimit(size_t bytes)
+{
+    m_limit.store(bytes);
+}
+
+size_t MemoryBudget::limit() const
+{
+    return m_limit.load();
+}
+
+void MemoryBudget::setUsage(MemoryCategory category, size_t bytes)
+{
+    m_usage[index(category)].store(bytes);
+}
+
+void MemoryBudget::add(MemoryCategory category, size_t bytes)
+{
+    m_usage[index(category)].fetch_add(bytes);
+}
+
+void MemoryBudget::release(MemoryCategory category, size_t bytes)
+{
+    std::atomic<size_t>& usage = m_usage[index(category)];
+    size_t current = usage.load();
+    while (!usage.compare_exchange_weak(current, current - std::min(current, bytes)))
+    {
+    }
+}
+
+size_t MemoryBudget::usage(MemoryCategory category) const
+{
+    return m_usage[index(category)].load();
+}
+
+size_t MemoryBudget::totalUsage() const
+{
+    size_t total = 0;
+    for (const std::atomic<size_t>& usage : m_usage)
+        total += usage.load();
+    return total;
+}
+
+size_t MemoryBudget::available() const
+{
+    const size_t total = totalUsage();
+    const size_t limitBytes = limit();
+    return (total < limitBytes) ? limitBytes - total : 0;
+}
+
+bool MemoryBudget::isOverBudget() const
+{
+    return totalUsage() > limit();
+}
+
+void MemoryBudget::setSpilledBytes(size_t bytes)
+{
+    m_spilledBytes.store(bytes);
+}
+
+size_t MemoryBudget::spilledBytes() const
+{
+    return m_spilledBytes.load();
+}
+
+void MemoryBudget::addReclaimer(int cost, std::string name, Reclaimer reclaimer)
+{
+    Entry entry;
+    entry.cost = cost;
+    entry.name = std::move(name);
+    entry.reclaim = std::move(reclaimer);
+
+    const auto position = std::upper_bound(m_reclaimers.begin(), m_reclaimers.end(), cost,
+                                           [](int value, const Entry& other) { return value < other.cost; });
+    m_reclaimers.insert(position, std::move(entry));
+}
+
+size_t MemoryBudget::enforce(size_t headroomBytes)
+{
+    const auto fits = [this, headroomBytes]() { return totalUsage() + headroomBytes <= limit(); };
+    if (fits())
+    {
+        m_exhausted = false;
+        return 0;
+    }
+
+    size_t releasedTotal = 0;
+    for (Entry& entry : m_reclaimers)
+    {
+        // A reclaimer may give memory back in steps (e.g. one waveform level at a time)
+        size_t released = 0;
+        while (!fits() && (released = entry.reclaim()) > 0)
+        {
+            releasedTotal += released;
+            std::cout << "MemoryBudget: " << entry.name << " released " << (released >> 20) << " MiB" << std::endl;
+        }
+        if (fits())
+            break;
+    }
+
+    if (!fits() && !m_exhausted)
+    {
+        m_exhausted = true;
+        std::cerr << "MemoryBudget: " << (totalUsage() >> 20) << " MiB in use, limit " << (limit() >> 20)
+                  << " MiB; nothing left to reclaim" << std::endl;
+    }
+    return releasedTotal;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class MemoryCategory
+{
+    OriginalAudio,   // Decoded PCM of the loaded track (source for stretching and the waveform)
+    PlaybackAudio,   // Buffer the audio callback reads; never reclaimed
+    Scratch,         // Buffers of background decode and tempo jobs until they are handed over
+    NextTrack,       // Preloaded setlist song
+    Waveform,        // Envelope pyramids
+    Count
+};
+
+// Accounts the large PCM-derived allocations against one configurable limit.
+// Usage may be reported from any thread. When the total exceeds the limit,
+// enforce() asks the registered reclaimers, cheapest first, to drop derived data
+// (rebuilt when needed again) or spill it to disk until the total fits again.
+class MemoryBudget
+{
+public:
+    // Frees some memory and returns the number of bytes released (0 when nothing is left)
+    using Reclaimer = std::function<size_t()>;
+
+    static constexpr size_t DEFAULT_LIMIT = size_t(2048) << 20;
+    static const char* categoryName(MemoryCategory category);
+
+    void setLimit(size_t bytes);
+    size_t limit() const;
+
+    // Owners either report their current total or adjust it by deltas, not both
+    void setUsage(MemoryCategory category, size_t bytes);
+    void add(MemoryCategory category, size_t bytes);
+    void release(MemoryCategory category, size_t bytes);
+    size_t usage(MemoryCategory category) const;
+    size_t totalUsage() const;
+    size_t available() const;
+    bool isOverBudget() const;
+
+    // Data moved out of memory into temporary files; not counted against the limit
+    void setSpilledBytes(size_t bytes);
+    size_t spilledBytes() const;
+
+    // Lower cost runs first. Call enforce() from the thread that owns the reclaimed data.
+    void addReclaimer(int cost, std::string name, Reclaimer reclaimer);
+    // Reclaims until totalUsage() + headroomBytes fits the limit; returns the bytes released
+    size_t enforce(size_t headroomBytes = 0);
+
+private:
+    struct Entry
+    {
+        int cost = 0;
+        std::string name;
+        Reclaimer reclaim;
+    };
+
+    std::array<std::atomic<size_t>, static_cast<size_t>(MemoryCategory::Count)> m_usage{};
+    std::atomic<size_t> m_limit{DEFAULT_LIMIT};
+    std::atomic<size_t> m_spilledBytes{0};
+    std::vector<Entry> m_reclaimers;  // Sorted by cost
+    bool m_exhausted = false;         // Over the limit with nothing left to reclaim (logged once)
+};
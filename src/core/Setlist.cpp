@@ -0,0 +1,152 @@
+#include "Setlist.h"
+#include "Utils.h"
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include <iostream>
+
+using json = nlohmann::json;
+
+bool Setlist::loadFromFile(const std::string& filePath)
+{
+    try
+    {
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            logError("Failed to open setlist file: " + filePath);
+            return false;
+        }
+
+        const json j = json::parse(file);
+        const auto it = j.find("entries");
+        if (it == j.end() || !it->is_array())
+        {
+            logError("No entries in setlist file: " + filePath);
+            return false;
+        }
+
+        std::vector<SetlistEntry> entries;
+        entries.reserve(it->size());
+        for (const auto& entryJson : *it)
+        {
+            SetlistEntry entry;
+            entry.audioPath = entryJson.value("audio", std::string());
+            entry.settingsPath = entryJson.value("settings", std::string());
+            if (!entry.audioPath.empty())
+                entries.push_back(std::move(entry));
+        }
+
+        m_entries = std::move(entries);
+        m_currentIndex = -1;
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        logError("Failed to parse setlist file " + filePath + ": " + e.what());
+        return false;
+    }
+}
+
+bool Setlist::saveToFile(const std::string& filePath) const
+{
+    try
+    {
+        json entriesJson = json::array();
+        for (const SetlistEntry& entry : m_entries)
+        {
+            json entryJson;
+            entryJson["audio"] = entry.audioPath;
+            if (!entry.settingsPath.empty())
+                entryJson["settings"] = entry.settingsPath;
+            entriesJson.push_back(std::move(entryJson));
+        }
+
+        json j;
+        j["entries"] = std::move(entriesJson);
+        if (!Utils::writeFileAtomically(filePath, j.dump(4)))
+        {
+            logError("Failed to write setlist file: " + filePath);
+            return false;
+        }
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        logError("Failed to save setlist file " + filePath + ": " + e.what());
+        return false;
+    }
+}
+
+const std::vector<SetlistEntry>& Setlist::entries() const
+{
+    return m_entries;
+}
+
+bool Setlist::empty() const
+{
+    return m_entries.empty();
+}
+
+void Setlist::add(SetlistEntry entry)
+{
+    m_entries.push_back(std::move(entry));
+}
+
+void Setlist::remove(size_t index)
+{
+    if (index >= m_entries.size())
+        return;
+
+    m_entries.erase(m_entries.begin() + static_cast<std::ptrdiff_t>(index));
+    if (m_currentIndex == static_cast<int>(index))
+        m_currentIndex = -1;
+    else if (m_currentIndex > static_cast<int>(index))
+        --m_currentIndex;
+}
+
+void Setlist::move(size_t from, size_t to)
+{
+    if (from >= m_entries.size() || to >= m_entries.size() || from == to)
+        return;
+
+    SetlistEntry entry = std::move(m_entries[from]);
+    m_entries.erase(m_entries.begin() + static_cast<std::ptrdiff_t>(from));
+    m_entries.insert(m_entries.begin() + static_cast<std::ptrdiff_t>(to), std::move(entry));
+
+    // Keep following the entry that is playing
+    const int current = m_currentIndex;
+    if (current == static_cast<int>(from))
+        m_currentIndex = static_cast<int>(to);
+    else if (from < to && current > static_cast<int>(from) && current <= static_cast<int>(to))
+        --m_currentIndex;
+    else if (to < from && current >= static_cast<int>(to) && current < static_cast<int>(from))
+        ++m_currentIndex;
+}
+
+void Setlist::clear()
+{
+    m_entries.clear();
+    m_currentIndex = -1;
+}
+
+int Setlist::currentIndex() const
+{
+    return m_currentIndex;
+}
+
+void Setlist::setCurrentIndex(int index)
+{
+    m_currentIndex = (index >= 0 && index < static_cast<int>(m_entries.size())) ? index : -1;
+}
+
+int Setlist::nextIndex() const
+{
+    if (m_currentIndex < 0 || m_currentIndex + 1 >= static_cast<int>(m_entries.size()))
+        return -1;
+    return m_currentIndex + 1;
+}
+
+void Setlist::logError(const std::string& message) const
+{
+    std::cerr << "Setlist Error: " << message << std::endl;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct SetlistEntry
+{
+    std::string audioPath;
+    std::string settingsPath;  // Optional .songpractice.json with markers and tempo
+};
+
+// Ordered list of songs for a rehearsal, saved as "<name>.songpractice-setlist.json"
+class Setlist
+{
+public:
+    bool loadFromFile(const std::string& filePath);
+    bool saveToFile(const std::string& filePath) const;
+
+    const std::vector<SetlistEntry>& entries() const;
+    bool empty() const;
+    void add(SetlistEntry entry);
+    void remove(size_t index);
+    void move(size_t from, size_t to);
+    void clear();
+
+    // Entry being played, -1 when playback is not following the setlist
+    int currentIndex() const;
+    void setCurrentIndex(int index);
+    // Entry after the current one, -1 at the end of the setlist
+    int nextIndex() const;
+
+    static constexpr const char* FILE_EXTENSION = ".songpractice-setlist.json";
+
+private:
+    void logError(const std::string& message) const;
+
+    std::vector<SetlistEntry> m_entries;
+    int m_currentIndex = -1;
+};
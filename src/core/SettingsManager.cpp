@@ -1,7 +1,9 @@
 #include "SettingsManager.h"
-#include "ui/MainWindow.h"  // For ApplicationState and Marker structs
+#include "ApplicationState.h"
+#include "Trace.h"
 #include "Utils.h"
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <filesystem>
@@ -9,8 +11,22 @@
 
 using json = nlohmann::json;
 
-SettingsManager::SettingsManager() = default;
-SettingsManager::~SettingsManager() = default;
+SettingsManager::SettingsManager()
+{
+    m_worker = std::thread(&SettingsManager::persistenceWorker, this);
+}
+
+SettingsManager::~SettingsManager()
+{
+    // The worker drains every pending save before exiting
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_stopping = true;
+    }
+    m_queueChanged.notify_all();
+    if (m_worker.joinable())
+        m_worker.join();
+}
 
 bool SettingsManager::loadGlobalSettings(ApplicationState& state)
 {
@@ -28,7 +44,7 @@ bool SettingsManager::loadGlobalSettings(ApplicationState& state)
 
 bool SettingsManager::saveGlobalSettings(const ApplicationState& state)
 {
-    return saveSettingsToFile(getGlobalSettingsPath(), state);
+    return saveAndWait(getGlobalSettingsPath(), state);
 }
 
 bool SettingsManager::loadTrackSettings(const std::string& settingsFilePath, ApplicationState& state)
@@ -38,7 +54,25 @@ bool SettingsManager::loadTrackSettings(const std::string& settingsFilePath, App
 
 bool SettingsManager::saveTrackSettings(const std::string& settingsFilePath, const ApplicationState& state)
 {
-    return saveSettingsToFile(settingsFilePath, state);
+    return saveAndWait(settingsFilePath, state);
+}
+
+void SettingsManager::saveGlobalSettingsAsync(const ApplicationState& state)
+{
+    enqueueSave(getGlobalSettingsPath(), state, false);
+}
+
+void SettingsManager::saveTrackSettingsAsync(const std::string& settingsFilePath, const ApplicationState& state)
+{
+    enqueueSave(settingsFilePath, state, true);
+}
+
+std::vector<SettingsManager::SaveResult> SettingsManager::takeFinishedSaves()
+{
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    std::vector<SaveResult> results;
+    results.swap(m_finishedSaves);
+    return results;
 }
 
 std::string SettingsManager::getGlobalSettingsPath() const
@@ -46,7 +80,7 @@ std::string SettingsManager::getGlobalSettingsPath() const
     return Utils::getExecutableDirectory() + "/" + GLOBAL_SETTINGS_FILENAME;
 }
 
-std::string SettingsManager::getTrackSettingsPath(const std::string& trackPath) const
+std::string SettingsManager::getTrackSettingsPath(const std::string& trackPath)
 {
     std::filesystem::path path(trackPath);
     std::string stem = path.stem().string();
@@ -62,6 +96,7 @@ void SettingsManager::logError(const std::string& message) const
 
 bool SettingsManager::loadSettingsFromFile(const std::string& filePath, ApplicationState& state) const
 {
+    Trace::Span span("Load settings", filePath.c_str());
     try
     {
         if (!std::filesystem::exists(filePath))
@@ -70,50 +105,133 @@ bool SettingsManager::loadSettingsFromFile(const std::string& filePath, Applicat
             return false;
         }
 
-        std::ifstream file(filePath);
+        std::ifstream file(filePath, std::ios::binary);
         if (!file.is_open())
         {
             logError("Failed to open settings file: " + filePath);
             return false;
         }
 
-        json j;
-        file >> j;
+        // Slurp the file and parse from memory rather than through the stream extractor
+        std::string contents;
+        file.seekg(0, std::ios::end);
+        contents.resize(static_cast<size_t>(std::max<std::streamoff>(0, file.tellg())));
+        file.seekg(0, std::ios::beg);
+        file.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+
+        const json j = json::parse(contents);
 
         // Load soundFilePath
-        if (j.contains("soundFilePath") && j["soundFilePath"].is_string())
+        auto it = j.find("soundFilePath");
+        if (it != j.end() && it->is_string())
         {
-            state.soundFilePath = j["soundFilePath"].get<std::string>();
+            state.soundFilePath = it->get<std::string>();
         }
 
-        // Load playPosition
-        if (j.contains("playPosition") && j["playPosition"].is_number())
+        // Positions are frames at sampleRate; files from older versions hold seconds
+        // ("playPosition", "timeSeconds"), converted at the default rate
+        it = j.find("sampleRate");
+        if (it != j.end() && it->is_number_unsigned() && it->get<uint32_t>() > 0)
         {
-            state.playPosition = j["playPosition"].get<float>();
+            state.sampleRate = it->get<uint32_t>();
+        }
+        else
+        {
+            state.sampleRate = FrameTime::kDefaultSampleRate;
+        }
+
+        // Load playPositionFrame
+        it = j.find("playPositionFrame");
+        const auto legacyPosition = j.find("playPosition");
+        if (it != j.end() && it->is_number_unsigned())
+        {
+            state.playPositionFrame = it->get<uint64_t>();
+        }
+        else if (legacyPosition != j.end() && legacyPosition->is_number())
+        {
+            state.playPositionFrame = state.toFrame(legacyPosition->get<double>());
         }
 
         // Load tempoMultiplier
-        if (j.contains("tempoMultiplier") && j["tempoMultiplier"].is_number())
+        it = j.find("tempoMultiplier");
+        if (it != j.end() && it->is_number())
+        {
+            state.tempoMultiplier = it->get<float>();
+        }
+
+        // Load beatGrid
+        it = j.find("beatGrid");
+        if (it != j.end() && it->is_object())
         {
-            state.tempoMultiplier = j["tempoMultiplier"].get<float>();
+            const auto bpm = it->find("bpm");
+            if (bpm != it->end() && bpm->is_number())
+                state.beatGrid.bpm = std::max(0.0, bpm->get<double>());
+            const auto firstBeat = it->find("firstBeatFrame");
+            if (firstBeat != it->end() && firstBeat->is_number_unsigned())
+                state.beatGrid.firstBeatFrame = firstBeat->get<uint64_t>();
+            const auto beatsPerBar = it->find("beatsPerBar");
+            if (beatsPerBar != it->end() && beatsPerBar->is_number_unsigned() && beatsPerBar->get<uint32_t>() > 0)
+                state.beatGrid.beatsPerBar = beatsPerBar->get<uint32_t>();
         }
 
         // Load markers
-        if (j.contains("markers") && j["markers"].is_array())
+        it = j.find("markers");
+        if (it != j.end() && it->is_array())
         {
             state.markers.clear();
-            for (const auto& markerJson : j["markers"])
+            state.markers.reserve(it->size());
+            for (const auto& markerJson : *it)
             {
                 Marker marker;
-                if (markerJson.contains("name") && markerJson["name"].is_string())
+                const auto name = markerJson.find("name");
+                if (name != markerJson.end() && name->is_string())
+                {
+                    marker.name = name->get<std::string>();
+                }
+                const auto frame = markerJson.find("frame");
+                const auto time = markerJson.find("timeSeconds");
+                if (frame != markerJson.end() && frame->is_number_unsigned())
                 {
-                    marker.name = markerJson["name"].get<std::string>();
+                    marker.frame = frame->get<uint64_t>();
                 }
-                if (markerJson.contains("timeSeconds") && markerJson["timeSeconds"].is_number())
+                else if (time != markerJson.end() && time->is_number())
                 {
-                    marker.timeSeconds = markerJson["timeSeconds"].get<float>();
+                    marker.frame = state.toFrame(time->get<double>());
                 }
-                state.markers.push_back(marker);
+                state.markers.push_back(std::move(marker));
+            }
+
+            // Files edited by hand (or by older versions) may not be sorted
+            std::stable_sort(state.markers.begin(), state.markers.end(), [](const Marker& a, const Marker& b) {
+                return a.frame < b.frame;
+            });
+        }
+
+        // Load takes; entries without a file are skipped
+        it = j.find("takes");
+        if (it != j.end() && it->is_array())
+        {
+            state.takes.clear();
+            for (const auto& takeJson : *it)
+            {
+                Take take;
+                const auto path = takeJson.find("filePath");
+                if (path == takeJson.end() || !path->is_string())
+                    continue;
+                take.filePath = path->get<std::string>();
+                const auto startFrame = takeJson.find("startFrame");
+                if (startFrame != takeJson.end() && startFrame->is_number_unsigned())
+                    take.startFrame = startFrame->get<uint64_t>();
+                const auto tempo = takeJson.find("tempo");
+                if (tempo != takeJson.end() && tempo->is_number() && tempo->get<float>() > 0.0f)
+                    take.tempo = tempo->get<float>();
+                const auto duration = takeJson.find("durationSeconds");
+                if (duration != takeJson.end() && duration->is_number())
+                    take.durationSeconds = std::max(0.0, duration->get<double>());
+                const auto withBacking = takeJson.find("withBacking");
+                if (withBacking != takeJson.end() && withBacking->is_boolean())
+                    take.withBacking = withBacking->get<bool>();
+                state.takes.push_back(std::move(take));
             }
         }
 
@@ -128,6 +246,7 @@ bool SettingsManager::loadSettingsFromFile(const std::string& filePath, Applicat
 
 bool SettingsManager::saveSettingsToFile(const std::string& filePath, const ApplicationState& state) const
 {
+    Trace::Span span("Save settings", filePath.c_str());
     try
     {
         json j;
@@ -135,31 +254,50 @@ bool SettingsManager::saveSettingsToFile(const std::string& filePath, const Appl
         // Save soundFilePath
         j["soundFilePath"] = state.soundFilePath;
 
-        // Save playPosition
-        j["playPosition"] = state.playPosition;
+        // Save positions as frames at sampleRate
+        j["sampleRate"] = state.sampleRate;
+        j["playPositionFrame"] = state.playPositionFrame;
 
         // Save tempoMultiplier
         j["tempoMultiplier"] = state.tempoMultiplier;
 
+        // Save beatGrid
+        if (state.beatGrid.isValid())
+        {
+            j["beatGrid"] = json{{"bpm", state.beatGrid.bpm},
+                                 {"firstBeatFrame", state.beatGrid.firstBeatFrame},
+                                 {"beatsPerBar", state.beatGrid.beatsPerBar}};
+        }
+
         // Save markers
         json markersJson = json::array();
+        markersJson.get_ref<json::array_t&>().reserve(state.markers.size());
         for (const auto& marker : state.markers)
         {
-            json markerJson;
-            markerJson["name"] = marker.name;
-            markerJson["timeSeconds"] = marker.timeSeconds;
-            markersJson.push_back(markerJson);
+            markersJson.push_back(json{{"name", marker.name}, {"frame", marker.frame}});
         }
-        j["markers"] = markersJson;
+        j["markers"] = std::move(markersJson);
 
-        std::ofstream file(filePath);
-        if (!file.is_open())
+        // Save takes
+        if (!state.takes.empty())
         {
-            logError("Failed to create settings file: " + filePath);
-            return false;
+            json takesJson = json::array();
+            for (const auto& take : state.takes)
+            {
+                takesJson.push_back(json{{"filePath", take.filePath},
+                                         {"startFrame", take.startFrame},
+                                         {"tempo", take.tempo},
+                                         {"durationSeconds", take.durationSeconds},
+                                         {"withBacking", take.withBacking}});
+            }
+            j["takes"] = std::move(takesJson);
         }
 
-        file << j.dump(4); // Pretty print with 4-space indentation
+        if (!Utils::writeFileAtomically(filePath, j.dump(4))) // Pretty print with 4-space indentation
+        {
+            logError("Failed to write settings file: " + filePath);
+            return false;
+        }
         return true;
     }
     catch (const std::exception& e)
@@ -168,3 +306,79 @@ bool SettingsManager::saveSettingsToFile(const std::string& filePath, const Appl
         return false;
     }
 }
+
+uint64_t SettingsManager::enqueueSave(const std::string& filePath, const ApplicationState& state, bool immediate)
+{
+    // Snapshot outside the lock; the worker only ever sees immutable copies
+    auto snapshot = std::make_shared<const ApplicationState>(state);
+    const Clock::time_point now = Clock::now();
+
+    uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        auto it = m_pendingSaves.find(filePath);
+        if (it == m_pendingSaves.end())
+        {
+            it = m_pendingSaves.emplace(filePath, PendingSave{}).first;
+            it->second.firstRequest = now;
+        }
+
+        PendingSave& pending = it->second;
+        pending.snapshot = std::move(snapshot);
+        pending.generation = m_nextGeneration++;
+        // Keep pushing the write back while edits keep coming, but never past SAVE_MAX_DELAY
+        pending.deadline = immediate ? now : std::min(now + SAVE_DEBOUNCE, pending.firstRequest + SAVE_MAX_DELAY);
+        generation = pending.generation;
+    }
+    m_queueChanged.notify_all();
+    return generation;
+}
+
+bool SettingsManager::saveAndWait(const std::string& filePath, const ApplicationState& state)
+{
+    const uint64_t generation = enqueueSave(filePath, state, true);
+
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    m_saveFinished.wait(lock, [&]() {
+        const auto it = m_writtenSaves.find(filePath);
+        return it != m_writtenSaves.end() && it->second.generation >= generation;
+    });
+    return m_writtenSaves[filePath].success;
+}
+
+void SettingsManager::persistenceWorker()
+{
+    Trace::setThreadName("Settings");
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    while (true)
+    {
+        if (m_pendingSaves.empty())
+        {
+            if (m_stopping)
+                break;
+            m_queueChanged.wait(lock);
+            continue;
+        }
+
+        auto next = std::min_element(m_pendingSaves.begin(), m_pendingSaves.end(), [](const auto& a, const auto& b) {
+            return a.second.deadline < b.second.deadline;
+        });
+        if (!m_stopping && next->second.deadline > Clock::now())
+        {
+            m_queueChanged.wait_until(lock, next->second.deadline);
+            continue;
+        }
+
+        const std::string filePath = next->first;
+        const PendingSave pending = std::move(next->second);
+        m_pendingSaves.erase(next);
+
+        lock.unlock();
+        const bool success = saveSettingsToFile(filePath, *pending.snapshot);
+        lock.lock();
+
+        m_writtenSaves[filePath] = WrittenSave{pending.generation, success};
+        m_finishedSaves.push_back(SaveResult{filePath, success});
+        m_saveFinished.notify_all();
+    }
+}
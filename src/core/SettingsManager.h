@@ -1,6 +1,13 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 struct Marker;
@@ -9,6 +16,13 @@ struct ApplicationState;
 class SettingsManager
 {
 public:
+    // Outcome of a background save, collected by the UI with takeFinishedSaves()
+    struct SaveResult
+    {
+        std::string filePath;
+        bool success = false;
+    };
+
     SettingsManager();
     ~SettingsManager();
 
@@ -20,17 +34,55 @@ public:
     bool loadTrackSettings(const std::string& settingsFilePath, ApplicationState& state);
     bool saveTrackSettings(const std::string& settingsFilePath, const ApplicationState& state);
 
+    // Background saves: the state is snapshotted and written by the persistence worker.
+    // Repeated requests for the same file within the debounce window collapse into one write.
+    void saveGlobalSettingsAsync(const ApplicationState& state);
+    void saveTrackSettingsAsync(const std::string& settingsFilePath, const ApplicationState& state);
+    std::vector<SaveResult> takeFinishedSaves();
+
     // Get paths
     std::string getGlobalSettingsPath() const;
-    std::string getTrackSettingsPath(const std::string& trackPath) const;
+    static std::string getTrackSettingsPath(const std::string& trackPath);
 
 private:
+    using Clock = std::chrono::steady_clock;
+
+    struct PendingSave
+    {
+        std::shared_ptr<const ApplicationState> snapshot;
+        Clock::time_point firstRequest;
+        Clock::time_point deadline;
+        uint64_t generation = 0;
+    };
+
+    struct WrittenSave
+    {
+        uint64_t generation = 0;
+        bool success = false;
+    };
+
     void logError(const std::string& message) const;
 
     // JSON serialization helpers
     bool loadSettingsFromFile(const std::string& filePath, ApplicationState& state) const;
     bool saveSettingsToFile(const std::string& filePath, const ApplicationState& state) const;
 
+    uint64_t enqueueSave(const std::string& filePath, const ApplicationState& state, bool immediate);
+    bool saveAndWait(const std::string& filePath, const ApplicationState& state);
+    void persistenceWorker();
+
+    std::thread m_worker;
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueChanged;
+    std::condition_variable m_saveFinished;
+    std::map<std::string, PendingSave> m_pendingSaves;
+    std::map<std::string, WrittenSave> m_writtenSaves;  // Last generation written per file
+    std::vector<SaveResult> m_finishedSaves;
+    uint64_t m_nextGeneration = 1;
+    bool m_stopping = false;
+
+    static constexpr std::chrono::milliseconds SAVE_DEBOUNCE{750};
+    static constexpr std::chrono::milliseconds SAVE_MAX_DELAY{3000};
     static constexpr const char* GLOBAL_SETTINGS_FILENAME = "songpractice-settings.json";
     static constexpr const char* TRACK_SETTINGS_EXTENSION = ".songpractice.json";
 };
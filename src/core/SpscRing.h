@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Fixed-size queue between exactly one producer and one consumer thread, without locks or
+// allocation after reset(): the audio callback hands its input to worker threads through
+// it. T must be trivially copyable. reset() must only run while neither side uses the ring.
+template <typename T>
+class SpscRing
+{
+public:
+    // Capacity is rounded up to a power of two
+    void reset(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        m_buffer.assign(size, T{});
+        m_mask = size - 1;
+        m_head.store(0);
+        m_tail.store(0);
+    }
+
+    size_t capacity() const { return m_buffer.size(); }
+
+    // Producer: values that write() accepts right now
+    size_t writable() const
+    {
+        return capacity() - (m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire));
+    }
+
+    // Producer: copies as many of count values as fit and returns how many that was
+    size_t write(const T* values, size_t count)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        count = std::min(count, capacity() - (head - m_tail.load(std::memory_order_acquire)));
+        const size_t start = head & m_mask;
+        const size_t first = std::min(count, capacity() - start);
+        std::copy(values, values + first, m_buffer.begin() + start);
+        std::copy(values + first, values + count, m_buffer.begin());
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer: values that read() can return right now
+    size_t readable() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed);
+    }
+
+    // Consumer: moves up to count values out and returns how many that was
+    size_t read(T* values, size_t count)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        count = std::min(count, m_head.load(std::memory_order_acquire) - tail);
+        const size_t start = tail & m_mask;
+        const size_t first = std::min(count, capacity() - start);
+        std::copy(m_buffer.begin() + start, m_buffer.begin() + start + first, values);
+        std::copy(m_buffer.begin(), m_buffer.begin() + (count - first), values + first);
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    std::vector<T> m_buffer;
+    size_t m_mask = 0;
+    // Free-running positions on separate cache lines, so the two threads do not share one
+    alignas(64) std::atomic<size_t> m_head{0};  // Written by the producer
+    alignas(64) std::atomic<size_t> m_tail{0};  // Written by the consumer
+};
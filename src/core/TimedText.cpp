@@ -0,0 +1,365 @@
+#include "TimedText.h"
+#include "ApplicationState.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+namespace
+{
+    void logError(const std::string& message)
+    {
+        std::cerr << "TimedText Error: " << message << std::endl;
+    }
+
+    std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+            text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r'))
+            text.remove_suffix(1);
+        return text;
+    }
+
+    // Removes a UTF-8 byte order mark and a trailing carriage return
+    void normalizeLine(std::string& line, bool firstLine)
+    {
+        if (firstLine && line.size() >= 3 && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+            line.erase(0, 3);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+    }
+
+    bool parseDigits(std::string_view& text, int& value, int& digitCount)
+    {
+        value = 0;
+        digitCount = 0;
+        while (!text.empty() && text.front() >= '0' && text.front() <= '9' && digitCount < 9)
+        {
+            value = value * 10 + (text.front() - '0');
+            ++digitCount;
+            text.remove_prefix(1);
+        }
+        return digitCount > 0;
+    }
+
+    // Parses "mm:ss", "mm:ss.xx", "hh:mm:ss,mmm" ... into seconds.
+    // LRC also allows "mm:ss:xx" where the last field holds hundredths.
+    bool parseClock(std::string_view text, bool lrcStyle, double& outSeconds)
+    {
+        text = trim(text);
+
+        int fields[3] = {0, 0, 0};
+        int lastDigits = 0;
+        int fieldCount = 0;
+        while (fieldCount < 3)
+        {
+            if (!parseDigits(text, fields[fieldCount], lastDigits))
+                return false;
+            ++fieldCount;
+            if (text.empty() || text.front() != ':')
+                break;
+            text.remove_prefix(1);
+        }
+
+        double fraction = 0.0;
+        if (!text.empty() && (text.front() == '.' || text.front() == ','))
+        {
+            text.remove_prefix(1);
+            int value = 0;
+            int digits = 0;
+            if (!parseDigits(text, value, digits))
+                return false;
+            fraction = value / std::pow(10.0, digits);
+        }
+        else if (lrcStyle && fieldCount == 3)
+        {
+            fraction = fields[2] / std::pow(10.0, lastDigits);
+            fieldCount = 2;
+        }
+
+        if (!text.empty() || fieldCount < 2)
+            return false;
+
+        if (fieldCount == 3)
+            outSeconds = fields[0] * 3600.0 + fields[1] * 60.0 + fields[2] + fraction;
+        else
+            outSeconds = fields[0] * 60.0 + fields[1] + fraction;
+        return true;
+    }
+
+    // Drops inline markup: enhanced-LRC word timings <mm:ss.xx> and subtitle tags <i>, <b> ...
+    std::string stripInlineTags(std::string_view text)
+    {
+        std::string result;
+        result.reserve(text.size());
+        bool inTag = false;
+        for (char c : text)
+        {
+            if (c == '<')
+                inTag = true;
+            else if (c == '>' && inTag)
+                inTag = false;
+            else if (!inTag)
+                result.push_back(c);
+        }
+        return std::string(trim(result));
+    }
+
+    void appendMarker(std::vector<Marker>& markers, double seconds, uint32_t sampleRate, std::string name)
+    {
+        seconds = std::max(0.0, seconds);
+        Marker marker;
+        marker.frame = FrameTime::fromSeconds(seconds, sampleRate);
+        marker.name = name.empty() ? Utils::formatTime(static_cast<float>(seconds)) : std::move(name);
+        markers.push_back(std::move(marker));
+    }
+
+    // Writes "mm:ss.xx" (LRC) or "hh:mm:ss,mmm" / "hh:mm:ss.mmm" (subtitles)
+    int formatClock(char* buffer, size_t size, double seconds, TimedText::Format format)
+    {
+        if (format == TimedText::Format::Lrc)
+        {
+            const long centis = std::lround(std::max(0.0, seconds) * 100.0);
+            return std::snprintf(buffer, size, "%02ld:%02ld.%02ld", centis / 6000, (centis / 100) % 60, centis % 100);
+        }
+
+        const long millis = std::lround(std::max(0.0, seconds) * 1000.0);
+        const char separator = (format == TimedText::Format::Vtt) ? '.' : ',';
+        return std::snprintf(buffer, size, "%02ld:%02ld:%02ld%c%03ld",
+                             millis / 3600000, (millis / 60000) % 60, (millis / 1000) % 60, separator, millis % 1000);
+    }
+}
+
+namespace TimedText
+{
+    Format detectFormat(const std::string& filePath)
+    {
+        const std::string extension = Utils::getFileExtension(filePath);
+        if (extension == "lrc")
+            return Format::Lrc;
+        if (extension == "srt")
+            return Format::Srt;
+        if (extension == "vtt")
+            return Format::Vtt;
+        return Format::Unknown;
+    }
+
+    bool parseLrc(std::istream& input, uint32_t sampleRate, std::vector<Marker>& outMarkers)
+    {
+        std::string line;
+        std::vector<double> lineTimes;
+        double offsetSeconds = 0.0;
+        bool firstLine = true;
+        const size_t markersBefore = outMarkers.size();
+
+        while (std::getline(input, line))
+        {
+            normalizeLine(line, firstLine);
+            firstLine = false;
+
+            // A line may start with several tags: [00:12.00][01:30.50]Chorus line
+            std::string_view rest(line);
+            lineTimes.clear();
+            while (!rest.empty() && rest.front() == '[')
+            {
+                const size_t close = rest.find(']');
+                if (close == std::string_view::npos)
+                    break;
+
+                const std::string_view tag = rest.substr(1, close - 1);
+                double seconds = 0.0;
+                if (parseClock(tag, true, seconds))
+                {
+                    lineTimes.push_back(seconds);
+                }
+                else if (tag.substr(0, 7) == "offset:")
+                {
+                    // Positive offsets make the lyrics appear sooner
+                    const std::string value(trim(tag.substr(7)));
+                    offsetSeconds = std::strtol(value.c_str(), nullptr, 10) / 1000.0;
+                }
+                // Other ID tags ([ar:], [ti:], [length:] ...) carry no timing
+                rest.remove_prefix(close + 1);
+            }
+
+            if (lineTimes.empty())
+                continue;
+
+            const std::string text = stripInlineTags(rest);
+            for (double seconds : lineTimes)
+                appendMarker(outMarkers, seconds - offsetSeconds, sampleRate, text);
+        }
+
+        return outMarkers.size() > markersBefore;
+    }
+
+    bool parseSubtitles(std::istream& input, uint32_t sampleRate, std::vector<Marker>& outMarkers)
+    {
+        std::string line;
+        std::string cueText;
+        double cueStart = 0.0;
+        bool inCue = false;
+        bool firstLine = true;
+        const size_t markersBefore = outMarkers.size();
+
+        auto finishCue = [&]() {
+            if (inCue)
+                appendMarker(outMarkers, cueStart, sampleRate, stripInlineTags(cueText));
+            inCue = false;
+            cueText.clear();
+        };
+
+        while (std::getline(input, line))
+        {
+            normalizeLine(line, firstLine);
+            firstLine = false;
+
+            const std::string_view text = trim(line);
+            const size_t arrow = text.find("-->");
+            if (arrow != std::string_view::npos)
+            {
+                // "00:01:02,500 --> 00:01:04,000 [cue settings]"
+                finishCue();
+                double seconds = 0.0;
+                if (parseClock(text.substr(0, arrow), false, seconds))
+                {
+                    cueStart = seconds;
+                    inCue = true;
+                }
+                continue;
+            }
+
+            if (text.empty())
+            {
+                finishCue();
+                continue;
+            }
+
+            if (inCue)
+            {
+                // Multi-line cues are joined into a single marker name
+                if (!cueText.empty())
+                    cueText.push_back(' ');
+                cueText.append(text.data(), text.size());
+            }
+        }
+        finishCue();
+
+        return outMarkers.size() > markersBefore;
+    }
+
+    bool importFile(const std::string& filePath, uint32_t sampleRate, std::vector<Marker>& outMarkers)
+    {
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            logError("Failed to open timed text file: " + filePath);
+            return false;
+        }
+
+        // A file without timed lines is not an error here; the caller reports the empty import
+        const Format format = detectFormat(filePath);
+        if (format == Format::Srt || format == Format::Vtt)
+            parseSubtitles(file, sampleRate, outMarkers);
+        else
+            parseLrc(file, sampleRate, outMarkers);
+        return true;
+    }
+
+    void mergeMarkers(std::vector<Marker>& markers, std::vector<Marker>& imported)
+    {
+        const auto byFrame = [](const Marker& a, const Marker& b) { return a.frame < b.frame; };
+        std::stable_sort(imported.begin(), imported.end(), byFrame);
+
+        std::vector<Marker> merged;
+        merged.reserve(markers.size() + imported.size());
+
+        auto existing = markers.begin();
+        auto incoming = imported.begin();
+        while (existing != markers.end() || incoming != imported.end())
+        {
+            const bool takeExisting = (incoming == imported.end())
+                                      || (existing != markers.end() && !byFrame(*incoming, *existing));
+            Marker& next = takeExisting ? *existing++ : *incoming++;
+
+            // Existing markers come first at a frame, so an imported one is checked against
+            // everything merged at its frame, not only the last
+            bool duplicate = false;
+            if (!takeExisting)
+            {
+                for (auto it = merged.rbegin(); !duplicate && it != merged.rend() && it->frame == next.frame; ++it)
+                    duplicate = (it->name == next.name);
+            }
+            if (!duplicate)
+                merged.push_back(std::move(next));
+        }
+
+        markers.swap(merged);
+        imported.clear();
+    }
+
+    void writeLrc(std::ostream& output, const std::vector<Marker>& markers, uint32_t sampleRate)
+    {
+        char clock[32];
+        for (const Marker& marker : markers)
+        {
+            formatClock(clock, sizeof(clock), FrameTime::toSeconds(marker.frame, sampleRate), Format::Lrc);
+            output << '[' << clock << ']' << marker.name << '\n';
+        }
+    }
+
+    void writeSubtitles(std::ostream& output, const std::vector<Marker>& markers, uint32_t sampleRate,
+                        uint64_t durationFrames, Format format)
+    {
+        constexpr uint64_t kLastCueSeconds = 2;
+        char start[32];
+        char end[32];
+
+        if (format == Format::Vtt)
+            output << "WEBVTT\n\n";
+
+        for (size_t i = 0; i < markers.size(); ++i)
+        {
+            const uint64_t cueStart = markers[i].frame;
+            uint64_t cueEnd = (i + 1 < markers.size()) ? markers[i + 1].frame : durationFrames;
+            if (cueEnd <= cueStart)
+                cueEnd = cueStart + kLastCueSeconds * sampleRate;
+
+            formatClock(start, sizeof(start), FrameTime::toSeconds(cueStart, sampleRate), format);
+            formatClock(end, sizeof(end), FrameTime::toSeconds(cueEnd, sampleRate), format);
+            if (format == Format::Srt)
+                output << (i + 1) << '\n';
+            output << start << " --> " << end << '\n' << markers[i].name << "\n\n";
+        }
+    }
+
+    bool exportFile(const std::string& filePath, const std::vector<Marker>& markers, uint32_t sampleRate,
+                    uint64_t durationFrames)
+    {
+        std::ofstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            logError("Failed to create timed text file: " + filePath);
+            return false;
+        }
+
+        const Format format = detectFormat(filePath);
+        if (format == Format::Srt || format == Format::Vtt)
+            writeSubtitles(file, markers, sampleRate, durationFrames, format);
+        else
+            writeLrc(file, markers, sampleRate);
+
+        file.flush();
+        if (!file)
+        {
+            logError("Failed to write timed text file: " + filePath);
+            return false;
+        }
+        return true;
+    }
+}
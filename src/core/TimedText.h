@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct Marker;
+
+// Import/export of markers as timed lyrics (LRC) and subtitles (SRT / WebVTT). The files
+// hold seconds; markers hold frames at sampleRate.
+namespace TimedText
+{
+    enum class Format
+    {
+        Unknown,
+        Lrc,
+        Srt,
+        Vtt
+    };
+
+    Format detectFormat(const std::string& filePath);
+
+    // Streaming parsers: read line by line and append one marker per timestamp.
+    // Output is in file order (not sorted); call mergeMarkers() to insert it.
+    bool parseLrc(std::istream& input, uint32_t sampleRate, std::vector<Marker>& outMarkers);
+    bool parseSubtitles(std::istream& input, uint32_t sampleRate, std::vector<Marker>& outMarkers);
+
+    // False only if the file cannot be read; a file without timed lines adds no markers
+    bool importFile(const std::string& filePath, uint32_t sampleRate, std::vector<Marker>& outMarkers);
+
+    // Sorts imported once, then merges it into the sorted markers in a single pass.
+    // Imported markers identical to an existing one (same time and name) are dropped.
+    void mergeMarkers(std::vector<Marker>& markers, std::vector<Marker>& imported);
+
+    // markers must be sorted; durationFrames closes the last subtitle cue
+    void writeLrc(std::ostream& output, const std::vector<Marker>& markers, uint32_t sampleRate);
+    void writeSubtitles(std::ostream& output, const std::vector<Marker>& markers, uint32_t sampleRate,
+                        uint64_t durationFrames, Format format);
+    bool exportFile(const std::string& filePath, const std::vector<Marker>& markers, uint32_t sampleRate,
+                    uint64_t durationFrames);
+}
@@ -0,0 +1,238 @@
+#include "Trace.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace
+{
+    constexpr size_t kEventsPerThread = 8192;
+    constexpr size_t kDetailLength = 35;
+
+    struct Event
+    {
+        const char* name;
+        uint64_t startNs;
+        uint64_t durationNs;
+        uint32_t threadId;
+        char detail[kDetailLength + 1];
+    };
+
+    // Written by its owning thread; the mutex is only contended while exporting
+    struct ThreadBuffer
+    {
+        std::mutex mutex;
+        std::unique_ptr<Event[]> events{new Event[kEventsPerThread]};
+        uint64_t written = 0;
+        uint64_t clearedBefore = 0;
+        bool inUse = true;   // Guarded by the registry mutex
+
+        uint64_t firstKept() const
+        {
+            return std::max(clearedBefore, written > kEventsPerThread ? written - kEventsPerThread : uint64_t(0));
+        }
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::map<uint32_t, std::string> threadNames;
+    };
+
+    Registry& registry()
+    {
+        // Leaked: threads may record while static destructors run
+        static Registry* instance = new Registry();
+        return *instance;
+    }
+
+    std::atomic<uint32_t> s_nextThreadId{1};
+
+    uint32_t currentThreadId()
+    {
+        thread_local const uint32_t id = s_nextThreadId.fetch_add(1);
+        return id;
+    }
+
+    // A thread's buffer returns to the pool when it exits; its events stay exportable
+    // until the next owner overwrites them
+    struct ThreadBufferLease
+    {
+        ThreadBuffer* buffer = nullptr;
+
+        ~ThreadBufferLease()
+        {
+            if (!buffer)
+                return;
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            buffer->inUse = false;
+        }
+    };
+
+    ThreadBuffer& currentBuffer()
+    {
+        thread_local ThreadBufferLease lease;
+        if (lease.buffer)
+            return *lease.buffer;
+
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (const std::unique_ptr<ThreadBuffer>& buffer : reg.buffers)
+        {
+            if (!buffer->inUse)
+            {
+                buffer->inUse = true;
+                lease.buffer = buffer.get();
+                return *lease.buffer;
+            }
+        }
+        reg.buffers.push_back(std::make_unique<ThreadBuffer>());
+        lease.buffer = reg.buffers.back().get();
+        return *lease.buffer;
+    }
+
+    const std::chrono::steady_clock::time_point s_epoch = std::chrono::steady_clock::now();
+
+    // Keeps the end of long details (file names end paths) without splitting a UTF-8 sequence
+    void copyDetail(char* out, const char* detail)
+    {
+        if (!detail)
+        {
+            out[0] = '\0';
+            return;
+        }
+        const size_t length = std::strlen(detail);
+        const char* start = detail + (length > kDetailLength ? length - kDetailLength : 0);
+        while (start > detail && *start != '\0' && (static_cast<unsigned char>(*start) & 0xC0) == 0x80)
+            ++start;
+        std::strncpy(out, start, kDetailLength);
+        out[kDetailLength] = '\0';
+    }
+
+    std::vector<Event> snapshot(ThreadBuffer& buffer)
+    {
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        std::vector<Event> events;
+        events.reserve(static_cast<size_t>(buffer.written - buffer.firstKept()));
+        for (uint64_t index = buffer.firstKept(); index < buffer.written; ++index)
+            events.push_back(buffer.events[index % kEventsPerThread]);
+        return events;
+    }
+}
+
+namespace Trace
+{
+    namespace Detail
+    {
+        std::atomic<bool> g_recording{false};
+
+        uint64_t now()
+        {
+            return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_epoch).count());
+        }
+
+        void record(const char* name, const char* detail, uint64_t startNs, uint64_t endNs)
+        {
+            ThreadBuffer& buffer = currentBuffer();
+            std::lock_guard<std::mutex> lock(buffer.mutex);
+            Event& event = buffer.events[buffer.written % kEventsPerThread];
+            event.name = name;
+            event.startNs = startNs;
+            event.durationNs = endNs - startNs;
+            event.threadId = currentThreadId();
+            copyDetail(event.detail, detail);
+            ++buffer.written;
+        }
+    }
+
+    void setRecording(bool recording)
+    {
+        Detail::g_recording.store(recording);
+    }
+
+    void setThreadName(const char* name)
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.threadNames[currentThreadId()] = name;
+    }
+
+    size_t eventCount()
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        size_t count = 0;
+        for (const std::unique_ptr<ThreadBuffer>& buffer : reg.buffers)
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            count += static_cast<size_t>(buffer->written - buffer->firstKept());
+        }
+        return count;
+    }
+
+    void clear()
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (const std::unique_ptr<ThreadBuffer>& buffer : reg.buffers)
+        {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            buffer->clearedBefore = buffer->written;
+        }
+    }
+
+    bool exportChromeJson(const std::string& filePath)
+    {
+        json events = json::array();
+        {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            for (const auto& [threadId, name] : reg.threadNames)
+            {
+                events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", threadId},
+                                  {"args", {{"name", name}}}});
+            }
+            for (const std::unique_ptr<ThreadBuffer>& buffer : reg.buffers)
+            {
+                for (const Event& event : snapshot(*buffer))
+                {
+                    json entry = {{"name", event.name},
+                                  {"ph", "X"},
+                                  {"pid", 1},
+                                  {"tid", event.threadId},
+                                  {"ts", static_cast<double>(event.startNs) / 1000.0},
+                                  {"dur", static_cast<double>(event.durationNs) / 1000.0}};
+                    if (event.detail[0] != '\0')
+                        entry["args"] = {{"detail", event.detail}};
+                    events.push_back(std::move(entry));
+                }
+            }
+        }
+
+        std::ofstream file(filePath);
+        if (!file.is_open())
+        {
+            std::cerr << "Trace: Failed to open " << filePath << " for writing" << std::endl;
+            return false;
+        }
+
+        const json trace = {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}};
+        file << trace.dump(-1, ' ', false, json::error_handler_t::replace);
+        if (!file.good())
+        {
+            std::cerr << "Trace: Failed to write " << filePath << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped timing spans for finding where slow operations (opening a song, tempo changes,
+// frames) spend their time. Spans go into a ring buffer per thread, the oldest being
+// overwritten, and are exported as Chrome trace JSON for chrome://tracing or Perfetto.
+// While recording is off a Span costs one relaxed load and a branch. Span names must be
+// string literals; the optional detail (e.g. a file name) is copied, keeping its end.
+// Not for the audio callback: a thread's first span allocates its buffer.
+namespace Trace
+{
+    namespace Detail
+    {
+        extern std::atomic<bool> g_recording;
+        uint64_t now();
+        void record(const char* name, const char* detail, uint64_t startNs, uint64_t endNs);
+    }
+
+    inline bool isRecording()
+    {
+        return Detail::g_recording.load(std::memory_order_relaxed);
+    }
+
+    void setRecording(bool recording);
+    // Shown for the calling thread in exported traces
+    void setThreadName(const char* name);
+    size_t eventCount();
+    void clear();
+    bool exportChromeJson(const std::string& filePath);
+
+    class Span
+    {
+    public:
+        explicit Span(const char* name, const char* detail = nullptr)
+        {
+            if (isRecording())
+            {
+                m_name = name;
+                m_detail = detail;
+                m_start = Detail::now();
+            }
+        }
+
+        ~Span()
+        {
+            if (m_name)
+                Detail::record(m_name, m_detail, m_start, Detail::now());
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* m_name = nullptr;
+        const char* m_detail = nullptr;
+        uint64_t m_start = 0;
+    };
+}
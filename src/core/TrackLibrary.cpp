@@ -0,0 +1,790 @@
+#include "TrackLibrary.h"
+#include "BinaryIO.h"
+#include "SettingsManager.h"
+#include "Trace.h"
+#include "Utils.h"
+#include "audio/DecoderInput.h"
+#include "platform/RealtimeSupport.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <unordered_set>
+
+namespace
+{
+    constexpr char kIndexMagic[8] = {'S', 'P', 'L', 'I', 'B', '0', '0', '3'};
+    constexpr uint32_t kProbeChunkFrames = 4096;
+    constexpr std::chrono::milliseconds kWatchSettleTime{1000};
+    constexpr std::chrono::milliseconds kIndexSaveDelay{1000};  // Batches of scan results share one write
+
+    // Smallest serialized root and entry: empty strings and no thumbnail
+    constexpr size_t kMinRootBytes = sizeof(uint16_t);
+    constexpr size_t kMinEntryBytes = 3 * sizeof(uint16_t) + 3 * sizeof(uint64_t) + sizeof(int64_t) + sizeof(float)
+                                      + 2 * sizeof(uint32_t) + sizeof(uint8_t);
+    constexpr size_t kHashSampleBytes = 64 * 1024;
+    constexpr const char* kSettingsSuffix = ".songpractice.json";
+
+    using BinaryIO::put;
+    using BinaryIO::putString;
+
+    bool isSupportedAudio(const std::string& path)
+    {
+        const std::string extension = Utils::getFileExtension(path);
+        return extension == "wav" || extension == "mp3";
+    }
+
+    bool statFile(const std::string& path, uint64_t& size, int64_t& modifiedTime)
+    {
+        std::error_code error;
+        const auto fileSize = std::filesystem::file_size(path, error);
+        if (error)
+            return false;
+        const auto writeTime = std::filesystem::last_write_time(path, error);
+        if (error)
+            return false;
+        size = static_cast<uint64_t>(fileSize);
+        modifiedTime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+        return true;
+    }
+
+    uint64_t fnv1a(uint64_t hash, const unsigned char* data, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Hashing whole files over a network share would dominate the scan, so only
+    // the size and the first and last 64 KiB are hashed
+    uint64_t hashFileContents(const std::string& path, uint64_t size)
+    {
+        uint64_t hash = fnv1a(14695981039346656037ull, reinterpret_cast<const unsigned char*>(&size), sizeof(size));
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return hash;
+
+        std::vector<unsigned char> buffer(kHashSampleBytes);
+        file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        hash = fnv1a(hash, buffer.data(), static_cast<size_t>(file.gcount()));
+
+        if (size > 2 * kHashSampleBytes)
+        {
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(size - kHashSampleBytes));
+            file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+            hash = fnv1a(hash, buffer.data(), static_cast<size_t>(file.gcount()));
+        }
+        return hash;
+    }
+
+    // A settings file found next to the audio wins; one that is no longer next to it
+    // (the audio was moved) stays attached while it exists
+    bool settingsPathChanged(const std::string& found, const std::string& stored)
+    {
+        std::error_code error;
+        return found != stored && (!found.empty() || !std::filesystem::exists(stored, error));
+    }
+
+    std::string toLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+        return text;
+    }
+}
+
+TrackLibrary::TrackLibrary()
+{
+    m_writerThread = std::thread(&TrackLibrary::indexWriter, this);
+}
+
+TrackLibrary::~TrackLibrary()
+{
+    m_cancelScan.store(true);
+    m_watcher.stop();
+    if (m_scanThread.joinable())
+        m_scanThread.join();
+
+    // The writer drains the last index before exiting
+    flushIndex(true);
+    {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        m_stopWriter = true;
+    }
+    m_writerWake.notify_all();
+    if (m_writerThread.joinable())
+        m_writerThread.join();
+}
+
+std::string TrackLibrary::getIndexPath() const
+{
+    return Utils::getExecutableDirectory() + "/" + INDEX_FILENAME;
+}
+
+bool TrackLibrary::loadIndex()
+{
+    std::ifstream file(getIndexPath(), std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(kIndexMagic) || std::memcmp(data.data(), kIndexMagic, sizeof(kIndexMagic)) != 0)
+    {
+        std::cerr << "TrackLibrary: Ignoring index with unknown format: " << getIndexPath() << std::endl;
+        return false;
+    }
+
+    BinaryIO::Reader reader(data);
+    reader.get<std::array<char, sizeof(kIndexMagic)>>();
+
+    // Counts are checked against the bytes left, so a damaged index cannot ask for gigabytes
+    const uint32_t rootCount = reader.get<uint32_t>();
+    if (!reader.ok() || rootCount > reader.remaining() / kMinRootBytes)
+    {
+        std::cerr << "TrackLibrary: Ignoring damaged index: " << getIndexPath() << std::endl;
+        return false;
+    }
+    std::vector<std::string> roots(rootCount);
+    for (std::string& root : roots)
+        root = reader.getString();
+
+    const uint32_t entryCount = reader.get<uint32_t>();
+    if (!reader.ok() || entryCount > reader.remaining() / kMinEntryBytes)
+    {
+        std::cerr << "TrackLibrary: Ignoring damaged index: " << getIndexPath() << std::endl;
+        return false;
+    }
+    std::vector<LibraryEntry> entries(entryCount);
+    for (LibraryEntry& entry : entries)
+    {
+        entry.path = reader.getString();
+        entry.format = reader.getString();
+        entry.settingsPath = reader.getString();
+        entry.fileSize = reader.get<uint64_t>();
+        entry.modifiedTime = reader.get<int64_t>();
+        entry.contentHash = reader.get<uint64_t>();
+        entry.durationSeconds = reader.get<float>();
+        entry.sampleRate = reader.get<uint32_t>();
+        entry.channelCount = reader.get<uint32_t>();
+        entry.thumbnail.resize(reader.get<uint8_t>());
+        for (uint8_t& peak : entry.thumbnail)
+            peak = reader.get<uint8_t>();
+        if (!reader.ok())
+            break;
+    }
+
+    if (!reader.ok())
+    {
+        std::cerr << "TrackLibrary: Truncated index: " << getIndexPath() << std::endl;
+        return false;
+    }
+
+    m_roots = std::move(roots);
+    m_entries = std::move(entries);
+    m_searchKeys.clear();
+    m_pathIndex.clear();
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        m_searchKeys.push_back(makeSearchKey(m_entries[i].path));
+        m_pathIndex[m_entries[i].path] = i;
+    }
+    ++m_revision;
+
+    restartWatcher();
+    return true;
+}
+
+void TrackLibrary::setRoots(const std::vector<std::string>& roots)
+{
+    m_roots = roots;
+    restartWatcher();
+    rescan();
+}
+
+const std::vector<std::string>& TrackLibrary::roots() const
+{
+    return m_roots;
+}
+
+void TrackLibrary::rescan()
+{
+    startScan({});
+}
+
+bool TrackLibrary::isScanning() const
+{
+    return m_scanning.load();
+}
+
+float TrackLibrary::scanProgress() const
+{
+    const uint32_t total = m_probeTotal.load();
+    return (total == 0) ? 0.0f : static_cast<float>(m_probeDone.load()) / static_cast<float>(total);
+}
+
+bool TrackLibrary::isWatching() const
+{
+    return m_watcher.isRunning();
+}
+
+const std::vector<LibraryEntry>& TrackLibrary::entries() const
+{
+    return m_entries;
+}
+
+uint64_t TrackLibrary::revision() const
+{
+    return m_revision;
+}
+
+bool TrackLibrary::update()
+{
+    std::vector<LibraryEntry> probed;
+    std::vector<LibraryEntry> settingsUpdates;
+    std::vector<std::pair<std::string, LibraryEntry>> moved;
+    std::vector<std::string> removed;
+    std::vector<std::string> changedPaths;
+    {
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        probed.swap(m_probedEntries);
+        settingsUpdates.swap(m_settingsUpdates);
+        moved.swap(m_movedEntries);
+        removed.swap(m_removedPaths);
+
+        // Let bursts of watcher events (create, write, close ...) settle into one pass
+        if (!m_changedPaths.empty() && !m_scanning.load() && Clock::now() - m_lastChange > kWatchSettleTime)
+            changedPaths.swap(m_changedPaths);
+    }
+
+    // A moved file keeps its entry, thumbnail included, under the new path
+    for (const auto& [fromPath, update] : moved)
+    {
+        const auto from = m_pathIndex.find(fromPath);
+        if (from == m_pathIndex.end() || m_pathIndex.count(update.path) > 0)
+            continue;
+
+        const size_t index = from->second;
+        LibraryEntry& entry = m_entries[index];
+        entry.path = update.path;
+        entry.fileSize = update.fileSize;
+        entry.modifiedTime = update.modifiedTime;
+        entry.settingsPath = update.settingsPath;
+        m_searchKeys[index] = makeSearchKey(entry.path);
+        m_pathIndex.erase(from);
+        m_pathIndex[entry.path] = index;
+    }
+
+    for (LibraryEntry& entry : probed)
+    {
+        const auto it = m_pathIndex.find(entry.path);
+        if (it != m_pathIndex.end())
+        {
+            m_entries[it->second] = std::move(entry);
+        }
+        else
+        {
+            m_pathIndex[entry.path] = m_entries.size();
+            m_searchKeys.push_back(makeSearchKey(entry.path));
+            m_entries.push_back(std::move(entry));
+        }
+    }
+
+    for (const LibraryEntry& update : settingsUpdates)
+    {
+        const auto it = m_pathIndex.find(update.path);
+        if (it != m_pathIndex.end())
+            m_entries[it->second].settingsPath = update.settingsPath;
+    }
+
+    if (!removed.empty())
+    {
+        const std::unordered_set<std::string> removedSet(removed.begin(), removed.end());
+        m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [&](const LibraryEntry& entry) {
+                            return removedSet.count(entry.path) > 0;
+                        }),
+                        m_entries.end());
+
+        m_searchKeys.clear();
+        m_pathIndex.clear();
+        for (size_t i = 0; i < m_entries.size(); ++i)
+        {
+            m_searchKeys.push_back(makeSearchKey(m_entries[i].path));
+            m_pathIndex[m_entries[i].path] = i;
+        }
+    }
+
+    const bool changed = !probed.empty() || !settingsUpdates.empty() || !moved.empty() || !removed.empty();
+    if (changed)
+    {
+        ++m_revision;
+        saveIndexAsync();
+    }
+    flushIndex(false);
+
+    if (m_rescanRequested && !m_scanning.load())
+    {
+        m_rescanRequested = false;
+        startScan({});
+    }
+    else if (!changedPaths.empty())
+    {
+        startScan(std::move(changedPaths));
+    }
+
+    return changed;
+}
+
+void TrackLibrary::search(const std::string& query, const std::string& formatFilter, std::vector<size_t>& outIndices) const
+{
+    outIndices.clear();
+
+    std::vector<std::string> terms;
+    const std::string lowered = toLower(query);
+    size_t start = 0;
+    while (start < lowered.size())
+    {
+        const size_t end = lowered.find(' ', start);
+        const size_t stop = (end == std::string::npos) ? lowered.size() : end;
+        if (stop > start)
+            terms.push_back(lowered.substr(start, stop - start));
+        start = stop + 1;
+    }
+
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        if (!formatFilter.empty() && m_entries[i].format != formatFilter)
+            continue;
+
+        const std::string& key = m_searchKeys[i];
+        const bool matches = std::all_of(terms.begin(), terms.end(), [&](const std::string& term) {
+            return key.find(term) != std::string::npos;
+        });
+        if (matches)
+            outIndices.push_back(i);
+    }
+}
+
+bool TrackLibrary::probeFile(const std::string& path, LibraryEntry& entry)
+{
+    entry.format = Utils::getFileExtension(path);
+
+    // Decode once, keeping one peak per chunk; the thumbnail is folded from those at the end
+    std::vector<float> chunkPeaks;
+    std::vector<float> chunk;
+    uint64_t frameCount = 0;
+    uint32_t channels = 0;
+    uint32_t sampleRate = 0;
+    AsyncFileReader reader;
+
+    const auto accumulate = [&](uint64_t framesRead) {
+        float peak = 0.0f;
+        for (size_t i = 0; i < framesRead * channels; ++i)
+            peak = std::max(peak, std::abs(chunk[i]));
+        chunkPeaks.push_back(peak);
+        frameCount += framesRead;
+    };
+
+    if (entry.format == "wav")
+    {
+        drwav wav;
+        if (!DecoderInput::openWav(wav, path, reader))
+            return false;
+        channels = wav.channels;
+        sampleRate = wav.sampleRate;
+        chunk.resize(static_cast<size_t>(kProbeChunkFrames) * channels);
+        drwav_uint64 framesRead = 0;
+        while (channels > 0 && (framesRead = drwav_read_pcm_frames_f32(&wav, kProbeChunkFrames, chunk.data())) > 0)
+            accumulate(framesRead);
+        drwav_uninit(&wav);
+    }
+    else if (entry.format == "mp3")
+    {
+        drmp3 mp3;
+        if (!DecoderInput::openMp3(mp3, path, reader))
+            return false;
+        channels = mp3.channels;
+        sampleRate = mp3.sampleRate;
+        chunk.resize(static_cast<size_t>(kProbeChunkFrames) * channels);
+        drmp3_uint64 framesRead = 0;
+        while (channels > 0 && (framesRead = drmp3_read_pcm_frames_f32(&mp3, kProbeChunkFrames, chunk.data())) > 0)
+            accumulate(framesRead);
+        drmp3_uninit(&mp3);
+    }
+
+    if (frameCount == 0 || channels == 0 || sampleRate == 0)
+        return false;
+
+    entry.channelCount = channels;
+    entry.sampleRate = sampleRate;
+    entry.durationSeconds = static_cast<float>(static_cast<double>(frameCount) / sampleRate);
+
+    entry.thumbnail.assign(THUMBNAIL_BUCKETS, 0);
+    const size_t chunkCount = chunkPeaks.size();
+    for (size_t bucket = 0; bucket < THUMBNAIL_BUCKETS; ++bucket)
+    {
+        const size_t begin = bucket * chunkCount / THUMBNAIL_BUCKETS;
+        const size_t end = std::max(begin + 1, (bucket + 1) * chunkCount / THUMBNAIL_BUCKETS);
+        float peak = 0.0f;
+        for (size_t i = begin; i < end && i < chunkCount; ++i)
+            peak = std::max(peak, chunkPeaks[i]);
+        entry.thumbnail[bucket] = static_cast<uint8_t>(std::lround(std::min(peak, 1.0f) * 255.0f));
+    }
+    return true;
+}
+
+std::string TrackLibrary::findSettingsFile(const std::string& audioPath)
+{
+    // Either "<stem>.songpractice.json" or the "<stem>-settings.songpractice.json" that
+    // "Save Track Settings..." proposes by default
+    std::error_code error;
+    const std::string sameStem = SettingsManager::getTrackSettingsPath(audioPath);
+    if (std::filesystem::exists(sameStem, error))
+        return sameStem;
+
+    const std::filesystem::path path(audioPath);
+    const std::string suffixed = path.parent_path().string() + "/" + path.stem().string() + "-settings" + kSettingsSuffix;
+    if (std::filesystem::exists(suffixed, error))
+        return suffixed;
+
+    return {};
+}
+
+std::string TrackLibrary::makeSearchKey(const std::string& path)
+{
+    const std::filesystem::path filePath(path);
+    return toLower(filePath.parent_path().filename().string() + "/" + filePath.filename().string());
+}
+
+void TrackLibrary::startScan(std::vector<std::string> explicitPaths)
+{
+    if (m_roots.empty())
+        return;
+
+    if (m_scanning.load())
+    {
+        // Picked up again by update() once the running scan is done
+        if (explicitPaths.empty())
+        {
+            m_rescanRequested = true;
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_resultsMutex);
+            m_changedPaths.insert(m_changedPaths.end(), explicitPaths.begin(), explicitPaths.end());
+        }
+        return;
+    }
+
+    if (m_scanThread.joinable())
+        m_scanThread.join();
+
+    std::unordered_map<std::string, FileStamp> known;
+    known.reserve(m_entries.size());
+    for (const LibraryEntry& entry : m_entries)
+        known[entry.path] = FileStamp{entry.fileSize, entry.modifiedTime, entry.contentHash, entry.settingsPath};
+
+    m_scanning.store(true);
+    m_probeTotal.store(0);
+    m_probeDone.store(0);
+    m_scanThread = std::thread(&TrackLibrary::scanWorker, this, m_roots, std::move(explicitPaths), std::move(known));
+}
+
+void TrackLibrary::scanWorker(std::vector<std::string> roots,
+                              std::vector<std::string> explicitPaths,
+                              std::unordered_map<std::string, FileStamp> known)
+{
+    RealtimeSupport::configureWorkerThread();
+    std::vector<std::string> toProbe;
+    std::vector<LibraryEntry> refreshed;  // Unchanged audio whose settings file appeared or vanished
+    std::vector<std::string> removed;
+    std::unordered_set<std::string> seen;
+
+    const auto visit = [&](const std::string& path) {
+        if (!isSupportedAudio(path) || !seen.insert(path).second)
+            return;
+
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+        if (!statFile(path, size, modifiedTime))
+        {
+            if (known.count(path) > 0)
+                removed.push_back(path);
+            return;
+        }
+
+        const auto it = known.find(path);
+        if (it == known.end() || it->second.size != size || it->second.modifiedTime != modifiedTime)
+        {
+            toProbe.push_back(path);
+            return;
+        }
+
+        const std::string settingsPath = findSettingsFile(path);
+        if (settingsPathChanged(settingsPath, it->second.settingsPath))
+        {
+            LibraryEntry entry;
+            entry.path = path;
+            entry.settingsPath = settingsPath;
+            refreshed.push_back(std::move(entry));
+        }
+    };
+
+    const auto walk = [&](const std::string& directory) {
+        std::error_code error;
+        const auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (std::filesystem::recursive_directory_iterator it(directory, options, error), end;
+             it != end && !m_cancelScan.load();
+             it.increment(error))
+        {
+            if (error)
+                break;
+            if (it->is_regular_file(error))
+                visit(it->path().string());
+        }
+    };
+
+    if (explicitPaths.empty())
+    {
+        for (const std::string& root : roots)
+            walk(root);
+
+        // Everything known but not found under the current roots is gone
+        for (const auto& [path, stamp] : known)
+        {
+            if (seen.count(path) == 0)
+                removed.push_back(path);
+        }
+    }
+    else
+    {
+        for (const std::string& path : explicitPaths)
+        {
+            std::error_code error;
+            if (std::filesystem::is_directory(path, error))
+            {
+                walk(path);
+            }
+            else if (Utils::stringEndsWith(path, kSettingsSuffix))
+            {
+                // A settings file changed: re-check the audio files it may belong to
+                std::string stem = std::filesystem::path(path).filename().string();
+                stem.resize(stem.size() - std::strlen(kSettingsSuffix));
+                if (Utils::stringEndsWith(stem, "-settings"))
+                    stem.resize(stem.size() - std::strlen("-settings"));
+                const std::string base = std::filesystem::path(path).parent_path().string() + "/" + stem;
+                visit(base + ".wav");
+                visit(base + ".mp3");
+            }
+            else
+            {
+                visit(path);
+            }
+        }
+    }
+
+    // A new path with the size and sampled hash of a vanished entry is that file moved or
+    // renamed: it keeps its thumbnail and settings instead of being probed again. Only new
+    // files whose size matches a vanished one are hashed here.
+    std::vector<std::pair<std::string, LibraryEntry>> moved;
+    if (!removed.empty())
+    {
+        std::unordered_multimap<uint64_t, std::string> vanishedBySize;
+        for (const std::string& path : removed)
+        {
+            const auto it = known.find(path);
+            if (it != known.end() && it->second.contentHash != 0)
+                vanishedBySize.emplace(it->second.size, path);
+        }
+
+        std::vector<std::string> unmatched;
+        for (std::string& path : toProbe)
+        {
+            uint64_t size = 0;
+            int64_t modifiedTime = 0;
+            if (known.count(path) > 0 || !statFile(path, size, modifiedTime) || vanishedBySize.count(size) == 0)
+            {
+                unmatched.push_back(std::move(path));
+                continue;
+            }
+
+            const uint64_t hash = hashFileContents(path, size);
+            const auto [first, last] = vanishedBySize.equal_range(size);
+            const auto match = std::find_if(first, last, [&](const auto& candidate) {
+                return known[candidate.second].contentHash == hash;
+            });
+            if (match == last)
+            {
+                unmatched.push_back(std::move(path));
+                continue;
+            }
+
+            const FileStamp& stamp = known[match->second];
+            LibraryEntry entry;
+            entry.path = path;
+            entry.fileSize = size;
+            entry.modifiedTime = modifiedTime;
+            entry.settingsPath = findSettingsFile(path);
+            if (!settingsPathChanged(entry.settingsPath, stamp.settingsPath))
+                entry.settingsPath = stamp.settingsPath;
+
+            removed.erase(std::find(removed.begin(), removed.end(), match->second));
+            moved.emplace_back(match->second, std::move(entry));
+            vanishedBySize.erase(match);
+        }
+        toProbe.swap(unmatched);
+    }
+
+    // Probe changed files in parallel; results are handed over as they complete
+    m_probeTotal.store(static_cast<uint32_t>(toProbe.size()));
+    std::atomic<size_t> nextFile{0};
+    const auto probeWorker = [&]() {
+        while (!m_cancelScan.load())
+        {
+            const size_t index = nextFile.fetch_add(1);
+            if (index >= toProbe.size())
+                break;
+
+            LibraryEntry entry;
+            entry.path = toProbe[index];
+            if (statFile(entry.path, entry.fileSize, entry.modifiedTime) && probeFile(entry.path, entry))
+            {
+                entry.contentHash = hashFileContents(entry.path, entry.fileSize);
+                entry.settingsPath = findSettingsFile(entry.path);
+                std::lock_guard<std::mutex> lock(m_resultsMutex);
+                m_probedEntries.push_back(std::move(entry));
+            }
+            else
+            {
+                std::cerr << "TrackLibrary: Could not probe " << entry.path << std::endl;
+            }
+            m_probeDone.fetch_add(1);
+        }
+    };
+
+    const size_t workerCount = std::min<size_t>(toProbe.size(), std::clamp(std::thread::hardware_concurrency(), 2u, 16u));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < workerCount; ++i)
+        workers.emplace_back(probeWorker);
+    if (workerCount > 0)
+        probeWorker();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    {
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        m_settingsUpdates.insert(m_settingsUpdates.end(),
+                                 std::make_move_iterator(refreshed.begin()),
+                                 std::make_move_iterator(refreshed.end()));
+        m_movedEntries.insert(m_movedEntries.end(), std::make_move_iterator(moved.begin()), std::make_move_iterator(moved.end()));
+        m_removedPaths.insert(m_removedPaths.end(), removed.begin(), removed.end());
+    }
+
+    if (!toProbe.empty() || !moved.empty() || !removed.empty())
+    {
+        std::cout << "TrackLibrary: Scan finished (" << toProbe.size() << " probed, " << moved.size()
+                  << " moved, " << removed.size() << " removed)" << std::endl;
+    }
+    m_scanning.store(false);
+}
+
+void TrackLibrary::restartWatcher()
+{
+    m_watcher.stop();
+    if (m_roots.empty())
+        return;
+
+    m_watcher.start(m_roots, [this](const std::string& path) {
+        // Only audio, settings files and new folders are of interest
+        std::error_code error;
+        if (!isSupportedAudio(path) && !Utils::stringEndsWith(path, kSettingsSuffix)
+            && !std::filesystem::is_directory(path, error))
+            return;
+
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        m_changedPaths.push_back(path);
+        m_lastChange = Clock::now();
+    });
+}
+
+std::string TrackLibrary::serializeIndex() const
+{
+    std::string out;
+    out.reserve(64 + m_entries.size() * 192);
+    out.append(kIndexMagic, sizeof(kIndexMagic));
+
+    put(out, static_cast<uint32_t>(m_roots.size()));
+    for (const std::string& root : m_roots)
+        putString(out, root);
+
+    put(out, static_cast<uint32_t>(m_entries.size()));
+    for (const LibraryEntry& entry : m_entries)
+    {
+        putString(out, entry.path);
+        putString(out, entry.format);
+        putString(out, entry.settingsPath);
+        put(out, entry.fileSize);
+        put(out, entry.modifiedTime);
+        put(out, entry.contentHash);
+        put(out, entry.durationSeconds);
+        put(out, entry.sampleRate);
+        put(out, entry.channelCount);
+        put(out, static_cast<uint8_t>(std::min<size_t>(entry.thumbnail.size(), UINT8_MAX)));
+        out.append(reinterpret_cast<const char*>(entry.thumbnail.data()), std::min<size_t>(entry.thumbnail.size(), UINT8_MAX));
+    }
+    return out;
+}
+
+void TrackLibrary::saveIndexAsync()
+{
+    if (!m_indexDirty)
+        m_indexDirtySince = Clock::now();
+    m_indexDirty = true;
+}
+
+void TrackLibrary::flushIndex(bool force)
+{
+    if (!m_indexDirty || (!force && Clock::now() - m_indexDirtySince < kIndexSaveDelay))
+        return;
+    m_indexDirty = false;
+
+    // A write still in progress is not waited for; the writer picks up the newest index after it
+    std::string data = serializeIndex();
+    {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        m_pendingIndex = std::move(data);
+        m_hasPendingIndex = true;
+    }
+    m_writerWake.notify_all();
+}
+
+void TrackLibrary::indexWriter()
+{
+    RealtimeSupport::configureWorkerThread();
+    Trace::setThreadName("Library index");
+    const std::string path = getIndexPath();
+    std::unique_lock<std::mutex> lock(m_writerMutex);
+    while (true)
+    {
+        m_writerWake.wait(lock, [this]() { return m_hasPendingIndex || m_stopWriter; });
+        if (!m_hasPendingIndex)
+            break;
+
+        const std::string data = std::move(m_pendingIndex);
+        m_pendingIndex.clear();
+        m_hasPendingIndex = false;
+        lock.unlock();
+        if (!Utils::writeFileAtomically(path, data))
+            std::cerr << "TrackLibrary: Failed to write index " << path << std::endl;
+        lock.lock();
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "platform/DirectoryWatcher.h"
+
+struct LibraryEntry
+{
+    std::string path;
+    std::string format;        // File extension, e.g. "wav" or "mp3"
+    std::string settingsPath;  // Associated .songpractice.json, empty if none
+    uint64_t fileSize = 0;
+    int64_t modifiedTime = 0;
+    uint64_t contentHash = 0;  // Sampled: size plus the first and last 64 KiB
+    float durationSeconds = 0.0f;
+    uint32_t sampleRate = 0;
+    uint32_t channelCount = 0;
+    std::vector<uint8_t> thumbnail;  // Peak envelope, 0..255 per bucket
+};
+
+// Song collection backed by a compact binary index next to the executable.
+// Scans run in the background and only re-probe files whose size or
+// modification time changed; a file that moved or was renamed is recognised
+// by its content hash and keeps its entry. On Linux, inotify keeps the index
+// current.
+class TrackLibrary
+{
+public:
+    static constexpr size_t THUMBNAIL_BUCKETS = 64;
+
+    TrackLibrary();
+    ~TrackLibrary();
+
+    bool loadIndex();
+    std::string getIndexPath() const;
+
+    void setRoots(const std::vector<std::string>& roots);
+    const std::vector<std::string>& roots() const;
+
+    // Starts an incremental scan of all roots (no-op if one is already running)
+    void rescan();
+    bool isScanning() const;
+    float scanProgress() const;
+    bool isWatching() const;
+
+    // Merges scanner and watcher results into entries(); call once per frame on the UI thread.
+    // Returns true when the entries changed.
+    bool update();
+
+    const std::vector<LibraryEntry>& entries() const;
+    uint64_t revision() const;
+
+    // Indices of entries matching every whitespace-separated term of query
+    // (case-insensitive, file and folder names) and formatFilter ("" for any)
+    void search(const std::string& query, const std::string& formatFilter, std::vector<size_t>& outIndices) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct FileStamp
+    {
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+        uint64_t contentHash = 0;
+        std::string settingsPath;
+    };
+
+    static bool probeFile(const std::string& path, LibraryEntry& entry);
+    static std::string findSettingsFile(const std::string& audioPath);
+    static std::string makeSearchKey(const std::string& path);
+
+    void startScan(std::vector<std::string> explicitPaths);
+    void scanWorker(std::vector<std::string> roots,
+                    std::vector<std::string> explicitPaths,
+                    std::unordered_map<std::string, FileStamp> known);
+    void restartWatcher();
+    // Marks the index dirty; update() hands it to the index writer once changes settle
+    void saveIndexAsync();
+    void flushIndex(bool force);
+    std::string serializeIndex() const;
+    void indexWriter();
+
+    std::vector<std::string> m_roots;
+    std::vector<LibraryEntry> m_entries;
+    std::vector<std::string> m_searchKeys;  // Lowercase "folder/file", parallel to m_entries
+    std::unordered_map<std::string, size_t> m_pathIndex;
+    uint64_t m_revision = 0;
+    bool m_rescanRequested = false;  // A full scan was asked for while another scan ran
+
+    // Scanner -> UI handoff
+    std::mutex m_resultsMutex;
+    std::vector<LibraryEntry> m_probedEntries;
+    std::vector<LibraryEntry> m_settingsUpdates;  // Only path and settingsPath are set
+    std::vector<std::pair<std::string, LibraryEntry>> m_movedEntries;  // Old path -> new path, stamp and settingsPath
+    std::vector<std::string> m_removedPaths;
+    std::vector<std::string> m_changedPaths;  // From the directory watcher
+    Clock::time_point m_lastChange;
+
+    bool m_indexDirty = false;
+    Clock::time_point m_indexDirtySince;
+
+    std::thread m_scanThread;
+
+    // UI -> index writer: the latest serialized index, written atomically off the UI thread
+    std::thread m_writerThread;
+    std::mutex m_writerMutex;
+    std::condition_variable m_writerWake;
+    std::string m_pendingIndex;
+    bool m_hasPendingIndex = false;
+    bool m_stopWriter = false;
+
+    std::atomic<bool> m_scanning{false};
+    std::atomic<bool> m_cancelScan{false};
+    std::atomic<uint32_t> m_probeTotal{0};
+    std::atomic<uint32_t> m_probeDone{0};
+    DirectoryWatcher m_watcher;
+
+    static constexpr const char* INDEX_FILENAME = "songpractice-library.idx";
+};
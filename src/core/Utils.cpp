@@ -1,28 +1,33 @@
 #include "Utils.h"
-#include <sstream>
-#include <iomanip>
 #include <algorithm>
 
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
+
 #ifdef _WIN32
     #include <windows.h>
 #elif defined(__APPLE__)
     #include <mach-o/dyld.h>
+    #include <fcntl.h>
     #include <unistd.h>
 #else
+    #include <fcntl.h>
     #include <unistd.h>
 #endif
 
 namespace Utils
 {
+    TimeText::TimeText(float seconds)
+    {
+        const int minutes = static_cast<int>(seconds) / 60;
+        const int secs = static_cast<int>(seconds) % 60;
+        std::snprintf(text, sizeof(text), "%02d:%02d", minutes, secs);
+    }
+
     std::string formatTime(float seconds)
     {
-        int minutes = static_cast<int>(seconds) / 60;
-        int secs = static_cast<int>(seconds) % 60;
-        
-        std::ostringstream oss;
-        oss << std::setfill('0') << std::setw(2) << minutes 
-            << ":" << std::setw(2) << secs;
-        return oss.str();
+        return TimeText(seconds).c_str();
     }
     
     std::string getFileName(const std::string& filePath)
@@ -32,6 +37,12 @@ namespace Utils
             return filePath;
         return filePath.substr(pos + 1);
     }
+
+    const char* getFileNameInPlace(const std::string& filePath)
+    {
+        const size_t pos = filePath.find_last_of("/\\");
+        return filePath.c_str() + (pos == std::string::npos ? 0 : pos + 1);
+    }
     
     std::string getFileExtension(const std::string& filePath)
     {
@@ -86,4 +97,71 @@ namespace Utils
         return ".";
 #endif
     }
-}
\ No newline at end of file
+
+    bool writeFileAtomically(const std::string& filePath, const std::string& contents)
+    {
+        const std::string tempPath = filePath + ".tmp";
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        DWORD written = 0;
+        const bool ok = WriteFile(file, contents.data(), static_cast<DWORD>(contents.size()), &written, nullptr)
+                        && written == contents.size()
+                        && FlushFileBuffers(file);
+        CloseHandle(file);
+        if (!ok)
+        {
+            DeleteFileA(tempPath.c_str());
+            return false;
+        }
+        if (!MoveFileExA(tempPath.c_str(), filePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        {
+            DeleteFileA(tempPath.c_str());
+            return false;
+        }
+#else
+        const int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+
+        size_t offset = 0;
+        bool ok = true;
+        while (ok && offset < contents.size())
+        {
+            const ssize_t written = ::write(fd, contents.data() + offset, contents.size() - offset);
+            if (written < 0)
+                ok = (errno == EINTR);
+            else
+                offset += static_cast<size_t>(written);
+        }
+        ok = ok && ::fsync(fd) == 0;
+        ok = (::close(fd) == 0) && ok;
+        if (!ok)
+        {
+            ::unlink(tempPath.c_str());
+            return false;
+        }
+
+        if (std::rename(tempPath.c_str(), filePath.c_str()) != 0)
+        {
+            ::unlink(tempPath.c_str());
+            return false;
+        }
+
+        // Persist the rename itself
+        std::string directory = std::filesystem::path(filePath).parent_path().string();
+        if (directory.empty())
+            directory = ".";
+        const int dirFd = ::open(directory.c_str(), O_RDONLY);
+        if (dirFd >= 0)
+        {
+            ::fsync(dirFd);
+            ::close(dirFd);
+        }
+#endif
+
+        return true;
+    }
+}
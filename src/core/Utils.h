@@ -3,15 +3,28 @@
 
 namespace Utils
 {
-    // Time formatting
+    // Time formatting ("MM:SS"). TimeText formats into itself, for per-frame UI text
+    struct TimeText
+    {
+        explicit TimeText(float seconds);
+        const char* c_str() const { return text; }
+
+        char text[16];
+    };
     std::string formatTime(float seconds);
     
     // File path utilities
     std::string getFileName(const std::string& filePath);
+    // Same as getFileName without copying: points into filePath
+    const char* getFileNameInPlace(const std::string& filePath);
     std::string getFileExtension(const std::string& filePath);
     bool isAudioFile(const std::string& filePath);
     bool stringEndsWith(const std::string& str, const std::string& suffix);
 
+    // Writes to a temporary sibling, syncs it and renames it over filePath, so the file
+    // on disk is always either the previous or the new version
+    bool writeFileAtomically(const std::string& filePath, const std::string& contents);
+
     // System utilities
     std::string getExecutableDirectory();
 }
\ No newline at end of file
@@ -1,9 +1,26 @@
 #include "immapp/immapp.h"
 #include "hello_imgui/hello_imgui.h"
 #include "ui/MainWindow.h"
+#include "audio/RealtimeCheckSession.h"
+#include "core/Trace.h"
+#include "platform/IoBenchmark.h"
+#include <cstring>
 
 int main(int argc, char **argv)
 {
+    if (argc > 1 && std::strcmp(argv[1], "--io-bench") == 0)
+        return IoBenchmark::run(std::vector<std::string>(argv + 2, argv + argc));
+    if (argc > 1 && std::strcmp(argv[1], "--rt-check") == 0)
+        return RealtimeCheckSession::run(std::vector<std::string>(argv + 2, argv + argc));
+
+    // `--trace <file>`: records from startup and writes the trace on exit
+    std::string traceFile;
+    if (argc > 2 && std::strcmp(argv[1], "--trace") == 0)
+    {
+        traceFile = argv[2];
+        Trace::setRecording(true);
+    }
+
     // Setup ImGui Bundle
     ImmApp::AddOnsParams addOnsParams;
     addOnsParams.withImplot = true;  // Enable ImPlot for waveform visualization
@@ -36,8 +53,10 @@ int main(int argc, char **argv)
     runnerParams.callbacks.PostInit = [&mainWindow]() {
         mainWindow.loadUserPrefs();
     };
-    runnerParams.callbacks.BeforeExit = [&mainWindow]() {
+    runnerParams.callbacks.BeforeExit = [&mainWindow, &traceFile]() {
         mainWindow.saveUserPrefs();
+        if (!traceFile.empty())
+            Trace::exportChromeJson(traceFile);
     };
     runnerParams.imGuiWindowParams.showMenu_View = false;
     runnerParams.imGuiWindowParams.showMenu_App_Quit = false;
@@ -0,0 +1,77 @@
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+namespace AllocationCounter
+{
+    namespace Detail
+    {
+        thread_local uint64_t t_allocations = 0;
+    }
+
+    void* countedMalloc(size_t size, void*)
+    {
+        noteAllocation();
+        return std::malloc(size);
+    }
+
+    void countedFree(void* pointer, void*)
+    {
+        std::free(pointer);
+    }
+}
+
+// The real-time checker replaces these itself and counts through noteAllocation()
+#ifndef SONGPRACTICE_RT_CHECK
+
+void* operator new(size_t size)
+{
+    AllocationCounter::noteAllocation();
+    void* pointer = std::malloc(size ? size : 1);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    AllocationCounter::noteAllocation();
+    void* pointer = std::malloc(size ? size : 1);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    AllocationCounter::noteAllocation();
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    AllocationCounter::noteAllocation();
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+#endif
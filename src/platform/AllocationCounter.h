@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Counts heap allocations per thread so the UI can show how many a frame makes. The
+// global operator new is replaced to count (AllocationCounter.cpp, or RealtimeChecker.cpp
+// in SONGPRACTICE_RT_CHECK builds); code allocating with malloc, such as ImGui, is counted
+// by routing it through countedMalloc/countedFree.
+namespace AllocationCounter
+{
+    namespace Detail
+    {
+        extern thread_local uint64_t t_allocations;
+    }
+
+    inline void noteAllocation()
+    {
+        ++Detail::t_allocations;
+    }
+
+    // Allocations made by the calling thread since it started
+    inline uint64_t threadAllocations()
+    {
+        return Detail::t_allocations;
+    }
+
+    // Signatures match ImGui::SetAllocatorFunctions
+    void* countedMalloc(size_t size, void* userData);
+    void countedFree(void* pointer, void* userData);
+}
@@ -0,0 +1,604 @@
+#include "AsyncFileReader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define SONGPRACTICE_HAVE_PREAD 1
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #define SONGPRACTICE_HAVE_IO_URING 1
+        #include <csignal>
+        #include <linux/io_uring.h>
+        #include <sys/mman.h>
+        #include <sys/syscall.h>
+        #include <sys/uio.h>
+    #endif
+#endif
+
+namespace
+{
+    constexpr size_t kBufferAlignment = 4096;
+    constexpr size_t kPoolThreads = 4;
+
+    // Summed over all readers when they close
+    struct TotalCounters
+    {
+        std::atomic<uint64_t> bytesRead{0};
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> latencyTotalNs{0};
+        std::atomic<uint64_t> latencyMaxNs{0};
+        std::atomic<uint64_t> waitNs{0};
+        std::atomic<uint64_t> elapsedNs{0};
+    };
+
+    TotalCounters s_totals;
+    std::atomic<bool> s_ioUringUnavailable{false};
+
+    uint64_t nanoseconds(std::chrono::steady_clock::duration duration)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    // Serves the reads of every reader on the thread pool backend
+    class ReadThreadPool
+    {
+    public:
+        static ReadThreadPool& instance()
+        {
+            static ReadThreadPool pool;
+            return pool;
+        }
+
+        void enqueue(std::function<void()> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_jobs.push_back(std::move(job));
+            }
+            m_wake.notify_one();
+        }
+
+    private:
+        ReadThreadPool()
+        {
+            for (size_t i = 0; i < kPoolThreads; ++i)
+                m_threads.emplace_back(&ReadThreadPool::run, this);
+        }
+
+        ~ReadThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_wake.notify_all();
+            for (std::thread& thread : m_threads)
+                thread.join();
+        }
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for (;;)
+            {
+                m_wake.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+                if (m_jobs.empty())
+                    return;
+                std::function<void()> job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+                lock.unlock();
+                job();
+                lock.lock();
+            }
+        }
+
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::deque<std::function<void()>> m_jobs;
+        std::vector<std::thread> m_threads;
+        bool m_stopping = false;
+    };
+}
+
+#ifdef SONGPRACTICE_HAVE_IO_URING
+
+// Minimal io_uring submission/completion queue on the raw system calls, so no liburing
+// is needed. Only the owning reader's thread touches it.
+class IoUringQueue
+{
+public:
+    ~IoUringQueue()
+    {
+        if (m_sqes)
+            munmap(m_sqes, m_sqesSize);
+        if (m_cqRing && m_cqRing != m_sqRing)
+            munmap(m_cqRing, m_cqRingSize);
+        if (m_sqRing)
+            munmap(m_sqRing, m_sqRingSize);
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+
+    bool init(unsigned entries)
+    {
+        m_vectors.resize(entries);
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0)
+            return false;
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap)
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+        m_sqRing = mapRegion(m_sqRingSize, IORING_OFF_SQ_RING);
+        m_cqRing = singleMmap ? m_sqRing : mapRegion(m_cqRingSize, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(mapRegion(m_sqesSize, IORING_OFF_SQES));
+        if (!m_sqRing || !m_cqRing || !m_sqes)
+            return false;
+
+        uint8_t* sq = static_cast<uint8_t*>(m_sqRing);
+        m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_sqEntries = params.sq_entries;
+
+        uint8_t* cq = static_cast<uint8_t*>(m_cqRing);
+        m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Completions report the slot as their user data; one request per slot at a time
+    bool submitRead(int fd, size_t slot, void* buffer, size_t length, uint64_t offset)
+    {
+        // The kernel may read the iovec until the request completes
+        iovec& vector = m_vectors[slot];
+        vector.iov_base = buffer;
+        vector.iov_len = length;
+
+        const unsigned tail = *m_sqTail;
+        if (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries)
+            return false;
+
+        const unsigned index = tail & m_sqMask;
+        io_uring_sqe& sqe = m_sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(&vector);
+        sqe.len = 1;
+        sqe.off = offset;
+        sqe.user_data = slot;
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+        int submitted;
+        while ((submitted = enter(1, 0, 0)) < 0 && errno == EINTR)
+        {
+        }
+        if (submitted == 1 || __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) != tail)
+            return true;
+        // Not consumed by the kernel; take the entry back so it can never run later
+        __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    // Pops one completion; with wait, blocks until one arrives
+    bool popCompletion(bool wait, uint64_t& userData, int64_t& result)
+    {
+        for (;;)
+        {
+            const unsigned head = *m_cqHead;
+            if (head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+            {
+                const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+                userData = cqe.user_data;
+                result = cqe.res;
+                __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            if (!wait || (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR))
+                return false;
+        }
+    }
+
+private:
+    void* mapRegion(size_t size, off_t offset) const
+    {
+        void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        return (region == MAP_FAILED) ? nullptr : region;
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags) const
+    {
+        return static_cast<int>(syscall(__NR_io_uring_enter, m_fd, toSubmit, minComplete, flags, nullptr, _NSIG / 8));
+    }
+
+    int m_fd = -1;
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    size_t m_sqesSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+    std::vector<iovec> m_vectors;
+};
+
+#else
+
+class IoUringQueue
+{
+};
+
+#endif
+
+double AsyncFileReader::Stats::throughputMiBs() const
+{
+    if (elapsedNs == 0)
+        return 0.0;
+    return (static_cast<double>(bytesRead) / (1024.0 * 1024.0)) / (static_cast<double>(elapsedNs) * 1e-9);
+}
+
+double AsyncFileReader::Stats::averageLatencyMs() const
+{
+    return (requests > 0) ? static_cast<double>(latencyTotalNs) / static_cast<double>(requests) * 1e-6 : 0.0;
+}
+
+AsyncFileReader::AsyncFileReader() = default;
+
+AsyncFileReader::~AsyncFileReader()
+{
+    close();
+}
+
+const char* AsyncFileReader::backendName(Backend backend)
+{
+    switch (backend)
+    {
+    case Backend::Auto:
+        return "auto";
+    case Backend::IoUring:
+        return "io_uring";
+    case Backend::ThreadPool:
+        return "pread pool";
+    }
+    return "";
+}
+
+bool AsyncFileReader::open(const std::string& filePath, Backend backend)
+{
+    close();
+
+#ifdef SONGPRACTICE_HAVE_PREAD
+    m_fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(m_fd, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_size = static_cast<uint64_t>(info.st_size);
+  #ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  #endif
+#else
+    (void)filePath;
+    (void)backend;
+    return false;
+#endif
+
+    m_filePath = filePath;
+    m_position = 0;
+    m_primed = false;
+    m_failed = false;
+    m_stats = Stats();
+    m_openTime = Clock::now();
+
+    m_backend = Backend::ThreadPool;
+#ifdef SONGPRACTICE_HAVE_IO_URING
+    if (backend != Backend::ThreadPool && !s_ioUringUnavailable.load())
+    {
+        auto ring = std::make_unique<IoUringQueue>();
+        if (ring->init(static_cast<unsigned>(WINDOW_COUNT)))
+        {
+            m_ring = std::move(ring);
+            m_backend = Backend::IoUring;
+        }
+        else if (!s_ioUringUnavailable.exchange(true))
+        {
+            std::cerr << "AsyncFileReader: io_uring unavailable (" << std::strerror(errno)
+                      << "), using the pread thread pool" << std::endl;
+        }
+    }
+#endif
+
+    for (Window& window : m_windows)
+    {
+        if (!window.buffer)
+            window.buffer = static_cast<uint8_t*>(::operator new(WINDOW_BYTES, std::align_val_t(kBufferAlignment)));
+        window.state.store(Idle);
+    }
+    return true;
+}
+
+void AsyncFileReader::close()
+{
+    if (m_fd >= 0)
+    {
+        // The backend may still write into the buffers
+        drain();
+        m_ring.reset();
+#ifdef SONGPRACTICE_HAVE_PREAD
+        ::close(m_fd);
+#endif
+        m_fd = -1;
+
+        m_stats.elapsedNs = nanoseconds(Clock::now() - m_openTime);
+        s_totals.bytesRead.fetch_add(m_stats.bytesRead);
+        s_totals.requests.fetch_add(m_stats.requests);
+        s_totals.latencyTotalNs.fetch_add(m_stats.latencyTotalNs);
+        s_totals.waitNs.fetch_add(m_stats.waitNs);
+        s_totals.elapsedNs.fetch_add(m_stats.elapsedNs);
+        uint64_t previousMax = s_totals.latencyMaxNs.load();
+        while (previousMax < m_stats.latencyMaxNs
+               && !s_totals.latencyMaxNs.compare_exchange_weak(previousMax, m_stats.latencyMaxNs))
+        {
+        }
+    }
+
+    for (Window& window : m_windows)
+    {
+        if (window.buffer)
+            ::operator delete(window.buffer, std::align_val_t(kBufferAlignment));
+        window.buffer = nullptr;
+    }
+}
+
+size_t AsyncFileReader::read(void* out, size_t bytes)
+{
+    if (m_fd < 0)
+        return 0;
+
+    uint8_t* destination = static_cast<uint8_t*>(out);
+    size_t copied = 0;
+    while (copied < bytes && m_position < m_size)
+    {
+        Window& window = windowFor(m_position);
+        if (!waitFor(window))
+            break;
+
+        const uint64_t offsetInWindow = m_position - window.offset;
+        if (offsetInWindow >= window.length)
+            break;
+
+        const size_t count = static_cast<size_t>(std::min<uint64_t>(bytes - copied, window.length - offsetInWindow));
+        std::memcpy(destination + copied, window.buffer + offsetInWindow, count);
+        copied += count;
+        m_position += count;
+    }
+    return copied;
+}
+
+bool AsyncFileReader::seek(uint64_t offset)
+{
+    if (m_fd < 0 || offset > m_size)
+        return false;
+    // The read-ahead moves on the next read()
+    m_position = offset;
+    return true;
+}
+
+AsyncFileReader::Stats AsyncFileReader::stats() const
+{
+    Stats stats = m_stats;
+    if (m_fd >= 0)
+        stats.elapsedNs = nanoseconds(Clock::now() - m_openTime);
+    return stats;
+}
+
+AsyncFileReader::Stats AsyncFileReader::totalStats()
+{
+    Stats stats;
+    stats.bytesRead = s_totals.bytesRead.load();
+    stats.requests = s_totals.requests.load();
+    stats.latencyTotalNs = s_totals.latencyTotalNs.load();
+    stats.latencyMaxNs = s_totals.latencyMaxNs.load();
+    stats.waitNs = s_totals.waitNs.load();
+    stats.elapsedNs = s_totals.elapsedNs.load();
+    return stats;
+}
+
+AsyncFileReader::Window& AsyncFileReader::windowFor(uint64_t position)
+{
+    const uint64_t ringEnd = m_ringOffset + WINDOW_COUNT * WINDOW_BYTES;
+    if (!m_primed || position < m_ringOffset || position >= ringEnd)
+    {
+        restartAt(position);
+        return m_windows[m_head];
+    }
+
+    // Recycle consumed windows for the range after the ring
+    while (position >= m_ringOffset + WINDOW_BYTES)
+    {
+        waitFor(m_windows[m_head]);
+        submit(m_head, m_ringOffset + WINDOW_COUNT * WINDOW_BYTES);
+        m_ringOffset += WINDOW_BYTES;
+        m_head = (m_head + 1) % WINDOW_COUNT;
+    }
+    return m_windows[m_head];
+}
+
+void AsyncFileReader::restartAt(uint64_t position)
+{
+    drain();
+    m_head = 0;
+    m_ringOffset = position - position % WINDOW_BYTES;
+    for (size_t index = 0; index < WINDOW_COUNT; ++index)
+        submit(index, m_ringOffset + index * WINDOW_BYTES);
+    m_primed = true;
+}
+
+void AsyncFileReader::submit(size_t index, uint64_t offset)
+{
+    Window& window = m_windows[index];
+    window.offset = offset;
+    if (offset >= m_size)
+    {
+        window.length = 0;
+        window.state.store(Idle);
+        return;
+    }
+
+    window.length = static_cast<size_t>(std::min<uint64_t>(WINDOW_BYTES, m_size - offset));
+    window.result = 0;
+    window.submitted = Clock::now();
+    window.state.store(InFlight);
+    ++m_stats.requests;
+
+#ifdef SONGPRACTICE_HAVE_IO_URING
+    if (m_ring)
+    {
+        if (m_ring->submitRead(m_fd, index, window.buffer, window.length, offset))
+            return;
+        // Ring full or rejected; read synchronously so the window is never lost
+        completeWindow(index, readAt(window.buffer, window.length, offset));
+        return;
+    }
+#endif
+
+    ReadThreadPool::instance().enqueue([this, index]() {
+        Window& target = m_windows[index];
+        const int64_t result = readAt(target.buffer, target.length, target.offset);
+        {
+            std::lock_guard<std::mutex> lock(m_completionMutex);
+            completeWindow(index, result);
+        }
+        m_completion.notify_all();
+    });
+}
+
+void AsyncFileReader::completeWindow(size_t index, int64_t result)
+{
+    Window& window = m_windows[index];
+    window.result = result;
+    window.latencyNs = nanoseconds(Clock::now() - window.submitted);
+    window.state.store(Complete);
+}
+
+bool AsyncFileReader::waitFor(Window& window)
+{
+    if (window.state.load() == InFlight)
+    {
+        const Clock::time_point waitStart = Clock::now();
+#ifdef SONGPRACTICE_HAVE_IO_URING
+        if (m_ring)
+        {
+            uint64_t index = 0;
+            int64_t result = 0;
+            while (window.state.load() == InFlight && m_ring->popCompletion(true, index, result))
+            {
+                if (index < WINDOW_COUNT)
+                    completeWindow(static_cast<size_t>(index), result);
+            }
+        }
+        else
+#endif
+        {
+            std::unique_lock<std::mutex> lock(m_completionMutex);
+            m_completion.wait(lock, [&window]() { return window.state.load() != InFlight; });
+        }
+        m_stats.waitNs += nanoseconds(Clock::now() - waitStart);
+    }
+
+    if (window.state.load() == Complete)
+    {
+        m_stats.latencyTotalNs += window.latencyNs;
+        m_stats.latencyMaxNs = std::max(m_stats.latencyMaxNs, window.latencyNs);
+
+        int64_t result = window.result;
+        if (result >= 0 && static_cast<size_t>(result) < window.length)
+        {
+            // Short read (network file systems may return less than asked); fetch the rest now
+            const int64_t rest = readAt(window.buffer + result, window.length - static_cast<size_t>(result),
+                                        window.offset + static_cast<uint64_t>(result));
+            result = (rest < 0) ? rest : result + rest;
+        }
+
+        if (result < 0)
+        {
+            if (!m_failed)
+                std::cerr << "AsyncFileReader: Failed to read " << m_filePath << " at offset " << window.offset
+                          << ": " << std::strerror(static_cast<int>(-result)) << std::endl;
+            m_failed = true;
+            result = 0;
+        }
+        window.length = static_cast<size_t>(result);
+        m_stats.bytesRead += window.length;
+        window.state.store(Ready);
+    }
+
+    return window.state.load() == Ready && window.length > 0;
+}
+
+int64_t AsyncFileReader::readAt(uint8_t* buffer, size_t bytes, uint64_t offset) const
+{
+#ifdef SONGPRACTICE_HAVE_PREAD
+    size_t total = 0;
+    while (total < bytes)
+    {
+        const ssize_t count = ::pread(m_fd, buffer + total, bytes - total, static_cast<off_t>(offset + total));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return -errno;
+        if (count == 0)
+            break;
+        total += static_cast<size_t>(count);
+    }
+    return static_cast<int64_t>(total);
+#else
+    (void)buffer;
+    (void)bytes;
+    (void)offset;
+    return -1;
+#endif
+}
+
+void AsyncFileReader::drain()
+{
+    for (Window& window : m_windows)
+        waitFor(window);
+}
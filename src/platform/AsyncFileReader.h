@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class IoUringQueue;
+
+// Sequential file reader that keeps WINDOW_COUNT large aligned reads in flight ahead of
+// the consumer, so decoding overlaps with slow (network) storage instead of stalling on
+// every small read. Reads go through io_uring on Linux when the kernel allows it and
+// through a small shared pool of pread threads otherwise. Seeking is allowed; a seek out
+// of the buffered range restarts the read-ahead at the new position.
+//
+// A reader is used by one thread at a time. open() returns false on platforms without
+// pread, and callers fall back to their blocking file functions.
+class AsyncFileReader
+{
+public:
+    enum class Backend
+    {
+        Auto,        // io_uring when available, else the thread pool
+        IoUring,
+        ThreadPool
+    };
+
+    struct Stats
+    {
+        uint64_t bytesRead = 0;       // Delivered by the backend
+        uint64_t requests = 0;
+        uint64_t latencyTotalNs = 0;  // Submission to completion, summed over requests
+        uint64_t latencyMaxNs = 0;
+        uint64_t waitNs = 0;          // Time the consumer blocked on a window
+        uint64_t elapsedNs = 0;       // open() to close() (or now)
+
+        double throughputMiBs() const;
+        double averageLatencyMs() const;
+    };
+
+    static constexpr size_t WINDOW_BYTES = size_t(1) << 20;
+    static constexpr size_t WINDOW_COUNT = 4;
+
+    AsyncFileReader();
+    ~AsyncFileReader();
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+    bool open(const std::string& filePath, Backend backend = Backend::Auto);
+    void close();
+    bool isOpen() const { return m_fd >= 0; }
+    Backend backend() const { return m_backend; }
+
+    uint64_t size() const { return m_size; }
+    uint64_t tell() const { return m_position; }
+    // Blocks only when the window holding the position has not arrived yet
+    size_t read(void* out, size_t bytes);
+    bool seek(uint64_t offset);
+
+    // Counters of this reader (kept after close()) and the sum over all closed readers
+    Stats stats() const;
+    static Stats totalStats();
+    static const char* backendName(Backend backend);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum WindowState : int
+    {
+        Idle,       // Past the end of the file
+        InFlight,
+        Complete,   // Finished by the backend, not yet seen by the consumer
+        Ready
+    };
+
+    struct Window
+    {
+        uint8_t* buffer = nullptr;   // WINDOW_BYTES, page aligned
+        uint64_t offset = 0;
+        size_t length = 0;           // Bytes requested, then bytes available once Ready
+        std::atomic<int> state{Idle};
+        int64_t result = 0;          // Bytes read or -errno, written by the backend
+        uint64_t latencyNs = 0;
+        Clock::time_point submitted;
+    };
+
+    Window& windowFor(uint64_t position);
+    void restartAt(uint64_t position);
+    void submit(size_t index, uint64_t offset);
+    bool waitFor(Window& window);
+    void completeWindow(size_t index, int64_t result);
+    int64_t readAt(uint8_t* buffer, size_t bytes, uint64_t offset) const;
+    void drain();
+
+    int m_fd = -1;
+    Backend m_backend = Backend::ThreadPool;
+    std::string m_filePath;
+    uint64_t m_size = 0;
+    uint64_t m_position = 0;
+
+    std::array<Window, WINDOW_COUNT> m_windows;
+    size_t m_head = 0;             // Window holding m_ringOffset
+    uint64_t m_ringOffset = 0;
+    bool m_primed = false;
+    bool m_failed = false;         // A read error was logged
+
+    std::unique_ptr<IoUringQueue> m_ring;
+    std::mutex m_completionMutex;  // Thread pool completions
+    std::condition_variable m_completion;
+
+    Stats m_stats;
+    Clock::time_point m_openTime;
+};
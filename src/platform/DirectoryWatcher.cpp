@@ -0,0 +1,170 @@
+#include "DirectoryWatcher.h"
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+    #include <poll.h>
+    #include <sys/eventfd.h>
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    stop();
+}
+
+bool DirectoryWatcher::isRunning() const
+{
+    return m_running.load();
+}
+
+#ifdef __linux__
+
+namespace
+{
+    constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                    | IN_DELETE_SELF | IN_ONLYDIR;
+}
+
+bool DirectoryWatcher::start(const std::vector<std::string>& roots, ChangeCallback callback)
+{
+    stop();
+
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0)
+    {
+        std::cerr << "DirectoryWatcher: inotify_init1 failed" << std::endl;
+        return false;
+    }
+    m_wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeFd < 0)
+    {
+        std::cerr << "DirectoryWatcher: eventfd failed" << std::endl;
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+        return false;
+    }
+
+    // The roots are walked by run(); a large library must not hold up the caller
+    m_roots = roots;
+    m_callback = std::move(callback);
+    m_running.store(true);
+    m_thread = std::thread(&DirectoryWatcher::run, this);
+    return true;
+}
+
+void DirectoryWatcher::stop()
+{
+    m_running.store(false);
+    if (m_thread.joinable())
+    {
+        const uint64_t wake = 1;
+        [[maybe_unused]] const ssize_t written = ::write(m_wakeFd, &wake, sizeof(wake));
+        m_thread.join();
+    }
+    for (int* descriptor : {&m_inotifyFd, &m_wakeFd})
+    {
+        if (*descriptor >= 0)
+        {
+            ::close(*descriptor);
+            *descriptor = -1;
+        }
+    }
+    m_watchPaths.clear();
+}
+
+void DirectoryWatcher::watchTree(const std::string& root)
+{
+    std::error_code error;
+    if (!std::filesystem::is_directory(root, error))
+        return;
+
+    // inotify is not recursive: every directory needs its own watch
+    const int rootWatch = inotify_add_watch(m_inotifyFd, root.c_str(), kWatchMask);
+    if (rootWatch >= 0)
+        m_watchPaths[rootWatch] = root;
+
+    const auto options = std::filesystem::directory_options::skip_permission_denied;
+    for (std::filesystem::recursive_directory_iterator it(root, options, error), end; it != end; it.increment(error))
+    {
+        if (error || !m_running.load())
+            break;
+        if (!it->is_directory(error))
+            continue;
+        const std::string directory = it->path().string();
+        const int watch = inotify_add_watch(m_inotifyFd, directory.c_str(), kWatchMask);
+        if (watch >= 0)
+            m_watchPaths[watch] = directory;
+    }
+}
+
+void DirectoryWatcher::run()
+{
+    // Events that arrive during the walk queue up in the inotify fd
+    for (const std::string& root : m_roots)
+    {
+        if (!m_running.load())
+            return;
+        watchTree(root);
+    }
+
+    alignas(inotify_event) char buffer[16 * 1024];
+    pollfd descriptors[2] = {{m_inotifyFd, POLLIN, 0}, {m_wakeFd, POLLIN, 0}};
+
+    while (m_running.load())
+    {
+        // stop() writes the eventfd, so a quiet tree needs no periodic wake-up
+        if (::poll(descriptors, 2, -1) <= 0 || !(descriptors[0].revents & POLLIN))
+            continue;
+
+        const ssize_t length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0)
+            continue;
+
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            const auto watch = m_watchPaths.find(event->wd);
+            if (watch == m_watchPaths.end())
+                continue;
+
+            if (event->mask & (IN_DELETE_SELF | IN_IGNORED))
+            {
+                m_watchPaths.erase(watch);
+                continue;
+            }
+
+            const std::string path = (event->len > 0) ? watch->second + "/" + event->name : watch->second;
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                watchTree(path);
+
+            if (m_callback)
+                m_callback(path);
+        }
+    }
+}
+
+#else
+
+bool DirectoryWatcher::start(const std::vector<std::string>& /*roots*/, ChangeCallback /*callback*/)
+{
+    return false;
+}
+
+void DirectoryWatcher::stop()
+{
+    m_running.store(false);
+}
+
+void DirectoryWatcher::watchTree(const std::string& /*root*/)
+{
+}
+
+void DirectoryWatcher::run()
+{
+}
+
+#endif
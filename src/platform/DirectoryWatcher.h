@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Recursive change notifications for the track library.
+// Implemented with inotify on Linux; elsewhere start() returns false and the
+// library falls back to manual rescans. The directory walk that adds the watches
+// runs on the watcher thread, so start() and stop() return without touching the
+// file system.
+class DirectoryWatcher
+{
+public:
+    // Called from the watcher thread with the full path of a created, modified,
+    // moved or deleted entry
+    using ChangeCallback = std::function<void(const std::string& path)>;
+
+    DirectoryWatcher() = default;
+    ~DirectoryWatcher();
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    bool start(const std::vector<std::string>& roots, ChangeCallback callback);
+    void stop();
+    bool isRunning() const;
+
+private:
+    void watchTree(const std::string& root);
+    void run();
+
+    std::vector<std::string> m_roots;  // Walked by run() before it waits for events
+    ChangeCallback m_callback;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    int m_inotifyFd = -1;
+    int m_wakeFd = -1;  // eventfd written by stop() to interrupt the walk or the poll
+    std::unordered_map<int, std::string> m_watchPaths;  // watch descriptor -> directory; watcher thread only
+};
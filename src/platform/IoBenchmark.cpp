@@ -0,0 +1,149 @@
+#include "IoBenchmark.h"
+#include "AsyncFileReader.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Roughly what dr_mp3 asks for per refill; dr_wav asks for the caller's chunk
+    constexpr size_t kConsumerReadBytes = 16 * 1024;
+
+    struct RunResult
+    {
+        bool ok = false;
+        uint64_t bytes = 0;
+        double seconds = 0.0;
+        std::vector<double> readMs;  // Duration of every consumer read
+    };
+
+    // Drops the file's pages so the next read comes from the device (or the server)
+    bool dropPageCache(const std::string& filePath)
+    {
+#if defined(POSIX_FADV_DONTNEED)
+        const int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        const bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        ::close(fd);
+        return dropped;
+#else
+        (void)filePath;
+        return false;
+#endif
+    }
+
+    RunResult consume(const std::function<size_t(char*, size_t)>& readChunk)
+    {
+        RunResult result;
+        std::vector<char> buffer(kConsumerReadBytes);
+        const Clock::time_point start = Clock::now();
+        for (;;)
+        {
+            const Clock::time_point readStart = Clock::now();
+            const size_t count = readChunk(buffer.data(), buffer.size());
+            result.readMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - readStart).count());
+            if (count == 0)
+                break;
+            result.bytes += count;
+        }
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        result.ok = true;
+        return result;
+    }
+
+    RunResult runStdio(const std::string& filePath)
+    {
+        std::FILE* file = std::fopen(filePath.c_str(), "rb");
+        if (!file)
+            return RunResult();
+        RunResult result = consume([file](char* out, size_t bytes) { return std::fread(out, 1, bytes, file); });
+        std::fclose(file);
+        return result;
+    }
+
+    RunResult runAsync(const std::string& filePath, AsyncFileReader::Backend backend)
+    {
+        AsyncFileReader reader;
+        if (!reader.open(filePath, backend) || reader.backend() != backend)
+            return RunResult();
+        return consume([&reader](char* out, size_t bytes) { return reader.read(out, bytes); });
+    }
+
+    void printResult(const char* path, const char* cache, RunResult result)
+    {
+        std::cout << "  " << std::left << std::setw(11) << path << std::setw(5) << cache << std::right;
+        if (!result.ok)
+        {
+            std::cout << "  unavailable" << std::endl;
+            return;
+        }
+
+        std::sort(result.readMs.begin(), result.readMs.end());
+        const double p99 = result.readMs[std::min(result.readMs.size() - 1, result.readMs.size() * 99 / 100)];
+        const double throughput = (result.seconds > 0.0) ? (result.bytes / (1024.0 * 1024.0)) / result.seconds : 0.0;
+        std::cout << std::fixed << std::setprecision(1) << std::setw(9) << throughput << " MiB/s"
+                  << std::setprecision(3) << "   read p99 " << std::setw(8) << p99 << " ms   max "
+                  << std::setw(8) << result.readMs.back() << " ms" << std::defaultfloat << std::endl;
+    }
+}
+
+namespace IoBenchmark
+{
+    int run(const std::vector<std::string>& filePaths)
+    {
+        if (filePaths.empty())
+        {
+            std::cerr << "Usage: SongPractice --io-bench <file>..." << std::endl;
+            return 2;
+        }
+
+        struct Path
+        {
+            const char* name;
+            std::function<RunResult(const std::string&)> run;
+        };
+        const Path paths[] = {
+            {"stdio", runStdio},
+            {"pread pool", [](const std::string& file) { return runAsync(file, AsyncFileReader::Backend::ThreadPool); }},
+            {"io_uring", [](const std::string& file) { return runAsync(file, AsyncFileReader::Backend::IoUring); }},
+        };
+
+        int exitCode = 0;
+        for (const std::string& filePath : filePaths)
+        {
+            std::FILE* probe = std::fopen(filePath.c_str(), "rb");
+            if (!probe)
+            {
+                std::cerr << "IoBenchmark: Cannot open " << filePath << std::endl;
+                exitCode = 1;
+                continue;
+            }
+            std::fclose(probe);
+
+            std::cout << filePath << std::endl;
+            for (const Path& path : paths)
+            {
+                const bool cold = dropPageCache(filePath);
+                printResult(path.name, cold ? "cold" : "?", path.run(filePath));
+                printResult(path.name, "warm", path.run(filePath));
+            }
+        }
+
+        const AsyncFileReader::Stats totals = AsyncFileReader::totalStats();
+        std::cout << "AsyncFileReader: " << totals.requests << " reads, avg latency " << std::fixed
+                  << std::setprecision(3) << totals.averageLatencyMs() << " ms, max "
+                  << static_cast<double>(totals.latencyMaxNs) * 1e-6 << " ms" << std::defaultfloat << std::endl;
+        return exitCode;
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// `SongPractice --io-bench <file>...`: reads each file the way the decoders consume it
+// (small sequential reads) through stdio, as dr_libs' *_init_file functions do, and
+// through AsyncFileReader with each backend, once with a cold and once with a warm page
+// cache, and prints throughput and consumer stalls.
+namespace IoBenchmark
+{
+    // Returns the process exit code
+    int run(const std::vector<std::string>& filePaths);
+}
@@ -0,0 +1,526 @@
+#include "RealtimeChecker.h"
+
+#ifndef SONGPRACTICE_RT_CHECK
+
+namespace RealtimeChecker
+{
+    bool isEnabled()
+    {
+        return false;
+    }
+
+    void setTrap(bool)
+    {
+    }
+
+    uint64_t violationCount()
+    {
+        return 0;
+    }
+
+    uint64_t printSummary()
+    {
+        return 0;
+    }
+}
+
+#else
+
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__GLIBC__)
+    #define SONGPRACTICE_RT_CHECK_LIBC 1
+    #include <cxxabi.h>
+    #include <dlfcn.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <pthread.h>
+    #include <sys/syscall.h>
+    #include <time.h>
+    #include <unistd.h>
+
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void __libc_free(void* pointer);
+}
+#endif
+
+namespace
+{
+    using RealtimeChecker::Violation;
+
+    constexpr size_t kMaxSites = 512;
+
+    // Written from hooks, so no allocation: a fixed open-addressed table keyed by call site
+    struct Site
+    {
+        std::atomic<uintptr_t> address{0};
+        std::atomic<int> kind{0};
+        std::atomic<uint64_t> count{0};
+    };
+
+    Site s_sites[kMaxSites];
+    std::atomic<uint64_t> s_counts[static_cast<size_t>(Violation::Count)];
+    std::atomic<uint64_t> s_unrecordedSites{0};
+    std::atomic<bool> s_trap{false};
+
+    thread_local int t_callbackDepth = 0;  // > 0 while inside a CallbackScope
+    thread_local int t_hookDepth = 0;      // > 0 inside a hook; nested calls are the hook's own
+
+    const char* violationName(Violation kind)
+    {
+        switch (kind)
+        {
+        case Violation::Allocation:
+            return "allocation";
+        case Violation::Deallocation:
+            return "deallocation";
+        case Violation::MutexLock:
+            return "mutex lock";
+        case Violation::Stdio:
+            return "stdio";
+        case Violation::BlockingCall:
+            return "blocking call";
+        case Violation::Count:
+            break;
+        }
+        return "";
+    }
+
+    // Hooks call this first; it is a no-op outside the callback
+    void record(Violation kind, const void* caller, const char* function)
+    {
+        if (t_callbackDepth == 0 || t_hookDepth > 0)
+            return;
+        ++t_hookDepth;
+
+        s_counts[static_cast<size_t>(kind)].fetch_add(1);
+        const uintptr_t address = reinterpret_cast<uintptr_t>(caller);
+        size_t slot = (address >> 4) % kMaxSites;
+        bool stored = false;
+        for (size_t probe = 0; probe < kMaxSites && !stored; ++probe, slot = (slot + 1) % kMaxSites)
+        {
+            Site& site = s_sites[slot];
+            uintptr_t expected = 0;
+            if (site.address.compare_exchange_strong(expected, address))
+                site.kind.store(static_cast<int>(kind));
+            else if (expected != address)
+                continue;
+            site.count.fetch_add(1);
+            stored = true;
+        }
+        if (!stored)
+            s_unrecordedSites.fetch_add(1);
+
+        if (s_trap.load())
+        {
+            std::fprintf(stderr, "RealtimeChecker: %s (%s) on the audio thread from %p\n",
+                         violationName(kind), function, caller);
+            std::abort();
+        }
+        --t_hookDepth;
+    }
+
+    std::string describeAddress(uintptr_t address)
+    {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%#lx", static_cast<unsigned long>(address));
+        std::string description = buffer;
+#ifdef SONGPRACTICE_RT_CHECK_LIBC
+        Dl_info info;
+        if (dladdr(reinterpret_cast<void*>(address), &info) == 0)
+            return description;
+
+        if (info.dli_sname)
+        {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+            description = (status == 0 && demangled) ? demangled : info.dli_sname;
+            std::free(demangled);
+            std::snprintf(buffer, sizeof(buffer), "+%#lx",
+                          static_cast<unsigned long>(address - reinterpret_cast<uintptr_t>(info.dli_saddr)));
+            description += buffer;
+        }
+        if (info.dli_fname)
+        {
+            // Module offset for addr2line when the symbol is not exported
+            std::snprintf(buffer, sizeof(buffer), "+%#lx",
+                          static_cast<unsigned long>(address - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+            description += std::string(" (") + info.dli_fname + buffer + ")";
+        }
+#endif
+        return description;
+    }
+}
+
+namespace RealtimeChecker
+{
+    CallbackScope::CallbackScope()
+    {
+        ++t_callbackDepth;
+    }
+
+    CallbackScope::~CallbackScope()
+    {
+        --t_callbackDepth;
+    }
+
+    bool isEnabled()
+    {
+        return true;
+    }
+
+    void setTrap(bool trap)
+    {
+        s_trap.store(trap);
+    }
+
+    uint64_t violationCount()
+    {
+        uint64_t total = 0;
+        for (const std::atomic<uint64_t>& count : s_counts)
+            total += count.load();
+        return total;
+    }
+
+    uint64_t printSummary()
+    {
+        const uint64_t total = violationCount();
+        if (total == 0)
+        {
+            std::cerr << "RealtimeChecker: no real-time violations in the audio callback" << std::endl;
+            return 0;
+        }
+
+        std::cerr << "RealtimeChecker: " << total << " real-time violation(s) in the audio callback:";
+        for (size_t kind = 0; kind < static_cast<size_t>(Violation::Count); ++kind)
+        {
+            if (s_counts[kind].load() > 0)
+                std::cerr << " " << violationName(static_cast<Violation>(kind)) << " " << s_counts[kind].load();
+        }
+        std::cerr << std::endl;
+
+        std::vector<const Site*> sites;
+        for (const Site& site : s_sites)
+        {
+            if (site.address.load() != 0)
+                sites.push_back(&site);
+        }
+        std::sort(sites.begin(), sites.end(),
+                  [](const Site* a, const Site* b) { return a->count.load() > b->count.load(); });
+        for (const Site* site : sites)
+        {
+            std::cerr << "  " << site->count.load() << "x " << violationName(static_cast<Violation>(site->kind.load()))
+                      << " from " << describeAddress(site->address.load()) << std::endl;
+        }
+        if (s_unrecordedSites.load() > 0)
+            std::cerr << "  (" << s_unrecordedSites.load() << " more at sites beyond the table)" << std::endl;
+        return total;
+    }
+}
+
+// C++ allocation: caught here so the call site is the caller of new, not the C library
+void* operator new(size_t size)
+{
+    record(Violation::Allocation, __builtin_return_address(0), "operator new");
+    AllocationCounter::noteAllocation();
+    ++t_hookDepth;
+    void* pointer = std::malloc(size ? size : 1);
+    --t_hookDepth;
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    record(Violation::Allocation, __builtin_return_address(0), "operator new[]");
+    AllocationCounter::noteAllocation();
+    ++t_hookDepth;
+    void* pointer = std::malloc(size ? size : 1);
+    --t_hookDepth;
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    record(Violation::Allocation, __builtin_return_address(0), "operator new");
+    AllocationCounter::noteAllocation();
+    ++t_hookDepth;
+    void* pointer = std::malloc(size ? size : 1);
+    --t_hookDepth;
+    return pointer;
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    record(Violation::Allocation, __builtin_return_address(0), "operator new[]");
+    AllocationCounter::noteAllocation();
+    ++t_hookDepth;
+    void* pointer = std::malloc(size ? size : 1);
+    --t_hookDepth;
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    if (!pointer)
+        return;
+    record(Violation::Deallocation, __builtin_return_address(0), "operator delete");
+    ++t_hookDepth;
+    std::free(pointer);
+    --t_hookDepth;
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    if (!pointer)
+        return;
+    record(Violation::Deallocation, __builtin_return_address(0), "operator delete[]");
+    ++t_hookDepth;
+    std::free(pointer);
+    --t_hookDepth;
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    if (!pointer)
+        return;
+    record(Violation::Deallocation, __builtin_return_address(0), "operator delete");
+    ++t_hookDepth;
+    std::free(pointer);
+    --t_hookDepth;
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    if (!pointer)
+        return;
+    record(Violation::Deallocation, __builtin_return_address(0), "operator delete[]");
+    ++t_hookDepth;
+    std::free(pointer);
+    --t_hookDepth;
+}
+
+#ifdef SONGPRACTICE_RT_CHECK_LIBC
+
+// The C library's entry points, interposed from the executable. Allocation forwards to
+// glibc's own allocator and system calls go straight to the kernel, so those hooks work
+// before dlsym() can. Locks and stdio forward through dlsym() pointers; glibc's dynamic
+// loader takes its own locks internally, so resolving the mutex lazily cannot recurse.
+namespace
+{
+    using MutexLockFunction = int (*)(pthread_mutex_t*);
+    using VfprintfFunction = int (*)(FILE*, const char*, va_list);
+    using FwriteFunction = size_t (*)(const void*, size_t, size_t, FILE*);
+    using FputsFunction = int (*)(const char*, FILE*);
+    using FputcFunction = int (*)(int, FILE*);
+    using PutsFunction = int (*)(const char*);
+    using FflushFunction = int (*)(FILE*);
+
+    std::atomic<MutexLockFunction> s_mutexLock{nullptr};
+    VfprintfFunction s_vfprintf = nullptr;
+    FwriteFunction s_fwrite = nullptr;
+    FputsFunction s_fputs = nullptr;
+    FputcFunction s_fputc = nullptr;
+    FputcFunction s_putc = nullptr;
+    PutsFunction s_puts = nullptr;
+    FflushFunction s_fflush = nullptr;
+
+    template <typename Function>
+    Function resolve(const char* name)
+    {
+        return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+    }
+
+    __attribute__((constructor)) void resolveFunctions()
+    {
+        s_mutexLock.store(resolve<MutexLockFunction>("pthread_mutex_lock"));
+        s_vfprintf = resolve<VfprintfFunction>("vfprintf");
+        s_fwrite = resolve<FwriteFunction>("fwrite");
+        s_fputs = resolve<FputsFunction>("fputs");
+        s_fputc = resolve<FputcFunction>("fputc");
+        s_putc = resolve<FputcFunction>("putc");
+        s_puts = resolve<PutsFunction>("puts");
+        s_fflush = resolve<FflushFunction>("fflush");
+    }
+}
+
+extern "C"
+{
+    void* malloc(size_t size)
+    {
+        record(Violation::Allocation, __builtin_return_address(0), "malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        record(Violation::Allocation, __builtin_return_address(0), "calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* pointer, size_t size)
+    {
+        record(Violation::Allocation, __builtin_return_address(0), "realloc");
+        return __libc_realloc(pointer, size);
+    }
+
+    void free(void* pointer)
+    {
+        if (pointer)
+            record(Violation::Deallocation, __builtin_return_address(0), "free");
+        __libc_free(pointer);
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        record(Violation::MutexLock, __builtin_return_address(0), "pthread_mutex_lock");
+        MutexLockFunction lock = s_mutexLock.load();
+        if (!lock)
+        {
+            // Static initialisers of other libraries may lock before our constructor ran
+            lock = resolve<MutexLockFunction>("pthread_mutex_lock");
+            s_mutexLock.store(lock);
+        }
+        return lock(mutex);
+    }
+
+    ssize_t read(int fd, void* buffer, size_t count)
+    {
+        record(Violation::BlockingCall, __builtin_return_address(0), "read");
+        return syscall(SYS_read, fd, buffer, count);
+    }
+
+    ssize_t write(int fd, const void* buffer, size_t count)
+    {
+        record(Violation::BlockingCall, __builtin_return_address(0), "write");
+        return syscall(SYS_write, fd, buffer, count);
+    }
+
+    int nanosleep(const struct timespec* duration, struct timespec* remaining)
+    {
+        record(Violation::BlockingCall, __builtin_return_address(0), "nanosleep");
+        return static_cast<int>(syscall(SYS_nanosleep, duration, remaining));
+    }
+
+    int usleep(useconds_t microseconds)
+    {
+        record(Violation::BlockingCall, __builtin_return_address(0), "usleep");
+        const struct timespec duration = {static_cast<time_t>(microseconds / 1000000),
+                                          static_cast<long>(microseconds % 1000000) * 1000};
+        return static_cast<int>(syscall(SYS_nanosleep, &duration, nullptr));
+    }
+
+    int poll(struct pollfd* fds, nfds_t count, int timeoutMs)
+    {
+        record(Violation::BlockingCall, __builtin_return_address(0), "poll");
+        struct timespec timeout = {timeoutMs / 1000, static_cast<long>(timeoutMs % 1000) * 1000000};
+        return static_cast<int>(syscall(SYS_ppoll, fds, count, timeoutMs < 0 ? nullptr : &timeout, nullptr, 0));
+    }
+
+    int fsync(int fd)
+    {
+        record(Violation::BlockingCall, __builtin_return_address(0), "fsync");
+        return static_cast<int>(syscall(SYS_fsync, fd));
+    }
+
+    int open(const char* path, int flags, ...)
+    {
+        record(Violation::BlockingCall, __builtin_return_address(0), "open");
+        mode_t mode = 0;
+        if (flags & (O_CREAT | O_TMPFILE))
+        {
+            va_list arguments;
+            va_start(arguments, flags);
+            mode = static_cast<mode_t>(va_arg(arguments, int));
+            va_end(arguments);
+        }
+        return static_cast<int>(syscall(SYS_openat, AT_FDCWD, path, flags, mode));
+    }
+
+    int vfprintf(FILE* stream, const char* format, va_list arguments)
+    {
+        record(Violation::Stdio, __builtin_return_address(0), "vfprintf");
+        return s_vfprintf(stream, format, arguments);
+    }
+
+    int fprintf(FILE* stream, const char* format, ...)
+    {
+        record(Violation::Stdio, __builtin_return_address(0), "fprintf");
+        va_list arguments;
+        va_start(arguments, format);
+        ++t_hookDepth;
+        const int result = s_vfprintf(stream, format, arguments);
+        --t_hookDepth;
+        va_end(arguments);
+        return result;
+    }
+
+    int printf(const char* format, ...)
+    {
+        record(Violation::Stdio, __builtin_return_address(0), "printf");
+        va_list arguments;
+        va_start(arguments, format);
+        ++t_hookDepth;
+        const int result = s_vfprintf(stdout, format, arguments);
+        --t_hookDepth;
+        va_end(arguments);
+        return result;
+    }
+
+    size_t fwrite(const void* data, size_t size, size_t count, FILE* stream)
+    {
+        record(Violation::Stdio, __builtin_return_address(0), "fwrite");
+        return s_fwrite(data, size, count, stream);
+    }
+
+    int fputs(const char* text, FILE* stream)
+    {
+        record(Violation::Stdio, __builtin_return_address(0), "fputs");
+        return s_fputs(text, stream);
+    }
+
+    int fputc(int character, FILE* stream)
+    {
+        record(Violation::Stdio, __builtin_return_address(0), "fputc");
+        return s_fputc(character, stream);
+    }
+
+    int putc(int character, FILE* stream)
+    {
+        record(Violation::Stdio, __builtin_return_address(0), "putc");
+        return s_putc(character, stream);
+    }
+
+    int puts(const char* text)
+    {
+        record(Violation::Stdio, __builtin_return_address(0), "puts");
+        return s_puts(text);
+    }
+
+    int fflush(FILE* stream)
+    {
+        record(Violation::Stdio, __builtin_return_address(0), "fflush");
+        return s_fflush(stream);
+    }
+}
+
+#endif  // SONGPRACTICE_RT_CHECK_LIBC
+
+#endif  // SONGPRACTICE_RT_CHECK
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+// Debug aid for the audio callback's real-time rules, compiled in with the CMake option
+// SONGPRACTICE_RT_CHECK. While a CallbackScope is alive on a thread, heap allocation
+// (malloc/free/new/delete), pthread_mutex_lock, stdio and blocking system calls made on
+// that thread are counted per call site, or abort at once in trap mode. The summary
+// names every offending site. Without the option CallbackScope is empty, nothing is
+// interposed and isEnabled() returns false.
+namespace RealtimeChecker
+{
+    enum class Violation
+    {
+        Allocation,
+        Deallocation,
+        MutexLock,
+        Stdio,
+        BlockingCall,
+        Count
+    };
+
+    class CallbackScope
+    {
+    public:
+#ifdef SONGPRACTICE_RT_CHECK
+        CallbackScope();
+        ~CallbackScope();
+#else
+        CallbackScope() {}
+#endif
+        CallbackScope(const CallbackScope&) = delete;
+        CallbackScope& operator=(const CallbackScope&) = delete;
+    };
+
+    bool isEnabled();
+    void setTrap(bool trap);
+
+    uint64_t violationCount();
+    // Writes the per-site counts to stderr; returns violationCount()
+    uint64_t printSummary();
+}
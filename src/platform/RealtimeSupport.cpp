@@ -0,0 +1,167 @@
+#include "RealtimeSupport.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #define SONGPRACTICE_HAVE_MXCSR 1
+    #include <xmmintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define SONGPRACTICE_HAVE_POSIX_RT 1
+    #include <pthread.h>
+    #include <sched.h>
+    #include <sys/mman.h>
+    #include <sys/resource.h>
+    #include <unistd.h>
+#endif
+
+#ifdef __linux__
+    #include <sys/syscall.h>
+#endif
+
+namespace
+{
+    std::atomic<bool> s_enabled{true};
+    std::atomic<size_t> s_lockedBytes{0};
+    std::atomic<bool> s_lockFailureLogged{false};
+
+    size_t pageSize()
+    {
+#ifdef SONGPRACTICE_HAVE_POSIX_RT
+        static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+#else
+        return 4096;
+#endif
+    }
+}
+
+namespace RealtimeSupport
+{
+    void setEnabled(bool enabled)
+    {
+        s_enabled.store(enabled);
+    }
+
+    bool isEnabled()
+    {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    void enableDenormalFlush()
+    {
+#if defined(SONGPRACTICE_HAVE_MXCSR)
+        // Bit 15 flushes denormal results to zero, bit 6 treats denormal inputs as zero
+        _mm_setcsr(_mm_getcsr() | 0x8040);
+#elif defined(__aarch64__)
+        uint64_t fpcr;
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (uint64_t(1) << 24)));
+#endif
+    }
+
+    bool lockMemory(const void* data, size_t bytes)
+    {
+#ifdef SONGPRACTICE_HAVE_POSIX_RT
+        if (data == nullptr || bytes == 0)
+            return true;
+        if (mlock(data, bytes) != 0)
+        {
+            if (!s_lockFailureLogged.exchange(true))
+                std::cerr << "RealtimeSupport: mlock failed (" << std::strerror(errno) << ", "
+                          << (s_lockedBytes.load() >> 20) << " MiB locked so far); raise RLIMIT_MEMLOCK "
+                          << "to keep playback buffers out of swap" << std::endl;
+            return false;
+        }
+        s_lockedBytes.fetch_add(bytes);
+        return true;
+#else
+        (void)data;
+        (void)bytes;
+        return false;
+#endif
+    }
+
+    void unlockMemory(const void* data, size_t bytes)
+    {
+#ifdef SONGPRACTICE_HAVE_POSIX_RT
+        if (data != nullptr && bytes > 0 && munlock(data, bytes) == 0)
+            s_lockedBytes.fetch_sub(std::min(bytes, s_lockedBytes.load()));
+#else
+        (void)data;
+        (void)bytes;
+#endif
+    }
+
+    size_t lockedBytes()
+    {
+        return s_lockedBytes.load();
+    }
+
+    void prefault(const void* data, size_t bytes)
+    {
+        const volatile uint8_t* bytePointer = static_cast<const volatile uint8_t*>(data);
+        const size_t step = pageSize();
+        uint8_t sink = 0;
+        for (size_t offset = 0; offset < bytes; offset += step)
+            sink ^= bytePointer[offset];
+        if (bytes > 0)
+            sink ^= bytePointer[bytes - 1];
+        (void)sink;
+    }
+
+    bool raiseToRealtime(int priority)
+    {
+#ifdef SONGPRACTICE_HAVE_POSIX_RT
+        int allowed = sched_get_priority_max(SCHED_FIFO);
+    #ifdef RLIMIT_RTPRIO
+        // Unprivileged processes may use priorities up to the soft RLIMIT_RTPRIO
+        struct rlimit limit;
+        if (geteuid() != 0 && getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+            allowed = std::min(allowed, static_cast<int>(limit.rlim_cur));
+    #endif
+        if (allowed < sched_get_priority_min(SCHED_FIFO))
+            allowed = 0;
+
+        sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        param.sched_priority = std::min(priority, allowed);
+        return allowed > 0 && pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#else
+        (void)priority;
+        return false;
+#endif
+    }
+
+    bool isRealtimeThread()
+    {
+#ifdef SONGPRACTICE_HAVE_POSIX_RT
+        int policy = 0;
+        sched_param param;
+        return pthread_getschedparam(pthread_self(), &policy, &param) == 0
+               && (policy == SCHED_FIFO || policy == SCHED_RR);
+#else
+        return false;
+#endif
+    }
+
+    void configureWorkerThread()
+    {
+        if (!isEnabled())
+            return;
+        enableDenormalFlush();
+#ifdef __linux__
+        // Linux applies nice values per thread
+        const pid_t thread = static_cast<pid_t>(syscall(SYS_gettid));
+        errno = 0;
+        const int current = getpriority(PRIO_PROCESS, static_cast<id_t>(thread));
+        if (errno == 0)
+            setpriority(PRIO_PROCESS, static_cast<id_t>(thread), std::min(current + kWorkerNice, 19));
+#endif
+    }
+}
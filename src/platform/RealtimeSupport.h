@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+// Keeps the audio path clear of page faults, denormal slowdowns and scheduling delays.
+// The mode is process wide and on by default. Every call degrades gracefully: when the
+// OS refuses (RLIMIT_MEMLOCK or RLIMIT_RTPRIO exhausted, unsupported platform) it
+// returns false and playback continues without that protection.
+namespace RealtimeSupport
+{
+    constexpr int kAudioThreadPriority = 70;  // SCHED_FIFO priority asked for the audio callback
+    constexpr int kWorkerNice = 10;           // Added to the nice value of DSP and analysis workers
+
+    void setEnabled(bool enabled);
+    bool isEnabled();
+
+    // Flush-to-zero and denormals-are-zero for the calling thread (SSE MXCSR, ARM FPCR)
+    void enableDenormalFlush();
+
+    // Pins pages in RAM; a failure is logged once per process
+    bool lockMemory(const void* data, size_t bytes);
+    void unlockMemory(const void* data, size_t bytes);
+    size_t lockedBytes();
+    // Reads one byte per page so swapped-out pages come back before the audio thread needs them
+    void prefault(const void* data, size_t bytes);
+
+    // SCHED_FIFO for the calling thread, clamped to RLIMIT_RTPRIO. Does not log, so the
+    // audio callback may call it; the caller reports a failure.
+    bool raiseToRealtime(int priority);
+    bool isRealtimeThread();
+
+    // Denormal flush and a lower priority than the UI; call at the start of background DSP
+    // and analysis work. No-op while the mode is off.
+    void configureWorkerThread();
+}
@@ -0,0 +1,43 @@
+#include "FrameScheduler.h"
+#include "hello_imgui/hello_imgui.h"
+#include <atomic>
+
+#if defined(HELLOIMGUI_USE_GLFW3)
+    #include <GLFW/glfw3.h>
+#elif defined(HELLOIMGUI_USE_SDL2)
+    #include <SDL.h>
+#endif
+
+namespace
+{
+    std::atomic<bool> s_woken{false};
+    // Input is handled at full rate for this long before idling resumes
+    constexpr float kActiveAfterInputSeconds = 1.0f;
+}
+
+void FrameScheduler::wake()
+{
+    s_woken.store(true);
+    // Both calls are thread-safe and end the backend's wait for events. With another backend
+    // the result is picked up at the next idle frame.
+#if defined(HELLOIMGUI_USE_GLFW3)
+    glfwPostEmptyEvent();
+#elif defined(HELLOIMGUI_USE_SDL2)
+    SDL_Event event{};
+    event.type = SDL_USEREVENT;
+    SDL_PushEvent(&event);
+#endif
+}
+
+void FrameScheduler::endFrame()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (s_woken.exchange(false))
+        m_activeUntil = now + kWakeActiveTime;
+
+    HelloImGui::FpsIdling& idling = HelloImGui::GetRunnerParams()->fpsIdling;
+    idling.fpsIdle = kIdleFps;
+    idling.timeActiveAfterLastEvent = kActiveAfterInputSeconds;
+    idling.enableIdling = !m_animationRequested && now >= m_activeUntil;
+    m_animationRequested = false;
+}
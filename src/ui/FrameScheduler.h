@@ -0,0 +1,25 @@
+#pragma once
+
+#include <chrono>
+
+// Decides per frame whether HelloImGui may idle. Idling waits for input with a timeout,
+// so a paused, still UI costs almost no CPU. requestAnimation() keeps the next frame at
+// full rate (playback, progress bars, drags). wake() may be called from any thread when
+// background work finishes; it interrupts an idle wait and keeps the UI at full rate
+// for a moment, long enough for the result to be collected.
+class FrameScheduler
+{
+public:
+    static constexpr float kIdleFps = 1.0f;
+    static constexpr std::chrono::milliseconds kWakeActiveTime{250};
+
+    void requestAnimation() { m_animationRequested = true; }
+    static void wake();
+
+    // Call at the end of the frame
+    void endFrame();
+
+private:
+    bool m_animationRequested = false;
+    std::chrono::steady_clock::time_point m_activeUntil;
+};
@@ -0,0 +1,80 @@
+#include "FrameStatsOverlay.h"
+#include "platform/AllocationCounter.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cfloat>
+
+FrameStatsOverlay::FrameStatsOverlay()
+{
+    ImGui::SetAllocatorFunctions(&AllocationCounter::countedMalloc, &AllocationCounter::countedFree);
+}
+
+void FrameStatsOverlay::beginFrame()
+{
+    const Clock::time_point now = Clock::now();
+    const uint64_t allocations = AllocationCounter::threadAllocations();
+
+    // The previous frame is complete now: its status bar, menus and rendering ran after endFrame()
+    if (m_frameStart != Clock::time_point())
+    {
+        m_frameMs[m_next] = std::chrono::duration<float, std::milli>(now - m_frameStart).count();
+        m_buildMs[m_next] = m_lastBuildMs;
+        m_allocations[m_next] = static_cast<float>(allocations - m_allocationsAtFrameStart);
+        m_next = (m_next + 1) % kHistory;
+        m_count = std::min(m_count + 1, kHistory);
+    }
+
+    m_frameStart = now;
+    m_allocationsAtFrameStart = allocations;
+}
+
+void FrameStatsOverlay::endFrame()
+{
+    m_lastBuildMs = std::chrono::duration<float, std::milli>(Clock::now() - m_frameStart).count();
+}
+
+float FrameStatsOverlay::percentile(const std::array<float, kHistory>& samples, float q)
+{
+    if (m_count == 0)
+        return 0.0f;
+    std::copy(samples.begin(), samples.begin() + m_count, m_scratch.begin());
+    const size_t rank = std::min(m_count - 1, static_cast<size_t>(q * static_cast<float>(m_count - 1) + 0.5f));
+    std::nth_element(m_scratch.begin(), m_scratch.begin() + rank, m_scratch.begin() + m_count);
+    return m_scratch[rank];
+}
+
+void FrameStatsOverlay::render()
+{
+    if (!m_visible)
+        return;
+
+    const ImGuiViewport* viewport = ImGui::GetMainViewport();
+    ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x - 10.0f, viewport->WorkPos.y + 10.0f),
+                            ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowBgAlpha(0.75f);
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize
+                                   | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing
+                                   | ImGuiWindowFlags_NoNav;
+    if (ImGui::Begin("Frame Stats", nullptr, flags))
+    {
+        // Samples oldest first for the plots
+        const int offset = (m_count == kHistory) ? static_cast<int>(m_next) : 0;
+        const int count = static_cast<int>(m_count);
+
+        ImGui::Text("Frame  p50 %5.1f  p95 %5.1f  p99 %5.1f ms",
+                    percentile(m_frameMs, 0.5f), percentile(m_frameMs, 0.95f), percentile(m_frameMs, 0.99f));
+        ImGui::PlotLines("##FrameMs", m_frameMs.data(), count, offset, nullptr, 0.0f, 50.0f, ImVec2(260.0f, 40.0f));
+        ImGui::Text("Build  p50 %5.2f  p95 %5.2f  p99 %5.2f ms",
+                    percentile(m_buildMs, 0.5f), percentile(m_buildMs, 0.95f), percentile(m_buildMs, 0.99f));
+
+        const size_t last = (m_next + kHistory - 1) % kHistory;
+        const float maxAllocations = percentile(m_allocations, 1.0f);
+        const ImVec4 allocationColor = maxAllocations > 0.0f ? ImVec4(1.0f, 0.6f, 0.2f, 1.0f)
+                                                              : ImVec4(0.5f, 0.9f, 0.5f, 1.0f);
+        ImGui::TextColored(allocationColor, "Allocations/frame  last %.0f  p95 %.0f  max %.0f",
+                           m_count > 0 ? m_allocations[last] : 0.0f, percentile(m_allocations, 0.95f), maxAllocations);
+        ImGui::PlotHistogram("##Allocations", m_allocations.data(), count, offset, nullptr, 0.0f, FLT_MAX,
+                             ImVec2(260.0f, 30.0f));
+    }
+    ImGui::End();
+}
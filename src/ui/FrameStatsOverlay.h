@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Frame time percentiles and allocations per frame over the last kHistory frames, drawn
+// as a small overlay so per-frame regressions are visible while using the app. Frame time
+// is the interval between frames, build time the CPU time of building the UI. Allocations
+// are those of the UI thread between two frames (operator new and ImGui's allocator, see
+// AllocationCounter); a steady frame should make none.
+class FrameStatsOverlay
+{
+public:
+    static constexpr size_t kHistory = 240;
+
+    // Routes ImGui's allocations through AllocationCounter
+    FrameStatsOverlay();
+
+    // Call at the start and at the end of building the frame
+    void beginFrame();
+    void endFrame();
+
+    void render();
+
+    bool isVisible() const { return m_visible; }
+    void setVisible(bool visible) { m_visible = visible; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // q in [0, 1] over the recorded frames
+    float percentile(const std::array<float, kHistory>& samples, float q);
+
+    std::array<float, kHistory> m_frameMs{};
+    std::array<float, kHistory> m_buildMs{};
+    std::array<float, kHistory> m_allocations{};
+    std::array<float, kHistory> m_scratch{};
+    size_t m_count = 0;
+    size_t m_next = 0;
+
+    Clock::time_point m_frameStart;
+    float m_lastBuildMs = 0.0f;
+    uint64_t m_allocationsAtFrameStart = 0;
+    bool m_visible = false;
+};
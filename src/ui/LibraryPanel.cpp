@@ -0,0 +1,173 @@
+#include "LibraryPanel.h"
+#include "core/TrackLibrary.h"
+#include "core/Utils.h"
+#include "imgui.h"
+#include "imgui_stdlib.h"
+#include "hello_imgui/hello_imgui.h"
+#include "portable_file_dialogs/portable_file_dialogs.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    const char* const kFormatFilters[] = {"All formats", "wav", "mp3"};
+
+    void drawThumbnail(const std::vector<uint8_t>& thumbnail, ImVec2 size)
+    {
+        const ImVec2 origin = ImGui::GetCursorScreenPos();
+        ImGui::Dummy(size);
+        if (thumbnail.empty())
+            return;
+
+        ImDrawList* drawList = ImGui::GetWindowDrawList();
+        const ImU32 color = ImGui::GetColorU32(ImGuiCol_PlotLines);
+        const float centerY = origin.y + size.y * 0.5f;
+        const float step = size.x / static_cast<float>(thumbnail.size());
+        for (size_t i = 0; i < thumbnail.size(); ++i)
+        {
+            const float x = origin.x + (static_cast<float>(i) + 0.5f) * step;
+            const float halfHeight = std::max(0.5f, thumbnail[i] / 255.0f * size.y * 0.5f);
+            drawList->AddLine(ImVec2(x, centerY - halfHeight), ImVec2(x, centerY + halfHeight), color);
+        }
+    }
+}
+
+const LibraryEntry* LibraryPanel::render(TrackLibrary& library)
+{
+    if (!m_open)
+        return nullptr;
+
+    const LibraryEntry* picked = nullptr;
+    ImGui::SetNextWindowSize(HelloImGui::EmToVec2(46.f, 32.f), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Track Library", &m_open))
+    {
+        ImGui::End();
+        return nullptr;
+    }
+
+    renderRoots(library);
+    ImGui::Separator();
+
+    ImGui::SetNextItemWidth(HelloImGui::EmSize(20.f));
+    ImGui::InputTextWithHint("##Search", "Search songs and folders", &m_query);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(HelloImGui::EmSize(8.f));
+    ImGui::Combo("##Format", &m_formatFilter, kFormatFilters, IM_ARRAYSIZE(kFormatFilters));
+
+    refreshResults(library);
+    ImGui::SameLine();
+    ImGui::TextDisabled("%zu of %zu tracks (%.2f ms)", m_results.size(), library.entries().size(), m_lastSearchMs);
+
+    const std::vector<LibraryEntry>& entries = library.entries();
+    const ImGuiTableFlags flags = ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg
+                                  | ImGuiTableFlags_BordersInnerV;
+    if (ImGui::BeginTable("LibraryEntries", 5, flags))
+    {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Waveform");
+        ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Duration");
+        ImGui::TableSetupColumn("Format");
+        ImGui::TableSetupColumn("Settings");
+        ImGui::TableHeadersRow();
+
+        const ImVec2 thumbnailSize = HelloImGui::EmToVec2(6.f, 1.2f);
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(m_results.size()));
+        while (clipper.Step())
+        {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+            {
+                const LibraryEntry& entry = entries[m_results[row]];
+                ImGui::TableNextRow();
+                ImGui::PushID(row);
+
+                ImGui::TableNextColumn();
+                drawThumbnail(entry.thumbnail, thumbnailSize);
+
+                ImGui::TableNextColumn();
+                if (ImGui::Selectable(Utils::getFileNameInPlace(entry.path), false, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowDoubleClick)
+                    && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+                {
+                    picked = &entry;
+                }
+                ImGui::SetItemTooltip("%s", entry.path.c_str());
+
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(Utils::TimeText(entry.durationSeconds).c_str());
+
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(entry.format.c_str());
+
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(entry.settingsPath.empty() ? "" : "yes");
+
+                ImGui::PopID();
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+    return picked;
+}
+
+void LibraryPanel::renderRoots(TrackLibrary& library)
+{
+    const std::vector<std::string>& roots = library.roots();
+    int rootToRemove = -1;
+
+    ImGui::Text("Library folders:");
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        ImGui::PushID(static_cast<int>(i));
+        if (ImGui::SmallButton("Remove"))
+            rootToRemove = static_cast<int>(i);
+        ImGui::SameLine();
+        ImGui::TextUnformatted(roots[i].c_str());
+        ImGui::PopID();
+    }
+
+    if (ImGui::Button("Add Folder..."))
+    {
+        const std::string folder = pfd::select_folder("Select Music Folder").result();
+        if (!folder.empty())
+        {
+            std::vector<std::string> newRoots = roots;
+            newRoots.push_back(folder);
+            library.setRoots(newRoots);
+        }
+    }
+    if (rootToRemove >= 0)
+    {
+        std::vector<std::string> newRoots = roots;
+        newRoots.erase(newRoots.begin() + rootToRemove);
+        library.setRoots(newRoots);
+    }
+
+    ImGui::SameLine();
+    ImGui::BeginDisabled(library.isScanning() || roots.empty());
+    if (ImGui::Button("Rescan"))
+        library.rescan();
+    ImGui::EndDisabled();
+
+    ImGui::SameLine();
+    if (library.isScanning())
+        ImGui::ProgressBar(library.scanProgress(), HelloImGui::EmToVec2(12.f, 0.f), "Scanning...");
+    else if (!roots.empty())
+        ImGui::TextDisabled(library.isWatching() ? "Watching for changes" : "Use Rescan after changing files");
+}
+
+void LibraryPanel::refreshResults(const TrackLibrary& library)
+{
+    if (m_resultsRevision == library.revision() && m_resultsQuery == m_query && m_resultsFormatFilter == m_formatFilter)
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+    library.search(m_query, (m_formatFilter > 0) ? kFormatFilters[m_formatFilter] : "", m_results);
+    m_lastSearchMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    m_resultsRevision = library.revision();
+    m_resultsQuery = m_query;
+    m_resultsFormatFilter = m_formatFilter;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class TrackLibrary;
+struct LibraryEntry;
+
+// "Track Library" window: library folders, search and the list of indexed songs
+class LibraryPanel
+{
+public:
+    bool isOpen() const { return m_open; }
+    void setOpen(bool open) { m_open = open; }
+
+    // Draws the window when open. Returns the entry the user chose to open, or nullptr.
+    const LibraryEntry* render(TrackLibrary& library);
+
+private:
+    void renderRoots(TrackLibrary& library);
+    void refreshResults(const TrackLibrary& library);
+
+    bool m_open = false;
+    std::string m_query;
+    int m_formatFilter = 0;  // Index into the format combo, 0 = all formats
+
+    // Search results are only recomputed when the query, filter or library changes
+    std::vector<size_t> m_results;
+    std::string m_resultsQuery;
+    int m_resultsFormatFilter = -1;
+    uint64_t m_resultsRevision = UINT64_MAX;
+    double m_lastSearchMs = 0.0;
+};
@@ -3,11 +3,19 @@
 #include "imgui_stdlib.h"
 #include "implot/implot.h"
 #include "hello_imgui/hello_imgui.h"
+#include "core/TimedText.h"
+#include "core/Trace.h"
 #include "core/Utils.h"
+#include "platform/RealtimeSupport.h"
 #include "portable_file_dialogs/portable_file_dialogs.h"
 #include "hello_imgui/icons_font_awesome_6.h"
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
 #include <filesystem>
+#include <limits>
 #include <unordered_set>
 #include "nlohmann/json.hpp"
 
@@ -16,6 +24,12 @@ namespace
     constexpr float kSeekStep = 1.0f;
     constexpr ImVec2 kTransportButtonSize = ImVec2(40.0f, 40.0f);
     constexpr float kTransportSpacing = 14.0f;
+    const char* const kSnapModes[] = {"Off", "Onsets", "Beats"};
+    constexpr double kSnapSeconds = 0.5;  // Farther than this, a marker stays where it was put
+    constexpr int64_t kLivePitchTrailNs = 4000000000;  // Mic pitch shown behind the playhead
+    constexpr float kLivePitchGapSeconds = 0.05f;      // A larger step in track time breaks the line
+    const char* const kNoteNames[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+    constexpr const char* kTakeDirectory = "songpractice-takes";
 
     std::string normalizePath(const std::string& path)
     {
@@ -30,6 +44,13 @@ namespace
             return path;
         }
     }
+
+    const char* formatBytes(FrameArena& arena, size_t bytes)
+    {
+        if (bytes >= (size_t(1) << 30))
+            return arena.format("%.1f GiB", static_cast<double>(bytes) / static_cast<double>(size_t(1) << 30));
+        return arena.format("%zu MiB", bytes >> 20);
+    }
 }
 
 
@@ -51,8 +72,17 @@ bool showControlButton(const char* icon, const char* tooltip, bool autorepeat =
 }
 
 MainWindow::MainWindow()
+    : m_startupTime(std::chrono::steady_clock::now())
 {
-    m_audioEngine.initialize();
+    Trace::setThreadName("UI");
+    m_audioEngine.setMemoryBudget(&m_memoryBudget);
+    m_audioEngine.setWakeCallback(&FrameScheduler::wake);
+    m_beatAnalysis.setWakeCallback(&FrameScheduler::wake);
+    m_pitchAnalysis.setWakeCallback(&FrameScheduler::wake);
+    m_takeLoad.setWakeCallback(&FrameScheduler::wake);
+    m_takeScore.setWakeCallback(&FrameScheduler::wake);
+    registerMemoryReclaimers();
+    m_audioEngine.initializeAsync();
     m_pendingTempoMultiplier = m_appState.tempoMultiplier;
     loadSettings();
 }
@@ -67,30 +97,95 @@ void MainWindow::loadSettings()
 {
     if (m_settingsManager.loadGlobalSettings(m_appState))
     {
-        // If we loaded a sound file path, try to load it
+        markersChanged();
+
+        // If we loaded a sound file path, restore it in the background
         if (!m_appState.soundFilePath.empty())
+            startSessionRestore();
+    }
+}
+
+void MainWindow::startSessionRestore()
+{
+    startAudioLoad(m_appState.soundFilePath, [this](bool loaded) {
+        if (loaded)
         {
-            if (m_audioEngine.loadAudioFile(m_appState.soundFilePath.c_str()))
+            // Positions now count at the track's playback rate
+            markersChanged();
+            // Restore tempo setting
+            m_audioEngine.setTempoMultiplier(m_appState.tempoMultiplier);
+            m_pendingTempoMultiplier = m_appState.tempoMultiplier;
+            // Seek to the saved play position
+            if (m_appState.playPositionFrame > 0)
             {
-                m_waveformDirty = true;
-                // Restore tempo setting
-                m_audioEngine.setTempoMultiplier(m_appState.tempoMultiplier);
-                m_pendingTempoMultiplier = m_appState.tempoMultiplier;
-                // Seek to the saved play position
-                if (m_appState.playPosition > 0.0f)
-                {
-                    m_audioEngine.seek(m_appState.playPosition);
-                }
-            }
-            else
-            {
-                // File couldn't be loaded, clear the path
-                m_appState.soundFilePath.clear();
-                m_appState.playPosition = 0.0f;
-                m_appState.markers.clear();
+                m_audioEngine.seekToFrame(m_appState.playPositionFrame);
             }
+
+            const auto elapsed = std::chrono::steady_clock::now() - m_startupTime;
+            HelloImGui::Log(HelloImGui::LogLevel::Info, "Startup: session audio ready to play after %lld ms",
+                            static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
         }
-    }
+        else
+        {
+            // File couldn't be loaded, clear the path
+            m_appState.soundFilePath.clear();
+            m_appState.playPositionFrame = 0;
+            m_appState.markers.clear();
+            markersChanged();
+        }
+    });
+}
+
+void MainWindow::startAudioLoad(const std::string& filePath, std::function<void(bool loaded)> onFinished)
+{
+    auto preparedWaveform = std::make_shared<WaveformRenderer>();
+    preparedWaveform->setPrecision(m_waveformPrecision);
+
+    const auto onComplete = [this, filePath, preparedWaveform, onFinished = std::move(onFinished)](AudioLoadStatus status) {
+        if (m_activeLoad && m_activeLoad->isFinished())
+            m_activeLoad.reset();
+
+        if (status == AudioLoadStatus::Cancelled)
+        {
+            HelloImGui::Log(HelloImGui::LogLevel::Info, "Cancelled loading %s", Utils::getFileName(filePath).c_str());
+            return;
+        }
+
+        if (status == AudioLoadStatus::Loaded)
+        {
+            m_waveformRenderer = std::move(*preparedWaveform);
+            m_waveformDirty = false;
+            // A restore started before the preferences were read
+            applyWaveformPrecision();
+        }
+        else
+        {
+            HelloImGui::Log(HelloImGui::LogLevel::Error, "Failed to load audio file: %s", Utils::getFileName(filePath).c_str());
+        }
+        onFinished(status == AudioLoadStatus::Loaded);
+
+        if (status == AudioLoadStatus::Loaded)
+            setlistTrackLoaded(filePath);
+    };
+
+    const auto prepareWaveform = [preparedWaveform](const DecodedAudio& audio) {
+        preparedWaveform->setWaveform(*audio.pcm);
+    };
+
+    m_activeLoad = m_audioEngine.loadAudioFileAsync(filePath, onComplete, prepareWaveform);
+}
+
+void MainWindow::renderLoadProgress()
+{
+    if (!m_activeLoad)
+        return;
+
+    ImGui::TextDisabled("Loading %s", Utils::getFileNameInPlace(m_activeLoad->filePath()));
+    ImGui::SameLine();
+    ImGui::ProgressBar(m_activeLoad->progress(), HelloImGui::EmToVec2(16.f, 0.f));
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Cancel"))
+        m_activeLoad->cancel();
 }
 
 void MainWindow::saveSettings()
@@ -98,7 +193,7 @@ void MainWindow::saveSettings()
     // Update current play position before saving
     if (m_audioEngine.hasAudio())
     {
-        m_appState.playPosition = m_audioEngine.getCurrentTime();
+        m_appState.playPositionFrame = m_audioEngine.getCurrentFrame();
     }
 
     m_settingsManager.saveGlobalSettings(m_appState);
@@ -126,7 +221,7 @@ void MainWindow::saveTrackSettings()
     // Update current play position before saving
     if (m_audioEngine.hasAudio())
     {
-        m_appState.playPosition = m_audioEngine.getCurrentTime();
+        m_appState.playPositionFrame = m_audioEngine.getCurrentFrame();
     }
 
     // Default filename based on current audio file
@@ -155,30 +250,137 @@ void MainWindow::saveTrackSettings()
             settingsPath += ".songpractice.json";
         }
 
-        if (m_settingsManager.saveTrackSettings(settingsPath, m_appState))
+        // Written by the persistence worker; the outcome is reported in handleFinishedSaves()
+        m_settingsManager.saveTrackSettingsAsync(settingsPath, m_appState);
+    }
+}
+
+void MainWindow::scheduleAutoSave()
+{
+    if (m_audioEngine.hasAudio())
+        m_appState.playPositionFrame = m_audioEngine.getCurrentFrame();
+    m_settingsManager.saveGlobalSettingsAsync(m_appState);
+}
+
+void MainWindow::handleFinishedSaves()
+{
+    const std::vector<SettingsManager::SaveResult> results = m_settingsManager.takeFinishedSaves();
+    if (results.empty())
+        return;
+
+    const std::string globalPath = m_settingsManager.getGlobalSettingsPath();
+    for (const SettingsManager::SaveResult& result : results)
+    {
+        const bool isGlobal = (result.filePath == globalPath);
+        if (result.success && !isGlobal)
         {
             HelloImGui::Log(HelloImGui::LogLevel::Info, "Saved track settings: %s",
-                          Utils::getFileName(settingsPath).c_str());
-            addRecentSettingsPath(settingsPath);
+                          Utils::getFileName(result.filePath).c_str());
+            addRecentSettingsPath(result.filePath);
         }
-        else
+        else if (!result.success)
         {
-            HelloImGui::Log(HelloImGui::LogLevel::Error, "Failed to save track settings: %s",
-                          Utils::getFileName(settingsPath).c_str());
+            HelloImGui::Log(HelloImGui::LogLevel::Error, "Failed to save %s: %s",
+                          isGlobal ? "session" : "track settings",
+                          Utils::getFileName(result.filePath).c_str());
         }
     }
 }
 
+void MainWindow::importTimedText()
+{
+    auto selection = pfd::open_file("Import Lyrics as Markers",
+                                   "",
+                                   {"Timed Lyrics", "*.lrc *.srt *.vtt",
+                                    "All Files", "*"},
+                                   pfd::opt::none).result();
+    if (selection.empty())
+        return;
+
+    const std::string& filePath = selection[0];
+    std::vector<Marker> imported;
+    if (!TimedText::importFile(filePath, m_appState.sampleRate, imported))
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Error, "Failed to import lyrics: %s",
+                        Utils::getFileName(filePath).c_str());
+        return;
+    }
+    if (imported.empty())
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Warning, "No timed lines found in: %s",
+                        Utils::getFileName(filePath).c_str());
+        return;
+    }
+
+    const size_t importedCount = imported.size();
+    TimedText::mergeMarkers(m_appState.markers, imported);
+    markersChanged();
+    scheduleAutoSave();
+    HelloImGui::Log(HelloImGui::LogLevel::Info, "Imported %zu markers from %s",
+                    importedCount, Utils::getFileName(filePath).c_str());
+}
+
+void MainWindow::exportTimedText()
+{
+    std::string defaultName = "markers";
+    if (!m_appState.soundFilePath.empty())
+        defaultName = std::filesystem::path(m_appState.soundFilePath).stem().string();
+    defaultName += ".lrc";
+
+    auto result = pfd::save_file("Export Markers as Lyrics",
+                                defaultName,
+                                {"LRC Lyrics", "*.lrc",
+                                 "SubRip Subtitles", "*.srt",
+                                 "WebVTT Subtitles", "*.vtt"}).result();
+    if (result.empty())
+        return;
+
+    std::string filePath = result;
+    if (TimedText::detectFormat(filePath) == TimedText::Format::Unknown)
+        filePath += ".lrc";
+
+    if (TimedText::exportFile(filePath, m_appState.markers, m_appState.sampleRate, m_audioEngine.getFrameCount()))
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Info, "Exported %zu markers to %s",
+                        m_appState.markers.size(), Utils::getFileName(filePath).c_str());
+    }
+    else
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Error, "Failed to export markers: %s",
+                        Utils::getFileName(filePath).c_str());
+    }
+}
+
+void MainWindow::exportTrace()
+{
+    auto result = pfd::save_file("Export Performance Trace",
+                                "songpractice-trace.json",
+                                {"Chrome Trace", "*.json",
+                                 "All Files", "*"}).result();
+    if (result.empty())
+        return;
+
+    if (Trace::exportChromeJson(result))
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Info, "Exported %zu trace events to %s",
+                        Trace::eventCount(), Utils::getFileName(result).c_str());
+    }
+    else
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Error, "Failed to export trace: %s",
+                        Utils::getFileName(result).c_str());
+    }
+}
+
 void MainWindow::renderAudioInfo()
 {
     if (m_audioEngine.hasAudio())
     {
-        const std::string fileName = Utils::getFileName(m_audioEngine.loadedFilePath());
         ImGui::Text("Duration: %s, Sample rate: %u Hz, Channels: %u (%s)",
-                    Utils::formatTime(m_audioEngine.getDuration()).c_str(),
+                    Utils::TimeText(m_audioEngine.getDuration()).c_str(),
                     m_audioEngine.getSampleRate(),
                     m_audioEngine.getChannelCount(),
-                    fileName.c_str());
+                    Utils::getFileNameInPlace(m_audioEngine.loadedFilePath()));
     }
     else
     {
@@ -189,6 +391,37 @@ void MainWindow::renderAudioInfo()
 
 void MainWindow::showGui()
 {
+    Trace::Span frameSpan("Frame");
+    m_frameStats.beginFrame();
+    m_frameArena.reset();
+    if (!m_firstFrameShown)
+    {
+        m_firstFrameShown = true;
+        const auto elapsed = std::chrono::steady_clock::now() - m_startupTime;
+        HelloImGui::Log(HelloImGui::LogLevel::Info, "Startup: first frame after %lld ms",
+                        static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
+        m_frameScheduler.requestAnimation();  // The library index is read on the next frame
+    }
+    else if (!m_libraryIndexLoaded)
+    {
+        // Parsing a large index takes tens of milliseconds, so it waits until the window is up.
+        // Then the indexed library shows, and a rescan picks up whatever changed since last run.
+        Trace::Span span("Library index");
+        m_libraryIndexLoaded = true;
+        if (m_trackLibrary.loadIndex())
+            m_trackLibrary.rescan();
+    }
+
+    {
+        Trace::Span span("Engine update");
+        m_audioEngine.update();
+        if (m_audioEngine.takeTrackSwitch())
+            onSetlistAdvanced();
+        updateTrackAnalysis();
+        updateLivePitch();
+        updateTakes();
+    }
+
     ImGui::Text("SongPractice - Audio Practice Tool");
     ImGui::Separator();
 
@@ -196,14 +429,28 @@ void MainWindow::showGui()
     const bool isProcessing = m_audioEngine.isTempoProcessing();
     if (m_wasTempoProcessing && !isProcessing)
     {
-        // Tempo processing just finished, update waveform
-        m_waveformDirty = true;
+        // The waveform shows the original, which tempo does not change; only restore
+        // detail dropped under memory pressure (this reads the whole track)
+        if (m_waveformRenderer.hasDroppedLevels())
+            m_waveformDirty = true;
     }
     m_wasTempoProcessing = isProcessing;
 
     if (m_audioEngine.hasAudio() && m_waveformDirty)
         updateWaveformData();
 
+    {
+        Trace::Span span("Memory budget");
+        reportWaveformMemory();
+        m_memoryBudget.enforce();
+    }
+
+    handleFinishedSaves();
+    {
+        Trace::Span span("Library update");
+        m_trackLibrary.update();
+    }
+
     // Handle keyboard shortcuts
     handleKeyboardShortcuts();
 
@@ -211,11 +458,31 @@ void MainWindow::showGui()
     renderAudioInfo();
     renderAudioControls();
     renderTempoControls();
+    renderMetronomeControls();
+    renderMicrophoneControls();
+    renderTakeControls();
     renderMarkerControls();
 
+    if (const LibraryEntry* entry = m_libraryPanel.render(m_trackLibrary))
+        openLibraryEntry(*entry);
+    handleSetlistAction(m_setlistPanel.render(m_setlist, setlistPreloadStatus()));
+
     HelloImGui::LogGui();
+    m_frameStats.render();
+
+    if (m_audioEngine.hasAudio())
+        m_appState.playPositionFrame = m_audioEngine.getCurrentFrame();
 
-    m_appState.playPosition = m_audioEngine.getCurrentTime();
+    // Full frame rate only while something on screen moves; the frame stats measure at full rate
+    if (m_audioEngine.isPlaying() || m_audioEngine.isLoading() || m_audioEngine.isTempoProcessing()
+        || m_beatAnalysis.isRunning() || m_pitchAnalysis.isRunning() || m_audioEngine.inputActive()
+        || m_audioEngine.recorder().isActive() || m_takeLoad.isRunning() || m_takeScore.isRunning()
+        || ImGui::IsAnyItemActive() || m_frameStats.isVisible())
+    {
+        m_frameScheduler.requestAnimation();
+    }
+    m_frameScheduler.endFrame();
+    m_frameStats.endFrame();
 }
 
 void MainWindow::showMenus()
@@ -242,6 +509,16 @@ void MainWindow::showMenus()
             openAudioFile();
         }
 
+        if (ImGui::MenuItem("Track Library...", nullptr, m_libraryPanel.isOpen()))
+        {
+            m_libraryPanel.setOpen(!m_libraryPanel.isOpen());
+        }
+
+        if (ImGui::MenuItem("Setlist...", nullptr, m_setlistPanel.isOpen()))
+        {
+            m_setlistPanel.setOpen(!m_setlistPanel.isOpen());
+        }
+
         ImGui::Separator();
 
         if (ImGui::MenuItem("Load Track Settings..."))
@@ -259,8 +536,7 @@ void MainWindow::showMenus()
                 for (int i = static_cast<int>(m_recentTrackSettings.size()) - 1; i >= 0; --i)
                 {
                     const std::string& path = m_recentTrackSettings[static_cast<size_t>(i)];
-                    const std::string label = Utils::getFileName(path);
-                    if (ImGui::MenuItem(label.c_str()))
+                    if (ImGui::MenuItem(Utils::getFileNameInPlace(path)))
                     {
                         loadTrackSettingsFromPath(path);
                     }
@@ -274,6 +550,73 @@ void MainWindow::showMenus()
             saveTrackSettings();
         }
 
+        ImGui::Separator();
+
+        if (ImGui::MenuItem("Import Lyrics as Markers...", nullptr, false, m_audioEngine.hasAudio()))
+        {
+            importTimedText();
+        }
+
+        if (ImGui::MenuItem("Export Markers as Lyrics...", nullptr, false, !m_appState.markers.empty()))
+        {
+            exportTimedText();
+        }
+
+        ImGui::Separator();
+
+        if (ImGui::BeginMenu("Memory Budget"))
+        {
+            ImGui::SetNextItemWidth(HelloImGui::EmSize(12.f));
+            if (ImGui::SliderInt("MiB", &m_memoryBudgetMiB, 256, 16384))
+                m_memoryBudget.setLimit(static_cast<size_t>(m_memoryBudgetMiB) << 20);
+            if (ImGui::IsItemDeactivatedAfterEdit())
+                saveUserPrefs();
+            ImGui::TextDisabled("Over budget, waveform detail is dropped first,\n"
+                                "then the original audio is moved to a temporary file,\n"
+                                "then the preloaded setlist song is released.");
+            ImGui::EndMenu();
+        }
+
+        const bool fineWaveform = (m_waveformPrecision == EnvelopePrecision::Int16);
+        if (ImGui::MenuItem("High-Precision Waveform", nullptr, fineWaveform))
+        {
+            m_waveformPrecision = fineWaveform ? EnvelopePrecision::Int8 : EnvelopePrecision::Int16;
+            applyWaveformPrecision();
+            saveUserPrefs();
+        }
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal))
+            ImGui::SetTooltip("Stores the waveform envelope with 16 instead of 8 bits: quiet passages\n"
+                              "keep their shape when zoomed in, at twice the waveform memory.");
+
+        if (ImGui::MenuItem("Real-time Audio Safety", nullptr, m_audioEngine.realtimeSafety()))
+        {
+            m_audioEngine.setRealtimeSafety(!m_audioEngine.realtimeSafety());
+            saveUserPrefs();
+        }
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal))
+            ImGui::SetTooltip("Locks playback audio in RAM, flushes denormals and asks for real-time\n"
+                              "scheduling of the audio thread; background work runs at lower priority.");
+
+        if (ImGui::BeginMenu("Performance Trace"))
+        {
+            if (ImGui::MenuItem("Record", nullptr, Trace::isRecording()))
+                Trace::setRecording(!Trace::isRecording());
+            const bool hasEvents = Trace::eventCount() > 0;
+            if (ImGui::MenuItem("Export...", nullptr, false, hasEvents))
+                exportTrace();
+            if (ImGui::MenuItem("Clear", nullptr, false, hasEvents))
+                Trace::clear();
+            ImGui::TextDisabled("Times loading, decoding, tempo changes and frames.\n"
+                                "Open the export in ui.perfetto.dev or chrome://tracing.");
+            ImGui::EndMenu();
+        }
+
+        if (ImGui::MenuItem("Frame Stats Overlay", nullptr, m_frameStats.isVisible()))
+            m_frameStats.setVisible(!m_frameStats.isVisible());
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal))
+            ImGui::SetTooltip("Frame time percentiles and heap allocations per frame.\n"
+                              "A steady frame should not allocate.");
+
         ImGui::EndMenu();
     }
 }
@@ -301,21 +644,17 @@ void MainWindow::openAudioFile()
                 return;
             }
 
-            if (m_audioEngine.loadAudioFile(filePath.c_str()))
-            {
+            startAudioLoad(filePath, [this, filePath](bool loaded) {
+                if (!loaded)
+                    return;
                 m_appState.soundFilePath = filePath;
-                m_waveformDirty = true;
+                markersChanged();
                 // Set tempo to current app state (may be default 1.0 or previously set value)
                 m_audioEngine.setTempoMultiplier(m_appState.tempoMultiplier);
                 m_pendingTempoMultiplier = m_appState.tempoMultiplier;
                 HelloImGui::Log(HelloImGui::LogLevel::Info, "Loaded audio file: %s",
                               Utils::getFileName(filePath).c_str());
-            }
-            else
-            {
-                HelloImGui::Log(HelloImGui::LogLevel::Error, "Failed to load audio file: %s",
-                              Utils::getFileName(filePath).c_str());
-            }
+            });
         }
         else
         {
@@ -339,7 +678,7 @@ void MainWindow::renderAudioControls()
 
     // Go to Start button
     if (showControlButton(ICON_FA_BACKWARD_STEP "##song_start", "Go to Start"))
-        m_audioEngine.seek(0.0f);
+        m_audioEngine.seekToFrame(0);
 
     ImGui::SameLine();
     if (showControlButton(ICON_FA_BACKWARD, "Rewind 1 second", true))
@@ -354,12 +693,7 @@ void MainWindow::renderAudioControls()
         if (isPlaying)
             m_audioEngine.pause();
         else
-        {
-            // rewind to start if at the end
-            if (m_audioEngine.getCurrentTime() >= m_audioEngine.getDuration())
-                m_audioEngine.seek(0.0f);
-            m_audioEngine.play();
-        }
+            startPlayback();
     }
 
     ImGui::SameLine();
@@ -380,8 +714,8 @@ void MainWindow::renderAudioControls()
                                        : ImVec4(0.8f, 0.8f, 0.8f, 1.0f);
     ImGui::PushStyleColor(ImGuiCol_Text, timeColor);
     ImGui::Text("%s / %s",
-                Utils::formatTime(m_audioEngine.getCurrentTime()).c_str(),
-                Utils::formatTime(m_audioEngine.getDuration()).c_str());
+                Utils::TimeText(m_audioEngine.getPlayheadTime()).c_str(),
+                Utils::TimeText(m_audioEngine.getDuration()).c_str());
     ImGui::PopStyleColor();
 
     // Display active tempo ratio
@@ -424,6 +758,7 @@ void MainWindow::renderTempoControls()
     {
         m_appState.tempoMultiplier = m_pendingTempoMultiplier;
         m_audioEngine.setTempoMultiplier(m_appState.tempoMultiplier);
+        scheduleAutoSave();
     }
 
     if (!tempoChanged)
@@ -436,6 +771,7 @@ void MainWindow::renderTempoControls()
         m_pendingTempoMultiplier = 1.0f;
         m_appState.tempoMultiplier = 1.0f;
         m_audioEngine.setTempoMultiplier(m_appState.tempoMultiplier);
+        scheduleAutoSave();
     }
 
     if (!hasAudio || isProcessing)
@@ -451,41 +787,592 @@ void MainWindow::renderTempoControls()
     }
 }
 
+void MainWindow::renderMetronomeControls()
+{
+    ImGui::Spacing();
+    ImGui::Text("Metronome:");
+
+    const bool hasAudio = m_audioEngine.hasAudio();
+    if (!hasAudio)
+        ImGui::BeginDisabled();
+
+    BeatGrid& grid = m_appState.beatGrid;
+    bool gridChanged = false;
+    ImGui::SetNextItemWidth(HelloImGui::EmSize(8.f));
+    if (ImGui::InputDouble("BPM", &grid.bpm, 1.0, 10.0, "%.2f"))
+    {
+        grid.bpm = std::clamp(grid.bpm, 0.0, 400.0);
+        gridChanged = true;
+    }
+
+    ImGui::SameLine();
+    int beatsPerBar = static_cast<int>(grid.beatsPerBar);
+    ImGui::SetNextItemWidth(HelloImGui::EmSize(6.f));
+    if (ImGui::InputInt("Beats/Bar", &beatsPerBar))
+    {
+        grid.beatsPerBar = static_cast<uint32_t>(std::clamp(beatsPerBar, 1, 16));
+        gridChanged = true;
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("Downbeat Here"))
+    {
+        // What is being heard, not what was last rendered
+        grid.firstBeatFrame = snapFrame(m_audioEngine.isPlaying() ? m_appState.toFrame(m_audioEngine.getPlayheadTime())
+                                                                  : m_audioEngine.getCurrentFrame());
+        gridChanged = true;
+    }
+    ImGui::SetItemTooltip("Puts the first beat of a bar at the playback position;\n"
+                          "the grid extends both ways from it");
+
+    if (gridChanged)
+    {
+        m_audioEngine.setBeatGrid(grid.bpm, grid.firstBeatFrame, grid.beatsPerBar);
+        scheduleAutoSave();
+    }
+
+    if (!grid.isValid())
+        ImGui::BeginDisabled();
+
+    bool clickEnabled = m_audioEngine.metronomeEnabled();
+    if (ImGui::Checkbox("Click", &clickEnabled))
+        m_audioEngine.setMetronomeEnabled(clickEnabled);
+
+    ImGui::SameLine();
+    float volumePercent = m_audioEngine.metronomeVolume() * 100.0f;
+    ImGui::SetNextItemWidth(HelloImGui::EmSize(10.f));
+    if (ImGui::SliderFloat("Click Volume", &volumePercent, 0.0f, 100.0f, "%.0f%%"))
+        m_audioEngine.setMetronomeVolume(volumePercent / 100.0f);
+
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(HelloImGui::EmSize(6.f));
+    ImGui::SliderInt("Count-in Bars", &m_countInBars, 0, 4);
+
+    if (!grid.isValid())
+        ImGui::EndDisabled();
+
+    if (!hasAudio)
+        ImGui::EndDisabled();
+
+    if (m_audioEngine.isCountingIn())
+    {
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Counting in...");
+    }
+    else if (m_beatAnalysis.isRunning())
+    {
+        ImGui::SameLine();
+        ImGui::TextDisabled("Detecting beats... (%.0f%%)", m_beatAnalysis.progress() * 100.0f);
+    }
+}
+
+void MainWindow::renderMicrophoneControls()
+{
+    ImGui::Spacing();
+    ImGui::Text("Microphone:");
+
+    bool enabled = m_audioEngine.inputEnabled();
+    if (ImGui::Checkbox("Live Pitch", &enabled))
+        m_audioEngine.setInputEnabled(enabled);
+    ImGui::SetItemTooltip("Tracks the pitch of the default input device and draws it over the\n"
+                          "reference pitch, where it was sung along to the track");
+    if (!enabled)
+        return;
+
+    ImGui::SameLine();
+    if (!m_audioEngine.inputActive())
+    {
+        ImGui::TextDisabled(m_audioEngine.hasAudio() ? "No input device" : "Starts with a loaded track");
+        return;
+    }
+
+    const LivePitchPoint* latest = m_livePoints.empty() ? nullptr : &m_livePoints.back();
+    if (latest == nullptr || std::isnan(latest->note))
+    {
+        ImGui::TextDisabled("--");
+    }
+    else
+    {
+        const int nearest = static_cast<int>(std::lround(latest->note));
+        ImGui::Text("%s%d %+d ct", kNoteNames[((nearest % 12) + 12) % 12], nearest / 12 - 1,
+                    static_cast<int>(std::lround((latest->note - nearest) * 100.0f)));
+
+        // Against the reference at the moment it was sung to, folded into the nearest octave
+        const PitchContour& reference = m_pitchAnalysis.result();
+        const size_t index = (latest->onTrack && reference.hopFrames > 0)
+                                 ? static_cast<size_t>(latest->trackFrame / reference.hopFrames)
+                                 : reference.notes.size();
+        if (index < reference.notes.size() && !std::isnan(reference.notes[index]))
+        {
+            const float difference = latest->note - reference.notes[index];
+            const float folded = difference - 12.0f * std::round(difference / 12.0f);
+            ImGui::SameLine();
+            ImGui::Text("(%+.0f ct from the reference)", folded * 100.0f);
+        }
+    }
+
+    ImGui::SameLine();
+    ImGui::TextDisabled("Latency %.0f ms, detector %.0f ms", m_liveLatencyMs,
+                        m_audioEngine.livePitch().detectionLatencyMs());
+    ImGui::SetItemTooltip("From the sound reaching the microphone to its pitch on screen, and the\n"
+                          "part of that spent in the device and the detector's analysis window");
+}
+
+void MainWindow::renderTakeControls()
+{
+    if (!m_audioEngine.hasAudio())
+        return;
+
+    ImGui::Spacing();
+    ImGui::Text("Takes:");
+
+    const TakeRecorder& recorder = m_audioEngine.recorder();
+    if (recorder.isActive())
+    {
+        if (ImGui::Button(ICON_FA_STOP " Stop Recording"))
+            m_audioEngine.stopRecording();
+        ImGui::SameLine();
+        const double seconds = recorder.capturedSeconds();
+        if (seconds > 0.0)
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Recording %s", Utils::TimeText(static_cast<float>(seconds)).c_str());
+        else
+            ImGui::TextDisabled("Waiting for playback");
+    }
+    else
+    {
+        const bool canRecord = !m_audioEngine.isTempoProcessing() && !m_takeLoad.isRunning();
+        if (!canRecord)
+            ImGui::BeginDisabled();
+        if (ImGui::Button(ICON_FA_CIRCLE " Record"))
+            startTakeRecording();
+        ImGui::SetItemTooltip("Records the microphone from the playback position until playback\n"
+                              "pauses, lined up with the track for listening back");
+        if (!canRecord)
+            ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::Checkbox("With Track", &m_recordWithTrack);
+        ImGui::SetItemTooltip("Mixes the track into the take as it was heard, metronome included");
+    }
+
+    if (m_appState.takes.empty())
+        return;
+
+    int takeToDelete = -1;
+    for (size_t i = 0; i < m_appState.takes.size(); ++i)
+    {
+        const Take& take = m_appState.takes[i];
+        ImGui::PushID(static_cast<int>(i));
+        const bool listening = m_takeLoad.audioPath() == take.filePath
+                               && (m_takeLoad.isRunning() || m_audioEngine.hasTakePlayback());
+        if (ImGui::SmallButton(listening ? ICON_FA_STOP : ICON_FA_PLAY))
+        {
+            if (listening)
+                stopListeningToTake();
+            else
+                listenToTake(take);
+        }
+        ImGui::SetItemTooltip(listening ? "Stop listening" : "Play the take over the track from where it was recorded");
+
+        ImGui::SameLine();
+        const bool scoring = m_takeScore.isRunning() && m_takeScore.audioPath() == take.filePath;
+        if (scoring)
+            ImGui::BeginDisabled();
+        if (ImGui::SmallButton(ICON_FA_CHART_LINE))
+            scoreTake(take);
+        if (scoring)
+            ImGui::EndDisabled();
+        ImGui::SetItemTooltip("Line the take up with the track and score its timing and pitch per section");
+
+        ImGui::SameLine();
+        const bool isShiftDown = ImGui::IsKeyDown(ImGuiKey_LeftShift) || ImGui::IsKeyDown(ImGuiKey_RightShift);
+        if (ImGui::SmallButton(ICON_FA_TRASH) && isShiftDown)
+            takeToDelete = static_cast<int>(i);
+        ImGui::SetItemTooltip("Press while holding Shift to delete the take and its file");
+
+        ImGui::SameLine();
+        ImGui::Text("%s  %s from %s at %.0f%%%s", Utils::getFileNameInPlace(take.filePath),
+                    Utils::TimeText(static_cast<float>(take.durationSeconds)).c_str(),
+                    Utils::TimeText(static_cast<float>(m_appState.toSeconds(take.startFrame))).c_str(),
+                    take.tempo * 100.0f, take.withBacking ? ", with track" : "");
+        ImGui::PopID();
+    }
+    renderTakeScore();
+
+    if (takeToDelete >= 0)
+    {
+        const Take& take = m_appState.takes[takeToDelete];
+        if (m_takeLoad.audioPath() == take.filePath)
+            stopListeningToTake();
+        if (m_takeScore.audioPath() == take.filePath)
+            m_takeScore.clear();
+        std::error_code error;
+        std::filesystem::remove(take.filePath, error);
+        m_appState.takes.erase(m_appState.takes.begin() + takeToDelete);
+        scheduleAutoSave();
+    }
+}
+
+void MainWindow::startTakeRecording()
+{
+    // Recording uses the same input as the live pitch
+    if (!m_audioEngine.inputEnabled())
+        m_audioEngine.setInputEnabled(true);
+    if (!m_audioEngine.inputActive())
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Warning, "Recording: no input device");
+        return;
+    }
+
+    const std::string directory = Utils::getExecutableDirectory() + "/" + kTakeDirectory;
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    const std::time_t now = std::time(nullptr);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H.%M.%S", std::localtime(&now));
+    const std::string filePath = directory + "/" + std::filesystem::path(m_appState.soundFilePath).stem().string()
+                                 + " take " + stamp + ".wav";
+
+    if (!m_audioEngine.startRecording(filePath, m_recordWithTrack))
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Error, "Recording: failed to create %s", filePath.c_str());
+        return;
+    }
+    m_recordingTrackPath = m_appState.soundFilePath;
+    if (!m_audioEngine.isPlaying())
+        startPlayback();
+}
+
+void MainWindow::listenToTake(const Take& take)
+{
+    const std::string filePath = take.filePath;
+    const uint32_t sampleRate = m_audioEngine.getSampleRate();
+    m_audioEngine.setTakePlayback(nullptr, 0, 1.0f, false);
+    m_takeLoad.start(filePath, [filePath, sampleRate](const auto& onProgress) {
+        DecodedAudio decoded;
+        if (!AudioEngine::decodeAudioFile(filePath, sampleRate, decoded, onProgress))
+            return std::shared_ptr<PcmStore>();
+        return decoded.pcm;
+    });
+}
+
+void MainWindow::stopListeningToTake()
+{
+    m_takeLoad.clear();
+    m_audioEngine.setTakePlayback(nullptr, 0, 1.0f, false);
+}
+
+void MainWindow::scoreTake(const Take& take)
+{
+    const std::shared_ptr<const PcmStore> reference = m_audioEngine.getAudioData();
+    if (!reference)
+        return;
+    const std::string filePath = take.filePath;
+    const std::string audioPath = m_audioEngine.loadedFilePath();
+    const uint32_t sampleRate = m_audioEngine.getSampleRate();
+    const float tempo = take.tempo;
+    const uint64_t startFrame = take.startFrame;
+    std::vector<Marker> markers = m_appState.markers;
+    m_takeScore.start(filePath, [=](const auto& onProgress) {
+        // Decoding and the track's contour (usually cached) come first
+        DecodedAudio decoded;
+        if (!AudioEngine::decodeAudioFile(filePath, sampleRate, decoded, [&](float fraction) { return onProgress(0.1f * fraction); }))
+            return TakeScore{};
+        const PitchContour referencePitch = PitchDetection::analyzeTrack(audioPath, *reference, [&](float fraction) {
+            return onProgress(0.1f + 0.2f * fraction);
+        });
+        if (referencePitch.empty())
+            return TakeScore{};
+        return TakeAlignment::scoreTake(*decoded.pcm, tempo, startFrame, *reference, referencePitch, markers,
+                                        [&](float fraction) { return onProgress(0.3f + 0.7f * fraction); });
+    });
+}
+
+void MainWindow::renderTakeScore()
+{
+    if (m_takeScore.audioPath().empty())
+        return;
+    const auto take = std::find_if(m_appState.takes.begin(), m_appState.takes.end(), [this](const Take& candidate) {
+        return candidate.filePath == m_takeScore.audioPath();
+    });
+    if (take == m_appState.takes.end())
+        return;
+
+    ImGui::Spacing();
+    ImGui::Text("Score of %s", Utils::getFileNameInPlace(take->filePath));
+    if (m_takeScore.isRunning())
+    {
+        ImGui::ProgressBar(m_takeScore.progress(), HelloImGui::EmToVec2(16.f, 0.f), "Aligning...");
+        return;
+    }
+    const TakeScore& score = m_takeScore.result();
+
+    // Offsets a listener would hardly notice count as on time and in tune
+    const auto timingText = [](const SectionScore& section) -> std::string {
+        if (section.timingHops == 0)
+            return "-";
+        char text[48];
+        const char* verdict = std::abs(section.timingMs) < 30.0 ? "on time" : section.timingMs > 0.0 ? "dragging" : "rushing";
+        std::snprintf(text, sizeof(text), "%+.0f ms, %s", section.timingMs, verdict);
+        return text;
+    };
+    const auto pitchText = [](const SectionScore& section) -> std::string {
+        if (section.pitchHops == 0)
+            return "-";
+        char text[64];
+        const char* verdict = std::abs(section.pitchCents) < 10.0 ? "in tune" : section.pitchCents > 0.0 ? "sharp" : "flat";
+        std::snprintf(text, sizeof(text), "%+.0f ct, %s (%.0f ct off)", section.pitchCents, verdict, section.pitchErrorCents);
+        return text;
+    };
+
+    const ImGuiTableFlags flags = ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg;
+    if (ImGui::BeginTable("TakeScore", 4, flags))
+    {
+        ImGui::TableSetupColumn("Section");
+        ImGui::TableSetupColumn("From");
+        ImGui::TableSetupColumn("Timing");
+        ImGui::TableSetupColumn("Pitch");
+        ImGui::TableHeadersRow();
+        for (size_t i = 0; i <= score.sections.size(); ++i)
+        {
+            const bool overall = i == score.sections.size();
+            const SectionScore& section = overall ? score.overall : score.sections[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(section.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(Utils::TimeText(static_cast<float>(m_appState.toSeconds(section.startFrame))).c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(timingText(section).c_str());
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(pitchText(section).c_str());
+        }
+        ImGui::EndTable();
+    }
+    if (take->withBacking)
+        ImGui::TextDisabled("Recorded with the track: its pitch is mixed into the take's.");
+}
+
+void MainWindow::updateTakes()
+{
+    RecordedTake recorded;
+    if (m_audioEngine.takeFinishedRecording(recorded))
+    {
+        const char* name = Utils::getFileNameInPlace(recorded.filePath);
+        if (recorded.frameCount == 0)
+        {
+            HelloImGui::Log(HelloImGui::LogLevel::Warning, "Recording: nothing was captured");
+        }
+        else if (m_appState.soundFilePath != m_recordingTrackPath)
+        {
+            HelloImGui::Log(HelloImGui::LogLevel::Warning, "Recording: the track changed, take kept in %s", name);
+        }
+        else
+        {
+            Take take;
+            take.filePath = recorded.filePath;
+            take.startFrame = recorded.startFrame;
+            take.tempo = recorded.tempo;
+            take.durationSeconds = m_appState.toSeconds(recorded.frameCount);
+            take.withBacking = recorded.withBacking;
+            m_appState.takes.push_back(std::move(take));
+            scheduleAutoSave();
+            HelloImGui::Log(HelloImGui::LogLevel::Info, "Recorded take %s (%s)%s", name,
+                            Utils::TimeText(static_cast<float>(m_appState.takes.back().durationSeconds)).c_str(),
+                            recorded.truncated ? ", cut short: the disk fell behind" : "");
+        }
+    }
+
+    if (m_takeScore.update() && m_takeScore.result().empty())
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Error, "Could not score take %s", Utils::getFileNameInPlace(m_takeScore.audioPath()));
+        m_takeScore.clear();
+    }
+    else if (!m_takeScore.audioPath().empty()
+             && std::none_of(m_appState.takes.begin(), m_appState.takes.end(), [this](const Take& take) {
+                    return take.filePath == m_takeScore.audioPath();
+                }))
+    {
+        m_takeScore.clear();
+    }
+
+    // A take of another track (after a setlist advance) is never heard; let it go
+    const auto listened = std::find_if(m_appState.takes.begin(), m_appState.takes.end(), [this](const Take& take) {
+        return take.filePath == m_takeLoad.audioPath();
+    });
+    if (!m_takeLoad.audioPath().empty() && listened == m_appState.takes.end())
+    {
+        stopListeningToTake();
+        return;
+    }
+
+    if (!m_takeLoad.update())
+        return;
+    if (!m_takeLoad.result())
+    {
+        HelloImGui::Log(HelloImGui::LogLevel::Error, "Failed to load take %s", Utils::getFileNameInPlace(listened->filePath));
+        m_takeLoad.clear();
+        return;
+    }
+
+    // The take lines up with the track only at the tempo it was sung to
+    if (std::abs(listened->tempo - m_audioEngine.getTempoMultiplier()) > 0.001f)
+    {
+        m_appState.tempoMultiplier = listened->tempo;
+        m_pendingTempoMultiplier = listened->tempo;
+        m_audioEngine.setTempoMultiplier(listened->tempo);
+        scheduleAutoSave();
+    }
+    m_audioEngine.setTakePlayback(m_takeLoad.result(), listened->startFrame, listened->tempo, listened->withBacking);
+    m_audioEngine.seekToFrame(listened->startFrame);
+    startPlayback();
+}
+
+void MainWindow::startPlayback()
+{
+    // Rewind to start if at the end
+    if (m_audioEngine.getCurrentFrame() >= m_audioEngine.getFrameCount())
+        m_audioEngine.seekToFrame(0);
+    m_audioEngine.playWithCountIn(static_cast<uint32_t>(m_countInBars));
+}
+
+void MainWindow::updateLivePitch()
+{
+    m_livePoints.clear();
+    m_liveTimes.clear();
+    m_liveNotes.clear();
+    if (m_audioEngine.inputActive())
+    {
+        const int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        m_audioEngine.livePitch().pointsSince(nowNs - kLivePitchTrailNs, m_livePoints);
+
+        const uint32_t sampleRate = m_audioEngine.getSampleRate();
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        for (const LivePitchPoint& point : m_livePoints)
+        {
+            // Sung while paused: nothing to place it against
+            if (!point.onTrack)
+                continue;
+            const float time = static_cast<float>(FrameTime::toSeconds(point.trackFrame, sampleRate));
+            if (!m_liveTimes.empty() && std::abs(time - m_liveTimes.back()) > kLivePitchGapSeconds)
+            {
+                m_liveTimes.push_back(time);
+                m_liveNotes.push_back(nan);
+            }
+            m_liveTimes.push_back(time);
+            m_liveNotes.push_back(point.note);
+        }
+
+        // A result reaches the screen in the first frame that draws it
+        if (!m_livePoints.empty() && m_livePoints.back().captureTimeNs > m_lastLiveCaptureNs)
+        {
+            m_lastLiveCaptureNs = m_livePoints.back().captureTimeNs;
+            const double latency = static_cast<double>(nowNs - m_lastLiveCaptureNs) * 1e-6;
+            m_liveLatencyMs = (m_liveLatencyMs == 0.0) ? latency : m_liveLatencyMs + 0.1 * (latency - m_liveLatencyMs);
+        }
+    }
+    m_waveformRenderer.setLivePitch(m_liveTimes, m_liveNotes);
+}
+
+void MainWindow::updateTrackAnalysis()
+{
+    if (!m_audioEngine.hasAudio())
+    {
+        if (!m_beatAnalysis.audioPath().empty())
+        {
+            m_beatAnalysis.clear();
+            m_pitchAnalysis.clear();
+            m_analysedAudio = nullptr;
+            m_waveformRenderer.setPitchContour(PitchContour{});
+        }
+        return;
+    }
+
+    // A reloaded track replaces the waveform as well, so it is analysed (or read from the cache) again
+    const std::string& audioPath = m_audioEngine.loadedFilePath();
+    const std::shared_ptr<const PcmStore> pcm = m_audioEngine.getAudioData();
+    if (m_beatAnalysis.audioPath() != audioPath || m_analysedAudio != pcm.get())
+    {
+        m_analysedAudio = pcm.get();
+        m_beatAnalysis.start(audioPath, [audioPath, pcm](const auto& onProgress) {
+            return BeatDetection::analyzeTrack(audioPath, *pcm, onProgress);
+        });
+        m_pitchAnalysis.start(audioPath, [audioPath, pcm](const auto& onProgress) {
+            return PitchDetection::analyzeTrack(audioPath, *pcm, onProgress);
+        });
+        m_waveformRenderer.setPitchContour(PitchContour{});
+    }
+
+    if (m_pitchAnalysis.update())
+        m_waveformRenderer.setPitchContour(m_pitchAnalysis.result());
+
+    if (!m_beatAnalysis.update())
+        return;
+    const BeatAnalysis& analysis = m_beatAnalysis.result();
+    if (analysis.empty())
+        return;
+    HelloImGui::Log(HelloImGui::LogLevel::Info, "Beat analysis: %.1f BPM, %zu onsets, %zu beats",
+                    analysis.bpm, analysis.onsets.size(), analysis.beats.size());
+
+    // A grid set up by hand is kept; otherwise the detected tempo map becomes the track's
+    BeatGrid grid;
+    if (m_appState.beatGrid.isValid() || !analysis.fitGrid(m_appState.beatGrid.beatsPerBar, grid))
+        return;
+    grid.firstBeatFrame = FrameTime::rescale(grid.firstBeatFrame, analysis.sampleRate, m_appState.sampleRate);
+    m_appState.beatGrid = grid;
+    m_audioEngine.setBeatGrid(grid.bpm, grid.firstBeatFrame, grid.beatsPerBar);
+    scheduleAutoSave();
+}
+
+uint64_t MainWindow::snapFrame(uint64_t frame) const
+{
+    const BeatAnalysis& analysis = m_beatAnalysis.result();
+    if (m_snapMode == 0 || analysis.sampleRate != m_appState.sampleRate
+        || m_beatAnalysis.audioPath() != m_audioEngine.loadedFilePath())
+        return frame;
+
+    const std::vector<uint64_t>& targets = (m_snapMode == 2) ? analysis.beats : analysis.onsets;
+    const uint64_t maxDistance = m_appState.toFrame(kSnapSeconds);
+    uint64_t snapped = frame;
+    BeatAnalysis::nearest(targets, frame, maxDistance, snapped);
+    return snapped;
+}
+
 void MainWindow::seekToPreviousMarker()
 {
     if (m_appState.markers.empty())
     {
-        m_audioEngine.seek(0.0f);
+        m_audioEngine.seekToFrame(0);
         return;
     }
 
-    const float currentTime = m_audioEngine.getCurrentTime();
+    const uint64_t currentFrame = m_audioEngine.getCurrentFrame();
     const int idx = currentMarkerIndex();
 
     if (idx >= 0)
     {
-        const float distanceToCurrentMarker = currentTime - m_appState.markers[idx].timeSeconds;
+        const uint64_t distanceToCurrentMarker = currentFrame - m_appState.markers[idx].frame;
 
-        if (distanceToCurrentMarker > 1.f)
+        if (distanceToCurrentMarker > m_appState.sampleRate)
         {
-            // Head is far from current marker, seek to current marker
-            m_audioEngine.seek(m_appState.markers[idx].timeSeconds);
+            // Head is more than a second past the current marker, seek to current marker
+            m_audioEngine.seekToFrame(m_appState.markers[idx].frame);
         }
         else if (idx > 0)
         {
             // Head is close to current marker, seek to previous marker
-            m_audioEngine.seek(m_appState.markers[idx - 1].timeSeconds);
+            m_audioEngine.seekToFrame(m_appState.markers[idx - 1].frame);
         }
         else
         {
             // No previous marker, seek to start
-            m_audioEngine.seek(0.0f);
+            m_audioEngine.seekToFrame(0);
         }
     }
     else
     {
         // No marker before current position, seek to start
-        m_audioEngine.seek(0.0f);
+        m_audioEngine.seekToFrame(0);
     }
 }
 
@@ -500,12 +1387,12 @@ void MainWindow::seekToNextMarker()
     if (nextIdx < static_cast<int>(m_appState.markers.size()))
     {
         // Seek to next marker
-        m_audioEngine.seek(m_appState.markers[nextIdx].timeSeconds);
+        m_audioEngine.seekToFrame(m_appState.markers[nextIdx].frame);
     }
     else
     {
         // seek to end
-        m_audioEngine.seek(m_audioEngine.getDuration());
+        m_audioEngine.seekToFrame(m_audioEngine.getFrameCount());
     }
 }
 
@@ -532,12 +1419,19 @@ void MainWindow::renderMarkerControls()
     if (showControlButton(ICON_FA_PLUS, "Add Marker"))
     {
         Marker marker;
-        marker.timeSeconds = m_audioEngine.getCurrentTime();
-        marker.name = Utils::formatTime(marker.timeSeconds);
+        marker.frame = snapFrame(m_audioEngine.getCurrentFrame());
+        marker.name = Utils::formatTime(static_cast<float>(m_appState.toSeconds(marker.frame)));
         m_appState.markers.push_back(marker);
-        sortMarkers();
+        markersChanged();
+        scheduleAutoSave();
     }
 
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(HelloImGui::EmSize(7.f));
+    ImGui::Combo("Snap", &m_snapMode, kSnapModes, IM_ARRAYSIZE(kSnapModes));
+    ImGui::SetItemTooltip("New markers and the downbeat move to the nearest\n"
+                          "detected onset or beat within half a second");
+
     if (!hasMarkers)
     {
         ImGui::TextDisabled(" No markers defined. ");
@@ -545,110 +1439,119 @@ void MainWindow::renderMarkerControls()
     }
 
 
-    ImGui::BeginChild("Markers", HelloImGui::EmToVec2(0.f, 10.5f), 0, ImGuiWindowFlags_HorizontalScrollbar);
     int markerToDelete = -1;
-    int markersPerColumn = 6;
 
     // Calculate current marker index
     int currentIdx = currentMarkerIndex();
 
-    static ImGuiTableFlags flags = ImGuiTableFlags_SizingFixedFit;
-    int nbColumns = (m_appState.markers.size() + markersPerColumn - 1) / markersPerColumn;
-    ImGui::BeginTable("Markers", nbColumns, flags);
-    ImGui::TableNextRow();
-    for (int i = 0; i < m_appState.markers.size(); ++i)
+    // One row per marker; the clipper only submits the rows that are scrolled into view
+    const ImGuiTableFlags flags = ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg;
+    if (ImGui::BeginTable("Markers", 4, flags, HelloImGui::EmToVec2(0.f, 10.5f)))
     {
-        if (i % markersPerColumn == 0)
-            ImGui::TableNextColumn();
-
-        ImGui::PushID(i);
-        Marker& marker = m_appState.markers[i];
-
-        // Highlight current marker in blue
-        bool isCurrentMarker = (i == currentIdx);
-        if (isCurrentMarker)
-            ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.2f, 0.5f, 1.0f, 1.0f));
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(m_appState.markers.size()));
+        while (clipper.Step())
+        {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+            {
+                ImGui::TableNextRow();
+                ImGui::PushID(i);
+                Marker& marker = m_appState.markers[i];
 
-        ImGui::Text("%05.2f s", marker.timeSeconds);
+                // Highlight current marker in blue
+                bool isCurrentMarker = (i == currentIdx);
+                if (isCurrentMarker)
+                    ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.2f, 0.5f, 1.0f, 1.0f));
 
-        ImGui::SameLine();
-        //ImGui::Text("Name");
-        //ImGui::SameLine();
-        ImGui::SetNextItemWidth(HelloImGui::EmSize(6.f));
-        ImGui::InputText("##Name", &marker.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%05.2f s", m_appState.toSeconds(marker.frame));
 
-        ImGui::SameLine();
-        if (ImGui::Button(" " ICON_FA_I_CURSOR " ##Marker"))
-            m_audioEngine.seek(marker.timeSeconds);
+                ImGui::TableNextColumn();
+                ImGui::SetNextItemWidth(HelloImGui::EmSize(12.f));
+                if (ImGui::InputText("##Name", &marker.name))
+                {
+                    m_markerViews[i].label = marker.name;
+                    scheduleAutoSave();
+                }
 
-        ImGui::SameLine();
-        bool isShiftDown = ImGui::IsKeyDown(ImGuiKey_LeftShift) || ImGui::IsKeyDown(ImGuiKey_RightShift);
-        if (ImGui::Button("Del") && isShiftDown)
-            markerToDelete = i;
-        ImGui::SetItemTooltip("Press while holding Shift to delete");
+                ImGui::TableNextColumn();
+                if (ImGui::Button(" " ICON_FA_I_CURSOR " ##Marker"))
+                    m_audioEngine.seekToFrame(marker.frame);
 
-        if (isCurrentMarker)
-            ImGui::PopStyleColor();
+                ImGui::TableNextColumn();
+                bool isShiftDown = ImGui::IsKeyDown(ImGuiKey_LeftShift) || ImGui::IsKeyDown(ImGuiKey_RightShift);
+                if (ImGui::Button("Del") && isShiftDown)
+                    markerToDelete = i;
+                ImGui::SetItemTooltip("Press while holding Shift to delete");
 
-        ImGui::PopID();
+                if (isCurrentMarker)
+                    ImGui::PopStyleColor();
 
+                ImGui::PopID();
+            }
+        }
+        ImGui::EndTable();
     }
-    ImGui::EndTable();
-    ImGui::EndChild();
     if (markerToDelete >= 0)
+    {
         m_appState.markers.erase(m_appState.markers.begin() + markerToDelete);
+        markersChanged();
+        scheduleAutoSave();
+    }
 }
 
 void MainWindow::renderWaveformArea()
 {
     ImGui::Spacing();
     ImGui::Text("Waveform Display:");
+    renderLoadProgress();
     ImGui::BeginChild("Waveform", ImVec2(0, 300), true);
 
+    bool cursorHeld = false;
     if (m_audioEngine.hasAudio() && m_waveformRenderer.hasWaveform())
     {
         ImPlot::SetNextAxesLimits(0.0, m_audioEngine.getDuration(), -1.0, 1.0, ImGuiCond_Once);
         float seekTime = 0.0f;
 
-        // Build marker views
-        std::vector<MarkerView> markerViews;
-        markerViews.reserve(m_appState.markers.size());
-        for (int i = 0; i < static_cast<int>(m_appState.markers.size()); ++i)
-        {
-            MarkerView mv;
-            mv.label = m_appState.markers[i].name;
-            mv.timeSeconds = m_appState.markers[i].timeSeconds;
-            markerViews.push_back(std::move(mv));
-        }
-
         // Calculate current marker index once
         int currentIdx = currentMarkerIndex();
 
-        if (m_waveformRenderer.draw("WaveformPlot",
-                                     ImVec2(-1, -1),
-                                     m_audioEngine.getCurrentTime(),
-                                     seekTime,
-                                     markerViews,
-                                     currentIdx))
-        {
-            m_audioEngine.seek(seekTime);
-        }
+        const bool cursorMoved = m_waveformRenderer.draw("WaveformPlot",
+                                                         ImVec2(-1, -1),
+                                                         m_audioEngine.getPlayheadTime(),
+                                                         seekTime,
+                                                         cursorHeld,
+                                                         m_markerViews,
+                                                         currentIdx);
+        // Dragging the cursor scrubs; releasing it leaves playback where it stopped
+        const uint64_t seekFrame = FrameTime::fromSeconds(seekTime, m_audioEngine.getSampleRate());
+        if (cursorHeld && !m_audioEngine.isScrubbing())
+            m_audioEngine.beginScrub(seekFrame);
+        else if (cursorMoved && m_audioEngine.isScrubbing())
+            m_audioEngine.scrubTo(seekFrame);
+        else if (cursorMoved)
+            m_audioEngine.seekToFrame(seekFrame);
+    }
+    else if (m_activeLoad)
+    {
+        ImGui::TextDisabled("Loading...");
     }
     else
     {
         ImGui::TextDisabled("Load an audio file to see waveform");
     }
+    if (!cursorHeld && m_audioEngine.isScrubbing())
+        m_audioEngine.endScrub();
 
     ImGui::EndChild();
 }
 
 void MainWindow::updateWaveformData()
 {
-    if (m_audioEngine.hasAudio())
+    const std::shared_ptr<const PcmStore> audioData = m_audioEngine.getAudioData();
+    if (m_audioEngine.hasAudio() && audioData)
     {
-        m_waveformRenderer.setWaveform(m_audioEngine.getAudioData(),
-                                       m_audioEngine.getChannelCount(),
-                                       m_audioEngine.getSampleRate());
+        m_waveformRenderer.setWaveform(*audioData);
     }
     else
     {
@@ -657,6 +1560,17 @@ void MainWindow::updateWaveformData()
     m_waveformDirty = false;
 }
 
+void MainWindow::applyWaveformPrecision()
+{
+    if (m_waveformRenderer.precision() == m_waveformPrecision)
+        return;
+
+    // Like restoring dropped detail, the loaded track's envelope is rebuilt on the next frame
+    m_waveformRenderer.setPrecision(m_waveformPrecision);
+    if (m_waveformRenderer.hasWaveform())
+        m_waveformDirty = true;
+}
+
 void MainWindow::showStatus()
 {
     // HelloImGui will handle the status bar layout, we just add content
@@ -664,6 +1578,10 @@ void MainWindow::showStatus()
     {
         ImGui::Text("Playing");
     }
+    else if (m_audioEngine.isLoading() || m_audioEngine.isInitializing())
+    {
+        ImGui::Text("Loading...");
+    }
     else
     {
         ImGui::Text("Ready");
@@ -677,34 +1595,124 @@ void MainWindow::showStatus()
     if (m_audioEngine.hasAudio())
     {
         ImGui::Text("%s - %s",
-                   Utils::getFileName(m_audioEngine.loadedFilePath()).c_str(),
-                   Utils::formatTime(m_audioEngine.getCurrentTime()).c_str());
+                   Utils::getFileNameInPlace(m_audioEngine.loadedFilePath()),
+                   Utils::TimeText(m_audioEngine.getPlayheadTime()).c_str());
     }
     else
     {
         ImGui::Text("No audio loaded");
     }
+
+    renderMemoryStatus();
+
+    ImGui::SameLine();
+    const size_t lockedBytes = RealtimeSupport::lockedBytes();
+    ImGui::Text(" | Audio: %s, %llu xruns%s%s",
+                m_audioEngine.callbackIsRealtime() ? "real-time" : "normal priority",
+                static_cast<unsigned long long>(m_audioEngine.xrunCount()),
+                lockedBytes > 0 ? ", locked " : "",
+                lockedBytes > 0 ? formatBytes(m_frameArena, lockedBytes) : "");
+
+    if (m_waveformRenderer.hasWaveform())
+    {
+        const WaveformRenderer::DrawStats& stats = m_waveformRenderer.drawStats();
+        ImGui::SameLine();
+        ImGui::Text(" | Waveform: %.3f ms (shaded body %.3f ms, geometry %s, last rebuild %.3f ms)",
+                    stats.lastDrawMs,
+                    stats.lastShadedMs,
+                    stats.lastDrawWasCached ? "cached" : "rebuilt",
+                    stats.lastGeometryBuildMs);
+    }
 }
 
-int MainWindow::currentMarkerIndex() const
+void MainWindow::registerMemoryReclaimers()
+{
+    // Cheapest first: detail levels are rebuilt with the next waveform update
+    m_memoryBudget.addReclaimer(0, "Waveform detail", [this]() {
+        const size_t released = m_waveformRenderer.dropFinestLevel();
+        reportWaveformMemory();
+        return released;
+    });
+    // Read back from disk on the next tempo change or waveform rebuild
+    m_memoryBudget.addReclaimer(1, "Original audio spill", [this]() {
+        return m_audioEngine.spillOriginalAudio();
+    });
+    // The song is loaded normally when the setlist moves on
+    m_memoryBudget.addReclaimer(2, "Preloaded setlist song", [this]() -> size_t {
+        if (!m_audioEngine.hasNextTrack())
+            return 0;
+        const size_t released = m_memoryBudget.usage(MemoryCategory::NextTrack)
+                                + (m_nextWaveform ? m_nextWaveform->memoryUsageBytes() : 0);
+        m_audioEngine.clearNextTrack();
+        m_memoryBudget.setUsage(MemoryCategory::NextTrack, 0);
+        m_nextWaveform.reset();
+        m_preloadHandle.reset();
+        m_preloadIndex = -1;
+        reportWaveformMemory();
+        return released;
+    });
+}
+
+void MainWindow::reportWaveformMemory()
+{
+    // The next song's waveform is built on the preload thread; count it once the preload is done
+    size_t bytes = m_waveformRenderer.memoryUsageBytes();
+    if (m_nextWaveform && m_audioEngine.hasNextTrack())
+        bytes += m_nextWaveform->memoryUsageBytes();
+    m_memoryBudget.setUsage(MemoryCategory::Waveform, bytes);
+}
+
+void MainWindow::renderMemoryStatus()
 {
-    const float currentTime = m_audioEngine.getCurrentTime();
-    int idx = -1;
-    for (int i = 0; i < static_cast<int>(m_appState.markers.size()); ++i)
+    const char* details = "";
+    for (size_t i = 0; i < static_cast<size_t>(MemoryCategory::Count); ++i)
     {
-        if (m_appState.markers[i].timeSeconds <= currentTime)
-            idx = i;
-        else
-            break;
+        const MemoryCategory category = static_cast<MemoryCategory>(i);
+        const size_t bytes = m_memoryBudget.usage(category);
+        if (bytes == 0)
+            continue;
+        details = m_frameArena.format("%s%s%s %s", details, details[0] ? ", " : "",
+                                      MemoryBudget::categoryName(category), formatBytes(m_frameArena, bytes));
+    }
+    if (m_memoryBudget.spilledBytes() > 0)
+    {
+        details = m_frameArena.format("%s%sspilled %s", details, details[0] ? ", " : "",
+                                      formatBytes(m_frameArena, m_memoryBudget.spilledBytes()));
     }
-    return idx;
+
+    const char* usage = formatBytes(m_frameArena, m_memoryBudget.totalUsage());
+    const char* limit = formatBytes(m_frameArena, m_memoryBudget.limit());
+    ImGui::SameLine();
+    if (m_memoryBudget.isOverBudget())
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), " | Memory: %s / %s (%s)", usage, limit, details);
+    else
+        ImGui::Text(" | Memory: %s / %s (%s)", usage, limit, details);
 }
 
-void MainWindow::sortMarkers()
+int MainWindow::currentMarkerIndex() const
+{
+    return m_markerIndex.indexAtOrBefore(m_audioEngine.getCurrentFrame());
+}
+
+void MainWindow::markersChanged()
 {
-    std::sort(m_appState.markers.begin(), m_appState.markers.end(), [](const Marker& a, const Marker& b) {
-        return a.timeSeconds < b.timeSeconds;
+    // Positions count frames at the rate the loaded track plays at
+    if (m_audioEngine.hasAudio())
+        m_appState.convertToSampleRate(m_audioEngine.getSampleRate());
+    const BeatGrid& grid = m_appState.beatGrid;
+    m_audioEngine.setBeatGrid(grid.bpm, grid.firstBeatFrame, grid.beatsPerBar);
+
+    std::stable_sort(m_appState.markers.begin(), m_appState.markers.end(), [](const Marker& a, const Marker& b) {
+        return a.frame < b.frame;
     });
+    m_markerIndex.rebuild(m_appState.markers);
+
+    m_markerViews.resize(m_appState.markers.size());
+    for (size_t i = 0; i < m_appState.markers.size(); ++i)
+    {
+        m_markerViews[i].label = m_appState.markers[i].name;
+        m_markerViews[i].timeSeconds = static_cast<float>(m_appState.toSeconds(m_appState.markers[i].frame));
+    }
 }
 
 void MainWindow::handleKeyboardShortcuts()
@@ -724,10 +1732,7 @@ void MainWindow::handleKeyboardShortcuts()
             }
             else
             {
-                // Rewind to start if at the end
-                if (m_audioEngine.getCurrentTime() >= m_audioEngine.getDuration())
-                    m_audioEngine.seek(0.0f);
-                m_audioEngine.play();
+                startPlayback();
             }
         }
     }
@@ -750,6 +1755,155 @@ void MainWindow::handleKeyboardShortcuts()
     }
 }
 
+void MainWindow::openLibraryEntry(const LibraryEntry& entry)
+{
+    // Prefer the saved session (markers, tempo) over a fresh one
+    if (!entry.settingsPath.empty() && loadTrackSettingsFromPath(entry.settingsPath))
+        return;
+    newSessionWithFile(entry.path);
+}
+
+void MainWindow::playSetlistEntry(int index)
+{
+    if (index < 0 || index >= static_cast<int>(m_setlist.entries().size()))
+        return;
+
+    const SetlistEntry& entry = m_setlist.entries()[static_cast<size_t>(index)];
+    m_setlist.setCurrentIndex(index);
+    m_playWhenLoaded = true;
+    if (entry.settingsPath.empty() || !loadTrackSettingsFromPath(entry.settingsPath))
+        newSessionWithFile(entry.audioPath);
+}
+
+void MainWindow::playNextSetlistEntry()
+{
+    // Preloaded: switch in place, onSetlistAdvanced() picks up the rest
+    if (m_audioEngine.hasNextTrack())
+    {
+        m_audioEngine.switchToNextTrack();
+        return;
+    }
+    playSetlistEntry(m_setlist.nextIndex());
+}
+
+void MainWindow::handleSetlistAction(const SetlistPanel::Result& result)
+{
+    switch (result.action)
+    {
+    case SetlistPanel::Action::PlayEntry:
+        playSetlistEntry(result.index);
+        break;
+    case SetlistPanel::Action::PlayNext:
+        playNextSetlistEntry();
+        break;
+    case SetlistPanel::Action::AddCurrentTrack:
+        if (m_audioEngine.hasAudio())
+        {
+            SetlistEntry entry;
+            entry.audioPath = m_appState.soundFilePath;
+            const std::string settingsPath = SettingsManager::getTrackSettingsPath(entry.audioPath);
+            if (std::filesystem::exists(settingsPath))
+                entry.settingsPath = settingsPath;
+            m_setlist.add(std::move(entry));
+            if (m_setlist.currentIndex() < 0)
+                m_setlist.setCurrentIndex(static_cast<int>(m_setlist.entries().size()) - 1);
+            prepareNextSetlistEntry();
+        }
+        break;
+    case SetlistPanel::Action::Edited:
+        prepareNextSetlistEntry();
+        break;
+    case SetlistPanel::Action::None:
+        break;
+    }
+}
+
+void MainWindow::setlistTrackLoaded(const std::string& filePath)
+{
+    const int index = m_setlist.currentIndex();
+    if (index < 0 || m_setlist.entries()[static_cast<size_t>(index)].audioPath != filePath)
+    {
+        // Opened outside the setlist
+        m_setlist.setCurrentIndex(-1);
+        m_playWhenLoaded = false;
+        return;
+    }
+
+    if (m_playWhenLoaded)
+    {
+        m_playWhenLoaded = false;
+        m_audioEngine.play();
+    }
+    prepareNextSetlistEntry();
+}
+
+void MainWindow::prepareNextSetlistEntry()
+{
+    const int nextIndex = m_setlist.nextIndex();
+    if (nextIndex < 0 || !m_audioEngine.hasAudio())
+    {
+        m_audioEngine.clearNextTrack();
+        m_preloadHandle.reset();
+        m_preloadIndex = -1;
+        return;
+    }
+
+    const SetlistEntry& entry = m_setlist.entries()[static_cast<size_t>(nextIndex)];
+    ApplicationState nextState;
+    if (!entry.settingsPath.empty() && !m_settingsManager.loadTrackSettings(entry.settingsPath, nextState))
+        nextState = ApplicationState{};
+    nextState.soundFilePath = entry.audioPath;
+    nextState.playPositionFrame = 0;
+
+    m_nextSetlistState = std::move(nextState);
+    m_nextWaveform = std::make_shared<WaveformRenderer>();
+    m_nextWaveform->setPrecision(m_waveformPrecision);
+    m_preloadIndex = nextIndex;
+
+    const auto prepareWaveform = [waveform = m_nextWaveform](const DecodedAudio& audio) {
+        waveform->setWaveform(*audio.pcm);
+    };
+    m_preloadHandle = m_audioEngine.preloadNextTrack(entry.audioPath,
+                                                     m_nextSetlistState.tempoMultiplier,
+                                                     prepareWaveform);
+}
+
+void MainWindow::onSetlistAdvanced()
+{
+    if (m_preloadIndex < 0 || !m_nextWaveform)
+        return;
+
+    m_setlist.setCurrentIndex(m_preloadIndex);
+    m_appState = std::move(m_nextSetlistState);
+    markersChanged();
+    m_pendingTempoMultiplier = m_appState.tempoMultiplier;
+    m_waveformRenderer = std::move(*m_nextWaveform);
+    m_waveformDirty = false;
+    m_nextWaveform.reset();
+    applyWaveformPrecision();
+
+    HelloImGui::Log(HelloImGui::LogLevel::Info, "Setlist: now playing %s",
+                    Utils::getFileName(m_appState.soundFilePath).c_str());
+    prepareNextSetlistEntry();
+}
+
+const char* MainWindow::setlistPreloadStatus()
+{
+    if (m_setlist.nextIndex() < 0)
+        return m_setlist.currentIndex() >= 0 ? "Last song" : "";
+
+    if (m_audioEngine.hasNextTrack())
+        return m_frameArena.format("Next ready: %s", Utils::getFileNameInPlace(m_audioEngine.nextTrackPath()));
+
+    if (m_preloadHandle && !m_preloadHandle->isFinished())
+    {
+        return m_frameArena.format("Preparing next: %s (%d%%)", Utils::getFileNameInPlace(m_preloadHandle->filePath()),
+                                   static_cast<int>(m_preloadHandle->progress() * 100.0f));
+    }
+    // Failed or skipped for the memory budget (see log); loaded normally when switching
+    return "Next song loads on switch";
+}
+
 bool MainWindow::loadTrackSettingsFromPath(const std::string& settingsPath)
 {
     ApplicationState tempState;
@@ -760,28 +1914,38 @@ bool MainWindow::loadTrackSettingsFromPath(const std::string& settingsPath)
         return false;
     }
 
-    // If the settings reference an audio file, ensure it loads before committing the state
-    if (!tempState.soundFilePath.empty())
+    if (tempState.soundFilePath.empty())
     {
-        if (!m_audioEngine.loadAudioFile(tempState.soundFilePath.c_str()))
+        applyTrackSettings(tempState, settingsPath);
+        return true;
+    }
+
+    // If the settings reference an audio file, ensure it loads before committing the state
+    startAudioLoad(tempState.soundFilePath, [this, tempState, settingsPath](bool loaded) {
+        if (!loaded)
         {
             HelloImGui::Log(HelloImGui::LogLevel::Warning,
                           "Loaded settings but couldn't load audio file: %s",
                           Utils::getFileName(tempState.soundFilePath).c_str());
-            return false;
+            return;
         }
-    }
+        applyTrackSettings(tempState, settingsPath);
+    });
+    return true;
+}
 
+void MainWindow::applyTrackSettings(const ApplicationState& state, const std::string& settingsPath)
+{
     // Commit state only after successful settings (and audio, if any) load
-    m_appState = tempState;
+    m_appState = state;
+    markersChanged();
 
     if (!m_appState.soundFilePath.empty())
     {
-        m_waveformDirty = true;
         m_audioEngine.setTempoMultiplier(m_appState.tempoMultiplier);
         m_pendingTempoMultiplier = m_appState.tempoMultiplier;
-        if (m_appState.playPosition > 0.0f)
-            m_audioEngine.seek(m_appState.playPosition);
+        if (m_appState.playPositionFrame > 0)
+            m_audioEngine.seekToFrame(m_appState.playPositionFrame);
         HelloImGui::Log(HelloImGui::LogLevel::Info, "Loaded track settings and audio file: %s",
                       Utils::getFileName(m_appState.soundFilePath).c_str());
     }
@@ -792,10 +1956,8 @@ bool MainWindow::loadTrackSettingsFromPath(const std::string& settingsPath)
     }
 
     addRecentSettingsPath(settingsPath);
-    return true;
 }
 
-
 void MainWindow::addRecentSettingsPath(const std::string& settingsPath)
 {
     const std::string normalized = normalizePath(settingsPath);
@@ -822,6 +1984,32 @@ void MainWindow::addRecentSettingsPath(const std::string& settingsPath)
 
 void MainWindow::loadUserPrefs()
 {
+    const std::string budgetPref = HelloImGui::LoadUserPref("memory_budget_mib");
+    if (!budgetPref.empty())
+    {
+        m_memoryBudgetMiB = std::clamp(std::atoi(budgetPref.c_str()), 256, 16384);
+        m_memoryBudget.setLimit(static_cast<size_t>(m_memoryBudgetMiB) << 20);
+    }
+
+    const std::string realtimePref = HelloImGui::LoadUserPref("realtime_safety");
+    if (!realtimePref.empty())
+        m_audioEngine.setRealtimeSafety(realtimePref != "0");
+
+    m_audioEngine.setMetronomeEnabled(HelloImGui::LoadUserPref("metronome_enabled") == "1");
+    const std::string volumePref = HelloImGui::LoadUserPref("metronome_volume");
+    if (!volumePref.empty())
+        m_audioEngine.setMetronomeVolume(static_cast<float>(std::atof(volumePref.c_str())));
+    const std::string countInPref = HelloImGui::LoadUserPref("count_in_bars");
+    if (!countInPref.empty())
+        m_countInBars = std::clamp(std::atoi(countInPref.c_str()), 0, 4);
+    const std::string snapPref = HelloImGui::LoadUserPref("marker_snap");
+    if (!snapPref.empty())
+        m_snapMode = std::clamp(std::atoi(snapPref.c_str()), 0, IM_ARRAYSIZE(kSnapModes) - 1);
+    m_audioEngine.setInputEnabled(HelloImGui::LoadUserPref("live_pitch") == "1");
+    m_waveformPrecision = (HelloImGui::LoadUserPref("waveform_precision") == "16") ? EnvelopePrecision::Int16
+                                                                                   : EnvelopePrecision::Int8;
+    applyWaveformPrecision();
+
     std::string recentJson = HelloImGui::LoadUserPref("recent_track_settings");
     if (recentJson.empty())
         return;
@@ -865,6 +2053,14 @@ void MainWindow::saveUserPrefs()
         for (const auto& path : m_recentTrackSettings)
             j.push_back(path);
         HelloImGui::SaveUserPref("recent_track_settings", j.dump());
+        HelloImGui::SaveUserPref("memory_budget_mib", std::to_string(m_memoryBudgetMiB));
+        HelloImGui::SaveUserPref("realtime_safety", m_audioEngine.realtimeSafety() ? "1" : "0");
+        HelloImGui::SaveUserPref("metronome_enabled", m_audioEngine.metronomeEnabled() ? "1" : "0");
+        HelloImGui::SaveUserPref("metronome_volume", std::to_string(m_audioEngine.metronomeVolume()));
+        HelloImGui::SaveUserPref("count_in_bars", std::to_string(m_countInBars));
+        HelloImGui::SaveUserPref("marker_snap", std::to_string(m_snapMode));
+        HelloImGui::SaveUserPref("live_pitch", m_audioEngine.inputEnabled() ? "1" : "0");
+        HelloImGui::SaveUserPref("waveform_precision", m_waveformPrecision == EnvelopePrecision::Int16 ? "16" : "8");
     }
     catch (const std::exception& e)
     {
@@ -886,21 +2082,20 @@ void MainWindow::newSessionWithFile(const std::string& filePath)
         HelloImGui::Log(HelloImGui::LogLevel::Warning, "Currently supported formats: wav, mp3 (got: %s)", extension.c_str());
         return;
     }
-    if (!m_audioEngine.loadAudioFile(filePath.c_str()))
-    {
-        HelloImGui::Log(HelloImGui::LogLevel::Error, "Failed to load audio file: %s", Utils::getFileName(filePath).c_str());
-        return;
-    }
+    startAudioLoad(filePath, [this, filePath](bool loaded) {
+        if (!loaded)
+            return;
 
-    // Only clear state if loading succeeded
-    m_waveformRenderer.clear();
-    m_appState.soundFilePath = filePath;
-    m_appState.playPosition = 0.0f;
-    m_appState.tempoMultiplier = 1.0f;
-    m_pendingTempoMultiplier = 1.0f;
-    m_appState.markers.clear();
-    m_waveformDirty = true;
-    m_audioEngine.setTempoMultiplier(1.0f);
-    m_audioEngine.seek(0.0f);
-    HelloImGui::Log(HelloImGui::LogLevel::Info, "Started new session with file: %s", Utils::getFileName(filePath).c_str());
+        // Only clear state if loading succeeded
+        m_appState.soundFilePath = filePath;
+        m_appState.playPositionFrame = 0;
+        m_appState.tempoMultiplier = 1.0f;
+        m_pendingTempoMultiplier = 1.0f;
+        m_appState.markers.clear();
+        m_appState.takes.clear();
+        markersChanged();
+        m_audioEngine.setTempoMultiplier(1.0f);
+        m_audioEngine.seekToFrame(0);
+        HelloImGui::Log(HelloImGui::LogLevel::Info, "Started new session with file: %s", Utils::getFileName(filePath).c_str());
+    });
 }
@@ -1,24 +1,27 @@
 #pragma once
 #include "audio/AudioEngine.h"
+#include "audio/BeatAnalysis.h"
+#include "audio/PitchDetection.h"
+#include "audio/TakeAlignment.h"
+#include "ui/FrameScheduler.h"
+#include "ui/FrameStatsOverlay.h"
+#include "ui/LibraryPanel.h"
+#include "ui/SetlistPanel.h"
 #include "ui/WaveformRenderer.h"
+#include "core/AnalysisJob.h"
+#include "core/ApplicationState.h"
+#include "core/FrameArena.h"
+#include "core/MarkerIndex.h"
+#include "core/MemoryBudget.h"
 #include "core/SettingsManager.h"
+#include "core/Setlist.h"
+#include "core/TrackLibrary.h"
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
-struct Marker
-{
-    std::string name;
-    float timeSeconds = 0.0f;
-};
-
-struct ApplicationState
-{
-    std::vector<Marker> markers;
-    std::string soundFilePath;
-    float playPosition = 0.0f;
-    float tempoMultiplier = 1.0f;  // 1.0 = normal speed, 0.5 = half speed, 2.0 = double speed
-};
-
 class MainWindow
 {
 public:
@@ -50,18 +53,78 @@ public:
     void loadTrackSettings();
     void saveTrackSettings();
 
+    // Timed lyrics (LRC / SRT / VTT) <-> markers
+    void importTimedText();
+    void exportTimedText();
+
+    // Performance trace (see Trace) as Chrome trace JSON
+    void exportTrace();
+
 private:
 
     void renderAudioControls();
     void renderTempoControls();
+    void renderMetronomeControls();
+    void renderMicrophoneControls();
+    void renderTakeControls();
     void renderMarkerControls();
     void renderWaveformArea();
     void updateWaveformData();
+    // Rebuilds the waveform when its envelope precision differs from the preference
+    void applyWaveformPrecision();
+    // Loads audio in the background; the waveform is built on the loader thread as well.
+    // onFinished runs on the UI thread unless the load was cancelled.
+    void startAudioLoad(const std::string& filePath, std::function<void(bool loaded)> onFinished);
+    void renderLoadProgress();
+    // The last session's audio is restored in the background so the first frame is not delayed
+    void startSessionRestore();
     void handleKeyboardShortcuts();
     int currentMarkerIndex() const;
-    void sortMarkers();
+    // Moves positions to the loaded track's rate, re-sorts markers, rebuilds the index and
+    // waveform views and hands the beat grid to the engine; call after any add/remove/move
+    // and once a track is loaded
+    void markersChanged();
+    // Play button and Space: rewinds at the end and counts in when that is enabled
+    void startPlayback();
+    // Starts the beat and pitch analyses of each newly loaded track and collects them: a
+    // track without a beat grid gets the detected one, the contour goes to the waveform
+    void updateTrackAnalysis();
+    // The mic's recent pitch, placed at the track times it was sung to, for the waveform
+    void updateLivePitch();
+    // Practice takes: recorded into kTakeDirectory next to the executable and listed in the
+    // track's settings. Listening back loads the take and plays it over the track from
+    // where it was sung, at its tempo.
+    void startTakeRecording();
+    void listenToTake(const Take& take);
+    void stopListeningToTake();
+    // Aligns the take with the track in the background and scores it per marker section
+    void scoreTake(const Take& take);
+    void renderTakeScore();
+    // Lists finished recordings, starts playback of loaded takes and collects scores
+    void updateTakes();
+    // frame moved onto the nearest onset or beat of the analysis, as the snap mode says
+    uint64_t snapFrame(uint64_t frame) const;
+    // Queues a debounced background save of the session; safe to call on every edit
+    void scheduleAutoSave();
+    void handleFinishedSaves();
+
+    // Setlist: the next entry is preloaded so the engine can roll over into it without a gap
+    void playSetlistEntry(int index);
+    void playNextSetlistEntry();
+    void handleSetlistAction(const SetlistPanel::Result& result);
+    void setlistTrackLoaded(const std::string& filePath);
+    void prepareNextSetlistEntry();
+    void onSetlistAdvanced();
+    const char* setlistPreloadStatus();
+
+    // Memory budget: derived data is dropped or spilled when the total goes over the limit
+    void registerMemoryReclaimers();
+    void reportWaveformMemory();
+    void renderMemoryStatus();
 
     bool loadTrackSettingsFromPath(const std::string& settingsPath);
+    void applyTrackSettings(const ApplicationState& state, const std::string& settingsPath);
+    void openLibraryEntry(const LibraryEntry& entry);
     void addRecentSettingsPath(const std::string& settingsPath);
 
     void seekToPreviousMarker();
@@ -69,12 +132,52 @@ private:
     void seekToNextMarker();
 
     // Application state
+    MemoryBudget m_memoryBudget;  // Declared first: the engine reports to it until it is destroyed
     AudioEngine m_audioEngine;
     WaveformRenderer m_waveformRenderer;
     ApplicationState m_appState;
+    MarkerIndex m_markerIndex;
+    std::vector<MarkerView> m_markerViews;  // Mirrors m_appState.markers for the waveform
     SettingsManager m_settingsManager;
+    TrackLibrary m_trackLibrary;
+    LibraryPanel m_libraryPanel;
+    FrameScheduler m_frameScheduler;
+    FrameStatsOverlay m_frameStats;
+    FrameArena m_frameArena;  // Per-frame UI text; reset at the start of showGui
     bool m_waveformDirty = false;
+    EnvelopePrecision m_waveformPrecision = EnvelopePrecision::Int8;  // User pref; applies to new waveforms
     bool m_wasTempoProcessing = false;
     float m_pendingTempoMultiplier = 1.0f;  // Tempo value in slider (not yet applied)
     std::vector<std::string> m_recentTrackSettings;
+    int m_memoryBudgetMiB = static_cast<int>(MemoryBudget::DEFAULT_LIMIT >> 20);
+    int m_countInBars = 0;  // Before playback starts, when the track has a beat grid
+    AnalysisJob<BeatAnalysis> m_beatAnalysis{"Beat analysis"};
+    AnalysisJob<PitchContour> m_pitchAnalysis{"Pitch analysis"};
+    const PcmStore* m_analysedAudio = nullptr;  // Identifies the load the analyses belong to
+    int m_snapMode = 1;  // Index into kSnapModes: off, onsets, beats
+    std::vector<LivePitchPoint> m_livePoints;  // Last few seconds of the mic, refilled every frame
+    std::vector<float> m_liveTimes;
+    std::vector<float> m_liveNotes;
+    int64_t m_lastLiveCaptureNs = 0;
+    double m_liveLatencyMs = 0.0;  // Microphone to screen, smoothed
+    bool m_recordWithTrack = false;
+    std::string m_recordingTrackPath;  // Track the take in progress belongs to
+    AnalysisJob<std::shared_ptr<PcmStore>> m_takeLoad{"Load take"};  // Keyed by the take's file
+    AnalysisJob<TakeScore> m_takeScore{"Score take"};                // Keyed by the take's file
+
+    // Startup
+    std::chrono::steady_clock::time_point m_startupTime;
+    bool m_firstFrameShown = false;
+    bool m_libraryIndexLoaded = false;  // Loaded on the second frame
+
+    std::shared_ptr<AudioLoadHandle> m_activeLoad;
+
+    // Setlist
+    Setlist m_setlist;
+    SetlistPanel m_setlistPanel;
+    bool m_playWhenLoaded = false;
+    int m_preloadIndex = -1;                           // Setlist entry held by the engine's next-track slot
+    ApplicationState m_nextSetlistState;               // Its markers and tempo
+    std::shared_ptr<WaveformRenderer> m_nextWaveform;  // Built on the preload thread
+    std::shared_ptr<AudioLoadHandle> m_preloadHandle;
 };
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "SetlistPanel.h"
+#include "core/Setlist.h"
+#include "core/SettingsManager.h"
+#include "core/Utils.h"
+#include "imgui.h"
+#include "hello_imgui/hello_imgui.h"
+#include "portable_file_dialogs/portable_file_dialogs.h"
+#include "hello_imgui/icons_font_awesome_6.h"
+#include <filesystem>
+
+SetlistPanel::Result SetlistPanel::render(Setlist& setlist, const char* preloadStatus)
+{
+    Result result;
+    if (!m_open)
+        return result;
+
+    ImGui::SetNextWindowSize(HelloImGui::EmToVec2(36.f, 26.f), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Setlist", &m_open))
+    {
+        ImGui::End();
+        return result;
+    }
+
+    if (ImGui::Button("Open..."))
+    {
+        auto selection = pfd::open_file("Open Setlist", "",
+                                        {"SongPractice Setlist", std::string("*") + Setlist::FILE_EXTENSION,
+                                         "All Files", "*"}).result();
+        if (!selection.empty() && setlist.loadFromFile(selection[0]))
+        {
+            m_filePath = selection[0];
+            result.action = Action::Edited;
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Save..."))
+    {
+        const std::string defaultPath = m_filePath.empty() ? std::string("setlist") + Setlist::FILE_EXTENSION : m_filePath;
+        std::string filePath = pfd::save_file("Save Setlist", defaultPath,
+                                              {"SongPractice Setlist", std::string("*") + Setlist::FILE_EXTENSION}).result();
+        if (!filePath.empty())
+        {
+            if (!Utils::stringEndsWith(filePath, Setlist::FILE_EXTENSION))
+                filePath += Setlist::FILE_EXTENSION;
+            if (setlist.saveToFile(filePath))
+                m_filePath = filePath;
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Add Files..."))
+    {
+        auto selection = pfd::open_file("Add Songs to Setlist", "",
+                                        {"Audio Files", "*.wav *.mp3", "All Files", "*"},
+                                        pfd::opt::multiselect).result();
+        for (const std::string& audioPath : selection)
+        {
+            // Pick up the song's saved markers and tempo when they sit next to it
+            SetlistEntry entry;
+            entry.audioPath = audioPath;
+            const std::string settingsPath = SettingsManager::getTrackSettingsPath(audioPath);
+            std::error_code error;
+            if (std::filesystem::exists(settingsPath, error))
+                entry.settingsPath = settingsPath;
+            setlist.add(std::move(entry));
+        }
+        if (!selection.empty())
+            result.action = Action::Edited;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Add Current Song"))
+        result.action = Action::AddCurrentTrack;
+
+    ImGui::BeginDisabled(setlist.nextIndex() < 0);
+    if (ImGui::Button(ICON_FA_FORWARD_STEP " Next Song"))
+        result.action = Action::PlayNext;
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    ImGui::TextDisabled("%s", preloadStatus);
+
+    ImGui::Separator();
+
+    int entryToRemove = -1;
+    int moveFrom = -1;
+    int moveTo = -1;
+    const std::vector<SetlistEntry>& entries = setlist.entries();
+    const ImGuiTableFlags flags = ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg;
+    if (ImGui::BeginTable("SetlistEntries", 4, flags))
+    {
+        ImGui::TableSetupColumn("#");
+        ImGui::TableSetupColumn("Song", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Settings");
+        ImGui::TableSetupColumn("Edit");
+
+        for (int i = 0; i < static_cast<int>(entries.size()); ++i)
+        {
+            const SetlistEntry& entry = entries[static_cast<size_t>(i)];
+            ImGui::TableNextRow();
+            ImGui::PushID(i);
+
+            const bool isCurrent = (i == setlist.currentIndex());
+            if (isCurrent)
+                ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.2f, 0.5f, 1.0f, 1.0f));
+
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", i + 1);
+
+            ImGui::TableNextColumn();
+            if (ImGui::Selectable(Utils::getFileNameInPlace(entry.audioPath), isCurrent, ImGuiSelectableFlags_AllowDoubleClick)
+                && ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+            {
+                result.action = Action::PlayEntry;
+                result.index = i;
+            }
+            ImGui::SetItemTooltip("%s", entry.audioPath.c_str());
+
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(entry.settingsPath.empty() ? "" : "yes");
+
+            if (isCurrent)
+                ImGui::PopStyleColor();
+
+            ImGui::TableNextColumn();
+            if (ImGui::SmallButton(ICON_FA_ARROW_UP) && i > 0)
+            {
+                moveFrom = i;
+                moveTo = i - 1;
+            }
+            ImGui::SameLine();
+            if (ImGui::SmallButton(ICON_FA_ARROW_DOWN) && i + 1 < static_cast<int>(entries.size()))
+            {
+                moveFrom = i;
+                moveTo = i + 1;
+            }
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Del"))
+                entryToRemove = i;
+
+            ImGui::PopID();
+        }
+        ImGui::EndTable();
+    }
+
+    if (moveFrom >= 0)
+    {
+        setlist.move(static_cast<size_t>(moveFrom), static_cast<size_t>(moveTo));
+        result.action = Action::Edited;
+    }
+    if (entryToRemove >= 0)
+    {
+        setlist.remove(static_cast<size_t>(entryToRemove));
+        result.action = Action::Edited;
+    }
+
+    ImGui::End();
+    return result;
+}
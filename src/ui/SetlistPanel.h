@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+class Setlist;
+
+// "Setlist" window: song order, load/save and the preload state of the next song
+class SetlistPanel
+{
+public:
+    enum class Action
+    {
+        None,
+        PlayEntry,        // index holds the entry
+        PlayNext,
+        AddCurrentTrack,
+        Edited            // Order or contents changed
+    };
+
+    struct Result
+    {
+        Action action = Action::None;
+        int index = -1;
+    };
+
+    bool isOpen() const { return m_open; }
+    void setOpen(bool open) { m_open = open; }
+
+    // preloadStatus: one line describing whether the next song is ready
+    Result render(Setlist& setlist, const char* preloadStatus);
+
+private:
+    bool m_open = false;
+    std::string m_filePath;
+};
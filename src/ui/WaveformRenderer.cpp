@@ -1,9 +1,47 @@
 #include "WaveformRenderer.h"
+#include "audio/PcmStore.h"
+#include "audio/PitchDetection.h"
+#include "core/Trace.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <limits>
 #include "implot/implot.h"
 
+namespace
+{
+    constexpr float kCoarseScale = 127.0f;
+    constexpr float kFineScale = 32767.0f;
+    constexpr uint32_t kPitchLevelFactor = 4;
+    constexpr size_t kMaxPitchLevels = 6;
+    constexpr float kMinNoteSpan = 12.0f;  // The note axis shows at least an octave
+    constexpr float kDefaultNoteMin = 48.0f;  // C3 to C6 until a contour sets the range
+    constexpr float kDefaultNoteMax = 84.0f;
+
+    using Clock = std::chrono::steady_clock;
+
+    double elapsedMs(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Min values round down and max values round up so the quantized
+    // envelope never looks thinner than the real signal.
+    template <typename T>
+    T quantizeMin(float value, float scale)
+    {
+        const float scaled = std::floor(std::clamp(value, -1.0f, 1.0f) * scale);
+        return static_cast<T>(scaled);
+    }
+
+    template <typename T>
+    T quantizeMax(float value, float scale)
+    {
+        const float scaled = std::ceil(std::clamp(value, -1.0f, 1.0f) * scale);
+        return static_cast<T>(scaled);
+    }
+}
 
 void WaveformRenderer::clear()
 {
@@ -12,33 +50,71 @@ void WaveformRenderer::clear()
     m_frameCount = 0;
     m_durationSeconds = 0.0f;
     m_levels.clear();
+    m_droppedLevels = 0;
+    m_channelLabels.clear();
+    m_geometry = GeometryCache{};
+}
+
+void WaveformRenderer::setPrecision(EnvelopePrecision precision)
+{
+    m_precision = precision;
 }
 
-void WaveformRenderer::setWaveform(const std::vector<float>& interleavedSamples,
-                                   uint32_t channelCount,
-                                   uint32_t sampleRate)
+EnvelopePrecision WaveformRenderer::precision() const
 {
+    return m_precision;
+}
+
+void WaveformRenderer::setWaveform(const PcmStore& pcm)
+{
+    Trace::Span span("Build waveform");
     clear();
 
-    if (interleavedSamples.empty() || channelCount == 0 || sampleRate == 0)
+    const uint32_t channelCount = pcm.channelCount();
+    const uint32_t sampleRate = pcm.sampleRate();
+    if (pcm.empty() || channelCount == 0 || sampleRate == 0)
         return;
 
     m_channelCount = channelCount;
     m_sampleRate = sampleRate;
-    m_frameCount = static_cast<uint64_t>(interleavedSamples.size()) / channelCount;
+    m_frameCount = pcm.frameCount();
     m_durationSeconds = static_cast<float>(m_frameCount) / static_cast<float>(sampleRate);
 
+    for (uint32_t channel = 0; channel < channelCount; ++channel)
+    {
+        m_channelLabels.push_back((channelCount > 1)
+                                      ? "Channel " + std::to_string(channel + 1)
+                                      : "Waveform");
+    }
+
     for (uint32_t samplesPerBucket : m_bucketTargets)
     {
         if (samplesPerBucket > m_frameCount)
             break;
-        m_levels.push_back(buildLevel(interleavedSamples, channelCount, sampleRate, samplesPerBucket));
+        m_levels.push_back(makeLevel(samplesPerBucket));
     }
 
     if (m_levels.empty())
     {
         const uint32_t bucketSize = static_cast<uint32_t>(std::max<uint64_t>(1, m_frameCount / 512));
-        m_levels.push_back(buildLevel(interleavedSamples, channelCount, sampleRate, bucketSize));
+        m_levels.push_back(makeLevel(bucketSize));
+    }
+
+    // All levels fill in one pass over the blocks, so a paged store is read only once
+    std::vector<BucketAccumulator> accumulators(m_levels.size());
+    for (BucketAccumulator& accumulator : accumulators)
+        accumulator.reset(channelCount);
+
+    pcm.forEachBlock([this, &accumulators](const float* frames, uint64_t frameCount) {
+        for (size_t index = 0; index < m_levels.size(); ++index)
+            accumulateLevel(m_levels[index], accumulators[index], frames, frameCount);
+        return true;
+    });
+
+    for (size_t index = 0; index < m_levels.size(); ++index)
+    {
+        if (accumulators[index].framesInBucket > 0)
+            storeBucket(m_levels[index], accumulators[index]);
     }
 }
 
@@ -47,18 +123,156 @@ bool WaveformRenderer::hasWaveform() const
     return !m_levels.empty();
 }
 
+size_t WaveformRenderer::memoryUsageBytes() const
+{
+    size_t bytes = 0;
+    for (const WaveformLevel& level : m_levels)
+    {
+        for (const ChannelEnvelope& envelope : level.channels)
+        {
+            bytes += envelope.coarse.capacity() * sizeof(int8_t);
+            bytes += envelope.fine.capacity() * sizeof(int16_t);
+        }
+    }
+    for (const PitchLevel& level : m_pitchLevels)
+        bytes += level.notes.capacity() * sizeof(float);
+    return bytes;
+}
+
+size_t WaveformRenderer::dropFinestLevel()
+{
+    if (m_levels.size() <= 1)
+        return 0;
+
+    size_t bytes = 0;
+    for (const ChannelEnvelope& envelope : m_levels.front().channels)
+        bytes += envelope.coarse.capacity() * sizeof(int8_t) + envelope.fine.capacity() * sizeof(int16_t);
+
+    m_levels.erase(m_levels.begin());
+    ++m_droppedLevels;
+    m_geometry = GeometryCache{};  // Level indices shifted
+    return bytes;
+}
+
+bool WaveformRenderer::hasDroppedLevels() const
+{
+    return m_droppedLevels > 0;
+}
+
+const WaveformRenderer::DrawStats& WaveformRenderer::drawStats() const
+{
+    return m_drawStats;
+}
+
+void WaveformRenderer::setPitchContour(const PitchContour& contour)
+{
+    m_pitchLevels.clear();
+    m_pitchGeometry = PitchGeometry{};
+    setNoteRange(kDefaultNoteMin, kDefaultNoteMax);
+
+    std::vector<float> voiced;
+    for (const float note : contour.notes)
+    {
+        if (!std::isnan(note))
+            voiced.push_back(note);
+    }
+    if (voiced.empty() || contour.sampleRate == 0)
+        return;
+    m_pitchSecondsPerValue = static_cast<double>(contour.hopFrames) / contour.sampleRate;
+
+    // The axis covers all but the outermost 2% of notes, so stray octave errors do not squash it
+    const size_t low = voiced.size() / 50;
+    const size_t high = voiced.size() - 1 - low;
+    std::nth_element(voiced.begin(), voiced.begin() + low, voiced.end());
+    const float noteMin = std::floor(voiced[low]) - 2.0f;
+    std::nth_element(voiced.begin(), voiced.begin() + high, voiced.end());
+    const float noteMax = std::ceil(voiced[high]) + 2.0f;
+    setNoteRange(noteMin, noteMax);
+
+    m_pitchLevels.push_back(PitchLevel{1, contour.notes});
+    while (m_pitchLevels.size() < kMaxPitchLevels && m_pitchLevels.back().notes.size() > kPitchLevelFactor)
+    {
+        const PitchLevel& finer = m_pitchLevels.back();
+        PitchLevel level;
+        level.valuesPerPoint = finer.valuesPerPoint * kPitchLevelFactor;
+        level.notes.resize((finer.notes.size() + kPitchLevelFactor - 1) / kPitchLevelFactor);
+        for (size_t point = 0; point < level.notes.size(); ++point)
+        {
+            const size_t begin = point * kPitchLevelFactor;
+            const size_t end = std::min(begin + kPitchLevelFactor, finer.notes.size());
+            float sum = 0.0f;
+            size_t count = 0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                if (!std::isnan(finer.notes[i]))
+                {
+                    sum += finer.notes[i];
+                    ++count;
+                }
+            }
+            level.notes[point] = (2 * count >= end - begin) ? sum / static_cast<float>(count)
+                                                             : std::numeric_limits<float>::quiet_NaN();
+        }
+        m_pitchLevels.push_back(std::move(level));
+    }
+}
+
+bool WaveformRenderer::hasPitchContour() const
+{
+    return !m_pitchLevels.empty();
+}
+
+void WaveformRenderer::setLivePitch(const std::vector<float>& times, const std::vector<float>& notes)
+{
+    // Assigned into the existing buffers: this runs every frame while the mic is on
+    const size_t count = std::min(times.size(), notes.size());
+    m_liveTimes.assign(times.begin(), times.begin() + static_cast<ptrdiff_t>(count));
+    m_liveNotes.assign(notes.begin(), notes.begin() + static_cast<ptrdiff_t>(count));
+    if (m_noteLanes.empty())
+        setNoteRange(kDefaultNoteMin, kDefaultNoteMax);
+}
+
+void WaveformRenderer::setNoteRange(float noteMin, float noteMax)
+{
+    m_noteMin = noteMin;
+    m_noteMax = noteMax;
+    if (m_noteMax - m_noteMin < kMinNoteSpan)
+    {
+        const float centre = std::round(0.5f * (m_noteMin + m_noteMax));
+        m_noteMin = centre - kMinNoteSpan / 2.0f;
+        m_noteMax = centre + kMinNoteSpan / 2.0f;
+    }
+
+    m_noteLanes.clear();
+    m_octaveLanes.clear();
+    m_octaveLabels.clear();
+    for (int note = static_cast<int>(m_noteMin); note <= static_cast<int>(m_noteMax); ++note)
+    {
+        m_noteLanes.push_back(static_cast<float>(note));
+        if (note % 12 == 0)
+        {
+            m_octaveLanes.push_back(static_cast<float>(note));
+            m_octaveLabels.push_back("C" + std::to_string(note / 12 - 1));
+        }
+    }
+}
+
 bool WaveformRenderer::draw(const char* plotId,
                             const ImVec2& size,
                             float currentTimeSeconds,
                             float& outSeekTimeSeconds,
+                            bool& outCursorHeld,
                             const std::vector<MarkerView>& markers,
                             int currentMarkerIndex) const
 {
     outSeekTimeSeconds = currentTimeSeconds;
+    outCursorHeld = false;
 
     if (!hasWaveform())
         return false;
 
+    Trace::Span span("Draw waveform");
+    const Clock::time_point drawStart = Clock::now();
     bool dragged = false;
 
     ImPlot::PushStyleVar(ImPlotStyleVar_PlotPadding, ImVec2(10.0f, 6.0f));
@@ -69,6 +283,12 @@ bool WaveformRenderer::draw(const char* plotId,
         ImPlot::SetupAxisLimits(ImAxis_X1, 0.0, m_durationSeconds, ImGuiCond_Always);
         ImPlot::SetupAxisLimits(ImAxis_Y1, -1.0, 1.0, ImGuiCond_Always);
         ImPlot::SetupAxes(nullptr, nullptr, axisFlags, axisFlags);
+        const bool showNotes = hasPitchContour() || !m_liveTimes.empty();
+        if (showNotes)
+        {
+            ImPlot::SetupAxis(ImAxis_Y2, nullptr, ImPlotAxisFlags_NoDecorations | ImPlotAxisFlags_Lock);
+            ImPlot::SetupAxisLimits(ImAxis_Y2, m_noteMin, m_noteMax, ImGuiCond_Always);
+        }
 
         const ImPlotRect limits = ImPlot::GetPlotLimits();
         const float visibleDuration = static_cast<float>(limits.X.Max - limits.X.Min);
@@ -76,26 +296,51 @@ bool WaveformRenderer::draw(const char* plotId,
         const float samplesPerPixel = (visibleDuration <= 0.0f || plotPixelWidth <= 0.0f)
                                           ? static_cast<float>(m_frameCount)
                                           : (visibleDuration * m_sampleRate) / plotPixelWidth;
-        const WaveformLevel* level = pickLevel(samplesPerPixel);
-        if (level != nullptr)
+        const size_t levelIndex = pickLevel(samplesPerPixel);
+        const ImVec2 plotSize = ImPlot::GetPlotSize();
+        const bool cacheValid = m_geometry.valid
+                                && m_geometry.levelIndex == levelIndex
+                                && m_geometry.viewMin == limits.X.Min
+                                && m_geometry.viewMax == limits.X.Max
+                                && m_geometry.plotSize.x == plotSize.x
+                                && m_geometry.plotSize.y == plotSize.y;
+        if (cacheValid)
         {
-            for (uint32_t channel = 0; channel < level->channels.size(); ++channel)
-            {
-                const ChannelEnvelope& envelope = level->channels[channel];
-                const std::string label = (m_channelCount > 1)
-                                              ? "Channel " + std::to_string(channel + 1)
-                                              : "Waveform";
-                //ImPlot::PushStyleColor(ImPlotCol_Line, IM_COL32(100, 180, 255, 255));
-                ImPlot::PlotShaded(label.c_str(),
-                                   level->times.data(),
-                                   envelope.minValues.data(),
-                                   envelope.maxValues.data(),
-                                   static_cast<int>(level->times.size()));
-                //ImPlot::PopStyleColor();
-            }
+            ++m_drawStats.geometryCacheHits;
+        }
+        else
+        {
+            const Clock::time_point buildStart = Clock::now();
+            rebuildGeometry(levelIndex, limits.X.Min, limits.X.Max, plotSize);
+            m_drawStats.lastGeometryBuildMs = elapsedMs(buildStart);
+            ++m_drawStats.geometryCacheMisses;
         }
+        m_drawStats.lastDrawWasCached = cacheValid;
 
-        for (size_t i = 0; i < markers.size(); ++i)
+        const Clock::time_point shadedStart = Clock::now();
+        const int pointCount = static_cast<int>(m_geometry.times.size());
+        for (size_t channel = 0; channel < m_geometry.minValues.size() && pointCount > 0; ++channel)
+        {
+            //ImPlot::PushStyleColor(ImPlotCol_Line, IM_COL32(100, 180, 255, 255));
+            ImPlot::PlotShaded(m_channelLabels[channel].c_str(),
+                               m_geometry.times.data(),
+                               m_geometry.minValues[channel].data(),
+                               m_geometry.maxValues[channel].data(),
+                               pointCount);
+            //ImPlot::PopStyleColor();
+        }
+        m_drawStats.lastShadedMs = elapsedMs(shadedStart);
+
+        if (showNotes)
+            drawPitch(limits.X.Min, limits.X.Max, plotPixelWidth);
+
+        // Markers are sorted by time, so only the ones inside the viewport are visited
+        const auto byTime = [](const MarkerView& marker, double time) { return marker.timeSeconds < time; };
+        const size_t firstMarker = static_cast<size_t>(
+            std::lower_bound(markers.begin(), markers.end(), limits.X.Min, byTime) - markers.begin());
+
+        ImGui::PushID("Markers");
+        for (size_t i = firstMarker; i < markers.size() && markers[i].timeSeconds <= limits.X.Max; ++i)
         {
             const auto& marker = markers[i];
             double markerX = marker.timeSeconds;
@@ -104,14 +349,14 @@ bool WaveformRenderer::draw(const char* plotId,
             const ImVec4 color = isCurrent
                 ? ImVec4(0.2f, 0.5f, 1.0f, 1.0f)   // Blue for current
                 : ImVec4(0.6f, 0.6f, 0.65f, 0.8f);  // Grayish for others
-            const std::string id = "Marker##" + marker.label;
             ImPlot::TagX(markerX, color, "%s", marker.label.c_str());
-            ImPlot::DragLineX(ImGui::GetID(id.c_str()),
+            ImPlot::DragLineX(ImGui::GetID(static_cast<int>(i)),
                                   &markerX,
                                   color,
                                   1.0f,
                                   ImPlotDragToolFlags_NoInputs);
         }
+        ImGui::PopID();
 
         double cursorValue = static_cast<double>(currentTimeSeconds);
         const ImPlotDragToolFlags cursorFlags = ImPlotDragToolFlags_NoFit;
@@ -130,79 +375,252 @@ bool WaveformRenderer::draw(const char* plotId,
             dragged = true;
             outSeekTimeSeconds = static_cast<float>(cursorValue);
         }
+        outCursorHeld = held;
 
         ImPlot::EndPlot();
     }
     ImPlot::PopStyleVar();
 
+    m_drawStats.lastDrawMs = elapsedMs(drawStart);
     return dragged;
 }
 
-WaveformRenderer::WaveformLevel WaveformRenderer::buildLevel(const std::vector<float>& interleavedSamples,
-                                                             uint32_t channelCount,
-                                                             uint32_t sampleRate,
-                                                             uint32_t samplesPerBucket) const
+WaveformRenderer::WaveformLevel WaveformRenderer::makeLevel(uint32_t samplesPerBucket) const
 {
     WaveformLevel level;
     level.samplesPerBucket = samplesPerBucket;
     const uint64_t bucketCount = (m_frameCount + samplesPerBucket - 1) / samplesPerBucket;
-    level.times.resize(bucketCount);
-    level.channels.resize(channelCount);
+    level.bucketCount = bucketCount;
+    level.channels.resize(m_channelCount);
 
-    for (uint32_t channel = 0; channel < channelCount; ++channel)
+    const bool fine = (m_precision == EnvelopePrecision::Int16);
+    for (ChannelEnvelope& envelope : level.channels)
     {
-        ChannelEnvelope& envelope = level.channels[channel];
-        envelope.minValues.resize(bucketCount);
-        envelope.maxValues.resize(bucketCount);
+        if (fine)
+            envelope.fine.resize(bucketCount * 2);
+        else
+            envelope.coarse.resize(bucketCount * 2);
     }
 
-    for (uint64_t bucketIndex = 0; bucketIndex < bucketCount; ++bucketIndex)
-    {
-        const uint64_t frameStart = bucketIndex * samplesPerBucket;
-        const uint64_t frameEnd = std::min<uint64_t>(frameStart + samplesPerBucket, m_frameCount);
-        const uint64_t framesInBucket = frameEnd - frameStart;
-        if (framesInBucket == 0)
-            continue;
+    return level;
+}
 
-        level.times[bucketIndex] = static_cast<float>(frameStart) / static_cast<float>(sampleRate);
+void WaveformRenderer::BucketAccumulator::reset(uint32_t channelCount)
+{
+    minSamples.assign(channelCount, 1.0f);
+    maxSamples.assign(channelCount, -1.0f);
+    framesInBucket = 0;
+}
 
-        for (uint32_t channel = 0; channel < channelCount; ++channel)
+void WaveformRenderer::accumulateLevel(WaveformLevel& level,
+                                       BucketAccumulator& accumulator,
+                                       const float* frames,
+                                       uint64_t frameCount) const
+{
+    uint64_t position = 0;
+    while (position < frameCount)
+    {
+        // A bucket may straddle two blocks; the accumulator carries it over
+        const uint64_t count = std::min<uint64_t>(frameCount - position, level.samplesPerBucket - accumulator.framesInBucket);
+        for (uint32_t channel = 0; channel < m_channelCount; ++channel)
         {
-            float minSample = 1.0f;
-            float maxSample = -1.0f;
-            const uint64_t channelOffset = channel;
-            const uint64_t startIndex = (frameStart * channelCount) + channelOffset;
-            for (uint64_t frame = 0; frame < framesInBucket; ++frame)
+            float minSample = accumulator.minSamples[channel];
+            float maxSample = accumulator.maxSamples[channel];
+            const float* samples = frames + position * m_channelCount + channel;
+            for (uint64_t frame = 0; frame < count; ++frame)
             {
-                const float sample = interleavedSamples[startIndex + frame * channelCount];
+                const float sample = samples[frame * m_channelCount];
                 minSample = std::min(minSample, sample);
                 maxSample = std::max(maxSample, sample);
             }
-            level.channels[channel].minValues[bucketIndex] = minSample;
-            level.channels[channel].maxValues[bucketIndex] = maxSample;
+            accumulator.minSamples[channel] = minSample;
+            accumulator.maxSamples[channel] = maxSample;
         }
+
+        accumulator.framesInBucket += count;
+        position += count;
+        if (accumulator.framesInBucket == level.samplesPerBucket)
+            storeBucket(level, accumulator);
     }
+}
 
-    return level;
+void WaveformRenderer::storeBucket(WaveformLevel& level, BucketAccumulator& accumulator) const
+{
+    const uint64_t bucketIndex = accumulator.bucketIndex++;
+    const bool fine = (m_precision == EnvelopePrecision::Int16);
+    for (uint32_t channel = 0; channel < m_channelCount; ++channel)
+    {
+        ChannelEnvelope& envelope = level.channels[channel];
+        if (fine)
+        {
+            envelope.fine[bucketIndex * 2] = quantizeMin<int16_t>(accumulator.minSamples[channel], kFineScale);
+            envelope.fine[bucketIndex * 2 + 1] = quantizeMax<int16_t>(accumulator.maxSamples[channel], kFineScale);
+        }
+        else
+        {
+            envelope.coarse[bucketIndex * 2] = quantizeMin<int8_t>(accumulator.minSamples[channel], kCoarseScale);
+            envelope.coarse[bucketIndex * 2 + 1] = quantizeMax<int8_t>(accumulator.maxSamples[channel], kCoarseScale);
+        }
+    }
+    accumulator.reset(m_channelCount);
 }
 
-const WaveformRenderer::WaveformLevel* WaveformRenderer::pickLevel(float samplesPerPixel) const
+void WaveformRenderer::rebuildGeometry(size_t levelIndex,
+                                       double viewMin,
+                                       double viewMax,
+                                       const ImVec2& plotSize) const
 {
-    if (m_levels.empty())
-        return nullptr;
+    Trace::Span span("Waveform geometry");
+    m_geometry.valid = true;
+    m_geometry.levelIndex = levelIndex;
+    m_geometry.viewMin = viewMin;
+    m_geometry.viewMax = viewMax;
+    m_geometry.plotSize = plotSize;
 
-    const WaveformLevel* bestLevel = &m_levels.front();
-    float bestDifference = std::abs(static_cast<float>(bestLevel->samplesPerBucket) - samplesPerPixel);
+    const WaveformLevel& level = m_levels[levelIndex];
+    const size_t channelCount = level.channels.size();
+    m_geometry.minValues.resize(channelCount);
+    m_geometry.maxValues.resize(channelCount);
+    m_geometry.times.clear();
+    if (level.bucketCount == 0)
+        return;
 
-    for (const WaveformLevel& level : m_levels)
+    // Only dequantize the buckets that fall inside the visible range
+    const double bucketSeconds = static_cast<double>(level.samplesPerBucket) / m_sampleRate;
+    const double firstVisible = std::max(0.0, std::floor(viewMin / bucketSeconds));
+    const double lastVisible = std::max(0.0, std::ceil(viewMax / bucketSeconds));
+    const uint64_t firstBucket = std::min<uint64_t>(static_cast<uint64_t>(firstVisible), level.bucketCount - 1);
+    const uint64_t lastBucket = std::min<uint64_t>(static_cast<uint64_t>(lastVisible) + 1, level.bucketCount);
+    const uint64_t bucketCount = lastBucket - firstBucket;
+
+    // Merge buckets so that no more than one point lands on each pixel column
+    const uint64_t columns = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(plotSize.x)));
+    const uint64_t bucketsPerPoint = std::max<uint64_t>(1, (bucketCount + columns - 1) / columns);
+    const size_t pointCount = static_cast<size_t>((bucketCount + bucketsPerPoint - 1) / bucketsPerPoint);
+
+    m_geometry.times.resize(pointCount);
+    for (size_t point = 0; point < pointCount; ++point)
+        m_geometry.times[point] = static_cast<float>((firstBucket + point * bucketsPerPoint) * bucketSeconds);
+
+    for (size_t channel = 0; channel < channelCount; ++channel)
+    {
+        const ChannelEnvelope& envelope = level.channels[channel];
+        std::vector<float>& minValues = m_geometry.minValues[channel];
+        std::vector<float>& maxValues = m_geometry.maxValues[channel];
+        minValues.resize(pointCount);
+        maxValues.resize(pointCount);
+
+        const bool fine = !envelope.fine.empty();
+        const float scale = fine ? kFineScale : kCoarseScale;
+        for (size_t point = 0; point < pointCount; ++point)
+        {
+            const uint64_t begin = firstBucket + point * bucketsPerPoint;
+            const uint64_t end = std::min(begin + bucketsPerPoint, lastBucket);
+            int minQuantized = fine ? envelope.fine[begin * 2] : envelope.coarse[begin * 2];
+            int maxQuantized = fine ? envelope.fine[begin * 2 + 1] : envelope.coarse[begin * 2 + 1];
+            for (uint64_t bucket = begin + 1; bucket < end; ++bucket)
+            {
+                const int bucketMin = fine ? envelope.fine[bucket * 2] : envelope.coarse[bucket * 2];
+                const int bucketMax = fine ? envelope.fine[bucket * 2 + 1] : envelope.coarse[bucket * 2 + 1];
+                minQuantized = std::min(minQuantized, bucketMin);
+                maxQuantized = std::max(maxQuantized, bucketMax);
+            }
+            minValues[point] = static_cast<float>(minQuantized) / scale;
+            maxValues[point] = static_cast<float>(maxQuantized) / scale;
+        }
+    }
+}
+
+void WaveformRenderer::drawPitch(double viewMin, double viewMax, float plotPixelWidth) const
+{
+    ImPlot::SetAxes(ImAxis_X1, ImAxis_Y2);
+
+    ImPlot::PushStyleColor(ImPlotCol_Line, ImVec4(1.0f, 1.0f, 1.0f, 0.06f));
+    ImPlot::PlotInfLines("##NoteLanes", m_noteLanes.data(), static_cast<int>(m_noteLanes.size()),
+                         ImPlotInfLinesFlags_Horizontal);
+    ImPlot::PopStyleColor();
+    ImPlot::PushStyleColor(ImPlotCol_Line, ImVec4(1.0f, 1.0f, 1.0f, 0.2f));
+    ImPlot::PlotInfLines("##OctaveLanes", m_octaveLanes.data(), static_cast<int>(m_octaveLanes.size()),
+                         ImPlotInfLinesFlags_Horizontal);
+    ImPlot::PopStyleColor();
+    for (size_t i = 0; i < m_octaveLanes.size(); ++i)
+        ImPlot::PlotText(m_octaveLabels[i].c_str(), viewMin, m_octaveLanes[i], ImVec2(12.0f, -7.0f));
+
+    if (hasPitchContour())
+        drawPitchContour(viewMin, viewMax, plotPixelWidth);
+
+    if (!m_liveTimes.empty())
+    {
+        ImPlot::PushStyleColor(ImPlotCol_Line, ImVec4(0.3f, 0.9f, 1.0f, 1.0f));
+        ImPlot::PushStyleVar(ImPlotStyleVar_LineWeight, 2.5f);
+        ImPlot::PlotLine("##LivePitch", m_liveTimes.data(), m_liveNotes.data(),
+                         static_cast<int>(m_liveTimes.size()));
+        ImPlot::PopStyleVar();
+        ImPlot::PopStyleColor();
+    }
+
+    ImPlot::SetAxes(ImAxis_X1, ImAxis_Y1);
+}
+
+void WaveformRenderer::drawPitchContour(double viewMin, double viewMax, float plotPixelWidth) const
+{
+    // The coarsest level that still has a point for every pixel column
+    const double valuesPerPixel = (plotPixelWidth > 0.0f)
+                                      ? (viewMax - viewMin) / m_pitchSecondsPerValue / plotPixelWidth
+                                      : 1.0;
+    size_t levelIndex = 0;
+    while (levelIndex + 1 < m_pitchLevels.size() && m_pitchLevels[levelIndex + 1].valuesPerPoint <= valuesPerPixel)
+        ++levelIndex;
+    if (!m_pitchGeometry.valid || m_pitchGeometry.levelIndex != levelIndex
+        || m_pitchGeometry.viewMin != viewMin || m_pitchGeometry.viewMax != viewMax)
+        rebuildPitchGeometry(levelIndex, viewMin, viewMax);
+
+    // Unvoiced (NaN) values leave gaps in the line
+    ImPlot::PushStyleColor(ImPlotCol_Line, ImVec4(1.0f, 0.8f, 0.2f, 0.9f));
+    ImPlot::PushStyleVar(ImPlotStyleVar_LineWeight, 2.0f);
+    ImPlot::PlotLine("##Pitch", m_pitchGeometry.times.data(), m_pitchGeometry.notes.data(),
+                     static_cast<int>(m_pitchGeometry.times.size()));
+    ImPlot::PopStyleVar();
+    ImPlot::PopStyleColor();
+}
+
+void WaveformRenderer::rebuildPitchGeometry(size_t levelIndex, double viewMin, double viewMax) const
+{
+    m_pitchGeometry.valid = true;
+    m_pitchGeometry.levelIndex = levelIndex;
+    m_pitchGeometry.viewMin = viewMin;
+    m_pitchGeometry.viewMax = viewMax;
+    m_pitchGeometry.times.clear();
+    m_pitchGeometry.notes.clear();
+
+    // One point outside the view on each side, so lines run to the edges
+    const PitchLevel& level = m_pitchLevels[levelIndex];
+    const double pointSeconds = m_pitchSecondsPerValue * level.valuesPerPoint;
+    const size_t first = static_cast<size_t>(std::max(0.0, std::floor(viewMin / pointSeconds) - 1.0));
+    const size_t last = std::min(level.notes.size(), static_cast<size_t>(std::max(0.0, std::ceil(viewMax / pointSeconds) + 2.0)));
+    for (size_t point = first; point < last; ++point)
+    {
+        // Level points cover several values; they sit at the centre of their span
+        const double offset = 0.5 * (level.valuesPerPoint - 1) * m_pitchSecondsPerValue;
+        m_pitchGeometry.times.push_back(static_cast<float>(point * pointSeconds + offset));
+        m_pitchGeometry.notes.push_back(level.notes[point]);
+    }
+}
+
+size_t WaveformRenderer::pickLevel(float samplesPerPixel) const
+{
+    size_t bestIndex = 0;
+    float bestDifference = std::abs(static_cast<float>(m_levels.front().samplesPerBucket) - samplesPerPixel);
+
+    for (size_t index = 1; index < m_levels.size(); ++index)
     {
-        const float difference = std::abs(static_cast<float>(level.samplesPerBucket) - samplesPerPixel);
+        const float difference = std::abs(static_cast<float>(m_levels[index].samplesPerBucket) - samplesPerPixel);
         if (difference < bestDifference)
         {
             bestDifference = difference;
-            bestLevel = &level;
+            bestIndex = index;
         }
     }
 
-    return bestLevel;
+    return bestIndex;
 }
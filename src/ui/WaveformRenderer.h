@@ -6,52 +6,172 @@
 
 #include "imgui.h"
 
+class PcmStore;
+struct PitchContour;
+
 struct MarkerView
 {
     std::string label;
     float timeSeconds = 0.0f;
 };
 
+// Storage precision of the min/max envelope pyramid.
+// Int8 is plenty for a plot a few hundred pixels high; Int16 (the "High-Precision Waveform"
+// preference) keeps quiet passages legible when zoomed in.
+enum class EnvelopePrecision
+{
+    Int8,
+    Int16
+};
+
 class WaveformRenderer
 {
 public:
+    // Timing of the last draw() call, used to keep an eye on the waveform's frame cost
+    struct DrawStats
+    {
+        double lastDrawMs = 0.0;
+        double lastShadedMs = 0.0;  // Handing the body to ImPlot, which tessellates it every frame
+        double lastGeometryBuildMs = 0.0;
+        uint64_t geometryCacheHits = 0;
+        uint64_t geometryCacheMisses = 0;
+        bool lastDrawWasCached = false;
+    };
+
     WaveformRenderer() = default;
     void clear();
-    void setWaveform(const std::vector<float>& interleavedSamples,
-                     uint32_t channelCount,
-                     uint32_t sampleRate);
+    // Takes effect on the next setWaveform()
+    void setPrecision(EnvelopePrecision precision);
+    EnvelopePrecision precision() const;
+    // Reads the store block by block; safe to call on a loader thread
+    void setWaveform(const PcmStore& pcm);
     bool hasWaveform() const;
+    size_t memoryUsageBytes() const;
+    // Memory pressure: frees the most detailed level, keeping at least one.
+    // The full pyramid comes back with the next setWaveform(). Returns the bytes released.
+    size_t dropFinestLevel();
+    bool hasDroppedLevels() const;
+    const DrawStats& drawStats() const;
+    // Pitch contour drawn over the waveform on note lanes; an empty contour removes it.
+    // Independent of setWaveform() and clear(), which only concern the amplitude envelope.
+    void setPitchContour(const PitchContour& contour);
+    bool hasPitchContour() const;
+    // Live pitch of the microphone as track times (seconds) and notes, NaN breaking the
+    // line; drawn over the contour, or on default note lanes without one. Empty hides it.
+    void setLivePitch(const std::vector<float>& times, const std::vector<float>& notes);
+    // markers must be sorted by time; only those inside the visible range are drawn.
+    // Returns true when the playback cursor was moved; outCursorHeld stays true while the
+    // mouse holds it, with outSeekTimeSeconds following the drag.
     bool draw(const char* plotId,
               const ImVec2& size,
               float currentTimeSeconds,
               float& outSeekTimeSeconds,
+              bool& outCursorHeld,
               const std::vector<MarkerView>& markers,
               int currentMarkerIndex = -1) const;
 
 private:
     struct ChannelEnvelope
     {
-        std::vector<float> minValues;
-        std::vector<float> maxValues;
+        // Interleaved (min, max) pairs per bucket; only the vector matching the
+        // renderer precision is populated.
+        std::vector<int8_t> coarse;
+        std::vector<int16_t> fine;
     };
 
     struct WaveformLevel
     {
         uint32_t samplesPerBucket = 0;
-        std::vector<float> times;
+        uint64_t bucketCount = 0;
         std::vector<ChannelEnvelope> channels;
     };
 
-    WaveformLevel buildLevel(const std::vector<float>& interleavedSamples,
-                             uint32_t channelCount,
-                             uint32_t sampleRate,
-                             uint32_t samplesPerBucket) const;
-    const WaveformLevel* pickLevel(float samplesPerPixel) const;
+    // Running min/max of the bucket being filled, per channel
+    struct BucketAccumulator
+    {
+        std::vector<float> minSamples;
+        std::vector<float> maxSamples;
+        uint64_t framesInBucket = 0;
+        uint64_t bucketIndex = 0;
+
+        void reset(uint32_t channelCount);
+    };
+
+    WaveformLevel makeLevel(uint32_t samplesPerBucket) const;
+    void accumulateLevel(WaveformLevel& level,
+                         BucketAccumulator& accumulator,
+                         const float* frames,
+                         uint64_t frameCount) const;
+    void storeBucket(WaveformLevel& level, BucketAccumulator& accumulator) const;
+    // Shaded waveform body in plot coordinates, reduced to at most one point per
+    // pixel column. Reused as long as level, viewport and plot size are unchanged.
+    // This saves reading and dequantizing the envelope, not the drawing: ImPlot is
+    // immediate-mode, so PlotShaded() still turns the arrays into two triangles per point
+    // and channel every frame (DrawStats::lastShadedMs).
+    struct GeometryCache
+    {
+        bool valid = false;
+        size_t levelIndex = 0;
+        double viewMin = 0.0;
+        double viewMax = 0.0;
+        ImVec2 plotSize;
+        std::vector<float> times;
+        std::vector<std::vector<float>> minValues;  // per channel
+        std::vector<std::vector<float>> maxValues;  // per channel
+    };
+
+    // Contour at decreasing detail: a value of each level is the mean of the voiced values
+    // it covers in the level before (NaN when most are unvoiced)
+    struct PitchLevel
+    {
+        uint32_t valuesPerPoint = 1;  // Contour values per entry of notes
+        std::vector<float> notes;
+    };
+
+    // Visible part of the contour, reused while the level and viewport are unchanged
+    struct PitchGeometry
+    {
+        bool valid = false;
+        size_t levelIndex = 0;
+        double viewMin = 0.0;
+        double viewMax = 0.0;
+        std::vector<float> times;
+        std::vector<float> notes;
+    };
+
+    size_t pickLevel(float samplesPerPixel) const;
+    void setNoteRange(float noteMin, float noteMax);
+    // Note lanes, the contour and the live pitch on the Y2 axis
+    void drawPitch(double viewMin, double viewMax, float plotPixelWidth) const;
+    void drawPitchContour(double viewMin, double viewMax, float plotPixelWidth) const;
+    void rebuildPitchGeometry(size_t levelIndex, double viewMin, double viewMax) const;
+    void rebuildGeometry(size_t levelIndex,
+                         double viewMin,
+                         double viewMax,
+                         const ImVec2& plotSize) const;
 
     uint32_t m_channelCount = 0;
     uint32_t m_sampleRate = 0;
     uint64_t m_frameCount = 0;
     float m_durationSeconds = 0.0f;
+    EnvelopePrecision m_precision = EnvelopePrecision::Int8;
     std::vector<WaveformLevel> m_levels;
+    size_t m_droppedLevels = 0;  // Since the last setWaveform()
     std::vector<uint32_t> m_bucketTargets = {64, 256, 1024, 4096, 16384};
+
+    std::vector<std::string> m_channelLabels;
+
+    std::vector<PitchLevel> m_pitchLevels;
+    double m_pitchSecondsPerValue = 0.0;
+    float m_noteMin = 0.0f;  // Note axis range
+    float m_noteMax = 0.0f;
+    std::vector<float> m_noteLanes;    // Every semitone in range
+    std::vector<float> m_octaveLanes;  // Every C in range
+    std::vector<std::string> m_octaveLabels;
+    std::vector<float> m_liveTimes;
+    std::vector<float> m_liveNotes;
+
+    mutable GeometryCache m_geometry;
+    mutable PitchGeometry m_pitchGeometry;
+    mutable DrawStats m_drawStats;
 };